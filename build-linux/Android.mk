@@ -55,6 +55,7 @@ LOCAL_SRC_FILES := \
     $(LOCAL_PATH)/../src/tbb/reader_writer_lock.cpp \
     $(LOCAL_PATH)/../src/tbb/recursive_mutex.cpp \
     $(LOCAL_PATH)/../src/tbb/scheduler.cpp \
+    $(LOCAL_PATH)/../src/tbb/scheduler_trace.cpp \
     $(LOCAL_PATH)/../src/tbb/semaphore.cpp \
     $(LOCAL_PATH)/../src/tbb/spin_mutex.cpp \
     $(LOCAL_PATH)/../src/tbb/spin_rw_mutex.cpp \
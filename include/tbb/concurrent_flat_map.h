@@ -0,0 +1,947 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef __TBB_concurrent_flat_map_H
+#define __TBB_concurrent_flat_map_H
+
+#define __TBB_concurrent_flat_map_H_include_area
+#include "internal/_warning_suppress_enable_notice.h"
+
+#if ! TBB_PREVIEW_CONCURRENT_FLAT_MAP
+    #error Set TBB_PREVIEW_CONCURRENT_FLAT_MAP to include concurrent_flat_map.h
+#endif
+
+#include "tbb_stddef.h"
+#include <iterator>
+#include <utility>      // Need std::pair
+#include <cstring>      // Need std::memset
+#include __TBB_STD_SWAP_HEADER
+
+#include "tbb_allocator.h"
+#include "atomic.h"
+#include "aligned_space.h"
+#include "tbb_machine.h"
+#include "task_arena.h"
+#include "internal/_tbb_hash_compare_impl.h"
+#include "internal/_allocator_traits.h"
+#if __TBB_CPP11_TYPE_PROPERTIES_PRESENT
+#include <type_traits>
+#endif
+
+#if (__TBB_x86_64 || __TBB_x86_32) && (__SSE2__ || _M_X64 || _M_IX86_FP >= 2)
+#define __TBB_FLAT_MAP_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace tbb {
+
+namespace interface5 {
+
+    template<typename Key, typename T, typename HashCompare = tbb_hash_compare<Key>, typename A = tbb_allocator<std::pair<Key, T> > >
+    class concurrent_flat_map;
+
+    //! @cond INTERNAL
+    namespace internal {
+    using namespace tbb::internal;
+
+    //! Number of slots in a group of concurrent_flat_map
+    static const size_t flat_map_group_size = 15;
+
+    //! Control part of a group of slots
+    /** The tags and the overflow bits are protected by a sequence lock, so that they can be read
+        without locking. The control part and the first slots share a cache line. */
+    struct flat_map_group_base {
+        //! Tag of an empty slot. Tags of the occupied slots have the highest bit set.
+        static const unsigned char empty_tag = 0;
+        //! Tags of the slots followed by the overflow bits of the group
+        /** A bit is set when an item hashed into it was placed further because the group was full. */
+        unsigned char my_tags[flat_map_group_size+1];
+        //! Sequence lock. It is odd while the group is modified.
+        atomic<unsigned> my_version;
+        //! Count of insertions of the keys which home group is this one
+        atomic<unsigned> my_inserts;
+
+        //! Returns bit mask of the slots with the tag
+        unsigned match( unsigned char tag ) const {
+#if __TBB_FLAT_MAP_USE_SSE2
+            __m128i tags = _mm_loadu_si128( reinterpret_cast<const __m128i*>(my_tags) );
+            unsigned m = (unsigned)_mm_movemask_epi8( _mm_cmpeq_epi8( tags, _mm_set1_epi8( (char)tag ) ) );
+            return m & ((1u<<flat_map_group_size)-1);
+#else
+            unsigned m = 0;
+            for( size_t i = 0; i < flat_map_group_size; ++i )
+                m |= unsigned(my_tags[i] == tag) << i;
+            return m;
+#endif
+        }
+        unsigned overflow() const { return my_tags[flat_map_group_size]; }
+        void set_overflow( unsigned bit ) { my_tags[flat_map_group_size] |= (unsigned char)bit; }
+        //! Reset the group to the empty state. Not thread safe.
+        void reset() {
+            std::memset( my_tags, 0, sizeof(my_tags) );
+            my_version = 0;
+            my_inserts = 0;
+        }
+    };
+
+    //! Group of slots stored inline
+    template<typename Value>
+    struct flat_map_group : flat_map_group_base {
+        aligned_space<Value, flat_map_group_size> my_slots;
+        Value& slot( size_t i ) { return my_slots.begin()[i]; }
+        const Value& slot( size_t i ) const { return my_slots.begin()[i]; }
+    };
+
+    //! Array of groups. The tables replaced by migration are retired until no concurrent reader can see them.
+    template<typename Value>
+    struct flat_map_table {
+        typedef flat_map_group<Value> group;
+        //! Number of groups - 1
+        size_t my_mask;
+        //! Groups of the table
+        group *my_groups;
+        //! The table retired before this one
+        flat_map_table *my_retired;
+        //! The epoch of the container when the table was retired
+        size_t my_retire_epoch;
+        //! The table that the items are migrated to, or NULL
+        atomic<flat_map_table*> my_next;
+        //! Position of the next groups to be migrated by a thread
+        atomic<size_t> my_migrate_cursor;
+        //! Count of the migrated groups
+        atomic<size_t> my_migrated;
+        //! Count of the erased items that were placed away from their home group
+        /** Their overflow bits are left set, so the table is rebuilt when there are too many of them. */
+        atomic<size_t> my_stale_overflows;
+    };
+
+    template<typename Iterator>
+    class flat_map_range;
+
+    //! Meets requirements of a forward iterator for STL
+    /** Iterates over the occupied slots of the current table.
+        @ingroup containers */
+    template<typename Container, typename Value>
+    class flat_map_iterator
+        : public std::iterator<std::forward_iterator_tag,Value>
+    {
+        typedef Container map_type;
+        typedef typename Container::group group;
+
+        template<typename C, typename T, typename U>
+        friend bool operator==( const flat_map_iterator<C,T>& i, const flat_map_iterator<C,U>& j );
+
+        template<typename C, typename T, typename U>
+        friend bool operator!=( const flat_map_iterator<C,T>& i, const flat_map_iterator<C,U>& j );
+
+        template<typename I>
+        friend class flat_map_range;
+
+#if !defined(_MSC_VER) || defined(__INTEL_COMPILER)
+        template<typename Key, typename T, typename HashCompare, typename A>
+        friend class interface5::concurrent_flat_map;
+#else
+    public: // workaround
+#endif
+        //! Group that has current item
+        const group *my_group;
+
+        //! End of the groups of the table
+        const group *my_end;
+
+        //! Index of the slot of current item in the group
+        size_t my_index;
+
+        void advance_to_next_item() {
+            for( ; my_group != my_end; ++my_group, my_index = 0 )
+                for( ; my_index < flat_map_group_size; ++my_index )
+                    if( my_group->my_tags[my_index] != flat_map_group_base::empty_tag )
+                        return;
+            my_index = 0; // the end
+        }
+
+        flat_map_iterator( const group *g, const group *end, size_t index ) : my_group(g), my_end(end), my_index(index) {
+            advance_to_next_item();
+        }
+
+    public:
+        //! Construct undefined iterator
+        flat_map_iterator(): my_group(), my_end(), my_index() {}
+        Value& operator*() const {
+            __TBB_ASSERT( my_group && my_group != my_end, "iterator uninitialized or at end of container?" );
+            return my_group->slot( my_index );
+        }
+        Value* operator->() const {return &operator*();}
+        flat_map_iterator& operator++() {
+            ++my_index;
+            advance_to_next_item();
+            return *this;
+        }
+
+        //! Post increment
+        flat_map_iterator operator++(int) {
+            flat_map_iterator old(*this);
+            operator++();
+            return old;
+        }
+    };
+
+    template<typename Container, typename T, typename U>
+    bool operator==( const flat_map_iterator<Container,T>& i, const flat_map_iterator<Container,U>& j ) {
+        return i.my_group == j.my_group && i.my_index == j.my_index;
+    }
+
+    template<typename Container, typename T, typename U>
+    bool operator!=( const flat_map_iterator<Container,T>& i, const flat_map_iterator<Container,U>& j ) {
+        return i.my_group != j.my_group || i.my_index != j.my_index;
+    }
+
+    //! Range class used with concurrent_flat_map
+    /** @ingroup containers */
+    template<typename Iterator>
+    class flat_map_range {
+        typedef typename Iterator::map_type map_type;
+        Iterator my_begin;
+        Iterator my_end;
+        mutable Iterator my_midpoint;
+        size_t my_grainsize;
+        //! Set my_midpoint to point approximately half way between my_begin and my_end.
+        void set_midpoint() const {
+            // Split by groups of slots
+            size_t m = my_end.my_group - my_begin.my_group;
+            if( m > my_grainsize )
+                my_midpoint = Iterator( my_begin.my_group + m/2u, my_begin.my_end, 0 );
+            else
+                my_midpoint = my_end;
+            __TBB_ASSERT( my_begin.my_group <= my_midpoint.my_group, "my_begin is after my_midpoint" );
+            __TBB_ASSERT( my_midpoint.my_group <= my_end.my_group, "my_midpoint is after my_end" );
+        }
+    public:
+        //! Type for size of a range
+        typedef std::size_t size_type;
+        typedef typename Iterator::value_type value_type;
+        typedef typename Iterator::reference reference;
+        typedef typename Iterator::difference_type difference_type;
+        typedef Iterator iterator;
+
+        //! True if range is empty.
+        bool empty() const {return my_begin==my_end;}
+
+        //! True if range can be partitioned into two subranges.
+        bool is_divisible() const {
+            return my_midpoint!=my_end;
+        }
+        //! Split range.
+        flat_map_range( flat_map_range& r, split ) :
+            my_end(r.my_end),
+            my_grainsize(r.my_grainsize)
+        {
+            r.my_end = my_begin = r.my_midpoint;
+            __TBB_ASSERT( !empty(), "Splitting despite the range is not divisible" );
+            __TBB_ASSERT( !r.empty(), "Splitting despite the range is not divisible" );
+            set_midpoint();
+            r.set_midpoint();
+        }
+        //! Init range with container and grainsize specified
+        flat_map_range( const map_type &map, size_type grainsize_ = 1 ) :
+            my_begin( map.begin() ),
+            my_end( map.end() ),
+            my_grainsize( grainsize_ )
+        {
+            __TBB_ASSERT( grainsize_>0, "grainsize must be positive" );
+            set_midpoint();
+        }
+        const Iterator& begin() const {return my_begin;}
+        const Iterator& end() const {return my_end;}
+        //! The grain size for this range.
+        size_type grainsize() const {return my_grainsize;}
+    };
+
+    } // internal
+    //! @endcond
+
+//! Unordered map from Key to T with items stored inline in the open addressing table.
+/** concurrent_flat_map is intended for small trivially copyable keys and values, like counters.
+    Items are stored in groups of slots without per-item allocations, and a lookup compares
+    one-byte tags of a group at once. find() does not take locks: it copies the value out and
+    validates the copy with the sequence lock of the group. insert() and erase() lock only the
+    group they modify.
+
+    The table grows by migrating all items into a new table of the doubled size. The threads that
+    insert or erase items help the migration, the threads that find items wait for it. Erasures do
+    not clear the overflow bits, so the table is migrated into a new one of the same size when many
+    erased items were placed away from their home groups. The replaced tables can be still read by
+    concurrent operations, so they are retired, and insert() and erase() release them once the
+    operations that could see them are gone.
+
+    Unlike concurrent_hash_map, the items cannot be accessed in place concurrently, and the
+    iterators and ranges give read only access to the container without concurrent modifications.
+@ingroup containers */
+template<typename Key, typename T, typename HashCompare, typename A>
+class concurrent_flat_map {
+    template<typename Container, typename Value>
+    friend class internal::flat_map_iterator;
+
+    template<typename I>
+    friend class internal::flat_map_range;
+
+#if __TBB_CPP11_TYPE_PROPERTIES_PRESENT
+    __TBB_STATIC_ASSERT( std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<T>::value,
+                         "concurrent_flat_map requires trivially copyable keys and values" );
+#endif
+
+public:
+    typedef Key key_type;
+    typedef T mapped_type;
+    typedef std::pair<Key,T> value_type;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+    typedef const value_type *const_pointer;
+    typedef const value_type &const_reference;
+    typedef internal::flat_map_iterator<concurrent_flat_map,const value_type> const_iterator;
+    typedef const_iterator iterator;
+    typedef internal::flat_map_range<const_iterator> const_range_type;
+    typedef const_range_type range_type;
+    typedef A allocator_type;
+
+protected:
+    typedef internal::flat_map_group<value_type> group;
+    typedef internal::flat_map_table<value_type> table;
+    typedef typename tbb::internal::allocator_rebind<A, group>::type group_allocator_type;
+    typedef typename tbb::internal::allocator_rebind<A, table>::type table_allocator_type;
+    typedef tbb::internal::allocator_traits<group_allocator_type> group_allocator_traits;
+    typedef tbb::internal::allocator_traits<table_allocator_type> table_allocator_traits;
+
+    //! The table grows when the number of items exceeds this fraction of the slots
+    static size_type max_items( size_type groups ) { return groups * internal::flat_map_group_size * 7 / 8; }
+    //! Count of the groups migrated by a thread at once
+    static const size_type migrate_chunk = 16;
+
+    group_allocator_type my_allocator;
+    HashCompare my_hash_compare;
+    //! Current table
+    atomic<table*> my_table;
+    //! Prevents false sharing between my_table and my_size
+    char my_pad[tbb::internal::NFS_MaxLineSize];
+    //! Number of items in the container
+    atomic<size_type> my_size;
+    //! Nonzero while the items are migrated into a new table or the retired tables are released
+    atomic<uintptr_t> my_resize_lock;
+    //! The retired tables, the latest first. Modified under my_resize_lock.
+    atomic<table*> my_retired;
+    //! Advanced when the operations that came at the previous epoch are gone
+    atomic<size_t> my_epoch;
+
+    //! Counts of the operations in flight, by the parity of the epoch they came at
+    struct reader_counts {
+        atomic<size_t> my_count[2];
+    };
+    static const size_type num_reader_slots = 8;
+    //! The operations of a thread are counted in the slot of its index in the arena
+    mutable tbb::internal::padded<reader_counts> my_readers[num_reader_slots];
+
+    //! Counts an operation that reads the tables, so that they are not released under it
+    class table_reader : tbb::internal::no_copy {
+        atomic<size_t> *my_count;
+    public:
+        table_reader( const concurrent_flat_map &map ) {
+            reader_counts &slot = map.my_readers[size_t( tbb::this_task_arena::current_thread_index() ) % num_reader_slots];
+            for(;;) {
+                const size_t epoch = map.my_epoch;
+                my_count = &slot.my_count[epoch & 1];
+                ++*my_count;
+                // the epoch does not advance past the one the operation is counted for
+                if( map.my_epoch == epoch )
+                    return;
+                --*my_count;
+            }
+        }
+        ~table_reader() { --*my_count; }
+    };
+
+    //! Hash code split into the position of the home group, the tag, and the overflow bit
+    struct hash_code {
+        size_t my_home;
+        unsigned char my_tag;
+        unsigned my_overflow;
+        hash_code( size_t h ) {
+            static const int bits = int(sizeof(size_t)*8);
+            my_home = h ^ (h >> bits/2); // the upper bits are the best ones for the multiplicative hashes
+            my_tag = (unsigned char)(h >> (bits-7)) | 0x80;
+            my_overflow = 1u << ((h >> (bits-10)) & 7);
+        }
+    };
+
+    table *allocate_table( size_type groups ) {
+        __TBB_ASSERT( groups && !(groups & (groups-1)), "the number of groups must be a power of two" );
+        table_allocator_type table_allocator( my_allocator );
+        table *t = table_allocator_traits::allocate( table_allocator, 1 );
+        __TBB_TRY {
+            t->my_groups = group_allocator_traits::allocate( my_allocator, groups );
+        } __TBB_CATCH(...) {
+            table_allocator_traits::deallocate( table_allocator, t, 1 );
+            __TBB_RETHROW();
+        }
+        t->my_mask = groups - 1;
+        t->my_retired = NULL;
+        t->my_retire_epoch = 0;
+        t->my_next = NULL;
+        t->my_migrate_cursor = 0;
+        t->my_migrated = 0;
+        t->my_stale_overflows = 0;
+        for( size_type i = 0; i < groups; ++i )
+            t->my_groups[i].reset();
+        return t;
+    }
+
+    //! Deallocate the table and the tables retired before it
+    void delete_tables( table *t ) {
+        table_allocator_type table_allocator( my_allocator );
+        while( t ) {
+            table *retired = t->my_retired;
+            group_allocator_traits::deallocate( my_allocator, t->my_groups, t->my_mask+1 );
+            table_allocator_traits::deallocate( table_allocator, t, 1 );
+            t = retired;
+        }
+    }
+
+    //! Number of groups to hold n items without growth
+    static size_type groups_for( size_type n ) {
+        size_type groups = 1;
+        while( max_items( groups ) < n )
+            groups <<= 1;
+        return groups;
+    }
+
+    //! Read the version of the group that is not locked
+    /** Returns false if the group is moved to another table. */
+    bool read_version( const table *t, const group *g, unsigned &v ) const {
+        tbb::internal::atomic_backoff backoff;
+        while( (v = g->my_version) & 1 ) {
+            if( my_table != t ) // the group can be locked forever by the growth
+                return false;
+            backoff.pause();
+        }
+        return true;
+    }
+
+    //! Check that the group was not modified since it was read at version @arg v
+    static bool validate( const group *g, unsigned v ) {
+        __TBB_acquire_consistency_helper(); // the reads of the group must complete before the version is reread
+        return g->my_version == v;
+    }
+
+    //! Lock the group for modification
+    /** Returns false if the group is moved to another table. Helps the migration of the table. */
+    bool lock( table *t, group *g, unsigned &v ) {
+        tbb::internal::atomic_backoff backoff;
+        for(;;) {
+            v = g->my_version;
+            if( !(v & 1) && g->my_version.compare_and_swap( v+1, v ) == v )
+                return true;
+            if( my_table != t )
+                return false;
+            if( t->my_next ) // the group can be locked by the migration
+                help_migrate( t );
+            backoff.pause();
+        }
+    }
+
+    //! Lock the group that cannot be moved to another table
+    static unsigned lock( group *g ) {
+        tbb::internal::atomic_backoff backoff;
+        unsigned v;
+        while( ((v = g->my_version) & 1) || g->my_version.compare_and_swap( v+1, v ) != v )
+            backoff.pause();
+        return v;
+    }
+
+    static void unlock( group *g, unsigned v ) {
+        __TBB_ASSERT( g->my_version == v+1, "the group is not locked" );
+        g->my_version = v + 2;
+    }
+
+    enum search_result { not_found, found, moved };
+
+    //! Lock-free search of the key in the table
+    /** Copies the mapped value if @arg result is not NULL.
+        Sets the group, the slot and the version of the group where the key was found. */
+    search_result search( const table *t, const hash_code &h, const Key &key, T *result,
+                          const group *&found_group, size_t &found_slot, unsigned &found_version ) const {
+        for( size_t pos = h.my_home & t->my_mask, i = 0; ; pos = (pos + ++i) & t->my_mask ) {
+            const group *g = t->my_groups + pos;
+            unsigned v;
+        retry:
+            if( !read_version( t, g, v ) )
+                return moved;
+            for( unsigned m = g->match( h.my_tag ); m; m &= m-1 ) {
+                size_t s = __TBB_Log2( m & (0u-m) );
+                Key k = g->slot(s).first; // the copy can be broken by a concurrent modification
+                if( my_hash_compare.equal( k, key ) ) {
+                    if( result )
+                        *result = g->slot(s).second;
+                    if( !validate( g, v ) )
+                        goto retry;
+                    found_group = g; found_slot = s; found_version = v;
+                    return found;
+                }
+            }
+            unsigned overflow = g->overflow();
+            if( !validate( g, v ) )
+                goto retry;
+            if( !(overflow & h.my_overflow) || i == t->my_mask ) // no more items with the hash code further
+                return not_found;
+        }
+    }
+
+    //! Insert the item into the table that is not shared
+    void unsafe_insert( table *t, const hash_code &h, const value_type &value ) {
+        for( size_t pos = h.my_home & t->my_mask, i = 0; ; pos = (pos + ++i) & t->my_mask ) {
+            group *g = t->my_groups + pos;
+            if( unsigned m = g->match( internal::flat_map_group_base::empty_tag ) ) {
+                size_t s = __TBB_Log2( m & (0u-m) );
+                new( &g->slot(s) ) value_type( value );
+                g->my_tags[s] = h.my_tag;
+                return;
+            }
+            __TBB_ASSERT( i < t->my_mask, "the table is full" );
+            g->set_overflow( h.my_overflow );
+        }
+    }
+
+    //! Insert the item into the table that is built by the migration
+    /** The groups are locked because several threads migrate the items. */
+    static void migrate_insert( table *t, const hash_code &h, const value_type &value ) {
+        for( size_t pos = h.my_home & t->my_mask, i = 0; ; pos = (pos + ++i) & t->my_mask ) {
+            group *g = t->my_groups + pos;
+            unsigned v = lock( g );
+            unsigned m = g->match( internal::flat_map_group_base::empty_tag );
+            if( m ) {
+                size_t s = __TBB_Log2( m & (0u-m) );
+                new( &g->slot(s) ) value_type( value );
+                g->my_tags[s] = h.my_tag;
+            } else {
+                __TBB_ASSERT( i < t->my_mask, "the table is full" );
+                g->set_overflow( h.my_overflow );
+            }
+            unlock( g, v );
+            if( m )
+                return;
+        }
+    }
+
+    //! Move the items of the groups claimed by this thread into the new table
+    /** The thread that migrates the last groups publishes the new table. */
+    void help_migrate( table *t ) {
+        table *new_table = t->my_next;
+        __TBB_ASSERT( new_table, "the table is not migrated" );
+        const size_type groups = t->my_mask + 1;
+        for( size_type pos; (pos = t->my_migrate_cursor.fetch_and_add( migrate_chunk )) < groups; ) {
+            const size_type end = pos + migrate_chunk < groups ? pos + migrate_chunk : groups;
+            const size_type n = end - pos;
+            for( ; pos < end; ++pos ) {
+                group *g = t->my_groups + pos;
+                lock( g ); // the group is never unlocked
+                for( size_t s = 0; s < internal::flat_map_group_size; ++s )
+                    if( g->my_tags[s] != internal::flat_map_group_base::empty_tag )
+                        migrate_insert( new_table, hash_code( my_hash_compare.hash( g->slot(s).first ) ), g->slot(s) );
+            }
+            if( (t->my_migrated += n) == groups ) {
+                my_table = new_table;
+                // the epoch does not advance while my_resize_lock is held
+                t->my_retire_epoch = my_epoch;
+                t->my_retired = my_retired;
+                my_retired = t;
+                my_resize_lock = 0;
+            }
+        }
+    }
+
+    //! Release the retired tables that no operation can see
+    /** Must be called outside of table_reader. Does nothing if the table is being migrated. */
+    void release_retired_tables() {
+        if( !my_retired || my_resize_lock || my_resize_lock.compare_and_swap( 1, 0 ) )
+            return;
+        size_t epoch = my_epoch;
+        // the operations that come at the next epoch are counted with the ones of the previous epoch
+        bool idle = true;
+        for( size_type i = 0; i < num_reader_slots && idle; ++i )
+            idle = my_readers[i].my_count[(epoch + 1) & 1] == 0;
+        if( idle )
+            my_epoch = ++epoch;
+        // a table retired at an epoch is seen only by the operations that came at it or before,
+        // and they are gone when the epoch advances twice
+        table *t = my_retired, *released = NULL;
+        if( t->my_retire_epoch + 2 <= epoch ) {
+            released = t;
+            my_retired = NULL;
+        } else {
+            while( t->my_retired && t->my_retired->my_retire_epoch + 2 > epoch )
+                t = t->my_retired;
+            released = t->my_retired;
+            t->my_retired = NULL;
+        }
+        my_resize_lock = 0;
+        delete_tables( released );
+    }
+
+    //! Release all retired tables. Not thread safe.
+    void delete_retired_tables() {
+        delete_tables( my_retired );
+        my_retired = NULL;
+    }
+
+    //! Start the migration of all items of the table into a new one of @arg groups groups and help it
+    /** Does nothing if another migration of the table is being started. */
+    void migrate( table *t, size_type groups ) {
+        if( !t->my_next ) {
+            if( my_resize_lock || my_resize_lock.compare_and_swap( 1, 0 ) )
+                return;
+            if( my_table != t ) { // the table was migrated concurrently
+                my_resize_lock = 0;
+                return;
+            }
+            table *new_table;
+            __TBB_TRY {
+                new_table = allocate_table( groups );
+            } __TBB_CATCH(...) {
+                my_resize_lock = 0;
+                __TBB_RETHROW();
+            }
+            t->my_next = new_table;
+        }
+        help_migrate( t );
+    }
+
+    //! Return the current table to modify. Helps the migration of its items if any.
+    table *table_for_update() {
+        table *t = my_table;
+        if( t->my_next )
+            help_migrate( t );
+        return t;
+    }
+
+    //! Double the number of groups of the table
+    void grow( table *t ) {
+        migrate( t, (t->my_mask+1) * 2 );
+    }
+
+    //! Wait until the table that has no free slots is grown
+    void wait_for_growth( table *t ) {
+        tbb::internal::atomic_backoff backoff;
+        // the growth is not started while the retired tables are released
+        for( ; my_table == t; backoff.pause() ) {
+            if( t->my_next )
+                help_migrate( t );
+            else
+                grow( t );
+        }
+    }
+
+    //! Insert the item or assign the mapped value of the existing one if @arg assign is true
+    bool internal_insert( const value_type &value, bool assign ) {
+        bool result;
+        {
+            table_reader reader( *this );
+            result = internal_insert_item( value, assign );
+        }
+        release_retired_tables();
+        return result;
+    }
+
+    bool internal_insert_item( const value_type &value, bool assign ) {
+        hash_code h( my_hash_compare.hash( value.first ) );
+        const group *found_group;
+        size_t found_slot;
+        unsigned v;
+    restart:
+        table *t = table_for_update();
+        group *home = t->my_groups + (h.my_home & t->my_mask);
+        unsigned inserts = home->my_inserts;
+        switch( search( t, h, value.first, NULL, found_group, found_slot, v ) ) {
+        case moved:
+            goto restart;
+        case found:
+            if( assign ) {
+                group *g = const_cast<group*>( found_group );
+                if( g->my_version.compare_and_swap( v+1, v ) != v )
+                    goto restart; // the group was modified after the search
+                g->slot( found_slot ).second = value.second;
+                unlock( g, v );
+            }
+            return false;
+        case not_found:
+            break;
+        }
+        for( size_t pos = h.my_home & t->my_mask, i = 0; ; pos = (pos + ++i) & t->my_mask ) {
+            group *g = t->my_groups + pos;
+            if( !lock( t, g, v ) )
+                goto restart;
+            if( unsigned m = g->match( internal::flat_map_group_base::empty_tag ) ) {
+                // the key could be inserted concurrently after the search
+                if( home->my_inserts.compare_and_swap( inserts+1, inserts ) != inserts ) {
+                    unlock( g, v );
+                    goto restart;
+                }
+                size_t s = __TBB_Log2( m & (0u-m) );
+                new( &g->slot(s) ) value_type( value );
+                g->my_tags[s] = h.my_tag;
+                unlock( g, v );
+                break;
+            }
+            g->set_overflow( h.my_overflow );
+            unlock( g, v );
+            if( i == t->my_mask ) {
+                wait_for_growth( t );
+                goto restart;
+            }
+        }
+        if( ++my_size > max_items( t->my_mask+1 ) )
+            grow( t );
+        return true;
+    }
+
+    //! Erase the item if it is found
+    bool internal_erase( const Key &key ) {
+        hash_code h( my_hash_compare.hash( key ) );
+        const group *found_group;
+        size_t s;
+        unsigned v;
+        table *t;
+        for(;;) {
+            t = table_for_update();
+            switch( search( t, h, key, NULL, found_group, s, v ) ) {
+            case not_found:
+                return false;
+            case moved:
+                continue;
+            case found:
+                break;
+            }
+            group *g = const_cast<group*>( found_group );
+            if( g->my_version.compare_and_swap( v+1, v ) == v ) // the group was not modified after the search
+                break;
+        }
+        group *g = const_cast<group*>( found_group );
+        g->my_tags[s] = internal::flat_map_group_base::empty_tag;
+        unlock( g, v );
+        --my_size;
+        // the overflow bits set for the item are left in the groups before its group
+        if( g != t->my_groups + (h.my_home & t->my_mask) && ++t->my_stale_overflows > t->my_mask + 1 )
+            migrate( t, t->my_mask + 1 );
+        return true;
+    }
+
+    void init_reclamation() {
+        my_resize_lock = 0;
+        my_retired = NULL;
+        my_epoch = 0;
+        for( size_type i = 0; i < num_reader_slots; ++i )
+            my_readers[i].my_count[0] = my_readers[i].my_count[1] = 0;
+    }
+
+    //! Copy items of the source into the table of this container. Not thread safe.
+    void internal_copy( const concurrent_flat_map &source ) {
+        table *t = my_table;
+        for( const_iterator it = source.begin(); it != source.end(); ++it )
+            unsafe_insert( t, hash_code( my_hash_compare.hash( it->first ) ), *it );
+        my_size = source.my_size;
+    }
+
+public:
+    //! Construct empty table with the capacity for n items.
+    explicit concurrent_flat_map( size_type n = 0, const allocator_type &a = allocator_type() )
+        : my_allocator(a)
+    {
+        my_table = allocate_table( groups_for( n ) );
+        my_size = 0;
+        init_reclamation();
+    }
+
+    concurrent_flat_map( size_type n, const HashCompare& compare, const allocator_type& a = allocator_type() )
+        : my_allocator(a), my_hash_compare(compare)
+    {
+        my_table = allocate_table( groups_for( n ) );
+        my_size = 0;
+        init_reclamation();
+    }
+
+    //! Copy constructor
+    concurrent_flat_map( const concurrent_flat_map &source )
+        : my_allocator(source.my_allocator), my_hash_compare(source.my_hash_compare)
+    {
+        my_table = allocate_table( groups_for( source.size() ) );
+        init_reclamation();
+        internal_copy( source );
+    }
+
+    //! Assignment
+    concurrent_flat_map& operator=( const concurrent_flat_map &source ) {
+        if( this != &source ) {
+            table *t = allocate_table( groups_for( source.size() ) );
+            delete_tables( my_table );
+            delete_retired_tables();
+            my_table = t;
+            internal_copy( source );
+        }
+        return *this;
+    }
+
+    //! Clear table and destroy it.
+    ~concurrent_flat_map() {
+        delete_tables( my_table );
+        delete_retired_tables();
+    }
+
+    //------------------------------------------------------------------------
+    // Parallel algorithm support
+    //------------------------------------------------------------------------
+    range_type range( size_type grainsize=1 ) const {
+        return range_type( *this, grainsize );
+    }
+
+    //------------------------------------------------------------------------
+    // STL support - not thread-safe methods
+    //------------------------------------------------------------------------
+    const_iterator begin() const {
+        table *t = my_table;
+        return const_iterator( t->my_groups, t->my_groups + t->my_mask + 1, 0 );
+    }
+    const_iterator end() const {
+        table *t = my_table;
+        return const_iterator( t->my_groups + t->my_mask + 1, t->my_groups + t->my_mask + 1, 0 );
+    }
+
+    //! Number of items in table.
+    size_type size() const { return my_size; }
+
+    //! True if size()==0.
+    bool empty() const { return my_size == 0; }
+
+    //! Upper bound on size.
+    size_type max_size() const { return (~size_type(0))/sizeof(value_type); }
+
+    //! Returns the current number of slots
+    size_type bucket_count() const { return (my_table->my_mask+1) * internal::flat_map_group_size; }
+
+    //! Erase all items. Keeps the capacity of the current table but releases the retired ones.
+    void clear() {
+        table *t = my_table;
+        delete_retired_tables();
+        t->my_stale_overflows = 0;
+        for( size_type i = 0; i <= t->my_mask; ++i )
+            t->my_groups[i].reset();
+        my_size = 0;
+    }
+
+    //! Rebuild the table with the capacity for max(n, size()) items and release the retired tables.
+    void rehash( size_type n = 0 ) {
+        table *old_table = my_table;
+        my_table = allocate_table( groups_for( n > size() ? n : size() ) );
+        for( size_t pos = 0; pos <= old_table->my_mask; ++pos ) {
+            group *g = old_table->my_groups + pos;
+            for( size_t s = 0; s < internal::flat_map_group_size; ++s )
+                if( g->my_tags[s] != internal::flat_map_group_base::empty_tag )
+                    unsafe_insert( my_table, hash_code( my_hash_compare.hash( g->slot(s).first ) ), g->slot(s) );
+        }
+        delete_tables( old_table );
+        delete_retired_tables();
+    }
+
+    //! return allocator object
+    allocator_type get_allocator() const { return allocator_type( my_allocator ); }
+
+    //! swap two instances. Iterators are invalidated
+    void swap( concurrent_flat_map &other ) {
+        using std::swap;
+        typedef typename tbb::internal::allocator_traits<A>::propagate_on_container_swap pocs_type;
+        tbb::internal::allocator_swap( my_allocator, other.my_allocator, pocs_type() );
+        swap( my_hash_compare, other.my_hash_compare );
+        table *t = my_table; my_table = other.my_table; other.my_table = t;
+        t = my_retired; my_retired = other.my_retired; other.my_retired = t;
+        size_type sz = my_size; my_size = other.my_size; other.my_size = sz;
+    }
+
+    //------------------------------------------------------------------------
+    // concurrent map operations
+    //------------------------------------------------------------------------
+
+    //! Copy the value mapped to the key into @arg result
+    /** Return true if the key was found. Does not lock the table. */
+    bool find( const Key &key, T &result ) const {
+        hash_code h( my_hash_compare.hash( key ) );
+        const group *g;
+        size_t s;
+        unsigned v;
+        search_result r;
+        table_reader reader( *this );
+        while( (r = search( my_table, h, key, &result, g, s, v )) == moved )
+            continue;
+        return r == found;
+    }
+
+    //! Return count of items (0 or 1)
+    size_type count( const Key &key ) const {
+        hash_code h( my_hash_compare.hash( key ) );
+        const group *g;
+        size_t s;
+        unsigned v;
+        search_result r;
+        table_reader reader( *this );
+        while( (r = search( my_table, h, key, NULL, g, s, v )) == moved )
+            continue;
+        return r == found;
+    }
+
+    //! Insert item by copying if there is no such key present already
+    /** Returns true if item is new. */
+    bool insert( const value_type &value ) {
+        return internal_insert( value, /*assign=*/false );
+    }
+
+    //! Insert item or assign the value to the existing one
+    /** Returns true if item is new. */
+    bool insert_or_assign( const Key &key, const T &obj ) {
+        return internal_insert( value_type( key, obj ), /*assign=*/true );
+    }
+
+    //! Erase item.
+    /** Return true if item was erased by particularly this call. */
+    bool erase( const Key &key ) {
+        bool result;
+        {
+            table_reader reader( *this );
+            result = internal_erase( key );
+        }
+        release_retired_tables();
+        return result;
+    }
+};
+
+template<typename Key, typename T, typename HashCompare, typename A>
+inline void swap(concurrent_flat_map<Key, T, HashCompare, A> &a, concurrent_flat_map<Key, T, HashCompare, A> &b)
+{ a.swap( b ); }
+
+} // namespace interface5
+
+using interface5::concurrent_flat_map;
+
+} // namespace tbb
+
+#include "internal/_warning_suppress_disable_notice.h"
+#undef __TBB_concurrent_flat_map_H_include_area
+
+#endif /* __TBB_concurrent_flat_map_H */
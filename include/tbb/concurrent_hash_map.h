@@ -27,6 +27,7 @@
 #include __TBB_STD_SWAP_HEADER
 
 #include "tbb_allocator.h"
+#include "cache_aligned_allocator.h"
 #include "spin_rw_mutex.h"
 #include "atomic.h"
 #include "tbb_exception.h"
@@ -50,9 +51,19 @@
 #include <tuple>
 #endif
 
+// Software prefetching of buckets and nodes by the batch operations
+#if __GNUC__
+#define __TBB_hash_map_prefetch(p) __builtin_prefetch(p)
+#elif _MSC_VER && (_M_IX86 || _M_X64)
+#include <xmmintrin.h>
+#define __TBB_hash_map_prefetch(p) _mm_prefetch((const char*)(p), _MM_HINT_T0)
+#else
+#define __TBB_hash_map_prefetch(p) ((void)(p))
+#endif
+
 namespace tbb {
 
-namespace interface5 {
+namespace interface6 {
 
     template<typename Key, typename T, typename HashCompare = tbb_hash_compare<Key>, typename A = tbb_allocator<std::pair<const Key, T> > >
     class concurrent_hash_map;
@@ -78,6 +89,8 @@ namespace interface5 {
     static hash_map_node_base *const rehash_req = reinterpret_cast<hash_map_node_base*>(size_t(3));
     //! Rehashed empty bucket flag
     static hash_map_node_base *const empty_rehashed = reinterpret_cast<hash_map_node_base*>(size_t(0));
+    //! Flag of a bucket merged into the lower part of the table by shrinking
+    static hash_map_node_base *const empty_merged = reinterpret_cast<hash_map_node_base*>(size_t(2));
     //! base class of concurrent_hash_map
     class hash_map_base {
     public:
@@ -110,14 +123,45 @@ namespace interface5 {
         typedef bucket *segment_ptr_t;
         //! Segment pointers table type
         typedef segment_ptr_t segments_table_t[pointers_per_table];
+        //! Count of buckets of the shrinking segment merged by one operation besides its own bucket
+        static size_type const merge_batch = 4;
+        //! Count of the counters of the operations in an epoch, see operation_counters
+        static size_type const operation_counter_shards = 16;
+        //! The epoch of a retired segment is kept in my_retired_segment above this bit
+        static size_type const retired_epoch_shift = 8;
+        //! Counters of the operations that can access a segment merged by a shrink
+        /** An operation is counted in the current epoch, which a shrink changes when all buckets
+            of its segment are merged. Then the segment is retired, and it is deallocated when
+            the operations counted in the previous epoch are done. */
+        struct operation_counters {
+            tbb::internal::padded< atomic<uintptr_t> > my_epoch;
+            tbb::internal::padded< atomic<size_type> > my_count[2][operation_counter_shards];
+        };
         //! Hash mask = sum of allocated segment sizes - 1
         atomic<hashcode_t> my_mask;
+        //! Index of the segment being merged into the lower part of the table, or 0 if the table is not shrinking
+        atomic<segment_index_t> my_shrink_segment;
+        //! Counters of the operations, allocated while shrinking is enabled
+        operation_counters *my_operations;
         //! Segment pointers table. Also prevents false sharing between my_mask and my_size
+        /** The segment above the mask is being merged or retired by shrinking. */
         segments_table_t my_table;
         //! Size of container in stored items
         atomic<size_type> my_size; // It must be in separate cache line from my_mask due to performance effects
         //! Zero segment
         bucket my_embedded_segment[embedded_buckets];
+        //! Nonzero while the table is being grown or shrunk
+        atomic<uintptr_t> my_resize_lock;
+        //! Count of buckets of the shrinking segment that are merged
+        atomic<size_type> my_merged_buckets;
+        //! Position of the next buckets to be merged by an operation
+        atomic<size_type> my_merge_cursor;
+        //! Index of the merged segment to deallocate and its epoch, or 0
+        atomic<uintptr_t> my_retired_segment;
+        //! Average number of items per bucket that makes the table grow
+        float my_max_load_factor;
+        //! Average number of items per bucket that makes the table shrink, zero disables shrinking
+        float my_min_load_factor;
 #if __TBB_STATISTICS
         atomic<unsigned> my_info_resizes; // concurrent ones
         mutable atomic<unsigned> my_info_restarts; // race collisions
@@ -132,6 +176,14 @@ namespace interface5 {
             for( size_type i = 0; i < embedded_block; i++ ) // fill the table
                 my_table[i] = my_embedded_segment + segment_base(i);
             my_mask = embedded_buckets - 1;
+            my_shrink_segment = 0;
+            my_operations = NULL;
+            my_resize_lock = 0;
+            my_merged_buckets = 0;
+            my_merge_cursor = 0;
+            my_retired_segment = 0;
+            my_max_load_factor = 1.0f;
+            my_min_load_factor = 0.0f;
             __TBB_ASSERT( embedded_block <= first_block, "The first block number must include embedded blocks");
 #if __TBB_STATISTICS
             my_info_resizes = 0; // concurrent ones
@@ -140,6 +192,11 @@ namespace interface5 {
 #endif
         }
 
+        //! Destructor
+        ~hash_map_base() {
+            if( my_operations ) NFS_Free( my_operations );
+        }
+
         //! @return segment index of given index in the array
         static segment_index_t segment_index_of( size_type index ) {
             return segment_index_t( __TBB_Log2( index|1 ) );
@@ -254,14 +311,33 @@ namespace interface5 {
         inline bool check_mask_race( const hashcode_t h, hashcode_t &m ) const {
             hashcode_t m_now, m_old = m;
             m_now = (hashcode_t) itt_load_word_with_acquire( my_mask );
-            if( m_old != m_now )
-                return check_rehashing_collision( h, m_old, m = m_now );
+            if( m_old != m_now && check_rehashing_collision( h, m_old, m = m_now ) )
+                return true;
+            return check_merging_collision( h & m );
+        }
+
+        //! Check whether items of bucket @arg h can be in its child that is not merged yet
+        /** It is possible when the table was grown and then started shrinking after the bucket was prepared. */
+        bool check_merging_collision( const hashcode_t h ) const {
+            segment_index_t s = my_shrink_segment;
+            if( s && h < segment_base(s) && is_valid( itt_load_word_with_acquire( my_table[s][h].node_list ) ) ) {
+#if __TBB_STATISTICS
+                my_info_restarts++; // race collisions
+#endif
+                return true;
+            }
             return false;
         }
 
         //! Process mask race, check for rehashing collision
         bool check_rehashing_collision( const hashcode_t h, hashcode_t m_old, hashcode_t m ) const {
             __TBB_ASSERT(m_old != m, NULL); // TODO?: m arg could be optimized out by passing h = h&m
+            if( m < m_old ) { // the table was shrunk, the item could be merged into another bucket
+#if __TBB_STATISTICS
+                my_info_restarts++; // race collisions
+#endif
+                return true;
+            }
             if( (h & m_old) != (h & m) ) { // mask changed for this hashcode, rare event
                 // condition above proves that 'h' has some other bits set beside 'm_old'
                 // find next applicable mask after m_old    //TODO: look at bsl instruction
@@ -286,17 +362,155 @@ namespace interface5 {
             size_type sz = ++my_size; // prefix form is to enforce allocation after the first item inserted
             add_to_bucket( b, n );
             // check load factor
-            if( sz >= mask ) { // TODO: add custom load_factor
+            if( sz >= mask * double(my_max_load_factor) ) {
                 segment_index_t new_seg = __TBB_Log2( mask+1 ); //optimized segment_index_of
                 __TBB_ASSERT( is_valid(my_table[new_seg-1]), "new allocations must not publish new mask until segment has allocated");
-                static const segment_ptr_t is_allocating = (segment_ptr_t)2;
-                if( !itt_hide_load_word(my_table[new_seg])
-                  && as_atomic(my_table[new_seg]).compare_and_swap(is_allocating, NULL) == NULL )
-                    return new_seg; // The value must be processed
+                if( !my_resize_lock && my_resize_lock.compare_and_swap(1, 0) == 0 ) {
+                    if( itt_load_word_with_acquire(my_mask) == mask )
+                        return new_seg; // The value must be processed by grow_table()
+                    my_resize_lock = 0; // the table was resized concurrently
+                }
             }
             return 0;
         }
 
+        //! Releases my_resize_lock when the resize is done or failed
+        struct resize_lock_guard : tbb::internal::no_copy {
+            atomic<uintptr_t> &my_lock;
+            resize_lock_guard( atomic<uintptr_t> &lock ) : my_lock(lock) {}
+            ~resize_lock_guard() { my_lock = 0; }
+        };
+
+        //! Enable segment @arg k found by insert_new_node()
+        /** The segment retired by the last shrink is deallocated before the lock is released. */
+        template<typename Allocator>
+        void grow_table( segment_index_t k, const Allocator& allocator ) {
+            __TBB_ASSERT( my_resize_lock, "the table must be locked for resizing" );
+            resize_lock_guard guard( my_resize_lock );
+            enable_segment( k, allocator );
+        }
+
+        //! Start merging the topmost segment into the lower part of the table if the load factor is low.
+        void try_shrink() {
+            hashcode_t mask = (hashcode_t) itt_load_word_with_acquire( my_mask );
+            segment_index_t s = segment_index_of( mask );
+            if( !my_operations || s < first_block || my_size >= (mask+1) * double(my_min_load_factor)
+              || my_resize_lock || my_resize_lock.compare_and_swap(1, 0) )
+                return;
+            if( mask != my_mask ) { // the table was resized concurrently
+                my_resize_lock = 0;
+                return;
+            }
+            // the lock is held until the segment is merged and deallocated
+            my_merged_buckets = 0;
+            my_merge_cursor = 0;
+            my_shrink_segment = s;
+            itt_store_word_with_release( my_mask, segment_base(s) - 1 );
+        }
+
+        //! Move items of the bucket h + 2^s in the shrinking segment @arg s to the bucket @arg h
+        void merge_bucket( hashcode_t h, segment_index_t s ) {
+            bucket *b_old = my_table[s] + h;
+            if( itt_load_word_with_acquire(b_old->node_list) == empty_merged ) return;
+            bucket::scoped_t lock( b_old->mutex, /*write=*/true );
+            node_base *n = b_old->node_list;
+            // the segment could be already merged and reused, or the new mask is not published yet
+            if( n == empty_merged || my_shrink_segment != s
+              || (hashcode_t) itt_load_word_with_acquire( my_mask ) >= segment_base(s) )
+                return;
+            if( is_valid(n) ) {
+                bucket *b_new = get_bucket( h );
+                bucket::scoped_t lock_new( b_new->mutex, /*write=*/true );
+                __TBB_ASSERT( b_new->node_list != rehash_req, "the bucket must be rehashed before its child" );
+                node_base **p = &b_new->node_list;
+                while( is_valid(*p) ) p = &(*p)->next;
+                *p = n;
+            } // else the items are still in the parent buckets, if any
+            itt_store_word_with_release( b_old->node_list, empty_merged );
+            if( ++my_merged_buckets == segment_size(s) ) { // the shrink is done
+                my_shrink_segment = 0;
+                // the operations that start in the new epoch see neither the segment nor the old mask
+                uintptr_t epoch = my_operations->my_epoch.fetch_and_increment() + 1;
+                my_retired_segment = s | epoch << retired_epoch_shift;
+            }
+        }
+
+        //! Prepare bucket @arg h for access when the table is being shrunk
+        /** The bucket must not hold a lock on any other bucket. */
+        void prepare_bucket( hashcode_t h ) {
+            segment_index_t s = my_shrink_segment;
+            if( !s ) return;
+            if( h < segment_base(s) )
+                merge_bucket( h, s ); // items of the bucket must be merged before it is accessed
+            // help to finish the shrink, so that it does not depend on which buckets are accessed
+            size_type i = my_merge_cursor.fetch_and_add( merge_batch );
+            for( size_type e = i + merge_batch; i < e; i++ )
+                merge_bucket( i & (segment_size(s)-1), s );
+        }
+
+        //! Merge all remaining buckets of the shrinking segment. Not thread safe.
+        void complete_shrink() {
+            if( segment_index_t s = my_shrink_segment )
+                for( size_type i = 0, sz = segment_size(s); i < sz; i++ )
+                    merge_bucket( i, s );
+            __TBB_ASSERT( !my_shrink_segment, "the shrink is not completed" );
+        }
+
+        //! Deallocate the segment retired by shrinking. Not thread safe.
+        template<typename Allocator>
+        void release_retired_segments( const Allocator& allocator ) {
+            __TBB_ASSERT( !my_shrink_segment, "the shrink must be completed" );
+            if( uintptr_t r = my_retired_segment ) {
+                my_retired_segment = 0;
+                delete_segment( r & ((1<<retired_epoch_shift)-1), allocator );
+                my_resize_lock = 0; // held since the shrink started
+            }
+        }
+
+        //! Count an operation on the key with hash code @arg h. @return the epoch to pass to exit_operation().
+        template<typename Allocator>
+        uintptr_t enter_operation( hashcode_t h, const Allocator& allocator ) {
+            for(;;) {
+                uintptr_t epoch = my_operations->my_epoch;
+                ++my_operations->my_count[epoch & 1][h % operation_counter_shards];
+                // a shrink must not miss the operation when it checks the counters of the previous epoch
+                if( my_operations->my_epoch == epoch )
+                    return epoch;
+                // the shrink could have seen the counter, so the segment is deallocated here then
+                exit_operation( h, epoch, allocator );
+            }
+        }
+
+        //! Finish the operation counted by enter_operation() and deallocate the retired segment if it is unused
+        template<typename Allocator>
+        void exit_operation( hashcode_t h, uintptr_t epoch, const Allocator& allocator ) {
+            --my_operations->my_count[epoch & 1][h % operation_counter_shards];
+            uintptr_t r = my_retired_segment;
+            if( !r ) return;
+            uintptr_t previous = ((r >> retired_epoch_shift) - 1) & 1;
+            for( size_type i = 0; i < operation_counter_shards; i++ )
+                if( my_operations->my_count[previous][i] )
+                    return;
+            // the epoch in r prevents from deallocating a segment retired after the check
+            if( my_retired_segment.compare_and_swap( 0, r ) == r ) {
+                delete_segment( r & ((1<<retired_epoch_shift)-1), allocator );
+                my_resize_lock = 0; // held since the shrink started
+            }
+        }
+
+        //! Enable shrinking if @arg z is positive. The shrink must be completed. Not thread safe.
+        void set_min_load_factor( float z ) {
+            __TBB_ASSERT( !my_shrink_segment && !my_retired_segment, "the shrink must be completed" );
+            my_min_load_factor = z;
+            if( z > 0 && !my_operations ) {
+                my_operations = static_cast<operation_counters*>( NFS_Allocate( 1, sizeof(operation_counters), NULL ) );
+                std::memset( static_cast<void*>(my_operations), 0, sizeof(operation_counters) );
+            } else if( !(z > 0) && my_operations ) {
+                NFS_Free( my_operations );
+                my_operations = NULL;
+            }
+        }
+
         //! Prepare enough segments for number of buckets
         template<typename Allocator>
         void reserve(size_type buckets, const Allocator& allocator) {
@@ -308,8 +522,13 @@ namespace interface5 {
         //! Swap hash_map_bases
         void internal_swap(hash_map_base &table) {
             using std::swap;
+            __TBB_ASSERT( !my_shrink_segment && !my_retired_segment && !table.my_shrink_segment && !table.my_retired_segment,
+                          "the shrinks must be completed" );
             swap(this->my_mask, table.my_mask);
             swap(this->my_size, table.my_size);
+            swap(this->my_max_load_factor, table.my_max_load_factor);
+            swap(this->my_min_load_factor, table.my_min_load_factor);
+            swap(this->my_operations, table.my_operations);
             for(size_type i = 0; i < embedded_buckets; i++)
                 swap(this->my_embedded_segment[i].node_list, table.my_embedded_segment[i].node_list);
             for(size_type i = embedded_block; i < pointers_per_table; i++)
@@ -318,6 +537,13 @@ namespace interface5 {
 
 #if __TBB_CPP11_RVALUE_REF_PRESENT
         void internal_move(hash_map_base&& other) {
+            using std::swap;
+            __TBB_ASSERT( !my_shrink_segment && !my_retired_segment && !other.my_shrink_segment && !other.my_retired_segment,
+                          "the shrinks must be completed" );
+            my_max_load_factor = other.my_max_load_factor;
+            // the counters go with the load factor, so the moved-from table keeps a consistent one
+            swap(my_min_load_factor, other.my_min_load_factor);
+            swap(my_operations, other.my_operations);
             my_mask = other.my_mask;
             other.my_mask = embedded_buckets - 1;
             my_size = other.my_size;
@@ -384,7 +610,7 @@ namespace interface5 {
         }
 #if !defined(_MSC_VER) || defined(__INTEL_COMPILER)
         template<typename Key, typename T, typename HashCompare, typename A>
-        friend class interface5::concurrent_hash_map;
+        friend class interface6::concurrent_hash_map;
 #else
     public: // workaround
 #endif
@@ -542,6 +768,17 @@ namespace interface5 {
             "[my_begin, my_midpoint) range should not be empty" );
     }
 
+    //! Checks whether the batch insertion can take the key and the mapped value of Value
+    template<typename Value, typename Key, typename T>
+    struct is_hash_map_value {
+        static const bool value = false;
+    };
+
+    template<typename K, typename Key, typename T>
+    struct is_hash_map_value<std::pair<K, T>, Key, T> {
+        static const bool value = is_same_type<typename strip<K>::type, Key>::value;
+    };
+
     } // internal
 //! @endcond
 
@@ -696,23 +933,49 @@ protected:
         return n;
     }
 
+    //! Counts an operation while shrinking is enabled, so that the buckets it accesses are not deallocated
+    /** Must be constructed before the operation reads the mask. */
+    class operation_guard : tbb::internal::no_copy {
+        concurrent_hash_map *my_map;
+        hashcode_t my_hash;
+        uintptr_t my_epoch;
+    public:
+        operation_guard( const concurrent_hash_map *map, hashcode_t h )
+            : my_map( map->my_operations ? const_cast<concurrent_hash_map*>(map) : NULL ), my_hash(h), my_epoch(0) {
+            if( my_map ) my_epoch = my_map->enter_operation( h, my_map->my_allocator );
+        }
+        ~operation_guard() {
+            if( my_map ) my_map->exit_operation( my_hash, my_epoch, my_map->my_allocator );
+        }
+    };
+
+    //! Merge the shrinking segment and deallocate it. Not thread safe.
+    void finish_shrink() {
+        complete_shrink();
+        release_retired_segments( my_allocator );
+    }
+
     //! bucket accessor is to find, rehash, acquire a lock, and access a bucket
     class bucket_accessor : public bucket::scoped_t {
         bucket *my_b;
     public:
-        bucket_accessor( concurrent_hash_map *base, const hashcode_t h, bool writer = false ) { acquire( base, h, writer ); }
-        //! find a bucket by masked hashcode, optionally rehash, and acquire the lock
-        inline void acquire( concurrent_hash_map *base, const hashcode_t h, bool writer = false ) {
+        bucket_accessor( concurrent_hash_map *base, const hashcode_t h, bool writer = false, bool merge = true ) { acquire( base, h, writer, merge ); }
+        //! find a bucket by masked hashcode, optionally merge or rehash, and acquire the lock
+        /** The bucket can be outdated by a concurrent shrink, see is_outdated(). */
+        inline void acquire( concurrent_hash_map *base, const hashcode_t h, bool writer = false, bool merge = true ) {
+            if( merge ) base->prepare_bucket( h );
             my_b = base->get_bucket( h );
             // TODO: actually, notification is unnecessary here, just hiding double-check
             if( itt_load_word_with_acquire(my_b->node_list) == internal::rehash_req
                 && try_acquire( my_b->mutex, /*write=*/true ) )
             {
-                if( my_b->node_list == internal::rehash_req ) base->rehash_bucket( my_b, h ); //recursive rehashing
+                // the bucket is not rehashed if it is out of the shrunk table
+                if( my_b->node_list == internal::rehash_req && h <= base->my_mask ) base->rehash_bucket( my_b, h ); //recursive rehashing
             }
             else bucket::scoped_t::acquire( my_b->mutex, writer );
-            __TBB_ASSERT( my_b->node_list != internal::rehash_req, NULL);
         }
+        //! check whether the bucket is out of the table shrunk concurrently, so the operation must be restarted
+        bool is_outdated() const { return my_b->node_list == internal::empty_merged || my_b->node_list == internal::rehash_req; }
         //! check whether bucket is locked for write
         bool is_writer() { return bucket::scoped_t::is_writer; }
         //! get bucket pointer
@@ -729,7 +992,8 @@ protected:
         my_info_rehashes++; // invocations of rehash_bucket
 #endif
 
-        bucket_accessor b_old( this, h & mask );
+        bucket_accessor b_old( this, h & mask, /*writer=*/false, /*merge=*/false ); // b_new could be in the shrinking segment
+        __TBB_ASSERT( !b_old.is_outdated(), "the parent bucket must be in the table" );
 
         mask = (mask<<1) | 1; // get full mask for new bucket
         __TBB_ASSERT( (mask&(mask+1))==0 && (h & mask) == h, NULL );
@@ -871,6 +1135,7 @@ public:
     concurrent_hash_map( concurrent_hash_map &&table )
         : internal::hash_map_base(), my_allocator(std::move(table.get_allocator()))
     {
+        table.finish_shrink();
         internal_move(std::move(table));
     }
 
@@ -879,6 +1144,7 @@ public:
         : internal::hash_map_base(), my_allocator(a)
     {
         if (a == table.get_allocator()){
+            table.finish_shrink();
             internal_move(std::move(table));
         }else{
             call_clear_on_leave scope_guard(this);
@@ -974,18 +1240,26 @@ public:
     // Parallel algorithm support
     //------------------------------------------------------------------------
     range_type range( size_type grainsize=1 ) {
+        finish_shrink();
         return range_type( *this, grainsize );
     }
     const_range_type range( size_type grainsize=1 ) const {
+        const_cast<concurrent_hash_map*>(this)->finish_shrink();
         return const_range_type( *this, grainsize );
     }
 
     //------------------------------------------------------------------------
     // STL support - not thread-safe methods
     //------------------------------------------------------------------------
-    iterator begin() { return iterator( *this, 0, my_embedded_segment, my_embedded_segment->node_list ); }
+    iterator begin() {
+        finish_shrink();
+        return iterator( *this, 0, my_embedded_segment, my_embedded_segment->node_list );
+    }
     iterator end() { return iterator( *this, 0, 0, 0 ); }
-    const_iterator begin() const { return const_iterator( *this, 0, my_embedded_segment, my_embedded_segment->node_list ); }
+    const_iterator begin() const {
+        const_cast<concurrent_hash_map*>(this)->finish_shrink();
+        return const_iterator( *this, 0, my_embedded_segment, my_embedded_segment->node_list );
+    }
     const_iterator end() const { return const_iterator( *this, 0, 0, 0 ); }
     std::pair<iterator, iterator> equal_range( const Key& key ) { return internal_equal_range( key, end() ); }
     std::pair<const_iterator, const_iterator> equal_range( const Key& key ) const { return internal_equal_range( key, end() ); }
@@ -1002,6 +1276,32 @@ public:
     //! Returns the current number of buckets
     size_type bucket_count() const { return my_mask+1; }
 
+    //! Returns the average number of items per bucket
+    float load_factor() const { return float(my_size) / float(my_mask+1); }
+
+    //! Returns the load factor that makes the table grow
+    float max_load_factor() const { return my_max_load_factor; }
+
+    //! Set the load factor that makes the table grow. Not thread safe.
+    void max_load_factor( float z ) {
+        __TBB_ASSERT( z > 0 && my_min_load_factor * 2 < z, "the load factor must be positive and much bigger than the minimal one" );
+        my_max_load_factor = z;
+    }
+
+    //! Returns the load factor that makes the table shrink
+    float min_load_factor() const { return my_min_load_factor; }
+
+    //! Set the load factor that makes the table shrink, zero disables shrinking. Not thread safe.
+    /** When erasures reduce the load factor below the value, the table halves its number of buckets,
+        merging them incrementally by concurrent operations. The memory of the merged buckets is
+        deallocated when the operations that could access them are done. Must be less than half of
+        max_load_factor(). While shrinking is enabled, the operations are counted by the table. */
+    void min_load_factor( float z ) {
+        __TBB_ASSERT( z >= 0 && z * 2 < my_max_load_factor, "the load factor must be less than half of the maximal one" );
+        finish_shrink();
+        set_min_load_factor( z );
+    }
+
     //! return allocator object
     allocator_type get_allocator() const { return this->my_allocator; }
 
@@ -1109,10 +1409,11 @@ public:
 #endif //__TBB_CPP11_RVALUE_REF_PRESENT
 
     //! Insert range [first, last)
+    /** Forward iterators over pairs of the key and the mapped value are processed in batches,
+        see find_batch(). */
     template<typename I>
     void insert( I first, I last ) {
-        for ( ; first != last; ++first )
-            insert( *first );
+        internal_insert_range( first, last, typename std::iterator_traits<I>::iterator_category() );
     }
 
 #if __TBB_INITIALIZER_LISTS_PRESENT
@@ -1138,7 +1439,70 @@ public:
         return exclude( item_accessor );
     }
 
+    //! Find the items with the keys from the forward range [first, last).
+    /** For every key, assigns whether it is found to *found++, and copies the mapped value of
+        the found item to *result++. Returns the number of found items.
+        The keys are processed in chunks: the hash codes of a chunk are computed at once and
+        its buckets and nodes are prefetched, then the lock of every bucket is acquired once for
+        all the keys that go into it. Large batches can be split by the caller with parallel_for. */
+    template<typename I, typename OutputIterator, typename FlagIterator>
+    size_type find_batch( I first, I last, OutputIterator result, FlagIterator found ) const;
+
+    //! Erase the items with the keys from the forward range [first, last).
+    /** Returns the number of erased items. The keys are processed like in find_batch(). */
+    template<typename I>
+    size_type erase_batch( I first, I last );
+
 protected:
+    //! Number of keys processed at once by the batch operations
+    static const size_type batch_chunk = 16;
+
+    //! Key of a batch operation
+    struct batch_item {
+        hashcode_t hash;
+        //! Bucket found by the mask loaded at the beginning of the chunk
+        bucket *b;
+        //! Position of the key in the chunk
+        size_type index;
+    };
+
+    //! Find and prefetch the buckets of the chunk, then group the items by buckets.
+    void prepare_batch( batch_item *items, size_type n, hashcode_t m ) const {
+        for( size_type i = 0; i < n; ++i ) {
+            items[i].b = get_bucket( items[i].hash & m );
+            __TBB_hash_map_prefetch( items[i].b );
+        }
+        for( size_type i = 0; i < n; ++i ) {
+            node_base *first = itt_hide_load_word( items[i].b->node_list ); // it is a hint only
+            if( is_valid( first ) )
+                __TBB_hash_map_prefetch( first );
+        }
+        for( size_type i = 1; i < n; ++i ) // insertion sort of the short chunk
+            for( size_type j = i; j && items[j].b < items[j-1].b; --j )
+                std::swap( items[j], items[j-1] );
+    }
+
+    template<typename I>
+    void internal_insert_range( I first, I last, std::input_iterator_tag ) {
+        for ( ; first != last; ++first )
+            insert( *first );
+    }
+
+    template<typename I>
+    void internal_insert_range( I first, I last, std::forward_iterator_tag ) {
+        typedef typename std::iterator_traits<I>::value_type iterator_value_type;
+        internal_insert_range( first, last, tbb::internal::bool_constant<internal::is_hash_map_value<iterator_value_type, Key, T>::value>() );
+    }
+
+    template<typename I>
+    void internal_insert_range( I first, I last, tbb::internal::false_type ) {
+        internal_insert_range( first, last, std::input_iterator_tag() );
+    }
+
+    //! Insert the forward range in batches
+    template<typename I>
+    void internal_insert_range( I first, I last, tbb::internal::true_type );
+
     //! Insert or find item and optionally acquire a lock on the item.
     bool lookup(bool op_insert, const Key &key, const T *t, const_accessor *result, bool write,  node* (*allocate_node)(node_allocator_type& ,  const Key &, const T * ), node *tmp_n = 0  ) ;
 
@@ -1183,12 +1547,16 @@ protected:
 #if __TBB_CPP11_RVALUE_REF_PRESENT
     // A compile-time dispatch to allow move assignment of containers with non-movable value_type if POCMA is true_type
     void internal_move_assign(concurrent_hash_map&& other, tbb::internal::traits_true_type) {
+        finish_shrink();
+        other.finish_shrink();
         tbb::internal::allocator_move_assignment(my_allocator, other.my_allocator, tbb::internal::traits_true_type());
         internal_move(std::move(other));
     }
 
     void internal_move_assign(concurrent_hash_map&& other, tbb::internal::traits_false_type) {
         if (this->my_allocator == other.my_allocator) {
+            finish_shrink();
+            other.finish_shrink();
             internal_move(std::move(other));
         } else {
             //do per element move
@@ -1202,10 +1570,12 @@ protected:
         Must not be called concurrently with erasure operations. */
     const_pointer internal_fast_find( const Key& key ) const {
         hashcode_t h = my_hash_compare.hash( key );
+        operation_guard guard( this, h );
         hashcode_t m = (hashcode_t) itt_load_word_with_acquire( my_mask );
         node *n;
     restart:
         __TBB_ASSERT((m&(m+1))==0, "data structure is invalid");
+        const_cast<concurrent_hash_map*>(this)->prepare_bucket( h & m ); // the table can't start shrinking without erasures
         bucket *b = get_bucket( h & m );
         // TODO: actually, notification is unnecessary here, just hiding double-check
         if( itt_load_word_with_acquire(b->node_list) == internal::rehash_req )
@@ -1259,6 +1629,7 @@ bool concurrent_hash_map<Key,T,HashCompare,A>::lookup( bool op_insert, const Key
     __TBB_ASSERT( !result || !result->my_node, NULL );
     bool return_value;
     hashcode_t const h = my_hash_compare.hash( key );
+    operation_guard guard( this, h );
     hashcode_t m = (hashcode_t) itt_load_word_with_acquire( my_mask );
     segment_index_t grow_segment = 0;
     node *n;
@@ -1268,6 +1639,10 @@ bool concurrent_hash_map<Key,T,HashCompare,A>::lookup( bool op_insert, const Key
         return_value = false;
         // get bucket
         bucket_accessor b( this, h & m );
+        if( b.is_outdated() ) {
+            m = (hashcode_t) itt_load_word_with_acquire( my_mask );
+            goto restart; // b.release() is done in ~b().
+        }
 
         // find a node
         n = search_bucket( key, b() );
@@ -1278,6 +1653,10 @@ bool concurrent_hash_map<Key,T,HashCompare,A>::lookup( bool op_insert, const Key
                     tmp_n = allocate_node(my_allocator, key, t);
                 }
                 if( !b.is_writer() && !b.upgrade_to_writer() ) { // TODO: improved insertion
+                    if( b.is_outdated() ) {
+                        m = (hashcode_t) itt_load_word_with_acquire( my_mask );
+                        goto restart;
+                    }
                     // Rerun search_list, in case another thread inserted the item during the upgrade.
                     n = search_bucket( key, b() );
                     if( is_valid(n) ) { // unfortunately, it did
@@ -1326,7 +1705,7 @@ check_growth:
 #if __TBB_STATISTICS
         my_info_resizes++; // concurrent ones
 #endif
-        enable_segment( grow_segment, my_allocator );
+        grow_table( grow_segment, my_allocator );
     }
     if( tmp_n ) // if op_insert only
         delete_node( tmp_n );
@@ -1336,6 +1715,7 @@ check_growth:
 template<typename Key, typename T, typename HashCompare, typename A>
 template<typename I>
 std::pair<I, I> concurrent_hash_map<Key,T,HashCompare,A>::internal_equal_range( const Key& key, I end_ ) const {
+    const_cast<concurrent_hash_map*>(this)->finish_shrink();
     hashcode_t h = my_hash_compare.hash( key );
     hashcode_t m = my_mask;
     __TBB_ASSERT((m&(m+1))==0, "data structure is invalid");
@@ -1357,10 +1737,15 @@ bool concurrent_hash_map<Key,T,HashCompare,A>::exclude( const_accessor &item_acc
     __TBB_ASSERT( item_accessor.my_node, NULL );
     node_base *const n = item_accessor.my_node;
     hashcode_t const h = item_accessor.my_hash;
+    operation_guard guard( this, h );
     hashcode_t m = (hashcode_t) itt_load_word_with_acquire( my_mask );
     do {
         // get bucket
         bucket_accessor b( this, h & m, /*writer=*/true );
+        if( b.is_outdated() ) {
+            m = (hashcode_t) itt_load_word_with_acquire( my_mask );
+            continue;
+        }
         node_base **p = &b()->node_list;
         while( *p && *p != n )
             p = &(*p)->next;
@@ -1379,6 +1764,7 @@ bool concurrent_hash_map<Key,T,HashCompare,A>::exclude( const_accessor &item_acc
         item_accessor.upgrade_to_writer(); // return value means nothing here
     item_accessor.release();
     delete_node( n ); // Only one thread can delete it
+    try_shrink();
     return true;
 }
 
@@ -1386,12 +1772,17 @@ template<typename Key, typename T, typename HashCompare, typename A>
 bool concurrent_hash_map<Key,T,HashCompare,A>::erase( const Key &key ) {
     node_base *n;
     hashcode_t const h = my_hash_compare.hash( key );
+    operation_guard guard( this, h );
     hashcode_t m = (hashcode_t) itt_load_word_with_acquire( my_mask );
 restart:
     {//lock scope
         // get bucket
         bucket_accessor b( this, h & m );
     search:
+        if( b.is_outdated() ) {
+            m = (hashcode_t) itt_load_word_with_acquire( my_mask );
+            goto restart;
+        }
         node_base **p = &b()->node_list;
         n = *p;
         while( is_valid(n) && !my_hash_compare.equal(key, static_cast<node*>(n)->value().first ) ) {
@@ -1416,14 +1807,198 @@ restart:
     }
     // note: there should be no threads pretending to acquire this mutex again, do not try to upgrade const_accessor!
     delete_node( n ); // Only one thread can delete it due to write lock on the bucket
+    try_shrink();
     return true;
 }
 
+template<typename Key, typename T, typename HashCompare, typename A>
+template<typename I>
+void concurrent_hash_map<Key,T,HashCompare,A>::internal_insert_range( I first, I last, tbb::internal::true_type ) {
+    batch_item items[batch_chunk];
+    I keys[batch_chunk];
+    while( first != last ) {
+        size_type n = 0;
+        for( ; n < batch_chunk && first != last; ++n, ++first ) {
+            keys[n] = first;
+            items[n].hash = my_hash_compare.hash( (*first).first );
+            items[n].index = n;
+        }
+        operation_guard guard( this, items[0].hash );
+        hashcode_t m = (hashcode_t) itt_load_word_with_acquire( my_mask );
+        prepare_batch( items, n, m );
+        bool deferred[batch_chunk] = {};
+        for( size_type i = 0; i < n; ) {
+            segment_index_t grow_segment = 0;
+            {
+                bucket_accessor b( this, items[i].hash & m, /*writer=*/true );
+                // the growth is done after the lock is released
+                for( bucket *run = items[i].b; i < n && items[i].b == run && !grow_segment; ++i ) {
+                    typename std::iterator_traits<I>::reference value = *keys[items[i].index];
+                    if( b.is_outdated() ) {
+                        deferred[items[i].index] = true;
+                        continue;
+                    }
+                    if( search_bucket( value.first, b() ) )
+                        continue; // the key exists
+                    hashcode_t mask = m;
+                    if( check_mask_race( items[i].hash, mask ) ) {
+                        deferred[items[i].index] = true;
+                        continue;
+                    }
+                    node *new_node = allocate_node_copy_construct( my_allocator, value.first, &value.second );
+                    grow_segment = insert_new_node( b(), new_node, m );
+                }
+            }
+            if( grow_segment ) {
+#if __TBB_STATISTICS
+                my_info_resizes++; // concurrent ones
+#endif
+                grow_table( grow_segment, my_allocator );
+            }
+        }
+        for( size_type i = 0; i < n; ++i )
+            if( deferred[i] ) // the table was resized concurrently
+                lookup( /*insert*/true, (*keys[i]).first, &(*keys[i]).second, NULL, /*write=*/false, &allocate_node_copy_construct );
+    }
+}
+
+template<typename Key, typename T, typename HashCompare, typename A>
+template<typename I, typename OutputIterator, typename FlagIterator>
+typename concurrent_hash_map<Key,T,HashCompare,A>::size_type
+concurrent_hash_map<Key,T,HashCompare,A>::find_batch( I first, I last, OutputIterator result, FlagIterator found ) const {
+    concurrent_hash_map *self = const_cast<concurrent_hash_map*>(this);
+    batch_item items[batch_chunk];
+    I keys[batch_chunk];
+    //! Copies of the mapped values of the found items in the chunk
+    struct values_guard : tbb::internal::no_copy {
+        tbb::aligned_space<T, batch_chunk> my_values;
+        bool my_constructed[batch_chunk];
+        values_guard() { std::memset( my_constructed, 0, sizeof(my_constructed) ); }
+        ~values_guard() {
+            for( size_type i = 0; i < batch_chunk; ++i )
+                if( my_constructed[i] ) my_values.begin()[i].~T();
+        }
+        void construct( size_type i, const T &value ) {
+            new( my_values.begin() + i ) T( value );
+            my_constructed[i] = true;
+        }
+    } values;
+    size_type found_count = 0;
+    while( first != last ) {
+        size_type n = 0;
+        for( ; n < batch_chunk && first != last; ++n, ++first ) {
+            keys[n] = first;
+            items[n].hash = my_hash_compare.hash( *first );
+            items[n].index = n;
+        }
+        operation_guard guard( this, items[0].hash );
+        hashcode_t m = (hashcode_t) itt_load_word_with_acquire( my_mask );
+        prepare_batch( items, n, m );
+        bool deferred[batch_chunk] = {};
+        for( size_type i = 0; i < n; ) {
+            bucket_accessor b( self, items[i].hash & m );
+            for( bucket *run = items[i].b; i < n && items[i].b == run; ++i ) {
+                size_type k = items[i].index;
+                hashcode_t mask = m;
+                node *found_node = b.is_outdated() ? NULL : search_bucket( *keys[k], b() );
+                if( found_node ) {
+                    typename node::scoped_t item_lock;
+                    if( item_lock.try_acquire( found_node->mutex, /*write=*/false ) )
+                        values.construct( k, found_node->value().second );
+                    else
+                        deferred[k] = true; // the item is locked for long, do not block the bucket
+                } else if( b.is_outdated() || check_mask_race( items[i].hash, mask ) )
+                    deferred[k] = true;
+            }
+        }
+        for( size_type i = 0; i < n; ++i ) {
+            if( deferred[i] ) {
+                const_accessor item;
+                if( find( item, *keys[i] ) )
+                    values.construct( i, item->second );
+            }
+            *found = values.my_constructed[i];
+            ++found;
+            if( values.my_constructed[i] ) {
+                *result = values.my_values.begin()[i];
+                ++result;
+                values.my_values.begin()[i].~T();
+                values.my_constructed[i] = false;
+                ++found_count;
+            }
+        }
+    }
+    return found_count;
+}
+
+template<typename Key, typename T, typename HashCompare, typename A>
+template<typename I>
+typename concurrent_hash_map<Key,T,HashCompare,A>::size_type
+concurrent_hash_map<Key,T,HashCompare,A>::erase_batch( I first, I last ) {
+    batch_item items[batch_chunk];
+    I keys[batch_chunk];
+    size_type erased = 0;
+    while( first != last ) {
+        size_type n = 0;
+        for( ; n < batch_chunk && first != last; ++n, ++first ) {
+            keys[n] = first;
+            items[n].hash = my_hash_compare.hash( *first );
+            items[n].index = n;
+        }
+        operation_guard guard( this, items[0].hash );
+        hashcode_t m = (hashcode_t) itt_load_word_with_acquire( my_mask );
+        prepare_batch( items, n, m );
+        bool deferred[batch_chunk] = {};
+        node_base *removed = NULL;
+        for( size_type i = 0; i < n; ) {
+            bucket_accessor b( this, items[i].hash & m, /*writer=*/true );
+            for( bucket *run = items[i].b; i < n && items[i].b == run; ++i ) {
+                hashcode_t mask = m;
+                if( b.is_outdated() ) {
+                    deferred[items[i].index] = true;
+                    continue;
+                }
+                node_base **p = &b()->node_list;
+                node_base *n_found = *p;
+                while( is_valid(n_found) && !my_hash_compare.equal( *keys[items[i].index], static_cast<node*>(n_found)->value().first ) ) {
+                    p = &n_found->next;
+                    n_found = *p;
+                }
+                if( !n_found ) {
+                    if( check_mask_race( items[i].hash, mask ) )
+                        deferred[items[i].index] = true;
+                    continue;
+                }
+                *p = n_found->next;
+                my_size--;
+                n_found->next = removed; // the nodes are deleted after the bucket locks are released
+                removed = n_found;
+            }
+        }
+        while( removed ) {
+            node_base *next = removed->next;
+            {
+                typename node::scoped_t item_locker( removed->mutex, /*write=*/true );
+            }
+            delete_node( removed );
+            try_shrink();
+            ++erased;
+            removed = next;
+        }
+        for( size_type i = 0; i < n; ++i )
+            if( deferred[i] )
+                erased += erase( *keys[i] );
+    }
+    return erased;
+}
+
 template<typename Key, typename T, typename HashCompare, typename A>
 void concurrent_hash_map<Key,T,HashCompare,A>::swap(concurrent_hash_map<Key,T,HashCompare,A> &table) {
     typedef typename node_allocator_traits::propagate_on_container_swap pocs_type;
     if (this != &table && (pocs_type::value || my_allocator == table.my_allocator)) {
         using std::swap;
+        finish_shrink(); // with the allocators that allocated the segments
+        table.finish_shrink();
         tbb::internal::allocator_swap(this->my_allocator, table.my_allocator, pocs_type());
         swap(this->my_hash_compare, table.my_hash_compare);
         internal_swap(table);
@@ -1432,7 +2007,8 @@ void concurrent_hash_map<Key,T,HashCompare,A>::swap(concurrent_hash_map<Key,T,Ha
 
 template<typename Key, typename T, typename HashCompare, typename A>
 void concurrent_hash_map<Key,T,HashCompare,A>::rehash(size_type sz) {
-    reserve( sz, my_allocator ); // TODO: add reduction of number of buckets as well
+    finish_shrink();
+    reserve( sz, my_allocator );
     hashcode_t mask = my_mask;
     hashcode_t b = (mask+1)>>1; // size or first index of the last segment
     __TBB_ASSERT((b&(b-1))==0, NULL); // zero or power of 2
@@ -1558,7 +2134,8 @@ void concurrent_hash_map<Key,T,HashCompare,A>::clear() {
 #endif // TBB_USE_ASSERT || TBB_USE_PERFORMANCE_WARNINGS || __TBB_STATISTICS
     my_size = 0;
     segment_index_t s = segment_index_of( m );
-    __TBB_ASSERT( s+1 == pointers_per_table || !my_table[s+1], "wrong mask or concurrent grow" );
+    if( s+1 < pointers_per_table && my_table[s+1] ) // the segment merged or retired by shrinking
+        s++;
     do {
         __TBB_ASSERT( is_valid( my_table[s] ), "wrong mask or concurrent grow" );
         segment_ptr_t buckets_ptr = my_table[s];
@@ -1571,10 +2148,16 @@ void concurrent_hash_map<Key,T,HashCompare,A>::clear() {
         delete_segment(s, my_allocator);
     } while(s-- > 0);
     my_mask = embedded_buckets - 1;
+    my_shrink_segment = 0;
+    my_retired_segment = 0;
+    my_resize_lock = 0;
 }
 
 template<typename Key, typename T, typename HashCompare, typename A>
 void concurrent_hash_map<Key,T,HashCompare,A>::internal_copy( const concurrent_hash_map& source ) {
+    const_cast<concurrent_hash_map&>(source).finish_shrink();
+    my_max_load_factor = source.my_max_load_factor;
+    set_min_load_factor( source.my_min_load_factor );
     hashcode_t mask = source.my_mask;
     if( my_mask == mask ) { // optimized version
         reserve( source.my_size, my_allocator ); // TODO: load_factor?
@@ -1613,9 +2196,9 @@ void concurrent_hash_map<Key,T,HashCompare,A>::internal_copy(I first, I last, si
     }
 }
 
-} // namespace interface5
+} // namespace interface6
 
-using interface5::concurrent_hash_map;
+using interface6::concurrent_hash_map;
 
 
 template<typename Key, typename T, typename HashCompare, typename A1, typename A2>
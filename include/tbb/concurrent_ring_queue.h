@@ -0,0 +1,371 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef __TBB_concurrent_ring_queue_H
+#define __TBB_concurrent_ring_queue_H
+
+#define __TBB_concurrent_ring_queue_H_include_area
+#include "internal/_warning_suppress_enable_notice.h"
+
+#if ! TBB_PREVIEW_CONCURRENT_RING_QUEUE
+    #error Set TBB_PREVIEW_CONCURRENT_RING_QUEUE to include concurrent_ring_queue.h
+#endif
+
+#include "tbb_stddef.h"
+#include "tbb_machine.h"
+#include "atomic.h"
+#include "aligned_space.h"
+#include "cache_aligned_allocator.h"
+#include "tbb_exception.h"
+#include "internal/_allocator_traits.h"
+#include <new>
+#include <iterator>
+
+namespace tbb {
+
+//! @cond INTERNAL
+namespace internal {
+
+//! Positions and blocking support of concurrent_ring_queue
+/** The positions of the next push and pop are on separate cache lines together with the
+    counters of the threads blocked on the opposite side, so that a non-blocking operation
+    touches only its own line and the slot. Blocking is implemented in the library with
+    concurrent_monitor, and the monitors are notified only if the counter is not zero. */
+class concurrent_ring_queue_base_v1 : no_copy {
+protected:
+    typedef size_t size_type;
+
+    //! Position of the next push
+    atomic<size_type> my_tail;
+    //! Number of threads blocked by an empty queue
+    atomic<size_type> my_items_waiters;
+    char my_pad1[NFS_MaxLineSize-2*sizeof(atomic<size_type>)];
+
+    //! Position of the next pop
+    atomic<size_type> my_head;
+    //! Number of threads blocked by a full queue
+    atomic<size_type> my_slots_waiters;
+    char my_pad2[NFS_MaxLineSize-2*sizeof(atomic<size_type>)];
+
+    //! Number of slots minus one; the number of slots is a power of two
+    size_type my_mask;
+    //! Incremented by abort() to wake up and fail the blocked operations
+    atomic<unsigned> my_abort_counter;
+    //! Monitors of the library
+    void* my_rep;
+
+    __TBB_EXPORTED_METHOD concurrent_ring_queue_base_v1();
+    __TBB_EXPORTED_METHOD ~concurrent_ring_queue_base_v1();
+
+    //! Block until the queue is not empty (for_items) or not full, or until the abort_counter changes
+    /** Returns without blocking if the condition holds already. Throws user_abort if aborted. */
+    void __TBB_EXPORTED_METHOD internal_wait( bool for_items, unsigned abort_counter );
+
+    //! Wake up the threads blocked by an empty (items) or a full queue
+    void __TBB_EXPORTED_METHOD internal_notify( bool items, bool all );
+
+    //! Wake up all the blocked threads with user_abort
+    void __TBB_EXPORTED_METHOD internal_abort();
+
+    void notify_items( bool all ) {
+        if( my_items_waiters )
+            internal_notify( /*items=*/true, all );
+    }
+    void notify_slots( bool all ) {
+        if( my_slots_waiters )
+            internal_notify( /*items=*/false, all );
+    }
+};
+
+//! Slot of concurrent_ring_queue
+/** The sequence number is equal to the position of the push for a free slot, to the position
+    plus one for an occupied slot, and to the position plus the capacity after a pop. */
+template<typename T>
+struct ring_queue_slot {
+    atomic<size_t> my_sequence;
+    //! False if the construction of the item has thrown an exception
+    bool my_valid;
+    aligned_space<T> my_item;
+};
+
+} // namespace internal
+//! @endcond
+
+//! A bounded multi-producer multi-consumer queue on a ring buffer
+/** The capacity is rounded up to a power of two, and all the memory is allocated by the constructor.
+    Each slot has a sequence number that tells whether the slot is ready for the push or the pop
+    at a position, so that the non-blocking operations are a compare-and-swap of the position and
+    the copy of the item. The blocking operations spin for a while and then block.
+    @ingroup containers */
+template<typename T, typename A = cache_aligned_allocator<T> >
+class concurrent_ring_queue : internal::concurrent_ring_queue_base_v1 {
+    typedef internal::ring_queue_slot<T> slot_type;
+    typedef typename tbb::internal::allocator_rebind<A, slot_type>::type slot_allocator_type;
+
+    slot_allocator_type my_allocator;
+    slot_type* my_slots;
+
+    slot_type& slot( size_type position ) const { return my_slots[position & my_mask]; }
+
+    //! Claim up to n consecutive positions which slots have sequences equal to the position plus shift
+    /** The shift is 0 for the push and 1 for the pop. Returns the number of claimed positions
+        and sets pos to the first one. */
+    size_type claim( atomic<size_type>& counter, size_type& pos, size_type n, size_type shift ) {
+        pos = counter;
+        for(;;) {
+            intptr_t d = intptr_t( slot( pos ).my_sequence - (pos+shift) );
+            if( d < 0 )
+                return 0; // the queue is full or empty
+            if( d > 0 ) {
+                pos = counter; // the position is taken by another thread
+                continue;
+            }
+            size_type m = 1;
+            while( m < n && slot( pos+m ).my_sequence == pos+m+shift )
+                ++m;
+            size_type p = counter.compare_and_swap( pos+m, pos );
+            if( p == pos )
+                return m;
+            pos = p;
+        }
+    }
+
+    //! Publish the item at the claimed position
+    void publish_item( size_type pos, bool valid ) {
+        slot_type& s = slot( pos );
+        s.my_valid = valid;
+        s.my_sequence.template store<release>( pos+1 );
+    }
+
+    //! Free the slot at the popped position
+    void release_slot( size_type pos ) {
+        slot( pos ).my_sequence.template store<release>( pos+my_mask+1 );
+    }
+
+    //! Push the items at n claimed positions starting from pos
+    template<typename I>
+    I push_claimed( I first, size_type pos, size_type n ) {
+        size_type i = 0;
+        __TBB_TRY {
+            for( ; i < n; ++i, ++first ) {
+                new( slot( pos+i ).my_item.begin() ) T( *first );
+                publish_item( pos+i, true );
+            }
+        } __TBB_CATCH(...) {
+            // the claimed positions cannot be returned, so they are published as invalid
+            for( ; i < n; ++i )
+                publish_item( pos+i, false );
+            notify_items( true );
+            __TBB_RETHROW();
+        }
+        return first;
+    }
+
+    //! Destroys the item and frees the slot of a popped position even if the move of the item throws
+    class pop_finalizer : tbb::internal::no_copy {
+        concurrent_ring_queue& my_queue;
+        size_type my_pos;
+    public:
+        pop_finalizer( concurrent_ring_queue& q, size_type pos ) : my_queue(q), my_pos(pos) {}
+        //! The popped item or NULL if it is invalid
+        T* item() const {
+            slot_type& s = my_queue.slot( my_pos );
+            return s.my_valid ? s.my_item.begin() : NULL;
+        }
+        ~pop_finalizer() {
+            if( T* p = item() )
+                p->~T();
+            my_queue.release_slot( my_pos );
+        }
+    };
+
+    //! Pop the items at n claimed positions starting from pos; returns the number of valid items
+    template<typename O>
+    size_type pop_claimed( O& result, size_type pos, size_type n ) {
+        size_type popped = 0;
+        for( size_type i = 0; i < n; ++i ) {
+            pop_finalizer f( *this, pos+i );
+            if( T* item = f.item() ) {
+                *result = tbb::internal::move( *item );
+                ++result; ++popped;
+            }
+        }
+        return popped;
+    }
+
+    //! Try to push one item; the Construct functor constructs it at the given address
+    template<typename Construct>
+    bool internal_try_push( const Construct& construct ) {
+        size_type pos;
+        if( !claim( my_tail, pos, 1, 0 ) )
+            return false;
+        __TBB_TRY {
+            construct( static_cast<void*>( slot( pos ).my_item.begin() ) );
+        } __TBB_CATCH(...) {
+            publish_item( pos, false );
+            notify_items( false );
+            __TBB_RETHROW();
+        }
+        publish_item( pos, true );
+        notify_items( false );
+        return true;
+    }
+
+    template<typename Construct>
+    void internal_push( const Construct& construct ) {
+        unsigned abort_counter = my_abort_counter;
+        for( tbb::internal::atomic_backoff backoff; !internal_try_push( construct ); )
+            if( !backoff.bounded_pause() )
+                internal_wait( /*for_items=*/false, abort_counter );
+    }
+
+    struct copy_construct : tbb::internal::no_assign {
+        const T& my_item;
+        copy_construct( const T& item ) : my_item(item) {}
+        void operator()( void* location ) const { new( location ) T( my_item ); }
+    };
+#if __TBB_CPP11_RVALUE_REF_PRESENT
+    struct move_construct : tbb::internal::no_assign {
+        T& my_item;
+        move_construct( T& item ) : my_item(item) {}
+        void operator()( void* location ) const { new( location ) T( std::move( my_item ) ); }
+    };
+#endif
+
+public:
+    typedef T value_type;
+    typedef A allocator_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+
+    //! Construct the queue with at least the given capacity
+    explicit concurrent_ring_queue( size_type capacity, const allocator_type& a = allocator_type() )
+        : my_allocator(a), my_slots(NULL)
+    {
+        __TBB_ASSERT( capacity, "the capacity must be positive" );
+        if( capacity > (~size_type(0)/sizeof(slot_type))/2 )
+            tbb::internal::throw_exception( tbb::internal::eid_reservation_length_error );
+        size_type n = 2;
+        while( n < capacity ) n *= 2;
+        my_mask = n-1;
+        my_slots = my_allocator.allocate( n );
+        for( size_type i = 0; i < n; ++i ) {
+            new( &my_slots[i].my_sequence ) atomic<size_type>();
+            my_slots[i].my_sequence = i;
+        }
+    }
+
+    //! Destroy the items left in the queue
+    ~concurrent_ring_queue() {
+        clear();
+        my_allocator.deallocate( my_slots, my_mask+1 );
+    }
+
+    //! Push a copy of the item, blocking while the queue is full
+    void push( const T& item ) { internal_push( copy_construct( item ) ); }
+
+    //! Try to push a copy of the item without blocking. Returns false if the queue is full.
+    bool try_push( const T& item ) { return internal_try_push( copy_construct( item ) ); }
+
+#if __TBB_CPP11_RVALUE_REF_PRESENT
+    void push( T&& item ) { internal_push( move_construct( item ) ); }
+
+    bool try_push( T&& item ) { return internal_try_push( move_construct( item ) ); }
+#endif
+
+    //! Pop an item, blocking while the queue is empty
+    void pop( T& destination ) {
+        unsigned abort_counter = my_abort_counter;
+        for( tbb::internal::atomic_backoff backoff; !try_pop( destination ); )
+            if( !backoff.bounded_pause() )
+                internal_wait( /*for_items=*/true, abort_counter );
+    }
+
+    //! Try to pop an item without blocking. Returns false if the queue is empty.
+    bool try_pop( T& destination ) {
+        size_type pos;
+        // the positions of invalid items are skipped
+        while( claim( my_head, pos, 1, 1 ) ) {
+            bool valid;
+            {
+                pop_finalizer f( *this, pos );
+                if( (valid = f.item() != NULL) )
+                    destination = tbb::internal::move( *f.item() );
+            }
+            notify_slots( false );
+            if( valid )
+                return true;
+        }
+        return false;
+    }
+
+    //! Push the longest prefix of [first, first+n) that fits into the queue without blocking
+    /** The positions of the items are claimed at once. Returns the number of pushed items. */
+    template<typename InputIterator>
+    size_type try_push_n( InputIterator first, size_type n ) {
+        size_type pos, m = n ? claim( my_tail, pos, n, 0 ) : 0;
+        if( m ) {
+            push_claimed( first, pos, m );
+            notify_items( m > 1 );
+        }
+        return m;
+    }
+
+    //! Pop up to n items into the output iterator without blocking
+    /** Returns the number of popped items. */
+    template<typename OutputIterator>
+    size_type try_pop_n( OutputIterator result, size_type n ) {
+        size_type popped = 0, pos, m;
+        while( popped < n && (m = claim( my_head, pos, n-popped, 1 )) ) {
+            popped += pop_claimed( result, pos, m );
+            notify_slots( m > 1 );
+        }
+        return popped;
+    }
+
+    //! Wake up the threads blocked in push() and pop() with user_abort exception
+    void abort() { internal_abort(); }
+
+    //! Number of items in the queue. Approximate if the queue is modified concurrently.
+    size_type size() const {
+        size_type head = my_head, tail = my_tail;
+        return intptr_t(tail-head) > 0 ? tail-head : 0;
+    }
+
+    //! Equivalent to size()==0
+    bool empty() const { return !size(); }
+
+    //! Maximal number of items in the queue
+    size_type capacity() const { return my_mask+1; }
+
+    //! Destroy all the items. Not thread-safe.
+    void clear() {
+        size_type pos;
+        while( size_type m = claim( my_head, pos, capacity(), 1 ) )
+            for( size_type i = 0; i < m; ++i )
+                pop_finalizer f( *this, pos+i );
+    }
+
+    allocator_type get_allocator() const { return allocator_type( my_allocator ); }
+};
+
+} // namespace tbb
+
+#include "internal/_warning_suppress_disable_notice.h"
+#undef __TBB_concurrent_ring_queue_H_include_area
+
+#endif /* __TBB_concurrent_ring_queue_H */
@@ -63,6 +63,10 @@ namespace tbb {
 template<typename T, class A = cache_aligned_allocator<T> >
 class concurrent_vector;
 
+//! Tag for the constructor of concurrent_vector that reserves a contiguous storage
+/** @ingroup containers */
+class contiguous_reserve {};
+
 //! @cond INTERNAL
 namespace internal {
 
@@ -271,6 +275,11 @@ namespace internal {
 
         //! Deprecated entry point for backwards compatibility to TBB 2.1.
         void __TBB_EXPORTED_METHOD internal_grow_to_at_least( size_type new_size, size_type element_size, internal_array_op2 init, const void *src );
+
+        //! Reserve address space of size bytes with pages committed on demand. Returns NULL on failure.
+        static void* __TBB_EXPORTED_FUNC internal_map_contiguous( size_type size );
+        //! Release address space reserved by internal_map_contiguous
+        static void __TBB_EXPORTED_FUNC internal_unmap_contiguous( void* ptr, size_type size );
 private:
         //! Private functionality
         class helper;
@@ -520,6 +529,11 @@ public:
     the first array. Using small number of elements as initial size incurs fragmentation that
     may increase element access time. Internal layout can be optimized by method compact() that
     merges several smaller arrays into one solid.
+@par
+    A vector constructed with contiguous_reserve keeps all elements in a single array instead.
+    The address space for the maximal capacity is reserved at once, and the memory pages are
+    committed on demand as the vector grows, so growth stays concurrent and data() points to
+    all the elements.
 
 @par Changes since TBB 2.1
     - Fixed guarantees of concurrent_vector::size() and grow_to_at_least() methods to assure elements are allocated.
@@ -611,6 +625,21 @@ public:
         vector_allocator_ptr = &internal_allocator;
     }
 
+    //! Construct empty vector with contiguous storage for at least max_capacity items.
+    /** The address space is reserved by the constructor, the allocator is not used for the items.
+        Growth beyond the reserved capacity throws std::bad_alloc. */
+    concurrent_vector(contiguous_reserve, size_type max_capacity, const allocator_type &a = allocator_type())
+        : internal::allocator_base<T, A>(a), internal::concurrent_vector_base()
+    {
+        vector_allocator_ptr = &internal_allocator;
+        if( !max_capacity || max_capacity > max_size()/2 )
+            internal::throw_exception(internal::eid_reservation_length_error);
+        vector_allocator_ptr = &internal_contiguous_allocator;
+        // all the segments up to max_capacity are parts of the first block
+        my_first_block.store<relaxed>( segment_index_of( max_capacity-1 ) + 1 );
+        internal_reserve( 1, sizeof(T), max_size() );
+    }
+
     //Constructors are not required to have synchronization
     //(for more details see comment in the concurrent_vector_base constructor).
 #if __TBB_INITIALIZER_LISTS_PRESENT
@@ -651,7 +680,7 @@ public:
         : internal::allocator_base<T, A>(std::move(source)), internal::concurrent_vector_base()
     {
         vector_allocator_ptr = &internal_allocator;
-        concurrent_vector_base_v3::internal_swap(source);
+        internal_swap_storage(source);
     }
 
     concurrent_vector( concurrent_vector&& source, const allocator_type& a)
@@ -661,7 +690,7 @@ public:
         //C++ standard requires instances of an allocator being compared for equality,
         //which means that memory allocated by one instance is possible to deallocate with the other one.
         if (a == source.my_allocator) {
-            concurrent_vector_base_v3::internal_swap(source);
+            internal_swap_storage(source);
         } else {
             __TBB_TRY {
                 internal_copy(source, sizeof(T), &move_array);
@@ -747,7 +776,7 @@ public:
         typedef typename tbb::internal::allocator_traits<A>::propagate_on_container_move_assignment pocma_t;
         if(pocma_t::value || this->my_allocator == other.my_allocator) {
             concurrent_vector trash (std::move(*this));
-            internal_swap(other);
+            internal_swap_storage(other);
             tbb::internal::allocator_move_assignment(this->my_allocator, other.my_allocator, pocma_t());
         } else {
             internal_assign(other, sizeof(T), &destroy_array, &move_assign_array, &move_array);
@@ -930,7 +959,9 @@ public:
     void shrink_to_fit();
 
     //! Upper bound on argument to reserve.
-    size_type max_size() const {return (~size_type(0))/sizeof(T);}
+    size_type max_size() const {
+        return internal_is_contiguous() ? segment_size(my_first_block) : (~size_type(0))/sizeof(T);
+    }
 
     //------------------------------------------------------------------------
     // STL support
@@ -982,6 +1013,16 @@ public:
         __TBB_ASSERT( size()>0, NULL);
         return internal_subscript( size()-1 );
     }
+    //! Pointer to the array of all items of a vector constructed with contiguous_reserve
+    /** Returns NULL if the items are stored in several arrays. */
+    pointer data() {
+        return internal_is_contiguous() ? my_segment[0].template load<relaxed>().template pointer<T>() : NULL;
+    }
+    //! Pointer to the array of all items of a vector constructed with contiguous_reserve
+    const_pointer data() const {
+        return internal_is_contiguous() ? my_segment[0].template load<relaxed>().template pointer<const T>() : NULL;
+    }
+
     //! return allocator object
     allocator_type get_allocator() const { return this->my_allocator; }
 
@@ -1008,7 +1049,7 @@ public:
     void swap(concurrent_vector &vector) {
         typedef typename tbb::internal::allocator_traits<A>::propagate_on_container_swap pocs_t;
         if( this != &vector && (this->my_allocator == vector.my_allocator || pocs_t::value) ) {
-            concurrent_vector_base_v3::internal_swap(static_cast<concurrent_vector_base_v3&>(vector));
+            internal_swap_storage(vector);
             tbb::internal::allocator_swap(this->my_allocator, vector.my_allocator, pocs_t());
         }
     }
@@ -1032,6 +1073,20 @@ private:
     static void *internal_allocator(internal::concurrent_vector_base_v3 &vb, size_t k) {
         return static_cast<concurrent_vector<T, A>&>(vb).my_allocator.allocate(k);
     }
+    //! Reserve the first block of k items; no more segments can be allocated for the contiguous storage
+    static void *internal_contiguous_allocator(internal::concurrent_vector_base_v3 &vb, size_t k) {
+        if( static_cast<concurrent_vector<T, A>&>(vb).my_segment[0].template load<relaxed>() != segment_not_used() )
+            return NULL;
+        return internal_map_contiguous( k*sizeof(T) );
+    }
+    bool internal_is_contiguous() const {
+        return vector_allocator_ptr == &internal_contiguous_allocator;
+    }
+    //! Swap the storage together with the way it is allocated
+    void internal_swap_storage(concurrent_vector &vector) {
+        concurrent_vector_base_v3::internal_swap(static_cast<concurrent_vector_base_v3&>(vector));
+        std::swap(vector_allocator_ptr, vector.vector_allocator_ptr);
+    }
     //! Free k segments from table
     void internal_free_segments(segment_t table[], segment_index_t k, segment_index_t first_block);
 
@@ -1191,6 +1246,8 @@ template<typename T, typename A = cache_aligned_allocator<T>
 #endif
 template<typename T, class A>
 void concurrent_vector<T, A>::shrink_to_fit() {
+    if( internal_is_contiguous() )
+        return; // the storage is a single array already
     internal_segments_table old;
     __TBB_TRY {
         internal_array_op2 copy_or_move_array =
@@ -1226,7 +1283,10 @@ void concurrent_vector<T, A>::internal_free_segments(segment_t table[], segment_
     if( segment_value == segment_allocated() ) {
         __TBB_ASSERT( first_block > 0, NULL );
         while(k > 0) table[--k].store<relaxed>(segment_not_used());
-        this->my_allocator.deallocate( (segment_value.pointer<T>()), segment_size(first_block) );
+        if( internal_is_contiguous() )
+            internal_unmap_contiguous( segment_value.pointer<void>(), segment_size(first_block)*sizeof(T) );
+        else
+            this->my_allocator.deallocate( (segment_value.pointer<T>()), segment_size(first_block) );
     }
 }
 
@@ -0,0 +1,521 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef __TBB_file_reader_H
+#define __TBB_file_reader_H
+
+#define __TBB_file_reader_H_include_area
+#include "internal/_warning_suppress_enable_notice.h"
+
+#if ! TBB_PREVIEW_FILE_READER
+    #error Set TBB_PREVIEW_FILE_READER to include file_reader.h
+#endif
+
+#include "tbb_stddef.h"
+#include "tbb_machine.h"
+#include "atomic.h"
+#include "spin_mutex.h"
+#include "cache_aligned_allocator.h"
+#include "pipeline.h"
+#include <cstring>
+#include <cerrno>
+#include <stdexcept> // std::runtime_error
+// required in C++03 to construct std::runtime_error
+#include <string>
+
+#if _WIN32 || _WIN64
+#include "machine/windows_api.h"
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace tbb {
+
+class file_reader;
+
+//! @cond INTERNAL
+namespace internal {
+
+//! Buffer of file_reader shared by the copies of a file_chunk
+/** In the memory_map mode the buffer only describes a part of the mapping, and my_storage is NULL. */
+struct file_chunk_buffer {
+    //! Number of file_chunk objects that refer to the buffer
+    atomic<size_t> my_ref_count;
+    file_reader* my_owner;
+    //! Next buffer in the pool of free buffers
+    file_chunk_buffer* my_next;
+    //! Memory owned by the buffer in the positional_read mode
+    char* my_storage;
+    size_t my_capacity;
+    //! Position of the data in my_storage or in the mapping
+    const char* my_data;
+    size_t my_size;
+    internal::uint64_t my_offset;
+};
+
+} // namespace internal
+//! @endcond
+
+//! A part of a file read by file_reader, that consists of whole records
+/** The chunk does not own the memory: it is a reference counted handle of a buffer of file_reader.
+    The buffer is returned to the reader when the last copy of the chunk is destroyed or released,
+    so the pointers into the chunk are valid only until then. */
+class file_chunk {
+    friend class file_reader;
+    internal::file_chunk_buffer* my_buffer;
+
+    explicit file_chunk( internal::file_chunk_buffer* b ) : my_buffer(b) {}
+public:
+    file_chunk() : my_buffer(NULL) {}
+    file_chunk( const file_chunk& other ) : my_buffer(other.my_buffer) {
+        if( my_buffer )
+            ++my_buffer->my_ref_count;
+    }
+#if __TBB_CPP11_RVALUE_REF_PRESENT
+    file_chunk( file_chunk&& other ) : my_buffer(other.my_buffer) {
+        other.my_buffer = NULL;
+    }
+    file_chunk& operator=( file_chunk&& other ) {
+        if( this != &other ) {
+            release();
+            my_buffer = other.my_buffer;
+            other.my_buffer = NULL;
+        }
+        return *this;
+    }
+#endif
+    file_chunk& operator=( const file_chunk& other ) {
+        if( my_buffer != other.my_buffer ) {
+            if( other.my_buffer )
+                ++other.my_buffer->my_ref_count;
+            release();
+            my_buffer = other.my_buffer;
+        }
+        return *this;
+    }
+    ~file_chunk() { release(); }
+
+    //! Return the buffer to the reader if this is its last chunk, and make the chunk empty
+    inline void release();
+
+    const char* data() const { return my_buffer ? my_buffer->my_data : NULL; }
+    const char* begin() const { return data(); }
+    const char* end() const { return data()+size(); }
+    size_t size() const { return my_buffer ? my_buffer->my_size : 0; }
+    bool empty() const { return !size(); }
+    //! Position of the chunk in the file
+    internal::uint64_t offset() const { return my_buffer ? my_buffer->my_offset : 0; }
+
+    //! Call f(first,last) for each record of the chunk
+    /** The range [first,last) does not include the delimiter. The chunk always ends with a delimiter
+        except for the last chunk of a file that does not end with a delimiter. */
+    template<typename F>
+    void for_each_record( char delimiter, F f ) const {
+        const char* p = begin();
+        const char* const e = end();
+        while( p != e ) {
+            const char* q = static_cast<const char*>( std::memchr( p, delimiter, e-p ) );
+            if( !q ) {
+                f( p, e );
+                break;
+            }
+            f( p, q );
+            p = q+1;
+        }
+    }
+};
+
+//! Reads a file sequentially by chunks that end at record delimiters
+/** The reader maps the file into memory or reads it with positional reads into a pool of buffers
+    that are reused when the chunks are released, so that the data are neither allocated nor copied
+    per chunk. It asks the OS to read ahead the part of the file that follows the last chunk.
+    read() is serial; the chunks can be processed and released by any thread. The reader must
+    outlive its chunks.
+    @ingroup algorithms */
+class file_reader : internal::no_copy {
+public:
+    enum io_mode {
+        //! memory_map if the file can be mapped, positional_read otherwise
+        automatic,
+        //! The chunks are parts of the file mapped into memory
+        memory_map,
+        //! The chunks are read into the buffers with pread (ReadFile on Windows)
+        positional_read
+    };
+
+    static const size_t default_chunk_size = 1<<20;
+
+    //! Open the file; throws std::runtime_error if it cannot be opened or mapped
+    /** A chunk holds at most chunk_size bytes unless a record is longer than that. The reader
+        requests the OS to read ahead readahead_size bytes after the last chunk; 0 means
+        four chunks. */
+    file_reader( const char* file_name, char delimiter = '\n', size_t chunk_size = default_chunk_size,
+                 io_mode mode = automatic, size_t readahead_size = 0 )
+        : my_delimiter(delimiter), my_chunk_size(chunk_size ? chunk_size : 1),
+          my_readahead_size(readahead_size ? readahead_size : 4*my_chunk_size),
+          my_file_size(0), my_offset(0), my_map(NULL), my_next(NULL), my_free(NULL), my_buffer_count(0)
+    {
+        open( file_name );
+        if( mode == automatic ) {
+            // Do not take too much of a 32-bit address space
+            mode = (sizeof(void*) >= 8 || my_file_size < (internal::uint64_t(1)<<30)) && (!my_file_size || map()) ?
+                memory_map : positional_read;
+        } else if( mode == memory_map && my_file_size && !map() ) {
+            close();
+            __TBB_THROW( std::runtime_error( std::string("Can't map file ") + file_name ) );
+        }
+        my_mode = mode;
+        advise_sequential();
+    }
+
+    ~file_reader() {
+        if( my_next )
+            recycle( my_next );
+        __TBB_ASSERT( my_buffer_count == pool_size(), "file_chunk objects outlive their file_reader" );
+        while( internal::file_chunk_buffer* b = my_free ) {
+            my_free = b->my_next;
+            if( b->my_storage )
+                cache_aligned_allocator<char>().deallocate( b->my_storage, b->my_capacity );
+            cache_aligned_allocator<internal::file_chunk_buffer>().deallocate( b, 1 );
+        }
+        unmap();
+        close();
+    }
+
+    //! Get the next chunk of the file; returns false at the end of the file
+    /** Not thread-safe. Throws std::runtime_error if the file cannot be read. */
+    bool read( file_chunk& chunk ) {
+        internal::file_chunk_buffer* b = my_mode == memory_map ? next_mapped() : next_read();
+        if( !b )
+            return false;
+        chunk = file_chunk( b );
+        return true;
+    }
+
+    //! Body of the input filter of parallel_pipeline, or of input_node of the flow graph
+    class input_body {
+        file_reader* my_reader;
+    public:
+        explicit input_body( file_reader& r ) : my_reader(&r) {}
+        file_chunk operator()( flow_control& fc ) const {
+            file_chunk c;
+            if( !my_reader->read( c ) )
+                fc.stop();
+            return c;
+        }
+    };
+
+    //! The input filter of parallel_pipeline that reads the file
+    filter_t<void,file_chunk> make_input_filter() {
+        return make_filter<void,file_chunk>( filter::serial_in_order, input_body( *this ) );
+    }
+
+    io_mode mode() const { return my_mode; }
+    char delimiter() const { return my_delimiter; }
+    internal::uint64_t file_size() const { return my_file_size; }
+
+    //! Number of the buffers allocated by the reader, that is the peak number of chunks in use
+    size_t buffer_count() const { return my_buffer_count; }
+
+private:
+    friend class file_chunk;
+
+    const char my_delimiter;
+    const size_t my_chunk_size;
+    const size_t my_readahead_size;
+    io_mode my_mode;
+    internal::uint64_t my_file_size;
+    //! Position of the next chunk in the file
+    internal::uint64_t my_offset;
+#if _WIN32 || _WIN64
+    HANDLE my_file;
+    HANDLE my_mapping;
+#else
+    int my_file;
+#endif
+    //! Start of the whole file mapped into memory
+    char* my_map;
+    //! Buffer with the beginning of a record that did not fit into the previous chunk
+    internal::file_chunk_buffer* my_next;
+    //! Free buffers
+    internal::file_chunk_buffer* my_free;
+    spin_mutex my_free_mutex;
+    size_t my_buffer_count;
+
+    //! Take a buffer from the pool, or allocate a new one
+    internal::file_chunk_buffer* acquire() {
+        {
+            spin_mutex::scoped_lock lock( my_free_mutex );
+            if( internal::file_chunk_buffer* b = my_free ) {
+                my_free = b->my_next;
+                b->my_ref_count = 1;
+                b->my_size = 0;
+                return b;
+            }
+        }
+        internal::file_chunk_buffer* b = cache_aligned_allocator<internal::file_chunk_buffer>().allocate( 1 );
+        b->my_ref_count = 1;
+        b->my_owner = this;
+        b->my_next = NULL;
+        b->my_storage = NULL;
+        b->my_capacity = 0;
+        b->my_data = NULL;
+        b->my_size = 0;
+        b->my_offset = 0;
+        ++my_buffer_count;
+        return b;
+    }
+
+    //! Return the buffer to the pool; called by the thread that releases the last chunk
+    void recycle( internal::file_chunk_buffer* b ) {
+        spin_mutex::scoped_lock lock( my_free_mutex );
+        b->my_next = my_free;
+        my_free = b;
+    }
+
+    size_t pool_size() {
+        size_t n = 0;
+        for( internal::file_chunk_buffer* b = my_free; b; b = b->my_next )
+            ++n;
+        return n;
+    }
+
+    //! Make room for at least n bytes in the buffer, keeping its data
+    static void reserve( internal::file_chunk_buffer* b, size_t n ) {
+        if( n <= b->my_capacity )
+            return;
+        size_t capacity = b->my_capacity ? b->my_capacity : n;
+        while( capacity < n )
+            capacity *= 2;
+        char* storage = cache_aligned_allocator<char>().allocate( capacity );
+        if( b->my_storage ) {
+            std::memcpy( storage, b->my_storage, b->my_size );
+            cache_aligned_allocator<char>().deallocate( b->my_storage, b->my_capacity );
+        }
+        b->my_storage = storage;
+        b->my_capacity = capacity;
+        b->my_data = storage;
+    }
+
+    //! Find the end of the last record that starts in [first,last), not looking past limit
+    /** Returns NULL if there is no delimiter in [first,limit). */
+    const char* record_end( const char* first, const char* last, const char* limit ) const {
+        for( const char* p = last; p != first; --p )
+            if( p[-1] == my_delimiter )
+                return p;
+        const char* q = static_cast<const char*>( std::memchr( last, my_delimiter, limit-last ) );
+        return q ? q+1 : NULL;
+    }
+
+    internal::file_chunk_buffer* next_mapped() {
+        if( my_offset == my_file_size )
+            return NULL;
+        const char* first = my_map + my_offset;
+        const char* limit = my_map + my_file_size;
+        const char* last = my_file_size-my_offset > my_chunk_size ? first+my_chunk_size : limit;
+        const char* e = last == limit ? limit : record_end( first, last, limit );
+        if( !e )
+            e = limit;
+        internal::file_chunk_buffer* b = acquire();
+        b->my_data = first;
+        b->my_size = e-first;
+        b->my_offset = my_offset;
+        my_offset += b->my_size;
+        readahead();
+        return b;
+    }
+
+    internal::file_chunk_buffer* next_read() {
+        internal::file_chunk_buffer* b = my_next;
+        my_next = NULL;
+        if( !b ) {
+            if( my_offset == my_file_size )
+                return NULL;
+            b = acquire();
+        }
+        // b holds the beginning of a record that has been read already
+        b->my_offset = my_offset - b->my_size;
+        size_t limit = my_chunk_size;
+        reserve( b, limit );
+        for( bool eof = false; ; ) {
+            while( b->my_size < limit && !eof ) {
+                size_t n = read_at( b->my_storage+b->my_size, limit-b->my_size, my_offset );
+                b->my_size += n;
+                my_offset += n;
+                eof = !n;
+            }
+            if( eof && !b->my_size ) {
+                readahead();
+                recycle( b );
+                return NULL;
+            }
+            const char* first = b->my_storage;
+            const char* last = first+b->my_size;
+            // At the end of the file the last record ends the chunk, unless the chunk holds more than
+            // chunk_size bytes after a long record; then the records that follow go to the next chunk.
+            const char* e = eof && b->my_size <= my_chunk_size ? last :
+                record_end( first, b->my_size > my_chunk_size ? first+my_chunk_size : last, last );
+            if( !e && eof )
+                e = last;
+            if( e ) {
+                size_t tail = last-e;
+                if( tail ) {
+                    my_next = acquire();
+                    reserve( my_next, tail > my_chunk_size ? tail : my_chunk_size );
+                    std::memcpy( my_next->my_storage, e, tail );
+                    my_next->my_size = tail;
+                }
+                b->my_size -= tail;
+                readahead();
+                return b;
+            }
+            // The record does not fit into the chunk
+            limit *= 2;
+            reserve( b, limit );
+        }
+    }
+
+#if _WIN32 || _WIN64
+    void open( const char* file_name ) {
+        my_mapping = NULL;
+        my_file = CreateFileA( file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+        LARGE_INTEGER size;
+        if( my_file == INVALID_HANDLE_VALUE || !GetFileSizeEx( my_file, &size ) ) {
+            close();
+            __TBB_THROW( std::runtime_error( std::string("Can't open file ") + file_name ) );
+        }
+        my_file_size = internal::uint64_t( size.QuadPart );
+    }
+    void close() {
+        if( my_file != INVALID_HANDLE_VALUE )
+            CloseHandle( my_file );
+        my_file = INVALID_HANDLE_VALUE;
+    }
+    bool map() {
+        my_mapping = CreateFileMappingA( my_file, NULL, PAGE_READONLY, 0, 0, NULL );
+        if( !my_mapping )
+            return false;
+        my_map = static_cast<char*>( MapViewOfFile( my_mapping, FILE_MAP_READ, 0, 0, 0 ) );
+        if( !my_map ) {
+            CloseHandle( my_mapping );
+            my_mapping = NULL;
+        }
+        return my_map != NULL;
+    }
+    void unmap() {
+        if( my_map ) {
+            UnmapViewOfFile( my_map );
+            CloseHandle( my_mapping );
+        }
+    }
+    size_t read_at( char* p, size_t n, internal::uint64_t offset ) {
+        OVERLAPPED o = OVERLAPPED();
+        o.Offset = DWORD( offset );
+        o.OffsetHigh = DWORD( offset>>32 );
+        DWORD m = 0;
+        if( n > 1u<<30 )
+            n = 1u<<30;
+        if( !ReadFile( my_file, p, DWORD(n), &m, &o ) && GetLastError() != ERROR_HANDLE_EOF )
+            __TBB_THROW( std::runtime_error( "Can't read file" ) );
+        return m;
+    }
+    // The sequential access is requested by FILE_FLAG_SEQUENTIAL_SCAN, and the OS reads ahead
+    void advise_sequential() {}
+    void readahead() {}
+#else
+    void open( const char* file_name ) {
+        my_file = ::open( file_name, O_RDONLY );
+        struct stat st;
+        if( my_file < 0 || fstat( my_file, &st ) ) {
+            close();
+            __TBB_THROW( std::runtime_error( std::string("Can't open file ") + file_name ) );
+        }
+        my_file_size = internal::uint64_t( st.st_size );
+    }
+    void close() {
+        if( my_file >= 0 )
+            ::close( my_file );
+        my_file = -1;
+    }
+    bool map() {
+        if( internal::uint64_t( size_t(my_file_size) ) != my_file_size )
+            return false;
+        void* p = mmap( NULL, size_t(my_file_size), PROT_READ, MAP_PRIVATE, my_file, 0 );
+        if( p == MAP_FAILED )
+            return false;
+        my_map = static_cast<char*>( p );
+        return true;
+    }
+    void unmap() {
+        if( my_map )
+            munmap( my_map, size_t(my_file_size) );
+    }
+    size_t read_at( char* p, size_t n, internal::uint64_t offset ) {
+        for(;;) {
+            ssize_t m = pread( my_file, p, n, off_t(offset) );
+            if( m >= 0 )
+                return size_t(m);
+            if( errno != EINTR )
+                __TBB_THROW( std::runtime_error( "Can't read file" ) );
+        }
+    }
+    void advise_sequential() {
+        if( my_map )
+            madvise( my_map, size_t(my_file_size), MADV_SEQUENTIAL );
+#if POSIX_FADV_SEQUENTIAL
+        else
+            posix_fadvise( my_file, 0, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+    }
+    //! Ask the OS to read the part of the file after my_offset
+    void readahead() {
+        if( my_offset == my_file_size )
+            return;
+        size_t n = size_t( my_file_size-my_offset < my_readahead_size ? my_file_size-my_offset : my_readahead_size );
+        if( my_map ) {
+            // madvise requires an address aligned to the page
+            const uintptr_t page = uintptr_t( sysconf( _SC_PAGESIZE ) );
+            uintptr_t first = uintptr_t( my_map+my_offset ) & ~(page-1);
+            madvise( reinterpret_cast<void*>( first ), uintptr_t( my_map+my_offset )-first+n, MADV_WILLNEED );
+        }
+#if POSIX_FADV_WILLNEED
+        else {
+            posix_fadvise( my_file, off_t(my_offset), off_t(n), POSIX_FADV_WILLNEED );
+        }
+#endif
+    }
+#endif /* !(_WIN32 || _WIN64) */
+};
+
+inline void file_chunk::release() {
+    if( my_buffer ) {
+        if( --my_buffer->my_ref_count == 0 )
+            my_buffer->my_owner->recycle( my_buffer );
+        my_buffer = NULL;
+    }
+}
+
+} // namespace tbb
+
+#include "internal/_warning_suppress_disable_notice.h"
+#undef __TBB_file_reader_H_include_area
+
+#endif /* __TBB_file_reader_H */
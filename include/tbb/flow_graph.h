@@ -35,6 +35,7 @@
 #include "tbb/internal/_allocator_traits.h"
 #include "tbb_profiling.h"
 #include "task_arena.h"
+#include "tbb_thread.h"
 
 #if TBB_USE_THREADING_TOOLS && TBB_PREVIEW_FLOW_GRAPH_TRACE && ( __linux__ || __APPLE__ )
    #if __INTEL_COMPILER
@@ -59,6 +60,10 @@
 #include <type_traits>      // std::decay, std::true_type, std::false_type
 #endif // __TBB_PREVIEW_STREAMING_NODE
 
+#if __TBB_PREVIEW_COALESCING_NODE
+#include "tick_count.h"
+#endif
+
 #if TBB_DEPRECATED_FLOW_ENQUEUE
 #define FLOW_SPAWN(a) tbb::task::enqueue((a))
 #else
@@ -88,6 +93,8 @@ namespace tbb {
 
 #include<list>
 #include<queue>
+#include<vector>
+#include<memory>
 
 /** @file
   \brief The graph related classes and functions
@@ -191,6 +198,9 @@ private:
 //! The graph class
 #include "internal/_flow_graph_impl.h"
 
+// The flow graph profiler
+#include "internal/_flow_graph_profiler_impl.h"
+
 namespace tbb {
 namespace flow {
 namespace interface11 {
@@ -361,6 +371,9 @@ class untyped_receiver  {
     template< typename, typename > friend class internal::broadcast_cache;
     template< typename, typename > friend class internal::round_robin_cache;
     template< typename, typename > friend class internal::successor_cache;
+#if __TBB_PREVIEW_FLOW_GRAPH_PROFILER
+    friend class internal::profile_access;
+#endif
 
 #if __TBB_PREVIEW_OPENCL_NODE
     template< typename, typename > friend class proxy_dependency_receiver;
@@ -408,6 +421,13 @@ protected:
 
     virtual task* try_put_task_wrapper( const void* p, bool is_async ) = 0;
 
+    template<typename X>
+    task *try_put_task_batch(const X* items, size_t n, size_t& accepted) {
+        return try_put_task_batch_wrapper( items, n, sizeof(X), internal::async_helpers<X>::is_async_type, accepted );
+    }
+
+    virtual task* try_put_task_batch_wrapper( const void* p, size_t n, size_t size, bool is_async, size_t& accepted ) = 0;
+
     virtual graph& graph_reference() const = 0;
 
     // NOTE: Following part of PROTECTED and PRIVATE sections is copy-paste from original receiver<T> class
@@ -477,14 +497,47 @@ public:
         return internal::untyped_receiver::try_put(t);
     }
 
+    //! Put a batch of n items to the receiver; returns the number of the first items accepted
+    size_t try_put_batch( const T* items, size_t n ) {
+        size_t accepted = 0;
+        task *res = try_put_task_batch(items, n, accepted);
+        if (res && res != SUCCESSFULLY_ENQUEUED) internal::spawn_in_graph_arena(graph_reference(), *res);
+        return accepted;
+    }
+
 protected:
     virtual task* try_put_task_wrapper( const void *p, bool is_async ) __TBB_override {
         return internal::async_helpers<T>::try_put_task_wrapper_impl(this, p, is_async);
     }
 
+    virtual task* try_put_task_batch_wrapper( const void* p, size_t n, size_t size, bool is_async, size_t& accepted ) __TBB_override {
+        if ( internal::async_helpers<T>::is_async_type == is_async && size == sizeof(T) )
+            return try_put_task_batch( static_cast<const T*>(p), n, accepted );
+        // The items are converted one by one
+        task *last_task = NULL;
+        for ( accepted = 0; accepted < n; ++accepted ) {
+            task *new_task = try_put_task_wrapper( static_cast<const char*>(p) + accepted*size, is_async );
+            if ( !new_task ) break;
+            last_task = combine_tasks(graph_reference(), last_task, new_task);
+        }
+        return last_task;
+    }
+
     //! Put item to successor; return task to run the successor if possible.
     virtual task *try_put_task(const T& t) = 0;
 
+    //! Put the first items of a batch to successor; return task to run the successor if possible.
+    /** Sets accepted to the number of the items accepted. Puts the items one by one by default. */
+    virtual task *try_put_task_batch(const T* items, size_t n, size_t& accepted) {
+        task *last_task = NULL;
+        for ( accepted = 0; accepted < n; ++accepted ) {
+            task *new_task = try_put_task(items[accepted]);
+            if ( !new_task ) break;
+            last_task = combine_tasks(graph_reference(), last_task, new_task);
+        }
+        return last_task;
+    }
+
 }; // class receiver<T>
 
 #else // __TBB_PREVIEW_ASYNC_MSG
@@ -554,12 +607,36 @@ public:
         return true;
     }
 
+    //! Put a batch of n items to the receiver; returns the number of the first items accepted
+    size_t try_put_batch( const T* items, size_t n ) {
+        size_t accepted = 0;
+        task *res = try_put_task_batch(items, n, accepted);
+        if (res && res != SUCCESSFULLY_ENQUEUED) internal::spawn_in_graph_arena(graph_reference(), *res);
+        return accepted;
+    }
+
     //! put item to successor; return task to run the successor if possible.
 protected:
     template< typename R, typename B > friend class run_and_put_task;
     template< typename X, typename Y > friend class internal::broadcast_cache;
     template< typename X, typename Y > friend class internal::round_robin_cache;
+#if __TBB_PREVIEW_FLOW_GRAPH_PROFILER
+    friend class internal::profile_access;
+#endif
     virtual task *try_put_task(const T& t) = 0;
+
+    //! Put the first items of a batch to successor; return task to run the successor if possible.
+    /** Sets accepted to the number of the items accepted. Puts the items one by one by default. */
+    virtual task *try_put_task_batch(const T* items, size_t n, size_t& accepted) {
+        task *last_task = NULL;
+        for ( accepted = 0; accepted < n; ++accepted ) {
+            task *new_task = try_put_task(items[accepted]);
+            if ( !new_task ) break;
+            last_task = combine_tasks(graph_reference(), last_task, new_task);
+        }
+        return last_task;
+    }
+
     virtual graph& graph_reference() const = 0;
 public:
     // NOTE: Following part of PUBLIC and PROTECTED sections is copy-pasted in receiver<T> under #if __TBB_PREVIEW_ASYNC_MSG
@@ -779,6 +856,9 @@ inline graph::graph() : my_nodes(NULL), my_nodes_last(NULL), my_task_arena(NULL)
     my_context = new task_group_context(tbb::internal::FLOW_TASKS);
     my_root_task = (new (task::allocate_root(*my_context)) empty_task);
     my_root_task->set_ref_count(1);
+#if __TBB_PREVIEW_FLOW_GRAPH_PROFILER
+    my_profile = new tbb::flow::interface11::internal::graph_profile;
+#endif
     tbb::internal::fgt_graph(this);
     my_is_active = true;
 }
@@ -791,6 +871,9 @@ inline graph::graph(task_group_context& use_this_context) :
     caught_exception = false;
     my_root_task = (new (task::allocate_root(*my_context)) empty_task);
     my_root_task->set_ref_count(1);
+#if __TBB_PREVIEW_FLOW_GRAPH_PROFILER
+    my_profile = new tbb::flow::interface11::internal::graph_profile;
+#endif
     tbb::internal::fgt_graph(this);
     my_is_active = true;
 }
@@ -801,6 +884,9 @@ inline graph::~graph() {
     tbb::task::destroy(*my_root_task);
     if (own_context) delete my_context;
     delete my_task_arena;
+#if __TBB_PREVIEW_FLOW_GRAPH_PROFILER
+    delete my_profile;
+#endif
 }
 
 inline void graph::reserve_wait() {
@@ -1113,6 +1199,7 @@ private:
             return false;
         }
         if ( !my_has_cached_item ) {
+            internal::profile_body_scope profile( this->my_graph, static_cast<sender<output_type> *>(this) );
             tbb::internal::fgt_begin_body( my_body );
 
 #if TBB_DEPRECATED_INPUT_NODE_BODY
@@ -1401,6 +1488,7 @@ private:
             return false;
         }
         if ( !my_has_cached_item ) {
+            internal::profile_body_scope profile( this->my_graph, static_cast<sender<output_type> *>(this) );
             tbb::internal::fgt_begin_body( my_body );
             bool r = (*my_body)(my_cached_item);
             tbb::internal::fgt_end_body( my_body );
@@ -2022,6 +2110,15 @@ protected:
         return new_task;
     }
 
+    //! forwards the batch as a whole, so a successor may run it in a single task
+    task *try_put_task_batch(const T* items, size_t n, size_t& accepted) __TBB_override {
+        size_t successors_accepted;
+        task *new_task = my_successors.try_put_task_batch(items, n, successors_accepted);
+        accepted = n;
+        if (!new_task) new_task = SUCCESSFULLY_ENQUEUED;
+        return new_task;
+    }
+
     graph& graph_reference() const __TBB_override {
         return my_graph;
     }
@@ -2082,7 +2179,7 @@ protected:
 
     friend class internal::forward_task_bypass< class_type >;
 
-    enum op_type {reg_succ, rem_succ, req_item, res_item, rel_res, con_res, put_item, try_fwd_task
+    enum op_type {reg_succ, rem_succ, req_item, res_item, rel_res, con_res, put_item, try_fwd_task, put_batch
 #if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
         , add_blt_succ, del_blt_succ,
         add_blt_pred, del_blt_pred,
@@ -2110,6 +2207,8 @@ protected:
         task * ltask;
         successor_type *r;
 #endif
+        //! The number of items of a batch at elem; set to the number of the items accepted
+        size_t batch_size;
         buffer_operation(const T& e, op_type t) : type(char(t))
 
 #if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
@@ -2146,8 +2245,15 @@ protected:
             case res_item: internal_reserve(tmp); break;
             case rel_res:  internal_release(tmp); try_forwarding = true; break;
             case con_res:  internal_consume(tmp); try_forwarding = true; break;
-            case put_item: try_forwarding = internal_push(tmp); break;
+            case put_item:
+                internal::profile_enqueued(this->my_graph, static_cast<receiver<input_type> *>(this), 1);
+                try_forwarding = internal_push(tmp);
+                break;
             case try_fwd_task: internal_forward_task(tmp); break;
+            case put_batch:
+                internal::profile_enqueued(this->my_graph, static_cast<receiver<input_type> *>(this), tmp->batch_size);
+                try_forwarding = internal_push_batch(tmp) || try_forwarding;
+                break;
 #if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
             // edge recording
             case add_blt_succ: internal_add_built_succ(tmp); break;
@@ -2163,6 +2269,7 @@ protected:
         }
 
         derived->order();
+        internal::profile_queue_length(this->my_graph, static_cast<receiver<input_type> *>(this), this->my_tail - this->my_head);
 
         if (try_forwarding && !forwarder_busy) {
             if(internal::is_graph_active(this->my_graph)) {
@@ -2326,6 +2433,21 @@ protected:
         return true;
     }
 
+    //! Pushes the items of a batch while they are accepted
+    virtual bool internal_push_batch(buffer_operation *op) {
+        bool try_forwarding = false;
+        size_t accepted = 0;
+        for (; accepted < op->batch_size; ++accepted) {
+            buffer_operation item_op(op->elem[accepted], put_item);
+            try_forwarding = internal_push(&item_op) || try_forwarding;
+            if (item_op.status == internal::FAILED)
+                break;
+        }
+        op->batch_size = accepted;
+        __TBB_store_with_release(op->status, accepted ? internal::SUCCEEDED : internal::FAILED);
+        return try_forwarding;
+    }
+
     virtual void internal_pop(buffer_operation *op) {
         if(this->pop_back(*(op->elem))) {
             __TBB_store_with_release(op->status, internal::SUCCEEDED);
@@ -2535,6 +2657,23 @@ protected:
         return ft;
     }
 
+    //! receive the items of a batch in a single operation
+    task *try_put_task_batch(const T* items, size_t n, size_t& accepted) __TBB_override {
+        buffer_operation op_data(put_batch);
+        op_data.elem = const_cast<T*>(items);
+        op_data.batch_size = n;
+        my_aggregator.execute(&op_data);
+        accepted = op_data.batch_size;
+        task *ft = grab_forwarding_task(op_data);
+        if(ft && op_data.status ==internal::FAILED) {
+            internal::spawn_in_graph_arena(graph_reference(), *ft); ft = NULL;
+        }
+        else if(!ft && op_data.status ==internal::SUCCEEDED) {
+            ft = SUCCESSFULLY_ENQUEUED;
+        }
+        return ft;
+    }
+
     graph& graph_reference() const __TBB_override {
         return my_graph;
     }
@@ -2663,6 +2802,180 @@ protected:
     }
 };  // queue_node
 
+#if __TBB_PREVIEW_COALESCING_NODE
+//! Forwards messages in FIFO order in batches
+/** The messages are held until batch_size of them are buffered or the first of them has waited
+    for max_wait, and then are put to a successor with try_put_batch. While messages are held, a
+    task enqueued to the graph sleeps until max_wait expires and then checks it, so wait_for_all does not return before they are
+    forwarded. Without max_wait, the messages short of a batch wait for flush(), which forwards the
+    messages held at the time of the call. Successors that pull from the node get the messages
+    one by one. */
+template <typename T>
+class coalescing_node : public queue_node<T> {
+protected:
+    typedef queue_node<T> base_type;
+    typedef typename base_type::size_type size_type;
+    typedef typename base_type::queue_operation queue_operation;
+
+private:
+    template<typename, typename> friend class buffer_node;
+    friend class internal::timer_task_bypass< coalescing_node<T> >;
+
+    const size_type my_batch_size;
+    const tick_count::interval_t my_max_wait;
+    //! The arrival of the first message held
+    tick_count my_batch_start;
+    //! The number of messages to forward regardless of the batch size
+    size_type my_flush_count;
+    atomic<bool> my_flush_requested;
+    //! True while a timer task checks max_wait for the messages held
+    bool my_timer_armed;
+    //! Makes the next batch operation check max_wait for the timer task
+    atomic<bool> my_timer_tick;
+    //! True if the successors did not accept the last batch
+    bool my_batch_rejected;
+    //! A copy of the batch forwarded
+    internal::batch_storage<T> my_batch;
+
+    bool batch_ready() {
+        const size_type n = this->size();
+        return n >= my_batch_size || my_flush_count ||
+            ( n && my_max_wait.seconds() > 0 && (tick_count::now() - my_batch_start).seconds() >= my_max_wait.seconds() );
+    }
+
+    bool is_item_valid() {
+        return this->my_item_valid(this->my_head) && batch_ready();
+    }
+
+    void try_put_and_add_task(task*& last_task) {
+        const size_type n = (std::min)(this->size(), my_batch_size);
+        for (size_type i = 0; i < n; ++i)
+            my_batch.push_back(this->get_my_item(this->my_head + i));
+        size_t accepted;
+        task *new_task = this->my_successors.try_put_task_batch(my_batch.data(), n, accepted);
+        my_batch.clear();
+        // workaround for icc bug
+        graph& graph_ref = this->graph_reference();
+        last_task = combine_tasks(graph_ref, last_task, new_task);
+        for (size_t i = 0; i < accepted; ++i)
+            this->destroy_front();
+        my_flush_count -= (std::min)(my_flush_count, accepted);
+        my_batch_rejected = accepted < n;
+        if (accepted && !this->buffer_empty())
+            my_batch_start = tick_count::now();
+    }
+
+    void init() {
+        __TBB_ASSERT(my_batch_size > 0, "coalescing_node needs a positive batch size");
+        my_flush_count = 0;
+        my_flush_requested = false;
+        my_timer_armed = false;
+        my_timer_tick = false;
+        my_batch_rejected = false;
+        my_batch.reserve(my_batch_size);
+    }
+
+    //! Enqueues a timer task if messages wait for max_wait; called by the aggregator
+    /** The messages that the successors rejected or reserved stay for pulling and need no timer. */
+    void arm_timer() {
+        if (my_timer_armed || my_max_wait.seconds() <= 0 || this->buffer_empty() || this->my_reserved
+            || my_batch_rejected || this->my_successors.empty())
+            return;
+        my_timer_armed = true;
+        enqueue_timer_task();
+    }
+
+    void enqueue_timer_task() {
+        if (!internal::is_graph_active(this->my_graph)) {
+            my_timer_armed = false;
+            return;
+        }
+        // the task is a child of the root task of the graph, so wait_for_all waits for it
+        task *t = new(task::allocate_additional_child_of(*(this->my_graph.root_task())))
+            internal::timer_task_bypass< coalescing_node<T> >(*this, my_batch_start, my_max_wait);
+        internal::enqueue_in_graph_arena(this->my_graph, *t);
+    }
+
+    //! Makes a batch operation check max_wait
+    task *timer_task() {
+        my_timer_tick = true;
+        // an empty batch makes the node check what to forward
+        size_t accepted;
+        return this->try_put_task_batch(NULL, 0, accepted);
+    }
+
+protected:
+    void internal_forward_task(queue_operation *op) __TBB_override {
+        this->internal_forward_task_impl(op, this);
+        // the messages short of a batch left after forwarding wait for max_wait anew
+        arm_timer();
+    }
+
+    bool internal_push(queue_operation *op) __TBB_override {
+        if (this->buffer_empty())
+            my_batch_start = tick_count::now();
+        base_type::internal_push(op);
+        my_batch_rejected = false;
+        arm_timer();
+        return batch_ready();
+    }
+
+    bool internal_push_batch(queue_operation *op) __TBB_override {
+        if (my_flush_requested.fetch_and_store(false))
+            my_flush_count = this->size();
+        base_type::internal_push_batch(op);
+        if (my_timer_tick.fetch_and_store(false)) {
+            __TBB_ASSERT(my_timer_armed, "a timer task ticks while the timer is not armed");
+            // the timer stops when the messages held are forwarded; the forwarding arms it again if needed
+            if (this->buffer_empty() || batch_ready())
+                my_timer_armed = false;
+            else
+                enqueue_timer_task();
+        }
+        return batch_ready();
+    }
+
+public:
+    typedef T input_type;
+    typedef T output_type;
+    typedef typename receiver<input_type>::predecessor_type predecessor_type;
+    typedef typename sender<output_type>::successor_type successor_type;
+
+    //! Constructor
+    __TBB_NOINLINE_SYM coalescing_node( graph &g, size_t batch_size,
+                                        tick_count::interval_t max_wait = tick_count::interval_t() )
+        : base_type(g), my_batch_size(batch_size), my_max_wait(max_wait) {
+        init();
+    }
+
+    //! Copy constructor
+    __TBB_NOINLINE_SYM coalescing_node( const coalescing_node& src )
+        : base_type(src), my_batch_size(src.my_batch_size), my_max_wait(src.my_max_wait) {
+        init();
+    }
+
+    //! Forwards the messages held, even if they do not make a batch
+    void flush() {
+        my_flush_requested = true;
+        // an empty batch makes the node check what to forward
+        size_t accepted;
+        task *ft = this->try_put_task_batch(NULL, 0, accepted);
+        if (ft && ft != SUCCESSFULLY_ENQUEUED)
+            internal::spawn_in_graph_arena(this->graph_reference(), *ft);
+    }
+
+protected:
+    void reset_node( reset_flags f) __TBB_override {
+        base_type::reset_node(f);
+        my_flush_count = 0;
+        my_flush_requested = false;
+        my_timer_armed = false;
+        my_timer_tick = false;
+        my_batch_rejected = false;
+    }
+};  // coalescing_node
+#endif /* __TBB_PREVIEW_COALESCING_NODE */
+
 //! Forwards messages in sequence order
 template< typename T, typename Allocator=__TBB_DEFAULT_NODE_ALLOCATOR(T) >
 class sequencer_node : public queue_node<T, Allocator> {
@@ -3831,6 +4144,7 @@ inline void internal_make_edge( sender<T> &p, receiver<T> &s ) {
 #endif
     p.register_successor( s );
     tbb::internal::fgt_make_edge( &p, &s );
+    internal::profile_make_edge( p, s );
 }
 
 //! Makes an edge between a single predecessor and a single successor
@@ -4690,6 +5004,12 @@ protected:
     using interface11::broadcast_node;
     using interface11::buffer_node;
     using interface11::queue_node;
+#if __TBB_PREVIEW_COALESCING_NODE
+    using interface11::coalescing_node;
+#endif
+#if __TBB_PREVIEW_FLOW_GRAPH_PROFILER
+    using interface11::graph_profiler;
+#endif
     using interface11::sequencer_node;
     using interface11::priority_queue_node;
     using interface11::limiter_node;
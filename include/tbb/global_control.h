@@ -27,6 +27,8 @@ public:
     enum parameter {
         max_allowed_parallelism,
         thread_stack_size,
+        numa_aware_stealing,
+        scheduler_tracing,
         parameter_max // insert new parameters above this point
     };
 
@@ -347,6 +347,29 @@ public:
     }
 };
 
+//! A task that sleeps until wait has passed since start, and then calls a node's timer_task function
+template< typename NodeType >
+class timer_task_bypass : public graph_task {
+
+    NodeType &my_node;
+    const tick_count my_start;
+    const tick_count::interval_t my_wait;
+
+public:
+
+    timer_task_bypass( NodeType &n, const tick_count &start, const tick_count::interval_t &wait )
+        : my_node(n), my_start(start), my_wait(wait) {}
+
+    task *execute() __TBB_override {
+        const tick_count::interval_t remaining = my_wait - (tick_count::now() - my_start);
+        if (remaining.seconds() > 0)
+            tbb::internal::thread_sleep_v3(remaining);
+        task * new_task = my_node.timer_task();
+        if (new_task == SUCCESSFULLY_ENQUEUED) new_task = NULL;
+        return new_task;
+    }
+};
+
 //! A task that calls a node's apply_body_bypass function, passing in an input of type Input
 //  return the task* unless it is SUCCESSFULLY_ENQUEUED, in which case return NULL
 template< typename NodeType, typename Input >
@@ -373,6 +396,80 @@ public:
     }
 };
 
+//! Contiguous storage for a batch of messages
+/** Unlike std::vector<bool>, the messages can always be passed on as a const T*. */
+template< typename T >
+class batch_storage : tbb::internal::no_copy {
+    T *my_items;
+    size_t my_size;
+    size_t my_capacity;
+public:
+    batch_storage() : my_items(NULL), my_size(0), my_capacity(0) {}
+
+    batch_storage( const T *items, size_t count ) : my_items(NULL), my_size(0), my_capacity(0) {
+        reserve(count);
+        for( size_t i = 0; i < count; ++i )
+            push_back(items[i]);
+    }
+
+    ~batch_storage() {
+        clear();
+        std::allocator<T>().deallocate(my_items, my_capacity);
+    }
+
+    //! Allocates room for the capacity messages; the storage must be empty
+    void reserve( size_t capacity ) {
+        __TBB_ASSERT( !my_size, "batch_storage is reserved while holding messages" );
+        if( capacity <= my_capacity ) return;
+        std::allocator<T> a;
+        T *items = a.allocate(capacity);
+        a.deallocate(my_items, my_capacity);
+        my_items = items;
+        my_capacity = capacity;
+    }
+
+    void push_back( const T &v ) {
+        __TBB_ASSERT( my_size < my_capacity, "batch_storage overflow" );
+        new( my_items + my_size ) T(v);
+        ++my_size;
+    }
+
+    void clear() {
+        for( size_t i = 0; i < my_size; ++i )
+            my_items[i].~T();
+        my_size = 0;
+    }
+
+    const T *data() const { return my_items; }
+    size_t size() const { return my_size; }
+};
+
+//! A task that calls a node's apply_body_batch_bypass function, passing in a copy of a batch of inputs
+//  return the task* unless it is SUCCESSFULLY_ENQUEUED, in which case return NULL
+template< typename NodeType, typename Input >
+class apply_body_batch_task_bypass : public graph_task {
+
+    NodeType &my_node;
+    batch_storage<Input> my_inputs;
+
+public:
+
+    apply_body_batch_task_bypass( NodeType &n, const Input *items, size_t count
+#if __TBB_PREVIEW_FLOW_GRAPH_PRIORITIES
+                                  , node_priority_t node_priority = no_priority
+    ) : graph_task(node_priority),
+#else
+    ) :
+#endif
+        my_node(n), my_inputs(items, count) {}
+
+    task *execute() __TBB_override {
+        task * next_task = my_node.apply_body_batch_bypass( my_inputs.data(), my_inputs.size() );
+        if(next_task == SUCCESSFULLY_ENQUEUED) next_task = NULL;
+        return next_task;
+    }
+};
+
 //! A task that calls a node's apply_body_bypass function with no input
 template< typename NodeType >
 class source_task_bypass : public graph_task {
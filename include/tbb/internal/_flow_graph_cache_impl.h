@@ -164,6 +164,8 @@ public:
             } else {
                 // Retain ownership of the edge
                 this->add(*src);
+                if (my_owner)
+                    profile_transfer( *my_owner, src, 1, 1 );
             }
         } while ( msg == false );
         return msg;
@@ -232,6 +234,7 @@ public:
             } else {
                 // Retain ownership of the edge
                 this->add( *reserved_src );
+                profile_reservation( *this->my_owner );
             }
         } while ( msg == false );
 
@@ -248,6 +251,7 @@ public:
     bool
     try_consume( ) {
         reserved_src->try_consume( );
+        profile_transfer( *this->my_owner, reserved_src, 1, 1 );
         reserved_src = NULL;
         return true;
     }
@@ -267,6 +271,228 @@ private:
 };
 
 
+//! An immutable array of successors, replaced as a whole when an edge is added or removed
+template< typename P >
+struct successor_snapshot {
+    size_t my_size;
+    P my_items[1];
+
+    static successor_snapshot *allocate( size_t n ) {
+        __TBB_ASSERT( n, "an empty successor_snapshot is represented by NULL" );
+        successor_snapshot *s = static_cast<successor_snapshot *>( ::operator new( sizeof(successor_snapshot) + (n - 1)*sizeof(P) ) );
+        s->my_size = n;
+        return s;
+    }
+
+    static void deallocate( successor_snapshot *s ) {
+        ::operator delete( s );
+    }
+};
+
+//! Tracks the threads that walk the successor snapshots of a cache
+/** A reader is counted in the slot of its thread for the current epoch. A writer that has published
+    a new snapshot advances the epoch and waits until the readers counted for the previous epoch are
+    gone; the readers that come meanwhile see the new snapshot and are not waited for. The slots are
+    allocated with the first snapshot, so a node without successors does not pay for them. */
+template< typename M >
+class successor_readers : tbb::internal::no_copy {
+    static const size_t num_slots = 8;
+    struct counters {
+        atomic<size_t> my_count[2];
+    };
+    typedef tbb::internal::padded<counters> slot_type;
+
+    atomic<slot_type *> my_slots;
+    atomic<size_t> my_epoch;
+
+public:
+    typedef atomic<size_t> *token_type;
+
+    successor_readers() {
+        my_slots = NULL;
+        my_epoch = 0;
+    }
+
+    ~successor_readers() {
+        if ( slot_type *s = my_slots )
+            tbb::cache_aligned_allocator<slot_type>().deallocate( s, num_slots );
+    }
+
+    //! Allocates the slots; the writer lock of the cache must be held
+    void prepare() {
+        if ( my_slots )
+            return;
+        slot_type *s = tbb::cache_aligned_allocator<slot_type>().allocate( num_slots );
+        for ( size_t i = 0; i < num_slots; ++i )
+            s[i].my_count[0] = s[i].my_count[1] = 0;
+        my_slots = s;
+    }
+
+    token_type enter() {
+        slot_type *s = my_slots;
+        if ( !s )
+            return NULL;
+        slot_type &mine = s[size_t( tbb::this_task_arena::current_thread_index() ) % num_slots];
+        for (;;) {
+            const size_t epoch = my_epoch;
+            atomic<size_t> &count = mine.my_count[epoch & 1];
+            ++count;
+            // the writer that advances the epoch after the increment waits for this reader
+            if ( my_epoch == epoch )
+                return &count;
+            --count;
+        }
+    }
+
+    void exit( token_type count ) {
+        if ( count )
+            --*count;
+    }
+
+    //! Whether a reader that entered with the token is waited for by synchronize
+    /** A reader that came before the slots were allocated is not, and has to enter again if it
+        sees a snapshot, since the slots are allocated before the first snapshot is published. */
+    bool counted( token_type count ) const { return count != NULL; }
+
+    //! Waits for the readers that could have seen the snapshots published before the call
+    void synchronize() {
+        slot_type *s = my_slots;
+        if ( !s )
+            return;
+        const size_t epoch = my_epoch.fetch_and_increment();
+        for ( size_t i = 0; i < num_slots; ++i )
+            for ( tbb::internal::atomic_backoff backoff; s[i].my_count[epoch & 1] != 0; backoff.pause() ) {}
+    }
+};
+
+//! The successors of a node that serializes the accesses to them do not need the reader tracking
+template<>
+class successor_readers< null_rw_mutex > : tbb::internal::no_copy {
+public:
+    typedef void *token_type;
+    void prepare() {}
+    token_type enter() { return NULL; }
+    void exit( token_type ) {}
+    bool counted( token_type ) const { return true; }
+    void synchronize() {}
+};
+
+//! The successors of a successor_cache, walked without a lock
+/** The walkers read an immutable snapshot. The writers hold the writer lock of the cache, publish a
+    new snapshot and free the old one once its readers are gone, so forwarding neither writes to the
+    lock nor waits for the writers. As with the lock, a successor is not called after the call that
+    removes it returns. */
+template< typename P, typename M >
+class successor_list : tbb::internal::no_copy {
+    typedef successor_snapshot<P> snapshot_type;
+
+    atomic<snapshot_type *> my_snapshot;
+    successor_readers<M> my_readers;
+
+    void publish( snapshot_type *s ) {
+        if ( s )
+            my_readers.prepare();
+        snapshot_type *old = my_snapshot.fetch_and_store( s );
+        if ( old ) {
+            my_readers.synchronize();
+            snapshot_type::deallocate( old );
+        }
+    }
+
+public:
+    //! The successors that rejected a message during a walk
+    typedef std::vector<P> rejected_type;
+
+    //! Walks the snapshot that is current when it is constructed
+    class reader : tbb::internal::no_copy {
+        successor_readers<M> &my_readers;
+        typename successor_readers<M>::token_type my_token;
+        snapshot_type *my_snapshot;
+    public:
+        reader( successor_list &l ) : my_readers(l.my_readers) {
+            for (;;) {
+                my_token = my_readers.enter();
+                my_snapshot = l.my_snapshot;
+                if ( !my_snapshot || my_readers.counted( my_token ) )
+                    break;
+                my_readers.exit( my_token );
+            }
+        }
+        ~reader() { my_readers.exit( my_token ); }
+        size_t size() const { return my_snapshot ? my_snapshot->my_size : 0; }
+        P operator[]( size_t i ) const { return my_snapshot->my_items[i]; }
+    };
+
+    successor_list() { my_snapshot = NULL; }
+
+    ~successor_list() {
+        if ( snapshot_type *s = my_snapshot )
+            snapshot_type::deallocate( s );
+    }
+
+    bool empty() {
+        reader r( *this );
+        return !r.size();
+    }
+
+    size_t size() {
+        reader r( *this );
+        return r.size();
+    }
+
+    // Assumes the writer lock is held
+    bool contains( P p ) {
+        snapshot_type *s = my_snapshot;
+        for ( size_t i = 0; s && i < s->my_size; ++i )
+            if ( s->my_items[i] == p )
+                return true;
+        return false;
+    }
+
+    // Assumes the writer lock is held
+    void push_back( P p ) {
+        snapshot_type *old = my_snapshot;
+        const size_t n = old ? old->my_size : 0;
+        snapshot_type *s = snapshot_type::allocate( n + 1 );
+        for ( size_t i = 0; i < n; ++i )
+            s->my_items[i] = old->my_items[i];
+        s->my_items[n] = p;
+        publish( s );
+    }
+
+    //! Removes one occurrence of p; assumes the writer lock is held
+    bool remove( P p ) {
+        snapshot_type *old = my_snapshot;
+        const size_t n = old ? old->my_size : 0;
+        size_t k = 0;
+        while ( k < n && old->my_items[k] != p )
+            ++k;
+        if ( k == n )
+            return false;
+        snapshot_type *s = n > 1 ? snapshot_type::allocate( n - 1 ) : NULL;
+        for ( size_t i = 0, j = 0; i < n; ++i )
+            if ( i != k )
+                s->my_items[j++] = old->my_items[i];
+        publish( s );
+        return true;
+    }
+
+    void clear() {
+        publish( NULL );
+    }
+
+    //! Reverses the edges to the successors that rejected a message and are still successors
+    /** It is done after the walk, since the walker cannot wait for itself to leave the snapshot. */
+    template< typename Owner >
+    void reverse_edges( M &mutex, const rejected_type &rejected, Owner &owner ) {
+        typename M::scoped_lock l( mutex, true );
+        for ( typename rejected_type::const_iterator i = rejected.begin(); i != rejected.end(); ++i ) {
+            if ( contains( *i ) && (*i)->register_predecessor( owner ) )
+                remove( *i );
+        }
+    }
+};
+
 //! An abstract cache of successors
 // TODO: make successor_cache type T-independent when async_msg becomes regular feature
 template<typename T, typename M=spin_rw_mutex >
@@ -285,7 +511,7 @@ protected:
     typedef receiver<T> *pointer_type;
     typedef sender<T> owner_type;
 #endif // __TBB_PREVIEW_ASYNC_MSG
-    typedef std::list< pointer_type > successors_type;
+    typedef successor_list< pointer_type, M > successors_type;
 #if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
     edge_container<successor_type> my_built_successors;
 #endif
@@ -334,17 +560,10 @@ public:
 
     void remove_successor( successor_type &r ) {
         typename mutex_type::scoped_lock l(my_mutex, true);
-        for ( typename successors_type::iterator i = my_successors.begin();
-              i != my_successors.end(); ++i ) {
-            if ( *i == & r ) {
-                my_successors.erase(i);
-                break;
-            }
-        }
+        my_successors.remove( &r );
     }
 
     bool empty() {
-        typename mutex_type::scoped_lock l(my_mutex, false);
         return my_successors.empty();
     }
 
@@ -375,7 +594,7 @@ protected:
     typedef receiver<continue_msg> successor_type;
     typedef receiver<continue_msg> *pointer_type;
 #endif // __TBB_PREVIEW_ASYNC_MSG
-    typedef std::list< pointer_type > successors_type;
+    typedef successor_list< pointer_type, M > successors_type;
     successors_type my_successors;
 #if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
     edge_container<successor_type> my_built_successors;
@@ -428,21 +647,16 @@ public:
 
     void remove_successor( successor_type &r ) {
         typename mutex_type::scoped_lock l(my_mutex, true);
-        for ( successors_type::iterator i = my_successors.begin();
-              i != my_successors.end(); ++i ) {
-            if ( *i == & r ) {
-                // TODO: Check if we need to test for continue_receiver before
-                // removing from r.
-                if ( my_owner )
-                    r.remove_predecessor( *my_owner );
-                my_successors.erase(i);
-                break;
-            }
+        if ( my_successors.contains( &r ) ) {
+            // TODO: Check if we need to test for continue_receiver before
+            // removing from r.
+            if ( my_owner )
+                r.remove_predecessor( *my_owner );
+            my_successors.remove( &r );
         }
     }
 
     bool empty() {
-        typename mutex_type::scoped_lock l(my_mutex, false);
         return my_successors.empty();
     }
 
@@ -465,6 +679,8 @@ template<typename T, typename M=spin_rw_mutex>
 class broadcast_cache : public successor_cache<T, M> {
     typedef M mutex_type;
     typedef typename successor_cache<T,M>::successors_type successors_type;
+    typedef typename successors_type::reader reader_type;
+    typedef typename successors_type::rejected_type rejected_type;
 
 public:
 
@@ -478,29 +694,52 @@ public:
     task * try_put_task( const T &t ) __TBB_override {
 #endif // __TBB_PREVIEW_ASYNC_MSG
         task * last_task = NULL;
-        bool upgraded = true;
-        typename mutex_type::scoped_lock l(this->my_mutex, upgraded);
-        typename successors_type::iterator i = this->my_successors.begin();
-        while ( i != this->my_successors.end() ) {
-            task *new_task = (*i)->try_put_task(t);
-            // workaround for icc bug
-            graph& graph_ref = (*i)->graph_reference();
-            last_task = combine_tasks(graph_ref, last_task, new_task);  // enqueue if necessary
-            if(new_task) {
-                ++i;
+        rejected_type rejected;
+        {
+            reader_type r(this->my_successors);
+            for ( size_t i = 0; i < r.size(); ++i ) {
+                task *new_task = r[i]->try_put_task(t);
+                profile_transfer( *r[i], this->my_owner, new_task ? 1 : 0, 1 );
+                // workaround for icc bug
+                graph& graph_ref = r[i]->graph_reference();
+                last_task = combine_tasks(graph_ref, last_task, new_task);  // enqueue if necessary
+                if ( !new_task )  // failed
+                    rejected.push_back( r[i] );
             }
-            else {  // failed
-                if ( (*i)->register_predecessor(*this->my_owner) ) {
-                    if (!upgraded) {
-                        l.upgrade_to_writer();
-                        upgraded = true;
-                    }
-                    i = this->my_successors.erase(i);
-                } else {
-                    ++i;
-                }
+        }
+        if ( !rejected.empty() )
+            this->my_successors.reverse_edges( this->my_mutex, rejected, *this->my_owner );
+        return last_task;
+    }
+
+    //! Puts a batch to each successor; sets accepted to the most items accepted by a successor
+    /** A successor that does not accept the whole batch is handled as one that rejects an item. */
+#if __TBB_PREVIEW_ASYNC_MSG
+    template<typename X>
+    task * try_put_task_batch( const X *items, size_t n, size_t &accepted ) {
+#else
+    task * try_put_task_batch( const T *items, size_t n, size_t &accepted ) {
+#endif // __TBB_PREVIEW_ASYNC_MSG
+        task * last_task = NULL;
+        accepted = 0;
+        rejected_type rejected;
+        {
+            reader_type r(this->my_successors);
+            for ( size_t i = 0; i < r.size(); ++i ) {
+                size_t successor_accepted = 0;
+                task *new_task = r[i]->try_put_task_batch(items, n, successor_accepted);
+                profile_transfer( *r[i], this->my_owner, successor_accepted, n );
+                // workaround for icc bug
+                graph& graph_ref = r[i]->graph_reference();
+                last_task = combine_tasks(graph_ref, last_task, new_task);
+                if ( successor_accepted > accepted )
+                    accepted = successor_accepted;
+                if ( successor_accepted != n )  // failed
+                    rejected.push_back( r[i] );
             }
         }
+        if ( !rejected.empty() )
+            this->my_successors.reverse_edges( this->my_mutex, rejected, *this->my_owner );
         return last_task;
     }
 
@@ -511,31 +750,26 @@ public:
 #else
     bool gather_successful_try_puts( const T &t, task_list &tasks ) {
 #endif // __TBB_PREVIEW_ASYNC_MSG
-        bool upgraded = true;
         bool is_at_least_one_put_successful = false;
-        typename mutex_type::scoped_lock l(this->my_mutex, upgraded);
-        typename successors_type::iterator i = this->my_successors.begin();
-        while ( i != this->my_successors.end() ) {
-            task * new_task = (*i)->try_put_task(t);
-            if(new_task) {
-                ++i;
-                if(new_task != SUCCESSFULLY_ENQUEUED) {
-                    tasks.push_back(*new_task);
-                }
-                is_at_least_one_put_successful = true;
-            }
-            else {  // failed
-                if ( (*i)->register_predecessor(*this->my_owner) ) {
-                    if (!upgraded) {
-                        l.upgrade_to_writer();
-                        upgraded = true;
+        rejected_type rejected;
+        {
+            reader_type r(this->my_successors);
+            for ( size_t i = 0; i < r.size(); ++i ) {
+                task * new_task = r[i]->try_put_task(t);
+                profile_transfer( *r[i], this->my_owner, new_task ? 1 : 0, 1 );
+                if(new_task) {
+                    if(new_task != SUCCESSFULLY_ENQUEUED) {
+                        tasks.push_back(*new_task);
                     }
-                    i = this->my_successors.erase(i);
-                } else {
-                    ++i;
+                    is_at_least_one_put_successful = true;
+                }
+                else {  // failed
+                    rejected.push_back( r[i] );
                 }
             }
         }
+        if ( !rejected.empty() )
+            this->my_successors.reverse_edges( this->my_mutex, rejected, *this->my_owner );
         return is_at_least_one_put_successful;
     }
 };
@@ -547,13 +781,14 @@ class round_robin_cache : public successor_cache<T, M> {
     typedef size_t size_type;
     typedef M mutex_type;
     typedef typename successor_cache<T,M>::successors_type successors_type;
+    typedef typename successors_type::reader reader_type;
+    typedef typename successors_type::rejected_type rejected_type;
 
 public:
 
     round_robin_cache( ) {}
 
     size_type size() {
-        typename mutex_type::scoped_lock l(this->my_mutex, false);
         return this->my_successors.size();
     }
 
@@ -563,27 +798,49 @@ public:
 #else
     task *try_put_task( const T &t ) __TBB_override {
 #endif // __TBB_PREVIEW_ASYNC_MSG
-        bool upgraded = true;
-        typename mutex_type::scoped_lock l(this->my_mutex, upgraded);
-        typename successors_type::iterator i = this->my_successors.begin();
-        while ( i != this->my_successors.end() ) {
-            task *new_task = (*i)->try_put_task(t);
-            if ( new_task ) {
-                return new_task;
-            } else {
-               if ( (*i)->register_predecessor(*this->my_owner) ) {
-                   if (!upgraded) {
-                       l.upgrade_to_writer();
-                       upgraded = true;
-                   }
-                   i = this->my_successors.erase(i);
-               }
-               else {
-                   ++i;
-               }
+        task *new_task = NULL;
+        rejected_type rejected;
+        {
+            reader_type r(this->my_successors);
+            for ( size_t i = 0; i < r.size() && !new_task; ++i ) {
+                new_task = r[i]->try_put_task(t);
+                profile_transfer( *r[i], this->my_owner, new_task ? 1 : 0, 1 );
+                if ( !new_task )
+                    rejected.push_back( r[i] );
+            }
+        }
+        if ( !rejected.empty() )
+            this->my_successors.reverse_edges( this->my_mutex, rejected, *this->my_owner );
+        return new_task;
+    }
+
+    //! Puts the rest of a batch to the next successor while the batch is not accepted as a whole
+#if __TBB_PREVIEW_ASYNC_MSG
+    template<typename X>
+    task * try_put_task_batch( const X *items, size_t n, size_t &accepted ) {
+#else
+    task *try_put_task_batch( const T *items, size_t n, size_t &accepted ) {
+#endif // __TBB_PREVIEW_ASYNC_MSG
+        task * last_task = NULL;
+        accepted = 0;
+        rejected_type rejected;
+        {
+            reader_type r(this->my_successors);
+            for ( size_t i = 0; i < r.size() && accepted < n; ++i ) {
+                size_t successor_accepted = 0;
+                task *new_task = r[i]->try_put_task_batch(items + accepted, n - accepted, successor_accepted);
+                profile_transfer( *r[i], this->my_owner, successor_accepted, n - accepted );
+                // workaround for icc bug
+                graph& graph_ref = r[i]->graph_reference();
+                last_task = combine_tasks(graph_ref, last_task, new_task);
+                accepted += successor_accepted;
+                if ( accepted != n )
+                    rejected.push_back( r[i] );
             }
         }
-        return NULL;
+        if ( !rejected.empty() )
+            this->my_successors.reverse_edges( this->my_mutex, rejected, *this->my_owner );
+        return last_task;
     }
 };
 
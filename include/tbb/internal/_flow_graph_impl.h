@@ -171,6 +171,11 @@ void spawn_in_graph_arena(tbb::flow::interface10::graph& g, tbb::task& arena_tas
 void enqueue_in_graph_arena(tbb::flow::interface10::graph &g, tbb::task& arena_task);
 void add_task_to_graph_reset_list(tbb::flow::interface10::graph& g, tbb::task *tp);
 
+#if __TBB_PREVIEW_FLOW_GRAPH_PROFILER
+class graph_profile;
+class profile_access;
+#endif
+
 #if __TBB_PREVIEW_FLOW_GRAPH_PRIORITIES
 struct graph_task_comparator {
     bool operator()(const graph_task* left, const graph_task* right) {
@@ -427,6 +432,11 @@ private:
     tbb::flow::interface11::internal::graph_task_priority_queue_t my_priority_queue;
 #endif
 
+#if __TBB_PREVIEW_FLOW_GRAPH_PROFILER
+    tbb::flow::interface11::internal::graph_profile *my_profile;
+    friend class tbb::flow::interface11::internal::profile_access;
+#endif
+
     friend void tbb::flow::interface11::internal::activate_graph(graph& g);
     friend void tbb::flow::interface11::internal::deactivate_graph(graph& g);
     friend bool tbb::flow::interface11::internal::is_graph_active(graph& g);
@@ -459,6 +469,9 @@ class graph_node : tbb::internal::no_copy {
 #if __TBB_PREVIEW_FLOW_GRAPH_NODE_SET
     friend class internal::get_graph_helper;
 #endif
+#if __TBB_PREVIEW_FLOW_GRAPH_PROFILER
+    friend class internal::profile_access;
+#endif
 
 protected:
     graph& my_graph;
@@ -34,14 +34,15 @@ namespace internal {
         graph& graph_ref;
     };
 
-    // specialization that lets us keep a copy of the current_key for building results.
+    // specialization that lets the key_matching ports pass their items to the front-end.
     // KeyType can be a reference type.
     template<typename KeyType>
     struct matching_forwarding_base : public forwarding_base {
-        typedef typename tbb::internal::strip<KeyType>::type current_key_type;
+        typedef typename tbb::internal::strip<KeyType>::type noref_key_type;
         matching_forwarding_base(graph &g) : forwarding_base(g) { }
-        virtual task * increment_key_count(current_key_type const & /*t*/, bool /*handle_task*/) = 0; // {return NULL;}
-        current_key_type current_key; // so ports can refer to FE's desired items
+        // the ports have different types, so the item is passed untyped along with the index of the port.
+        // returns NULL if the port already has an item with this key.
+        virtual task * put_with_key(noref_key_type const &k, size_t port, const void *item) = 0;
     };
 
     template< int N >
@@ -116,6 +117,20 @@ namespace internal {
             join_helper<N-1>::copy_key_functors(my_inputs, other_inputs);
         }
 
+        template<typename InputTuple>
+        static inline void set_port_indices(InputTuple &my_input) {
+            tbb::flow::get<N-1>(my_input).set_my_port_index(N-1);
+            join_helper<N-1>::set_port_indices(my_input);
+        }
+
+        // item points to an object of the type of the port with the given index
+        template<typename OutputTuple>
+        static inline void set_item(OutputTuple &out, size_t port, const void *item) {
+            typedef typename tbb::flow::tuple_element<N-1, OutputTuple>::type item_type;
+            if(port == N-1) tbb::flow::get<N-1>(out) = *static_cast<const item_type *>(item);
+            else join_helper<N-1>::set_item(out, port, item);
+        }
+
         template<typename InputTuple>
         static inline void reset_inputs(InputTuple &my_input, reset_flags f) {
             join_helper<N-1>::reset_inputs(my_input, f);
@@ -191,6 +206,17 @@ namespace internal {
                 tbb::flow::get<0>(my_inputs).set_my_key_func(tbb::flow::get<0>(other_inputs).get_my_key_func()->clone());
             }
         }
+        template<typename InputTuple>
+        static inline void set_port_indices(InputTuple &my_input) {
+            tbb::flow::get<0>(my_input).set_my_port_index(0);
+        }
+
+        template<typename OutputTuple>
+        static inline void set_item(OutputTuple &out, size_t /*port*/, const void *item) {
+            typedef typename tbb::flow::tuple_element<0, OutputTuple>::type item_type;
+            tbb::flow::get<0>(out) = *static_cast<const item_type *>(item);
+        }
+
         template<typename InputTuple>
         static inline void reset_inputs(InputTuple &my_input, reset_flags f) {
             tbb::flow::get<0>(my_input).reset_receiver(f);
@@ -638,27 +664,26 @@ namespace internal {
 
 #include "_flow_graph_tagged_buffer_impl.h"
 
-    template<typename K>
-    struct count_element {
+    // a tuple of a key_matching join that is still waiting for some of its items
+    template<typename K, typename TupleType>
+    struct matching_element {
         K my_key;
-        size_t my_value;
+        TupleType my_items;
+        unsigned my_ports;  // bit i is set when input port i has received its item
     };
 
-    // method to access the key in the counting table
+    // method to access the key in the table of pending tuples
     // the ref has already been removed from K
-    template< typename K >
-    struct key_to_count_functor {
-        typedef count_element<K> table_item_type;
+    template< typename K, typename TupleType >
+    struct key_to_matching_functor {
+        typedef matching_element<K, TupleType> table_item_type;
         const K& operator()(const table_item_type& v) { return v.my_key; }
     };
 
     // the ports can have only one template parameter.  We wrap the types needed in
     // a traits type
     template< class TraitsType >
-    class key_matching_port :
-        public receiver<typename TraitsType::T>,
-        public hash_buffer< typename TraitsType::K, typename TraitsType::T, typename TraitsType::TtoK,
-                typename TraitsType::KHash > {
+    class key_matching_port : public receiver<typename TraitsType::T> {
     public:
         typedef TraitsType traits;
         typedef key_matching_port<traits> class_type;
@@ -668,36 +693,22 @@ namespace internal {
         typedef typename receiver<input_type>::predecessor_type predecessor_type;
         typedef typename TraitsType::TtoK type_to_key_func_type;
         typedef typename TraitsType::KHash hash_compare_type;
-        typedef hash_buffer< key_type, input_type, type_to_key_func_type, hash_compare_type > buffer_type;
 #if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
         typedef typename receiver<input_type>::built_predecessors_type built_predecessors_type;
         typedef typename receiver<input_type>::predecessor_list_type predecessor_list_type;
 #endif
     private:
+#if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
 // ----------- Aggregator ------------
     private:
-        enum op_type { try__put, get__item, res_port
-#if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
-           , add_blt_pred, del_blt_pred, blt_pred_cnt, blt_pred_cpy
-#endif
-        };
+        enum op_type { add_blt_pred, del_blt_pred, blt_pred_cnt, blt_pred_cpy };
 
         class key_matching_port_operation : public aggregated_operation<key_matching_port_operation> {
         public:
             char type;
-            input_type my_val;
-            input_type *my_arg;
-#if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
             predecessor_type *pred;
             size_t cnt_val;
             predecessor_list_type *plist;
-#endif
-            // constructor for value parameter
-            key_matching_port_operation(const input_type& e, op_type t) :
-                type(char(t)), my_val(e) {}
-            // constructor for pointer parameter
-            key_matching_port_operation(const input_type* p, op_type t) :
-                type(char(t)), my_arg(const_cast<input_type*>(p)) {}
             // constructor with no parameter
             key_matching_port_operation(op_type t) : type(char(t)) {}
         };
@@ -712,25 +723,6 @@ namespace internal {
                 current = op_list;
                 op_list = op_list->next;
                 switch(current->type) {
-                case try__put: {
-                        bool was_inserted = this->insert_with_key(current->my_val);
-                        // return failure if a duplicate insertion occurs
-                        __TBB_store_with_release(current->status, was_inserted ? SUCCEEDED : FAILED);
-                    }
-                    break;
-                case get__item:
-                    // use current_key from FE for item
-                    if(!this->find_with_key(my_join->current_key, *(current->my_arg))) {
-                        __TBB_ASSERT(false, "Failed to find item corresponding to current_key.");
-                    }
-                    __TBB_store_with_release(current->status, SUCCEEDED);
-                    break;
-                case res_port:
-                    // use current_key from FE for item
-                    this->delete_with_key(my_join->current_key);
-                    __TBB_store_with_release(current->status, SUCCEEDED);
-                    break;
-#if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
                 case add_blt_pred:
                     my_built_predecessors.add_edge(*(current->pred));
                     __TBB_store_with_release(current->status, SUCCEEDED);
@@ -747,25 +739,19 @@ namespace internal {
                     my_built_predecessors.copy_edges(*(current->plist));
                     __TBB_store_with_release(current->status, SUCCEEDED);
                     break;
-#endif
                 }
             }
         }
 // ------------ End Aggregator ---------------
+#endif
     protected:
         template< typename R, typename B > friend class run_and_put_task;
         template<typename X, typename Y> friend class internal::broadcast_cache;
         template<typename X, typename Y> friend class internal::round_robin_cache;
+        // the item is kept by the front-end, in the tuple pending for its key.
+        // the try_put fails if this port already has an item with the key.
         task *try_put_task(const input_type& v) __TBB_override {
-            key_matching_port_operation op_data(v, try__put);
-            task *rtask = NULL;
-            my_aggregator.execute(&op_data);
-            if(op_data.status == SUCCEEDED) {
-                rtask = my_join->increment_key_count((*(this->get_key_func()))(v), false);  // may spawn
-                // rtask has to reflect the return status of the try_put
-                if(!rtask) rtask = SUCCESSFULLY_ENQUEUED;
-            }
-            return rtask;
+            return my_join->put_with_key((*my_key_func)(v), my_port_index, &v);
         }
 
         graph& graph_reference() const __TBB_override {
@@ -774,33 +760,33 @@ namespace internal {
 
     public:
 
-        key_matching_port() : receiver<input_type>(), buffer_type() {
+        key_matching_port() : receiver<input_type>(), my_key_func(NULL), my_port_index(0) {
             my_join = NULL;
+#if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
             my_aggregator.initialize_handler(handler_type(this));
+#endif
         }
 
         // copy constructor
-        key_matching_port(const key_matching_port& /*other*/) : receiver<input_type>(), buffer_type() {
+        key_matching_port(const key_matching_port& /*other*/) : receiver<input_type>(), my_key_func(NULL), my_port_index(0) {
             my_join = NULL;
+#if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
             my_aggregator.initialize_handler(handler_type(this));
+#endif
         }
 
-        ~key_matching_port() { }
+        ~key_matching_port() { delete my_key_func; }
 
         void set_join_node_pointer(forwarding_base *join) {
             my_join = dynamic_cast<matching_forwarding_base<key_type>*>(join);
         }
 
-        void set_my_key_func(type_to_key_func_type *f) { this->set_key_func(f); }
+        void set_my_port_index(size_t i) { my_port_index = i; }
 
-        type_to_key_func_type* get_my_key_func() { return this->get_key_func(); }
+        // Take ownership of func object allocated with new.
+        void set_my_key_func(type_to_key_func_type *f) { my_key_func = f; }
 
-        bool get_item( input_type &v ) {
-            // aggregator uses current_key from FE for Key
-            key_matching_port_operation op_data(&v, get__item);
-            my_aggregator.execute(&op_data);
-            return op_data.status == SUCCEEDED;
-        }
+        type_to_key_func_type* get_my_key_func() { return my_key_func; }
 
 #if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
         built_predecessors_type &built_predecessors() __TBB_override { return my_built_predecessors; }
@@ -830,23 +816,14 @@ namespace internal {
         }
 #endif
 
-        // reset_port is called when item is accepted by successor, but
-        // is initiated by join_node.
-        void reset_port() {
-            key_matching_port_operation op_data(res_port);
-            my_aggregator.execute(&op_data);
-            return;
-        }
-
 #if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
         void extract_receiver() {
-            buffer_type::reset();
             my_built_predecessors.receiver_extract(*this);
         }
 #endif
+        // the pending items are cleared by the front-end
         void reset_receiver(reset_flags f ) __TBB_override {
             tbb::internal::suppress_unused_warning(f);
-            buffer_type::reset();
 #if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
            if (f & rf_clear_edges)
               my_built_predecessors.clear();
@@ -854,9 +831,11 @@ namespace internal {
         }
 
     private:
-        // my_join forwarding base used to count number of inputs that
-        // received key.
+        // my_join forwarding base that keeps the items received
+        // by the ports until all of them have an item with the key.
         matching_forwarding_base<key_type> *my_join;
+        type_to_key_func_type *my_key_func;
+        size_t my_port_index;
 #if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
         edge_container<predecessor_type> my_built_predecessors;
 #endif
@@ -1029,17 +1008,11 @@ namespace internal {
         atomic<size_t> ports_with_no_items;
     };  // join_node_FE<queueing, ...>
 
-    // key_matching join front-end.
+    // key_matching join front-end.  The tuples waiting for items are kept in shards selected by
+    // the hash of their key, each with its own lock, so the ports match different keys in parallel.
+    // The port that completes a tuple puts it to the successors itself.
     template<typename InputTuple, typename OutputTuple, typename K, typename KHash>
     class join_node_FE<key_matching<K,KHash>, InputTuple, OutputTuple> : public matching_forwarding_base<K>,
-             // buffer of key value counts
-              public hash_buffer<   // typedefed below to key_to_count_buffer_type
-                  typename tbb::internal::strip<K>::type&,        // force ref type on K
-                  count_element<typename tbb::internal::strip<K>::type>,
-                  internal::type_to_key_function_body<
-                      count_element<typename tbb::internal::strip<K>::type>,
-                      typename tbb::internal::strip<K>::type& >,
-                  KHash >,
              // buffer of output items
              public item_buffer<OutputTuple> {
     public:
@@ -1050,160 +1023,112 @@ namespace internal {
         typedef typename tbb::internal::strip<key_type>::type unref_key_type;
         typedef KHash key_hash_compare;
         // must use K without ref.
-        typedef count_element<unref_key_type> count_element_type;
+        typedef matching_element<unref_key_type, output_type> matching_element_type;
         // method that lets us refer to the key of this type.
-        typedef key_to_count_functor<unref_key_type> key_to_count_func;
-        typedef internal::type_to_key_function_body< count_element_type, unref_key_type&> TtoK_function_body_type;
-        typedef internal::type_to_key_function_body_leaf<count_element_type, unref_key_type&, key_to_count_func> TtoK_function_body_leaf_type;
-        // this is the type of the special table that keeps track of the number of discrete
-        // elements corresponding to each key that we've seen.
-        typedef hash_buffer< unref_key_type&, count_element_type, TtoK_function_body_type, key_hash_compare >
-                 key_to_count_buffer_type;
+        typedef key_to_matching_functor<unref_key_type, output_type> key_to_matching_func;
+        typedef internal::type_to_key_function_body< matching_element_type, unref_key_type&> TtoK_function_body_type;
+        typedef internal::type_to_key_function_body_leaf<matching_element_type, unref_key_type&, key_to_matching_func> TtoK_function_body_leaf_type;
+        // this is the type of the table that keeps the tuples that are still waiting for items.
+        typedef hash_buffer< unref_key_type&, matching_element_type, TtoK_function_body_type, key_hash_compare >
+                 key_to_matching_buffer_type;
         typedef item_buffer<output_type> output_buffer_type;
         typedef join_node_base<key_matching<key_type,key_hash_compare>, InputTuple, OutputTuple> base_node_type; // for forwarding
         typedef matching_forwarding_base<key_type> forwarding_base_type;
 
-// ----------- Aggregator ------------
-        // the aggregator is only needed to serialize the access to the hash table.
-        // and the output_buffer_type base class
     private:
-        enum op_type { res_count, inc_count, may_succeed, try_make };
-        typedef join_node_FE<key_matching<key_type,key_hash_compare>, InputTuple, OutputTuple> class_type;
+        static const size_t shard_bits = 4;
+        static const size_t shard_count = size_t(1) << shard_bits;
+        static const unsigned all_ports = (1u << N) - 1;
 
-        class key_matching_FE_operation : public aggregated_operation<key_matching_FE_operation> {
-        public:
-            char type;
-            unref_key_type my_val;
-            output_type* my_output;
-            task *bypass_t;
-            bool enqueue_task;
-            // constructor for value parameter
-            key_matching_FE_operation(const unref_key_type& e , bool q_task , op_type t) : type(char(t)), my_val(e),
-                 my_output(NULL), bypass_t(NULL), enqueue_task(q_task) {}
-            key_matching_FE_operation(output_type *p, op_type t) : type(char(t)), my_output(p), bypass_t(NULL),
-                 enqueue_task(true) {}
-            // constructor with no parameter
-            key_matching_FE_operation(op_type t) : type(char(t)), my_output(NULL), bypass_t(NULL), enqueue_task(true) {}
+        struct shard_type {
+            spin_mutex my_mutex;
+            key_to_matching_buffer_type my_pending;
         };
 
-        typedef internal::aggregating_functor<class_type, key_matching_FE_operation> handler_type;
-        friend class internal::aggregating_functor<class_type, key_matching_FE_operation>;
-        aggregator<handler_type, key_matching_FE_operation> my_aggregator;
-
-        // called from aggregator, so serialized
-        // returns a task pointer if the a task would have been enqueued but we asked that
-        // it be returned.  Otherwise returns NULL.
-        task * fill_output_buffer(unref_key_type &t, bool should_enqueue, bool handle_task) {
-            output_type l_out;
-            task *rtask = NULL;
-            bool do_fwd = should_enqueue && this->buffer_empty() && internal::is_graph_active(this->graph_ref);
-            this->current_key = t;
-            this->delete_with_key(this->current_key);   // remove the key
-            if(join_helper<N>::get_items(my_inputs, l_out)) {  //  <== call back
-                this->push_back(l_out);
-                if(do_fwd) {  // we enqueue if receiving an item from predecessor, not if successor asks for item
-                    rtask = new ( task::allocate_additional_child_of( *(this->graph_ref.root_task()) ) )
-                        forward_task_bypass<base_node_type>(*my_node);
-                    if(handle_task) {
-                        internal::spawn_in_graph_arena(this->graph_ref, *rtask);
-                        rtask = NULL;
-                    }
-                    do_fwd = false;
-                }
-                // retire the input values
-                join_helper<N>::reset_ports(my_inputs);  //  <== call back
-            }
-            else {
-                __TBB_ASSERT(false, "should have had something to push");
-            }
-            return rtask;
+        // the buckets of a hash_buffer are selected by the low bits of the hash, so the shard is
+        // selected by the high bits of the hash, scrambled as in tbb_hasher.
+        shard_type &shard_for(const unref_key_type &k) {
+            const size_t h = my_hash_compare.hash(k) *
+                tbb::internal::select_size_t_constant<2654435769U, 11400714819323198485ULL>::value;
+            return my_shards[h >> (8 * sizeof(size_t) - shard_bits)];
         }
 
-        void handle_operations(key_matching_FE_operation* op_list) {
-            key_matching_FE_operation *current;
-            while(op_list) {
-                current = op_list;
-                op_list = op_list->next;
-                switch(current->type) {
-                case res_count:  // called from BE
-                    {
-                        this->destroy_front();
-                        __TBB_store_with_release(current->status, SUCCEEDED);
-                    }
-                    break;
-                case inc_count: {  // called from input ports
-                        count_element_type *p = 0;
-                        unref_key_type &t = current->my_val;
-                        bool do_enqueue = current->enqueue_task;
-                        if(!(this->find_ref_with_key(t,p))) {
-                            count_element_type ev;
-                            ev.my_key = t;
-                            ev.my_value = 0;
-                            this->insert_with_key(ev);
-                            if(!(this->find_ref_with_key(t,p))) {
-                                __TBB_ASSERT(false, "should find key after inserting it");
-                            }
-                        }
-                        if(++(p->my_value) == size_t(N)) {
-                            task *rtask = fill_output_buffer(t, true, do_enqueue);
-                            __TBB_ASSERT(!rtask || !do_enqueue, "task should not be returned");
-                            current->bypass_t = rtask;
-                        }
-                    }
-                    __TBB_store_with_release(current->status, SUCCEEDED);
-                    break;
-                case may_succeed:  // called from BE
-                    __TBB_store_with_release(current->status, this->buffer_empty() ? FAILED : SUCCEEDED);
-                    break;
-                case try_make:  // called from BE
-                    if(this->buffer_empty()) {
-                        __TBB_store_with_release(current->status, FAILED);
-                    }
-                    else {
-                        *(current->my_output) = this->front();
-                        __TBB_store_with_release(current->status, SUCCEEDED);
-                    }
-                    break;
-                }
+        void initialize_shards() {
+            for(size_t i = 0; i < shard_count; ++i)
+                my_shards[i].my_pending.set_key_func(new TtoK_function_body_leaf_type(key_to_matching_func()));
+        }
+
+        // puts a complete tuple to the successors.  If they reject it, or if tuples they rejected
+        // earlier are still waiting, the tuple is buffered and a forwarding task is returned
+        // if the buffer was empty, as a put to the join_node_base would.
+        task *forward_tuple(output_type &out) {
+            if(!internal::is_graph_active(this->graph_ref)) {
+                spin_mutex::scoped_lock lock(my_output_mutex);
+                this->push_back(out);
+                return SUCCESSFULLY_ENQUEUED;
             }
+            if(!tuple_build_may_succeed()) {
+                task *rtask = my_node->try_put_task_to_successors(out);
+                if(rtask) return rtask;
+            }
+            bool do_fwd;
+            {
+                spin_mutex::scoped_lock lock(my_output_mutex);
+                do_fwd = this->buffer_empty();
+                this->push_back(out);
+            }
+            if(!do_fwd) return SUCCESSFULLY_ENQUEUED;
+            return new ( task::allocate_additional_child_of( *(this->graph_ref.root_task()) ) )
+                forward_task_bypass<base_node_type>(*my_node);
         }
-// ------------ End Aggregator ---------------
 
     public:
         template<typename FunctionTuple>
         join_node_FE(graph &g, FunctionTuple &TtoK_funcs) : forwarding_base_type(g), my_node(NULL) {
             join_helper<N>::set_join_node_pointer(my_inputs, this);
+            join_helper<N>::set_port_indices(my_inputs);
             join_helper<N>::set_key_functors(my_inputs, TtoK_funcs);
-            my_aggregator.initialize_handler(handler_type(this));
-                    TtoK_function_body_type *cfb = new TtoK_function_body_leaf_type(key_to_count_func());
-            this->set_key_func(cfb);
+            initialize_shards();
         }
 
-        join_node_FE(const join_node_FE& other) : forwarding_base_type((other.forwarding_base_type::graph_ref)), key_to_count_buffer_type(),
-        output_buffer_type() {
+        join_node_FE(const join_node_FE& other) : forwarding_base_type((other.forwarding_base_type::graph_ref)),
+        output_buffer_type(), my_hash_compare(other.my_hash_compare) {
             my_node = NULL;
             join_helper<N>::set_join_node_pointer(my_inputs, this);
+            join_helper<N>::set_port_indices(my_inputs);
             join_helper<N>::copy_key_functors(my_inputs, const_cast<input_type &>(other.my_inputs));
-            my_aggregator.initialize_handler(handler_type(this));
-            TtoK_function_body_type *cfb = new TtoK_function_body_leaf_type(key_to_count_func());
-            this->set_key_func(cfb);
+            initialize_shards();
         }
 
         // needed for forwarding
         void set_my_node(base_node_type *new_my_node) { my_node = new_my_node; }
 
-        void reset_port_count() {  // called from BE
-            key_matching_FE_operation op_data(res_count);
-            my_aggregator.execute(&op_data);
-            return;
-        }
-
-        // if all input_ports have items, spawn forward to try and consume tuples
-        // return a task if we are asked and did create one.
-        task *increment_key_count(unref_key_type const & t, bool handle_task) __TBB_override {  // called from input_ports
-            key_matching_FE_operation op_data(t, handle_task, inc_count);
-            my_aggregator.execute(&op_data);
-            return op_data.bypass_t;
+        // called from input_ports.  The item is stored in the tuple pending for its key;
+        // if that completes the tuple, it is removed from the shard and forwarded.
+        task *put_with_key(unref_key_type const & k, size_t port, const void *item) __TBB_override {
+            const unsigned port_bit = 1u << port;
+            output_type out;
+            {
+                shard_type &shard = shard_for(k);
+                spin_mutex::scoped_lock lock(shard.my_mutex);
+                matching_element_type *p = NULL;
+                if(!shard.my_pending.find_ref_with_key(k, p)) {
+                    // key_matching join_nodes have at least two ports, so the tuple is not complete yet
+                    matching_element_type e;
+                    e.my_key = k;
+                    e.my_ports = port_bit;
+                    join_helper<N>::set_item(e.my_items, port, item);
+                    shard.my_pending.insert_with_key(e);
+                    return SUCCESSFULLY_ENQUEUED;
+                }
+                if(p->my_ports & port_bit) return NULL;  // the port already has an item with this key
+                join_helper<N>::set_item(p->my_items, port, item);
+                p->my_ports |= port_bit;
+                if(p->my_ports != all_ports) return SUCCESSFULLY_ENQUEUED;
+                out = p->my_items;
+                shard.my_pending.delete_with_key(k);
+            }
+            return forward_tuple(out);
         }
 
         task *decrement_port_count(bool /*handle_task*/) __TBB_override { __TBB_ASSERT(false, NULL); return NULL; }
@@ -1218,7 +1143,8 @@ namespace internal {
             // called outside of parallel contexts
             join_helper<N>::reset_inputs(my_inputs, f);
 
-            key_to_count_buffer_type::reset();
+            for(size_t i = 0; i < shard_count; ++i)
+                my_shards[i].my_pending.reset();
             output_buffer_type::reset();
         }
 
@@ -1226,29 +1152,29 @@ namespace internal {
         void extract() {
             // called outside of parallel contexts
             join_helper<N>::extract_inputs(my_inputs);
-            key_to_count_buffer_type::reset();  // have to reset the tag counts
+            for(size_t i = 0; i < shard_count; ++i)
+                my_shards[i].my_pending.reset();  // have to drop the pending tuples
             output_buffer_type::reset();  // also the queue of outputs
-            // my_node->current_tag = NO_TAG;
         }
 #endif
-        // all methods on input ports should be called under mutual exclusion from join_node_base.
+        // the output buffer is only emptied by join_node_base, under its aggregator,
+        // so the front item stays in place until tuple_accepted is called.
 
         bool tuple_build_may_succeed() {  // called from back-end
-            key_matching_FE_operation op_data(may_succeed);
-            my_aggregator.execute(&op_data);
-            return op_data.status == SUCCEEDED;
+            spin_mutex::scoped_lock lock(my_output_mutex);
+            return !this->buffer_empty();
         }
 
-        // cannot lock while calling back to input_ports.  current_key will only be set
-        // and reset under the aggregator, so it will remain consistent.
         bool try_to_make_tuple(output_type &out) {
-            key_matching_FE_operation op_data(&out,try_make);
-            my_aggregator.execute(&op_data);
-            return op_data.status == SUCCEEDED;
+            spin_mutex::scoped_lock lock(my_output_mutex);
+            if(this->buffer_empty()) return false;
+            out = this->front();
+            return true;
         }
 
         void tuple_accepted() {
-            reset_port_count();  // reset current_key after ports reset.
+            spin_mutex::scoped_lock lock(my_output_mutex);
+            this->destroy_front();
         }
 
         void tuple_rejected() {
@@ -1257,8 +1183,23 @@ namespace internal {
 
         input_type my_inputs;  // input ports
         base_node_type *my_node;
+        key_hash_compare my_hash_compare;
+        tbb::internal::padded<shard_type> my_shards[shard_count];
+        spin_mutex my_output_mutex;
     }; // join_node_FE<key_matching<K,KHash>, InputTuple, OutputTuple>
 
+    // the successors of a join_node are only walked under the aggregator of join_node_base,
+    // except for key_matching, where the port that completes a tuple puts it to them.
+    template<typename JP>
+    struct join_successors_mutex {
+        typedef null_rw_mutex type;
+    };
+
+    template<typename K, typename KHash>
+    struct join_successors_mutex< key_matching<K,KHash> > {
+        typedef spin_rw_mutex type;
+    };
+
     //! join_node_base
     template<typename JP, typename InputTuple, typename OutputTuple>
     class join_node_base : public graph_node, public join_node_FE<JP, InputTuple, OutputTuple>,
@@ -1472,7 +1413,13 @@ namespace internal {
         }
 
     private:
-        broadcast_cache<output_type, null_rw_mutex> my_successors;
+        broadcast_cache<output_type, typename join_successors_mutex<JP>::type> my_successors;
+
+        friend class join_node_FE<JP, InputTuple, OutputTuple>;
+        // called by the key_matching front-end outside of the aggregator
+        task *try_put_task_to_successors(const output_type &t) {
+            return my_successors.try_put_task(t);
+        }
 
         friend class forward_task_bypass< join_node_base<JP, InputTuple, OutputTuple> >;
         task *forward_task() {
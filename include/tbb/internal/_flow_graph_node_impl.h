@@ -52,6 +52,10 @@ namespace internal {
          bool push( T& t ) {
              return this->push_back( t );
          }
+
+         size_t size() const {
+             return this->my_tail - this->my_head;
+         }
      };
 
     //! Input and scheduling for a function node that takes a type Input as input
@@ -59,7 +63,7 @@ namespace internal {
     //  call and any handling of the result.
     template< typename Input, typename Policy, typename A, typename ImplType >
     class function_input_base : public receiver<Input>, tbb::internal::no_assign {
-        enum op_type {reg_pred, rem_pred, try_fwd, tryput_bypass, app_body_bypass, occupy_concurrency
+        enum op_type {reg_pred, rem_pred, try_fwd, tryput_bypass, app_body_bypass, occupy_concurrency, tryput_batch
 #if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
             , add_blt_pred, del_blt_pred,
             blt_pred_cnt, blt_pred_cpy   // create vector copies of preds and succs
@@ -87,10 +91,12 @@ namespace internal {
         function_input_base(
             graph &g, __TBB_FLOW_GRAPH_PRIORITY_ARG1(size_t max_concurrency, node_priority_t priority)
         ) : my_graph_ref(g), my_max_concurrency(max_concurrency)
-          , __TBB_FLOW_GRAPH_PRIORITY_ARG1(my_concurrency(0), my_priority(priority))
+          __TBB_FLOW_GRAPH_PRIORITY_ARG0(my_priority(priority))
           , my_queue(!internal::has_policy<rejecting, Policy>::value ? new input_queue_type() : NULL)
           , forwarder_busy(false)
         {
+            my_concurrency = 0;
+            my_has_predecessors = false;
             my_predecessors.set_owner(this);
             my_aggregator.initialize_handler(handler_type(this));
         }
@@ -99,9 +105,11 @@ namespace internal {
         function_input_base( const function_input_base& src)
             : receiver<Input>(), tbb::internal::no_assign()
             , my_graph_ref(src.my_graph_ref), my_max_concurrency(src.my_max_concurrency)
-            , __TBB_FLOW_GRAPH_PRIORITY_ARG1(my_concurrency(0), my_priority(src.my_priority))
+            __TBB_FLOW_GRAPH_PRIORITY_ARG0(my_priority(src.my_priority))
             , my_queue(src.my_queue ? new input_queue_type() : NULL), forwarder_busy(false)
         {
+            my_concurrency = 0;
+            my_has_predecessors = false;
             my_predecessors.set_owner(this);
             my_aggregator.initialize_handler(handler_type(this));
         }
@@ -118,6 +126,14 @@ namespace internal {
             return try_put_task_impl(t, internal::has_policy<lightweight, Policy>());
         }
 
+        //! Puts a batch that takes a single unit of the concurrency and is run in a single task
+        task* try_put_task_batch( const input_type* items, size_t n, size_t& accepted ) __TBB_override {
+            accepted = 0;
+            if( !n )
+                return NULL;
+            return try_put_task_batch_impl(items, n, accepted, internal::has_policy<lightweight, Policy>());
+        }
+
         //! Adds src to the list of cached predecessors.
         bool register_predecessor( predecessor_type &src ) __TBB_override {
             operation_type op_data(reg_pred);
@@ -174,12 +190,18 @@ namespace internal {
                 my_queue->reset();
             }
             reset_receiver(f);
+            my_has_predecessors = !my_predecessors.empty();
             forwarder_busy = false;
         }
 
         graph& my_graph_ref;
         const size_t my_max_concurrency;
-        size_t my_concurrency;
+        //! The number of running bodies, counted if my_max_concurrency is not unlimited
+        /** A rejecting node changes it outside of the aggregator as well. **/
+        tbb::atomic<size_t> my_concurrency;
+        //! True if predecessors wait for the rejecting node to pull messages from them
+        /** Changed by the aggregator only. **/
+        tbb::atomic<bool> my_has_predecessors;
         __TBB_FLOW_GRAPH_PRIORITY_EXPR( node_priority_t my_priority; )
         input_queue_type *my_queue;
         predecessor_cache<input_type, null_mutex > my_predecessors;
@@ -196,14 +218,35 @@ namespace internal {
         }
 
         task* try_get_postponed_task(const input_type& i) {
+            if( !my_queue && !my_has_predecessors ) {
+                // Nothing to pull, so the concurrency is released without the aggregator.
+                // The fenced decrement and the check after it pair with the aggregator that
+                // sets my_has_predecessors before a forwarder tries to occupy the concurrency:
+                // either the forwarder sees the released concurrency or it is taken back here.
+                --my_concurrency;
+                if( !my_has_predecessors || !try_occupy_concurrency() )
+                    return NULL;
+            }
             operation_type op_data(i, app_body_bypass);  // tries to pop an item or get_item
             my_aggregator.execute(&op_data);
             return op_data.bypass_t;
         }
 
+        //! Takes a unit of the concurrency if it is available
+        bool try_occupy_concurrency() {
+            for( size_t c = my_concurrency; c < my_max_concurrency; ) {
+                const size_t old = my_concurrency.compare_and_swap(c + 1, c);
+                if( old == c )
+                    return true;
+                c = old;
+            }
+            return false;
+        }
+
     private:
 
         friend class apply_body_task_bypass< class_type, input_type >;
+        friend class apply_body_batch_task_bypass< class_type, input_type >;
         friend class forward_task_bypass< class_type >;
 
         class operation_type : public aggregated_operation< operation_type > {
@@ -218,6 +261,8 @@ namespace internal {
 #endif  /* TBB_DEPRECATED_FLOW_NODE_EXTRACTION */
             };
             tbb::task *bypass_t;
+            //! The number of items of a batch at elem
+            size_t batch_size;
             operation_type(const input_type& e, op_type t) :
                 type(char(t)), elem(const_cast<input_type*>(&e)) {}
             operation_type(op_type t) : type(char(t)), r(NULL) {}
@@ -228,11 +273,11 @@ namespace internal {
         friend class internal::aggregating_functor<class_type, operation_type>;
         aggregator< handler_type, operation_type > my_aggregator;
 
+        //! Creates a task for a postponed message, if any, under the concurrency taken by the caller
         task* perform_queued_requests() {
             task* new_task = NULL;
             if(my_queue) {
                 if(!my_queue->empty()) {
-                    ++my_concurrency;
                     new_task = create_body_task(my_queue->front());
 
                     my_queue->pop();
@@ -241,7 +286,6 @@ namespace internal {
             else {
                 input_type i;
                 if(my_predecessors.get_item(i)) {
-                    ++my_concurrency;
                     new_task = create_body_task(i);
                 }
             }
@@ -255,6 +299,8 @@ namespace internal {
                 switch (tmp->type) {
                 case reg_pred:
                     my_predecessors.add(*(tmp->r));
+                    // fenced before a forwarder reads my_concurrency, see try_get_postponed_task
+                    my_has_predecessors.fetch_and_store(true);
                     __TBB_store_with_release(tmp->status, SUCCEEDED);
                     if (!forwarder_busy) {
                         forwarder_busy = true;
@@ -266,20 +312,20 @@ namespace internal {
                     __TBB_store_with_release(tmp->status, SUCCEEDED);
                     break;
                 case app_body_bypass: {
-                        tmp->bypass_t = NULL;
                         __TBB_ASSERT(my_max_concurrency != 0, NULL);
-                        --my_concurrency;
-                        if(my_concurrency<my_max_concurrency)
-                            tmp->bypass_t = perform_queued_requests();
+                        // the concurrency of the completed body goes to the postponed message, if any
+                        tmp->bypass_t = perform_queued_requests();
+                        if(!tmp->bypass_t)
+                            --my_concurrency;
 
                         __TBB_store_with_release(tmp->status, SUCCEEDED);
                     }
                     break;
                 case tryput_bypass: internal_try_put_task(tmp);  break;
+                case tryput_batch: internal_try_put_batch(tmp);  break;
                 case try_fwd: internal_forward(tmp);  break;
                 case occupy_concurrency:
-                    if (my_concurrency < my_max_concurrency) {
-                        ++my_concurrency;
+                    if (try_occupy_concurrency()) {
                         __TBB_store_with_release(tmp->status, SUCCEEDED);
                     } else {
                         __TBB_store_with_release(tmp->status, FAILED);
@@ -306,17 +352,21 @@ namespace internal {
 #endif  /* TBB_DEPRECATED_FLOW_NODE_EXTRACTION */
                 }
             }
+            if(my_has_predecessors && my_predecessors.empty())
+                my_has_predecessors = false;
+            if(my_queue)
+                profile_queue_length(my_graph_ref, static_cast<receiver<input_type> *>(this), my_queue->size());
         }
 
         //! Put to the node, but return the task instead of enqueueing it
         void internal_try_put_task(operation_type *op) {
             __TBB_ASSERT(my_max_concurrency != 0, NULL);
-            if (my_concurrency < my_max_concurrency) {
-               ++my_concurrency;
+            if (try_occupy_concurrency()) {
                task * new_task = create_body_task(*(op->elem));
                op->bypass_t = new_task;
                __TBB_store_with_release(op->status, SUCCEEDED);
            } else if ( my_queue && my_queue->push(*(op->elem)) ) {
+               profile_enqueued(my_graph_ref, static_cast<receiver<input_type> *>(this), 1);
                op->bypass_t = SUCCESSFULLY_ENQUEUED;
                __TBB_store_with_release(op->status, SUCCEEDED);
            } else {
@@ -325,11 +375,30 @@ namespace internal {
            }
         }
 
+        //! Put a batch to the node; the items wait in the queue if the concurrency is not available
+        void internal_try_put_batch(operation_type *op) {
+            __TBB_ASSERT(my_max_concurrency != 0 && my_queue, NULL);
+            if (try_occupy_concurrency()) {
+                op->bypass_t = create_body_batch_task(op->elem, op->batch_size);
+            } else {
+                for (size_t i = 0; i < op->batch_size; ++i)
+                    my_queue->push(op->elem[i]);
+                profile_enqueued(my_graph_ref, static_cast<receiver<input_type> *>(this), op->batch_size);
+                op->bypass_t = SUCCESSFULLY_ENQUEUED;
+            }
+            __TBB_store_with_release(op->status, op->bypass_t ? SUCCEEDED : FAILED);
+        }
+
         //! Creates tasks for postponed messages if available and if concurrency allows
         void internal_forward(operation_type *op) {
             op->bypass_t = NULL;
-            if (my_concurrency < my_max_concurrency || !my_max_concurrency)
+            if (!my_max_concurrency)
                 op->bypass_t = perform_queued_requests();
+            else if (try_occupy_concurrency()) {
+                op->bypass_t = perform_queued_requests();
+                if (!op->bypass_t)
+                    --my_concurrency;
+            }
             if(op->bypass_t)
                 __TBB_store_with_release(op->status, SUCCEEDED);
             else {
@@ -347,9 +416,13 @@ namespace internal {
             return NULL;
         }
 
+        // A rejecting node, that has no queue to keep in order with, takes the concurrency without
+        // the aggregator; the aggregator is left for the postponed messages.
         task* try_put_task_impl( const input_type& t, /*lightweight=*/tbb::internal::true_type ) {
             if( my_max_concurrency == 0 ) {
                 return apply_body_bypass(t);
+            } else if( !my_queue ) {
+                return try_occupy_concurrency() ? apply_body_bypass(t) : NULL;
             } else {
                 operation_type check_op(t, occupy_concurrency);
                 my_aggregator.execute(&check_op);
@@ -363,17 +436,67 @@ namespace internal {
         task* try_put_task_impl( const input_type& t, /*lightweight=*/tbb::internal::false_type ) {
             if( my_max_concurrency == 0 ) {
                 return create_body_task(t);
+            } else if( !my_queue ) {
+                return try_occupy_concurrency() ? create_body_task(t) : NULL;
             } else {
                 return internal_try_put_bypass(t);
             }
         }
 
+        task* try_put_task_batch_impl( const input_type* items, size_t n, size_t& accepted,
+                                       /*lightweight=*/tbb::internal::true_type ) {
+            if( my_max_concurrency != 0 ) {
+                if( !my_queue ) {
+                    if( !try_occupy_concurrency() )
+                        return NULL;
+                } else {
+                    operation_type check_op(occupy_concurrency);
+                    my_aggregator.execute(&check_op);
+                    if( check_op.status != internal::SUCCEEDED )
+                        return internal_try_put_batch_bypass(items, n, accepted);
+                }
+            }
+            accepted = n;
+            return apply_body_batch_bypass(items, n);
+        }
+
+        task* try_put_task_batch_impl( const input_type* items, size_t n, size_t& accepted,
+                                       /*lightweight=*/tbb::internal::false_type ) {
+            if( my_max_concurrency != 0 ) {
+                if( my_queue )
+                    return internal_try_put_batch_bypass(items, n, accepted);
+                if( !try_occupy_concurrency() )
+                    return NULL;
+            }
+            task* new_task = create_body_batch_task(items, n);
+            if( new_task )
+                accepted = n;
+            return new_task;
+        }
+
+        task* internal_try_put_batch_bypass( const input_type* items, size_t n, size_t& accepted ) {
+            operation_type op_data(*items, tryput_batch);
+            op_data.batch_size = n;
+            my_aggregator.execute(&op_data);
+            if( op_data.status == internal::SUCCEEDED ) {
+                accepted = n;
+                return op_data.bypass_t;
+            }
+            return NULL;
+        }
+
         //! Applies the body to the provided input
         //  then decides if more work is available
         task * apply_body_bypass( const input_type &i ) {
             return static_cast<ImplType *>(this)->apply_body_impl_bypass(i);
         }
 
+        //! Applies the body to each input of a batch
+        //  then decides if more work is available
+        task * apply_body_batch_bypass( const input_type *items, size_t n ) {
+            return static_cast<ImplType *>(this)->apply_body_batch_impl_bypass(items, n);
+        }
+
         //! allocates a task to apply a body
         inline task * create_body_task( const input_type &input ) {
             return (internal::is_graph_active(my_graph_ref)) ?
@@ -383,6 +506,15 @@ namespace internal {
                 : NULL;
         }
 
+        //! allocates a task to apply a body to each input of a batch
+        inline task * create_body_batch_task( const input_type *items, size_t n ) {
+            return (internal::is_graph_active(my_graph_ref)) ?
+                new( task::allocate_additional_child_of(*(my_graph_ref.root_task())) )
+                apply_body_batch_task_bypass < class_type, input_type >(
+                    *this, items, __TBB_FLOW_GRAPH_PRIORITY_ARG1(n, my_priority))
+                : NULL;
+        }
+
        //! This is executed by an enqueued task, the "forwarder"
        task* forward_task() {
            operation_type op_data(try_fwd);
@@ -458,6 +590,7 @@ namespace internal {
         output_type apply_body_impl( const input_type& i) {
             // There is an extra copied needed to capture the
             // body execution without the try_put
+            profile_body_scope profile( this->my_graph_ref, static_cast<receiver<input_type> *>(this) );
             tbb::internal::fgt_begin_body( my_body );
             output_type v = (*my_body)(i);
             tbb::internal::fgt_end_body( my_body );
@@ -503,6 +636,34 @@ namespace internal {
 #endif /* TBB_DEPRECATED_MESSAGE_FLOW_ORDER */
         }
 
+        //! Applies the body to each input of a batch and puts the outputs as a batch
+        task * apply_body_batch_impl_bypass( const input_type *items, size_t n ) {
+            batch_storage<output_type> outputs;
+            outputs.reserve(n);
+            for( size_t i = 0; i < n; ++i )
+                outputs.push_back(apply_body_impl(items[i]));
+            size_t accepted;
+#if TBB_DEPRECATED_MESSAGE_FLOW_ORDER
+            task* successor_task = successors().try_put_task_batch(outputs.data(), n, accepted);
+#endif
+            task* postponed_task = NULL;
+            if( base_type::my_max_concurrency != 0 ) {
+                postponed_task = base_type::try_get_postponed_task(items[n - 1]);
+                __TBB_ASSERT( !postponed_task || postponed_task != SUCCESSFULLY_ENQUEUED, NULL );
+            }
+#if TBB_DEPRECATED_MESSAGE_FLOW_ORDER
+            graph& g = base_type::my_graph_ref;
+            return combine_tasks(g, successor_task, postponed_task);
+#else
+            if( postponed_task ) {
+                internal::spawn_in_graph_arena(base_type::graph_reference(), *postponed_task);
+            }
+            task* successor_task = successors().try_put_task_batch(outputs.data(), n, accepted);
+            // the bodies have been executed anyway
+            return successor_task ? successor_task : SUCCESSFULLY_ENQUEUED;
+#endif /* TBB_DEPRECATED_MESSAGE_FLOW_ORDER */
+        }
+
     protected:
 
         void reset_function_input(reset_flags f) {
@@ -678,9 +839,12 @@ namespace internal {
         // the task we were successful.
         //TODO: consider moving common parts with implementation in function_input into separate function
         task * apply_body_impl_bypass( const input_type &i) {
-            tbb::internal::fgt_begin_body( my_body );
-            (*my_body)(i, my_output_ports);
-            tbb::internal::fgt_end_body( my_body );
+            {
+                profile_body_scope profile( this->my_graph_ref, static_cast<receiver<input_type> *>(this) );
+                tbb::internal::fgt_begin_body( my_body );
+                (*my_body)(i, my_output_ports);
+                tbb::internal::fgt_end_body( my_body );
+            }
             task* ttask = NULL;
             if(base_type::my_max_concurrency != 0) {
                 ttask = base_type::try_get_postponed_task(i);
@@ -688,6 +852,21 @@ namespace internal {
             return ttask ? ttask : SUCCESSFULLY_ENQUEUED;
         }
 
+        //! Applies the body to each input of a batch; the body puts to the ports one by one
+        task * apply_body_batch_impl_bypass( const input_type *items, size_t n ) {
+            for( size_t i = 0; i < n; ++i ) {
+                profile_body_scope profile( this->my_graph_ref, static_cast<receiver<input_type> *>(this) );
+                tbb::internal::fgt_begin_body( my_body );
+                (*my_body)(items[i], my_output_ports);
+                tbb::internal::fgt_end_body( my_body );
+            }
+            task* ttask = NULL;
+            if(base_type::my_max_concurrency != 0) {
+                ttask = base_type::try_get_postponed_task(items[n - 1]);
+            }
+            return ttask ? ttask : SUCCESSFULLY_ENQUEUED;
+        }
+
         output_ports_type &output_ports(){ return my_output_ports; }
 
     protected:
@@ -815,12 +994,17 @@ namespace internal {
 
         //! Applies the body to the provided input
         task *apply_body_bypass( input_type ) {
+            return successors().try_put_task( apply_body_impl() );
+        }
+
+        output_type apply_body_impl() {
             // There is an extra copied needed to capture the
             // body execution without the try_put
+            profile_body_scope profile( my_graph_ref, static_cast<receiver<input_type> *>(this) );
             tbb::internal::fgt_begin_body( my_body );
             output_type v = (*my_body)( continue_msg() );
             tbb::internal::fgt_end_body( my_body );
-            return successors().try_put_task( v );
+            return v;
         }
 
         task* execute() __TBB_override {
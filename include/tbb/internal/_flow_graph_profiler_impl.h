@@ -0,0 +1,823 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef __TBB__flow_graph_profiler_impl_H
+#define __TBB__flow_graph_profiler_impl_H
+
+#ifndef __TBB_flow_graph_H
+#error Do not #include this internal file directly; use public TBB headers instead.
+#endif
+
+#if __TBB_PREVIEW_FLOW_GRAPH_PROFILER
+#include "../tick_count.h"
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#endif
+
+// The nodes and edges of a graph are registered in its profile by the same calls that name them
+// to the threading tools (see _flow_graph_trace_impl.h), keyed by the addresses of their ports.
+// The hooks in the nodes and caches do nothing but test a counter while no graph is profiled.
+
+namespace tbb {
+namespace flow {
+namespace interface11 {
+
+#if __TBB_PREVIEW_FLOW_GRAPH_PROFILER
+
+class graph_profiler;
+
+namespace internal {
+
+//! The number of profiled graphs; the hooks do nothing else while it is zero
+template< typename T = void >
+struct profiler_state {
+    static tbb::atomic<int> active;
+};
+
+template< typename T >
+tbb::atomic<int> profiler_state<T>::active;
+
+//! The counters of a node
+struct node_profile : tbb::internal::no_copy {
+    //! The port the node was registered with
+    const void *my_key;
+    tbb::internal::string_index my_type;
+    std::string my_name;
+
+    tbb::atomic<size_t> my_invocations;
+    tbb::atomic<size_t> my_enqueued;
+    tbb::atomic<size_t> my_rejections;
+    tbb::atomic<size_t> my_reservations;
+    tbb::atomic<long long> my_body_ns;
+    tbb::atomic<long long> my_max_body_ns;
+
+    //! The integral of the queue length over time, in seconds; changed under the serialization of the node
+    double my_queue_area;
+    size_t my_queue_length;
+    tick_count my_queue_changed;
+
+    node_profile( const void *key, tbb::internal::string_index type ) : my_key(key), my_type(type) {
+        reset( tick_count::now() );
+    }
+
+    void reset( tick_count now ) {
+        my_invocations = 0;
+        my_enqueued = 0;
+        my_rejections = 0;
+        my_reservations = 0;
+        my_body_ns = 0;
+        my_max_body_ns = 0;
+        my_queue_area = 0;
+        my_queue_length = 0;
+        my_queue_changed = now;
+    }
+
+    void add_body_time( long long ns ) {
+        ++my_invocations;
+        my_body_ns += ns;
+        for ( long long m = my_max_body_ns; m < ns; m = my_max_body_ns )
+            if ( my_max_body_ns.compare_and_swap( ns, m ) == m )
+                break;
+    }
+
+    void set_queue_length( size_t length, tick_count now ) {
+        my_queue_area += double(my_queue_length)*(now - my_queue_changed).seconds();
+        my_queue_length = length;
+        my_queue_changed = now;
+    }
+};
+
+//! The counters of an edge
+struct edge_profile : tbb::internal::no_copy {
+    tbb::atomic<size_t> my_messages;
+    edge_profile() { my_messages = 0; }
+};
+
+//! The tables the hooks search while a graph is profiled; frozen when the profiling starts
+struct profile_table : tbb::internal::no_copy {
+    typedef std::pair<const void *, node_profile *> port_entry;
+    typedef std::pair<const void *, const void *> edge_key;
+    typedef std::pair<edge_key, edge_profile *> edge_entry;
+
+    struct port_less {
+        bool operator()( const port_entry &a, const port_entry &b ) const {
+            return std::less<const void *>()( a.first, b.first );
+        }
+    };
+
+    struct edge_less {
+        bool operator()( const edge_key &a, const edge_key &b ) const {
+            std::less<const void *> less;
+            return less( a.first, b.first ) || ( a.first == b.first && less( a.second, b.second ) );
+        }
+        bool operator()( const edge_entry &a, const edge_entry &b ) const {
+            return (*this)( a.first, b.first );
+        }
+    };
+
+    //! Sorted by port
+    std::vector<port_entry> my_ports;
+    //! Sorted by the ports of the predecessor and the successor
+    std::vector<edge_entry> my_edges;
+
+    node_profile *find_node( const void *port ) const {
+        std::vector<port_entry>::const_iterator i =
+            std::lower_bound( my_ports.begin(), my_ports.end(), port_entry( port, (node_profile *)NULL ), port_less() );
+        return i != my_ports.end() && i->first == port ? i->second : NULL;
+    }
+
+    edge_profile *find_edge( const void *from, const void *to ) const {
+        const edge_entry e( edge_key( from, to ), (edge_profile *)NULL );
+        std::vector<edge_entry>::const_iterator i = std::lower_bound( my_edges.begin(), my_edges.end(), e, edge_less() );
+        return i != my_edges.end() && i->first == e.first ? i->second : NULL;
+    }
+};
+
+//! The nodes and edges of a graph and their counters
+/** A node made where a node of the graph was destroyed takes the record of the old node.
+    Records are freed with the graph. */
+class graph_profile : tbb::internal::no_copy {
+    typedef std::map<const void *, node_profile *, std::less<const void *> > port_map_type;
+    typedef std::map<profile_table::edge_key, edge_profile *, profile_table::edge_less> edge_map_type;
+
+    friend class tbb::flow::interface11::graph_profiler;
+
+    //! Protects the maps and the state of the profiling
+    spin_mutex my_mutex;
+    std::vector<node_profile *> my_nodes;
+    port_map_type my_ports;
+    edge_map_type my_edges;
+
+    //! The table the hooks search; NULL while the graph is not profiled
+    tbb::atomic<profile_table *> my_table;
+    //! The tables that were searched; a hook may still hold one, so they are freed with the graph
+    std::vector<profile_table *> my_retired;
+    //! Set when a node, port or edge is added after the last table was made
+    bool my_changed;
+
+    bool my_active;
+    bool my_started;
+    tick_count my_start;
+    tick_count my_stop;
+
+    bool is_current( const node_profile *n ) const {
+        port_map_type::const_iterator i = my_ports.find( n->my_key );
+        return i != my_ports.end() && i->second == n;
+    }
+
+    node_profile *port_owner( const void *port ) const {
+        port_map_type::const_iterator i = my_ports.find( port );
+        return i != my_ports.end() && is_current( i->second ) ? i->second : NULL;
+    }
+
+    profile_table *make_table() const {
+        profile_table *t = new profile_table;
+        t->my_ports.assign( my_ports.begin(), my_ports.end() );
+        t->my_edges.assign( my_edges.begin(), my_edges.end() );
+        return t;
+    }
+
+public:
+    graph_profile() : my_changed(true), my_active(false), my_started(false) {
+        my_table = NULL;
+    }
+
+    ~graph_profile() {
+        stop();
+        for ( size_t i = 0; i < my_nodes.size(); ++i )
+            delete my_nodes[i];
+        for ( edge_map_type::iterator i = my_edges.begin(); i != my_edges.end(); ++i )
+            delete i->second;
+        for ( size_t i = 0; i < my_retired.size(); ++i )
+            delete my_retired[i];
+    }
+
+    void add_node( tbb::internal::string_index type, const void *key ) {
+        spin_mutex::scoped_lock lock( my_mutex );
+        port_map_type::iterator i = my_ports.find( key );
+        if ( i != my_ports.end() && i->second->my_key == key ) {
+            i->second->my_type = type;
+            i->second->my_name.clear();
+        } else {
+            node_profile *n = new node_profile( key, type );
+            my_nodes.push_back( n );
+            my_ports[key] = n;
+        }
+        my_changed = true;
+    }
+
+    void add_port( const void *key, const void *port ) {
+        spin_mutex::scoped_lock lock( my_mutex );
+        port_map_type::iterator i = my_ports.find( key );
+        if ( i != my_ports.end() ) {
+            my_ports[port] = i->second;
+            my_changed = true;
+        }
+    }
+
+    void add_edge( const void *from, const void *to ) {
+        spin_mutex::scoped_lock lock( my_mutex );
+        edge_profile *&e = my_edges[profile_table::edge_key( from, to )];
+        if ( !e ) {
+            e = new edge_profile;
+            my_changed = true;
+        }
+    }
+
+    void set_name( const void *key, const char *name ) {
+        spin_mutex::scoped_lock lock( my_mutex );
+        port_map_type::iterator i = my_ports.find( key );
+        if ( i != my_ports.end() )
+            i->second->my_name = name ? name : "";
+    }
+
+    void start() {
+        spin_mutex::scoped_lock lock( my_mutex );
+        if ( my_active )
+            return;
+        if ( my_changed || my_retired.empty() ) {
+            my_retired.push_back( make_table() );
+            my_changed = false;
+        }
+        my_start = tick_count::now();
+        for ( size_t i = 0; i < my_nodes.size(); ++i )
+            my_nodes[i]->reset( my_start );
+        for ( edge_map_type::iterator i = my_edges.begin(); i != my_edges.end(); ++i )
+            i->second->my_messages = 0;
+        my_active = my_started = true;
+        my_table = my_retired.back();
+        ++profiler_state<>::active;
+    }
+
+    void stop() {
+        spin_mutex::scoped_lock lock( my_mutex );
+        if ( !my_active )
+            return;
+        my_table = NULL;
+        my_stop = tick_count::now();
+        my_active = false;
+        --profiler_state<>::active;
+    }
+
+    bool is_active() const { return my_active; }
+
+    node_profile *find_node( const void *port ) const {
+        profile_table *t = my_table;
+        return t ? t->find_node( port ) : NULL;
+    }
+
+    edge_profile *find_edge( const void *from, const void *to ) const {
+        profile_table *t = my_table;
+        return t ? t->find_edge( from, to ) : NULL;
+    }
+};
+
+//! Gives the profiler the graph of a node or receiver and the profile of a graph
+class profile_access {
+public:
+    static graph_profile &profile( graph &g ) { return *g.my_profile; }
+
+    template< typename Receiver >
+    static graph &graph_of( const Receiver &r ) { return r.graph_reference(); }
+
+    template< typename Node >
+    static graph &node_graph( const Node *n ) { return static_cast<const graph_node *>(n)->my_graph; }
+};
+
+// Registration, called from the fgt_* functions and from make_edge
+
+inline void profile_node( void *g, tbb::internal::string_index type, void *node ) {
+    profile_access::profile( *static_cast<graph *>(g) ).add_node( type, node );
+}
+
+inline void profile_port( void *g, void *node, void *port ) {
+    profile_access::profile( *static_cast<graph *>(g) ).add_port( node, port );
+}
+
+template< typename T >
+void *profile_input_port_key( receiver<T> *port ) { return port; }
+
+template< typename T >
+void *profile_output_port_key( sender<T> *port ) { return port; }
+
+template< typename PortsTuple, int N >
+struct profile_input_ports_helper {
+    static void add( void *g, void *node, PortsTuple &ports ) {
+        profile_port( g, node, profile_input_port_key( &tbb::flow::get<N-1>(ports) ) );
+        profile_input_ports_helper<PortsTuple, N-1>::add( g, node, ports );
+    }
+};
+
+template< typename PortsTuple >
+struct profile_input_ports_helper<PortsTuple, 0> {
+    static void add( void *, void *, PortsTuple & ) {}
+};
+
+template< typename PortsTuple, int N >
+struct profile_output_ports_helper {
+    static void add( void *g, void *node, PortsTuple &ports ) {
+        profile_port( g, node, profile_output_port_key( &tbb::flow::get<N-1>(ports) ) );
+        profile_output_ports_helper<PortsTuple, N-1>::add( g, node, ports );
+    }
+};
+
+template< typename PortsTuple >
+struct profile_output_ports_helper<PortsTuple, 0> {
+    static void add( void *, void *, PortsTuple & ) {}
+};
+
+template< int N, typename PortsTuple >
+void profile_input_ports( void *g, void *node, PortsTuple &ports ) {
+    profile_input_ports_helper<PortsTuple, N>::add( g, node, ports );
+}
+
+template< int N, typename PortsTuple >
+void profile_output_ports( void *g, void *node, PortsTuple &ports ) {
+    profile_output_ports_helper<PortsTuple, N>::add( g, node, ports );
+}
+
+template< typename Node >
+void profile_node_desc( const Node *node, const void *key, const char *desc ) {
+    profile_access::profile( profile_access::node_graph( node ) ).set_name( key, desc );
+}
+
+template< typename Sender, typename Receiver >
+void profile_make_edge( Sender &p, Receiver &s ) {
+    profile_access::profile( profile_access::graph_of( s ) ).add_edge( &p, &s );
+}
+
+// Hooks
+
+inline node_profile *find_node_profile( graph &g, const void *port ) {
+    return profiler_state<>::active ? profile_access::profile( g ).find_node( port ) : NULL;
+}
+
+//! Adds the time to the end of its scope to the body time of the node of a port
+class profile_body_scope : tbb::internal::no_copy {
+    node_profile *my_node;
+    tick_count my_start;
+public:
+    profile_body_scope( graph &g, const void *port ) : my_node( find_node_profile( g, port ) ) {
+        if ( my_node )
+            my_start = tick_count::now();
+    }
+
+    ~profile_body_scope() {
+        if ( my_node )
+            my_node->add_body_time( (long long)( (tick_count::now() - my_start).seconds()*1e9 ) );
+    }
+};
+
+//! Counts the messages put to the queue or buffer of the node of a port
+inline void profile_enqueued( graph &g, const void *port, size_t n ) {
+    if ( node_profile *node = find_node_profile( g, port ) )
+        node->my_enqueued += n;
+}
+
+//! Records the length of the queue or buffer of the node of a port; called under its serialization
+inline void profile_queue_length( graph &g, const void *port, size_t length ) {
+    if ( node_profile *node = find_node_profile( g, port ) )
+        node->set_queue_length( length, tick_count::now() );
+}
+
+//! Counts the messages passed from a sender to a receiver, and the messages the receiver rejected
+template< typename Receiver >
+void profile_transfer( const Receiver &r, const void *from, size_t accepted, size_t offered ) {
+    if ( !profiler_state<>::active )
+        return;
+    graph_profile &p = profile_access::profile( profile_access::graph_of( r ) );
+    if ( accepted )
+        if ( edge_profile *e = p.find_edge( from, &r ) )
+            e->my_messages += accepted;
+    if ( accepted < offered )
+        if ( node_profile *node = p.find_node( &r ) )
+            ++node->my_rejections;
+}
+
+//! Counts an item reserved by a receiver from its predecessor
+template< typename Receiver >
+void profile_reservation( const Receiver &r ) {
+    if ( !profiler_state<>::active )
+        return;
+    if ( node_profile *node = profile_access::profile( profile_access::graph_of( r ) ).find_node( &r ) )
+        ++node->my_reservations;
+}
+
+inline const char *profile_type_name( tbb::internal::string_index type ) {
+    static const char *const names[] = {
+#define TBB_STRING_RESOURCE(index_name,str) str,
+#include "_tbb_strings.h"
+#undef TBB_STRING_RESOURCE
+    };
+    return size_t(type) < sizeof(names)/sizeof(names[0]) ? names[type] : "node";
+}
+
+//! Writes a string with the characters escaped for a JSON string or a DOT label
+inline void profile_write_quoted( std::ostream &out, const std::string &s ) {
+    static const char hex[] = "0123456789abcdef";
+    out << '"';
+    for ( size_t i = 0; i < s.size(); ++i ) {
+        const unsigned char c = (unsigned char)s[i];
+        if ( c == '"' || c == '\\' )
+            out << '\\' << s[i];
+        else if ( c == '\n' )
+            out << "\\n";
+        else if ( c < 0x20 )
+            out << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+        else
+            out << s[i];
+    }
+    out << '"';
+}
+
+} // namespace internal
+
+//! Profiles the nodes and edges of a graph
+/** The profile belongs to the graph, so the profilers made for a graph share it. The nodes and
+    edges made while the graph is profiled are counted from the next start(). Make reports when no
+    messages are in flight, e.g. after wait_for_all(). */
+class graph_profiler : tbb::internal::no_copy {
+public:
+    //! The statistics of a node over the profiled time; the times are in seconds
+    struct node_statistics {
+        const char *type;
+        std::string name;
+        //! The bodies run
+        size_t invocations;
+        //! The messages that waited in the queue or the buffer of the node
+        size_t enqueued;
+        //! The messages the node rejected when its predecessors put them
+        size_t rejections;
+        //! The items the node reserved from its predecessors
+        size_t reservations;
+        double body_time;
+        double max_body_time;
+        //! The integral of the length of the queue or the buffer over time
+        double queueing_time;
+
+        double mean_body_time() const { return invocations ? body_time/invocations : 0; }
+
+        //! The mean time the messages that waited spent in the queue, by Little's law
+        double mean_queueing_delay() const { return enqueued ? queueing_time/enqueued : 0; }
+
+        //! The mean time a message spends in the node, waiting and in the body
+        double latency() const {
+            const size_t messages = invocations ? invocations : enqueued;
+            return messages ? ( body_time + queueing_time )/messages : 0;
+        }
+    };
+
+    //! The messages passed along an edge; from and to index the nodes of the report
+    struct edge_statistics {
+        size_t from;
+        size_t to;
+        size_t messages;
+        //! Messages per second over the profiled time
+        double throughput;
+    };
+
+    //! The statistics of the nodes and edges that took part in the profiled run
+    class report {
+    public:
+        report() : my_duration(0), my_critical_path_length(0) {}
+
+        //! The profiled time in seconds
+        double duration() const { return my_duration; }
+
+        const std::vector<node_statistics> &nodes() const { return my_nodes; }
+        const std::vector<edge_statistics> &edges() const { return my_edges; }
+
+        //! The nodes on the path with the largest sum of node latencies, as indices of nodes()
+        /** The edges that close cycles are left out. */
+        const std::vector<size_t> &critical_path() const { return my_critical_path; }
+        double critical_path_length() const { return my_critical_path_length; }
+
+        //! The node with the name given by set_name, or NULL
+        const node_statistics *find( const char *name ) const {
+            for ( size_t i = 0; i < my_nodes.size(); ++i )
+                if ( my_nodes[i].name == name )
+                    return &my_nodes[i];
+            return NULL;
+        }
+
+        //! The node of a port, or NULL
+        template< typename T >
+        const node_statistics *find( const sender<T> &port ) const { return find_port( &port ); }
+
+        template< typename T >
+        const node_statistics *find( const receiver<T> &port ) const { return find_port( &port ); }
+
+        //! Writes the graph in the DOT language with the critical path in red
+        void write_dot( std::ostream &out ) const;
+
+        //! Writes the statistics as a JSON object
+        void write_json( std::ostream &out ) const;
+
+    private:
+        friend class graph_profiler;
+
+        const node_statistics *find_port( const void *port ) const {
+            std::vector< std::pair<const void *, size_t> >::const_iterator i =
+                std::lower_bound( my_ports.begin(), my_ports.end(), std::make_pair( port, size_t(0) ), port_less() );
+            return i != my_ports.end() && i->first == port ? &my_nodes[i->second] : NULL;
+        }
+
+        struct port_less {
+            bool operator()( const std::pair<const void *, size_t> &a, const std::pair<const void *, size_t> &b ) const {
+                return std::less<const void *>()( a.first, b.first );
+            }
+        };
+
+        struct edge_less {
+            bool operator()( const edge_statistics &a, const edge_statistics &b ) const {
+                return a.from < b.from || ( a.from == b.from && a.to < b.to );
+            }
+        };
+
+        bool on_critical_path( size_t from, size_t to ) const {
+            for ( size_t i = 1; i < my_critical_path.size(); ++i )
+                if ( my_critical_path[i-1] == from && my_critical_path[i] == to )
+                    return true;
+            return false;
+        }
+
+        void compute_critical_path();
+
+        double my_duration;
+        std::vector<node_statistics> my_nodes;
+        std::vector<edge_statistics> my_edges;
+        //! The ports of the nodes and the indices of the nodes, sorted by port
+        std::vector< std::pair<const void *, size_t> > my_ports;
+        std::vector<size_t> my_critical_path;
+        double my_critical_path_length;
+    };
+
+    explicit graph_profiler( graph &g ) : my_profile( internal::profile_access::profile( g ) ) {}
+
+    //! Resets the counters and starts counting
+    void start() { my_profile.start(); }
+
+    void stop() { my_profile.stop(); }
+
+    bool is_active() const { return my_profile.is_active(); }
+
+    report make_report() const;
+
+    void write_dot( std::ostream &out ) const { make_report().write_dot( out ); }
+
+    void write_json( std::ostream &out ) const { make_report().write_json( out ); }
+
+private:
+    internal::graph_profile &my_profile;
+};
+
+inline graph_profiler::report graph_profiler::make_report() const {
+    typedef internal::graph_profile profile_type;
+    report r;
+    spin_mutex::scoped_lock lock( my_profile.my_mutex );
+    if ( !my_profile.my_started )
+        return r;
+    const tick_count end = my_profile.my_active ? tick_count::now() : my_profile.my_stop;
+    r.my_duration = (end - my_profile.my_start).seconds();
+
+    // The nodes that counted anything or passed messages took part in the run
+    std::set<internal::node_profile *> taking_part;
+    for ( profile_type::edge_map_type::const_iterator i = my_profile.my_edges.begin(); i != my_profile.my_edges.end(); ++i ) {
+        internal::node_profile *from = my_profile.port_owner( i->first.first );
+        internal::node_profile *to = my_profile.port_owner( i->first.second );
+        if ( i->second->my_messages && from && to ) {
+            taking_part.insert( from );
+            taking_part.insert( to );
+        }
+    }
+    std::map<internal::node_profile *, size_t> index;
+    for ( size_t i = 0; i < my_profile.my_nodes.size(); ++i ) {
+        internal::node_profile *n = my_profile.my_nodes[i];
+        if ( !my_profile.is_current( n ) )
+            continue;
+        if ( !n->my_invocations && !n->my_enqueued && !n->my_rejections && !n->my_reservations && !taking_part.count( n ) )
+            continue;
+        node_statistics s;
+        s.type = internal::profile_type_name( n->my_type );
+        s.name = n->my_name;
+        s.invocations = n->my_invocations;
+        s.enqueued = n->my_enqueued;
+        s.rejections = n->my_rejections;
+        s.reservations = n->my_reservations;
+        s.body_time = double(n->my_body_ns)*1e-9;
+        s.max_body_time = double(n->my_max_body_ns)*1e-9;
+        const double unchanged = (end - n->my_queue_changed).seconds();
+        s.queueing_time = n->my_queue_area + ( unchanged > 0 ? double(n->my_queue_length)*unchanged : 0 );
+        index[n] = r.my_nodes.size();
+        r.my_nodes.push_back( s );
+    }
+
+    for ( profile_type::edge_map_type::const_iterator i = my_profile.my_edges.begin(); i != my_profile.my_edges.end(); ++i ) {
+        const size_t messages = i->second->my_messages;
+        internal::node_profile *from = my_profile.port_owner( i->first.first );
+        internal::node_profile *to = my_profile.port_owner( i->first.second );
+        if ( !messages || !index.count( from ) || !index.count( to ) )
+            continue;
+        edge_statistics e;
+        e.from = index[from];
+        e.to = index[to];
+        e.messages = messages;
+        e.throughput = r.my_duration > 0 ? messages/r.my_duration : 0;
+        r.my_edges.push_back( e );
+    }
+    std::sort( r.my_edges.begin(), r.my_edges.end(), report::edge_less() );
+
+    for ( profile_type::port_map_type::const_iterator i = my_profile.my_ports.begin(); i != my_profile.my_ports.end(); ++i )
+        if ( index.count( i->second ) )
+            r.my_ports.push_back( std::make_pair( i->first, index[i->second] ) );
+
+    r.compute_critical_path();
+    return r;
+}
+
+inline void graph_profiler::report::compute_critical_path() {
+    const size_t n = my_nodes.size();
+    if ( !n )
+        return;
+    std::vector< std::vector<size_t> > successors( n );
+    for ( size_t i = 0; i < my_edges.size(); ++i )
+        if ( my_edges[i].from != my_edges[i].to )
+            successors[my_edges[i].from].push_back( my_edges[i].to );
+
+    // Depth-first search for the postorder; the edges to the nodes on the stack close cycles
+    enum { unvisited, on_stack, done };
+    std::vector<int> state( n, unvisited );
+    std::vector<size_t> postorder;
+    std::vector< std::pair<size_t, size_t> > stack;
+    for ( size_t s = 0; s < n; ++s ) {
+        if ( state[s] != unvisited )
+            continue;
+        state[s] = on_stack;
+        stack.push_back( std::make_pair( s, size_t(0) ) );
+        while ( !stack.empty() ) {
+            const size_t u = stack.back().first;
+            if ( stack.back().second < successors[u].size() ) {
+                const size_t v = successors[u][stack.back().second++];
+                if ( state[v] == unvisited ) {
+                    state[v] = on_stack;
+                    stack.push_back( std::make_pair( v, size_t(0) ) );
+                }
+            } else {
+                state[u] = done;
+                postorder.push_back( u );
+                stack.pop_back();
+            }
+        }
+    }
+
+    // The longest path over the nodes in the reverse postorder, along the edges that go forward in it
+    std::vector<size_t> position( n );
+    for ( size_t i = 0; i < n; ++i )
+        position[postorder[i]] = n - 1 - i;
+    std::vector<double> length( n );
+    std::vector<size_t> previous( n, n );
+    for ( size_t v = 0; v < n; ++v )
+        length[v] = my_nodes[v].latency();
+    for ( size_t i = n; i-- > 0; ) {
+        const size_t u = postorder[i];
+        for ( size_t j = 0; j < successors[u].size(); ++j ) {
+            const size_t v = successors[u][j];
+            if ( position[u] > position[v] )
+                continue;
+            const double l = length[u] + my_nodes[v].latency();
+            // A predecessor that adds nothing to the length still starts the path
+            if ( l > length[v] || ( l == length[v] && previous[v] == n ) ) {
+                length[v] = l;
+                previous[v] = u;
+            }
+        }
+    }
+    size_t last = 0;
+    for ( size_t v = 1; v < n; ++v )
+        if ( length[v] > length[last] )
+            last = v;
+    my_critical_path_length = length[last];
+    for ( size_t v = last; v != n; v = previous[v] )
+        my_critical_path.push_back( v );
+    std::reverse( my_critical_path.begin(), my_critical_path.end() );
+}
+
+inline void graph_profiler::report::write_dot( std::ostream &out ) const {
+    std::vector<bool> critical( my_nodes.size() );
+    for ( size_t i = 0; i < my_critical_path.size(); ++i )
+        critical[my_critical_path[i]] = true;
+    out << "digraph profile {\n";
+    for ( size_t i = 0; i < my_nodes.size(); ++i ) {
+        const node_statistics &n = my_nodes[i];
+        std::ostringstream label;
+        if ( !n.name.empty() )
+            label << n.name << '\n';
+        label << n.type << '\n' << n.invocations << " invocations, " << n.latency() << " s latency";
+        out << "    n" << i << " [label=";
+        internal::profile_write_quoted( out, label.str() );
+        if ( critical[i] )
+            out << ", color=red, penwidth=2";
+        out << "];\n";
+    }
+    for ( size_t i = 0; i < my_edges.size(); ++i ) {
+        const edge_statistics &e = my_edges[i];
+        out << "    n" << e.from << " -> n" << e.to << " [label=\"" << e.throughput << " msg/s\"";
+        if ( on_critical_path( e.from, e.to ) )
+            out << ", color=red, penwidth=2";
+        out << "];\n";
+    }
+    out << "}\n";
+}
+
+inline void graph_profiler::report::write_json( std::ostream &out ) const {
+    out << "{\n  \"duration\": " << my_duration << ",\n  \"nodes\": [";
+    for ( size_t i = 0; i < my_nodes.size(); ++i ) {
+        const node_statistics &n = my_nodes[i];
+        out << ( i ? ",\n" : "\n" ) << "    {\"id\": " << i << ", \"type\": ";
+        internal::profile_write_quoted( out, n.type );
+        out << ", \"name\": ";
+        internal::profile_write_quoted( out, n.name );
+        out << ", \"invocations\": " << n.invocations
+            << ", \"enqueued\": " << n.enqueued
+            << ", \"rejections\": " << n.rejections
+            << ", \"reservations\": " << n.reservations
+            << ", \"body_time\": " << n.body_time
+            << ", \"max_body_time\": " << n.max_body_time
+            << ", \"mean_body_time\": " << n.mean_body_time()
+            << ", \"mean_queueing_delay\": " << n.mean_queueing_delay()
+            << ", \"latency\": " << n.latency() << "}";
+    }
+    out << "\n  ],\n  \"edges\": [";
+    for ( size_t i = 0; i < my_edges.size(); ++i ) {
+        const edge_statistics &e = my_edges[i];
+        out << ( i ? ",\n" : "\n" ) << "    {\"from\": " << e.from << ", \"to\": " << e.to
+            << ", \"messages\": " << e.messages << ", \"throughput\": " << e.throughput << "}";
+    }
+    out << "\n  ],\n  \"critical_path\": {\"length\": " << my_critical_path_length << ", \"nodes\": [";
+    for ( size_t i = 0; i < my_critical_path.size(); ++i )
+        out << ( i ? ", " : "" ) << my_critical_path[i];
+    out << "]}\n}\n";
+}
+
+#else // __TBB_PREVIEW_FLOW_GRAPH_PROFILER
+
+namespace internal {
+
+static inline void profile_node( void *, tbb::internal::string_index, void * ) {}
+static inline void profile_port( void *, void *, void * ) {}
+
+template< int N, typename PortsTuple >
+void profile_input_ports( void *, void *, PortsTuple & ) {}
+
+template< int N, typename PortsTuple >
+void profile_output_ports( void *, void *, PortsTuple & ) {}
+
+template< typename Node >
+void profile_node_desc( const Node *, const void *, const char * ) {}
+
+template< typename Sender, typename Receiver >
+void profile_make_edge( Sender &, Receiver & ) {}
+
+class profile_body_scope : tbb::internal::no_copy {
+public:
+    profile_body_scope( graph &, const void * ) {}
+};
+
+static inline void profile_enqueued( graph &, const void *, size_t ) {}
+static inline void profile_queue_length( graph &, const void *, size_t ) {}
+
+template< typename Receiver >
+void profile_transfer( const Receiver &, const void *, size_t, size_t ) {}
+
+template< typename Receiver >
+void profile_reservation( const Receiver & ) {}
+
+} // namespace internal
+
+#endif // __TBB_PREVIEW_FLOW_GRAPH_PROFILER
+
+} // namespace interface11
+} // namespace flow
+} // namespace tbb
+
+#endif // __TBB__flow_graph_profiler_impl_H
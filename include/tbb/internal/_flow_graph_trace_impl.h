@@ -167,18 +167,21 @@ template< typename NodeType >
 void fgt_multioutput_node_desc( const NodeType *node, const char *desc ) {
     void *addr =  (void *)( static_cast< tbb::flow::receiver< typename NodeType::input_type > * >(const_cast< NodeType *>(node)) );
     itt_metadata_str_add( ITT_DOMAIN_FLOW, addr, FLOW_NODE, FLOW_OBJECT_NAME, desc );
+    tbb::flow::interface11::internal::profile_node_desc( node, addr, desc );
 }
 
 template< typename NodeType >
 void fgt_multiinput_multioutput_node_desc( const NodeType *node, const char *desc ) {
     void *addr =  const_cast<NodeType *>(node);
     itt_metadata_str_add( ITT_DOMAIN_FLOW, addr, FLOW_NODE, FLOW_OBJECT_NAME, desc );
+    tbb::flow::interface11::internal::profile_node_desc( node, addr, desc );
 }
 
 template< typename NodeType >
 static inline void fgt_node_desc( const NodeType *node, const char *desc ) {
     void *addr =  (void *)( static_cast< tbb::flow::sender< typename NodeType::output_type > * >(const_cast< NodeType *>(node)) );
     itt_metadata_str_add( ITT_DOMAIN_FLOW, addr, FLOW_NODE, FLOW_OBJECT_NAME, desc );
+    tbb::flow::interface11::internal::profile_node_desc( node, addr, desc );
 }
 
 static inline void fgt_graph_desc( void *g, const char *desc ) {
@@ -194,6 +197,8 @@ static inline void fgt_multioutput_node(void* codeptr, string_index t, void *g,
     itt_make_task_group( ITT_DOMAIN_FLOW, input_port, FLOW_NODE, g, FLOW_GRAPH, t );
     fgt_internal_create_input_port( input_port, input_port, FLOW_INPUT_PORT_0 );
     fgt_internal_output_helper<PortsTuple, N>::register_port(codeptr, input_port, ports );
+    tbb::flow::interface11::internal::profile_node( g, t, input_port );
+    tbb::flow::interface11::internal::profile_output_ports<N>( g, input_port, ports );
 }
 
 template< int N, typename PortsTuple >
@@ -202,6 +207,8 @@ static inline void fgt_multioutput_node_with_body( void* codeptr, string_index t
     fgt_internal_create_input_port( input_port, input_port, FLOW_INPUT_PORT_0 );
     fgt_internal_output_helper<PortsTuple, N>::register_port( codeptr, input_port, ports );
     fgt_body( input_port, body );
+    tbb::flow::interface11::internal::profile_node( g, t, input_port );
+    tbb::flow::interface11::internal::profile_output_ports<N>( g, input_port, ports );
 }
 
 template< int N, typename PortsTuple >
@@ -209,10 +216,13 @@ static inline void fgt_multiinput_node( void* codeptr, string_index t, void *g,
     itt_make_task_group( ITT_DOMAIN_FLOW, output_port, FLOW_NODE, g, FLOW_GRAPH, t );
     fgt_internal_create_output_port( codeptr, output_port, output_port, FLOW_OUTPUT_PORT_0 );
     fgt_internal_input_helper<PortsTuple, N>::register_port( output_port, ports );
+    tbb::flow::interface11::internal::profile_node( g, t, output_port );
+    tbb::flow::interface11::internal::profile_input_ports<N>( g, output_port, ports );
 }
 
 static inline void fgt_multiinput_multioutput_node( void* codeptr, string_index t, void *n, void *g ) {
     itt_make_task_group( ITT_DOMAIN_FLOW, n, FLOW_NODE, g, FLOW_GRAPH, t );
+    tbb::flow::interface11::internal::profile_node( g, t, n );
     suppress_unused_warning( codeptr );
 #if TBB_PREVIEW_FLOW_GRAPH_TRACE
     if (codeptr != NULL) {
@@ -224,28 +234,33 @@ static inline void fgt_multiinput_multioutput_node( void* codeptr, string_index
 static inline void fgt_node( void* codeptr, string_index t, void *g, void *output_port ) {
     itt_make_task_group( ITT_DOMAIN_FLOW, output_port, FLOW_NODE, g, FLOW_GRAPH, t );
     fgt_internal_create_output_port( codeptr, output_port, output_port, FLOW_OUTPUT_PORT_0 );
+    tbb::flow::interface11::internal::profile_node( g, t, output_port );
 }
 
 static void fgt_node_with_body( void* codeptr, string_index t, void *g, void *output_port, void *body ) {
     itt_make_task_group( ITT_DOMAIN_FLOW, output_port, FLOW_NODE, g, FLOW_GRAPH, t );
     fgt_internal_create_output_port(codeptr, output_port, output_port, FLOW_OUTPUT_PORT_0 );
     fgt_body( output_port, body );
+    tbb::flow::interface11::internal::profile_node( g, t, output_port );
 }
 
 static inline void fgt_node( void* codeptr, string_index t, void *g, void *input_port, void *output_port ) {
     fgt_node( codeptr, t, g, output_port );
     fgt_internal_create_input_port( output_port, input_port, FLOW_INPUT_PORT_0 );
+    tbb::flow::interface11::internal::profile_port( g, output_port, input_port );
 }
 
 static inline void  fgt_node_with_body( void* codeptr, string_index t, void *g, void *input_port, void *output_port, void *body ) {
     fgt_node_with_body( codeptr, t, g, output_port, body );
     fgt_internal_create_input_port( output_port, input_port, FLOW_INPUT_PORT_0 );
+    tbb::flow::interface11::internal::profile_port( g, output_port, input_port );
 }
 
 
 static inline void  fgt_node( void* codeptr, string_index t, void *g, void *input_port, void *decrement_port, void *output_port ) {
     fgt_node( codeptr, t, g, input_port, output_port );
     fgt_internal_create_input_port( output_port, decrement_port, FLOW_INPUT_PORT_1 );
+    tbb::flow::interface11::internal::profile_port( g, output_port, decrement_port );
 }
 
 static inline void fgt_make_edge( void *output_port, void *input_port ) {
@@ -303,32 +318,60 @@ static inline void fgt_composite ( void* /*codeptr*/, void * /*node*/, void * /*
 static inline void fgt_graph( void * /*g*/ ) { }
 
 template< typename NodeType >
-static inline void fgt_multioutput_node_desc( const NodeType * /*node*/, const char * /*desc*/ ) { }
+static inline void fgt_multioutput_node_desc( const NodeType *node, const char *desc ) {
+    void *addr =  (void *)( static_cast< tbb::flow::receiver< typename NodeType::input_type > * >(const_cast< NodeType *>(node)) );
+    tbb::flow::interface11::internal::profile_node_desc( node, addr, desc );
+}
 
 template< typename NodeType >
-static inline void fgt_node_desc( const NodeType * /*node*/, const char * /*desc*/ ) { }
+static inline void fgt_node_desc( const NodeType *node, const char *desc ) {
+    void *addr =  (void *)( static_cast< tbb::flow::sender< typename NodeType::output_type > * >(const_cast< NodeType *>(node)) );
+    tbb::flow::interface11::internal::profile_node_desc( node, addr, desc );
+}
 
 static inline void fgt_graph_desc( void * /*g*/, const char * /*desc*/ ) { }
 
 static inline void fgt_body( void * /*node*/, void * /*body*/ ) { }
 
 template< int N, typename PortsTuple >
-static inline void fgt_multioutput_node( void* /*codeptr*/, string_index /*t*/, void * /*g*/, void * /*input_port*/, PortsTuple & /*ports*/ ) { }
+static inline void fgt_multioutput_node( void* /*codeptr*/, string_index t, void *g, void *input_port, PortsTuple &ports ) {
+    tbb::flow::interface11::internal::profile_node( g, t, input_port );
+    tbb::flow::interface11::internal::profile_output_ports<N>( g, input_port, ports );
+}
 
 template< int N, typename PortsTuple >
-static inline void fgt_multioutput_node_with_body( void* /*codeptr*/, string_index /*t*/, void * /*g*/, void * /*input_port*/, PortsTuple & /*ports*/, void * /*body*/ ) { }
+static inline void fgt_multioutput_node_with_body( void* codeptr, string_index t, void *g, void *input_port, PortsTuple &ports, void * /*body*/ ) {
+    fgt_multioutput_node<N>( codeptr, t, g, input_port, ports );
+}
 
 template< int N, typename PortsTuple >
-static inline void fgt_multiinput_node( void* /*codeptr*/, string_index /*t*/, void * /*g*/, PortsTuple & /*ports*/, void * /*output_port*/ ) { }
+static inline void fgt_multiinput_node( void* /*codeptr*/, string_index t, void *g, PortsTuple &ports, void *output_port ) {
+    tbb::flow::interface11::internal::profile_node( g, t, output_port );
+    tbb::flow::interface11::internal::profile_input_ports<N>( g, output_port, ports );
+}
 
-static inline void fgt_multiinput_multioutput_node( void* /*codeptr*/, string_index /*t*/, void * /*node*/, void * /*graph*/ ) { }
+static inline void fgt_multiinput_multioutput_node( void* /*codeptr*/, string_index t, void *node, void *graph ) {
+    tbb::flow::interface11::internal::profile_node( graph, t, node );
+}
 
-static inline void fgt_node( void* /*codeptr*/, string_index /*t*/, void * /*g*/, void * /*output_port*/ ) { }
-static inline void fgt_node( void* /*codeptr*/, string_index /*t*/, void * /*g*/, void * /*input_port*/, void * /*output_port*/ ) { }
-static inline void  fgt_node( void* /*codeptr*/, string_index /*t*/, void * /*g*/, void * /*input_port*/, void * /*decrement_port*/, void * /*output_port*/ ) { }
+static inline void fgt_node( void* /*codeptr*/, string_index t, void *g, void *output_port ) {
+    tbb::flow::interface11::internal::profile_node( g, t, output_port );
+}
+static inline void fgt_node( void* codeptr, string_index t, void *g, void *input_port, void *output_port ) {
+    fgt_node( codeptr, t, g, output_port );
+    tbb::flow::interface11::internal::profile_port( g, output_port, input_port );
+}
+static inline void  fgt_node( void* codeptr, string_index t, void *g, void *input_port, void *decrement_port, void *output_port ) {
+    fgt_node( codeptr, t, g, input_port, output_port );
+    tbb::flow::interface11::internal::profile_port( g, output_port, decrement_port );
+}
 
-static inline void fgt_node_with_body( void* /*codeptr*/, string_index /*t*/, void * /*g*/, void * /*output_port*/, void * /*body*/ ) { }
-static inline void fgt_node_with_body( void* /*codeptr*/, string_index /*t*/, void * /*g*/, void * /*input_port*/, void * /*output_port*/, void * /*body*/ ) { }
+static inline void fgt_node_with_body( void* codeptr, string_index t, void *g, void *output_port, void * /*body*/ ) {
+    fgt_node( codeptr, t, g, output_port );
+}
+static inline void fgt_node_with_body( void* codeptr, string_index t, void *g, void *input_port, void *output_port, void * /*body*/ ) {
+    fgt_node( codeptr, t, g, input_port, output_port );
+}
 
 static inline void fgt_make_edge( void * /*output_port*/, void * /*input_port*/ ) { }
 static inline void fgt_remove_edge( void * /*output_port*/, void * /*input_port*/ ) { }
@@ -344,7 +387,9 @@ static inline void fgt_reserve_wait( void * /*graph*/ ) { }
 static inline void fgt_release_wait( void * /*graph*/ ) { }
 
 template< typename NodeType >
-void fgt_multiinput_multioutput_node_desc( const NodeType * /*node*/, const char * /*desc*/ ) { }
+void fgt_multiinput_multioutput_node_desc( const NodeType *node, const char *desc ) {
+    tbb::flow::interface11::internal::profile_node_desc( node, node, desc );
+}
 
 template < typename PortsTuple, int N >
 struct fgt_internal_input_alias_helper {
@@ -199,7 +199,7 @@ public:
     //! Task type used to combine the partial results of parallel_deterministic_reduce.
     /** @ingroup algorithms */
     template<typename Body>
-    class finish_deterministic_reduce: public task {
+    class finish_deterministic_reduce: public flag_task {
         Body &my_left_body;
         Body my_right_body;
 
@@ -241,6 +241,61 @@ public:
             my_partition( parent_.my_partition, split_obj )
         {
         }
+        //! Construct right child from the given range as response to the demand.
+        /** parent_ remains left child.  Newly constructed object is right child. */
+        start_deterministic_reduce( start_deterministic_reduce& parent_, finish_type& c, const Range& r, depth_t d ) :
+            my_body( c.my_right_body ),
+            my_range( r ),
+            my_partition( parent_.my_partition, split() )
+        {
+            my_partition.align_depth( d );
+        }
+        //! Reduce the range into the fresh body as the simple partitioner would do.
+        /** The range is split until it is not divisible, every right part is reduced by
+            a new body, and the bodies are joined in the order of the splits. */
+        static void run_serial( Range& range, Body& body ) {
+            if( range.is_divisible() ) {
+                Range right( range, split() );
+                run_serial( range, body );
+                Body right_body( body, split() );
+                run_serial( right, right_body );
+                body.join( right_body );
+            } else
+                body( range );
+        }
+        template<typename Partition>
+        void execute_partition( Partition& partition ) { partition.execute(*this, my_range); }
+        //! Adaptive partitioning that preserves the reduction tree of the simple partitioner.
+        /** The tasks are created while the auto partitioner asks for them, but the parts are
+            the same halves that the simple partitioner produces, and the parts that are
+            processed serially are reduced by run_serial(). So the result does not depend
+            on the number of threads or on stealing. Only the outermost right part of the
+            range pool is offered on demand, because its result is joined by the parent. */
+        void execute_partition( auto_partition_type& partition ) {
+            partition.check_being_stolen( *this );
+            typename Partitioner::split_type split_obj = split();
+            while( my_range.is_divisible() && partition.is_divisible() )
+                offer_work( split_obj );
+            if( !my_range.is_divisible() || !partition.max_depth() ) {
+                run_serial( my_range, my_body );
+                return;
+            }
+            range_vector<Range, auto_partition_type::range_pool_size> range_pool( my_range );
+            range_pool.split_to_fill( partition.max_depth() );
+            run_serial( range_pool.back(), my_body );
+            range_pool.pop_back();
+            while( !range_pool.empty() && !is_cancelled() ) {
+                if( partition.check_for_demand( *this ) ) {
+                    offer_work( range_pool.front(), range_pool.front_depth() );
+                    range_pool.pop_front();
+                } else {
+                    Body right_body( my_body, split() );
+                    run_serial( range_pool.back(), right_body );
+                    my_body.join( right_body );
+                    range_pool.pop_back();
+                }
+            }
+        }
 
 public:
         static void run( const Range& range, Body& body, Partitioner& partitioner ) {
@@ -269,13 +324,21 @@ public:
             new((void*)tasks[1]) start_deterministic_reduce(*this, *static_cast<finish_type*>(tasks[0]), split_obj);
             spawn(*tasks[1]);
         }
+        //! spawn right task, serves as callback for the adaptive partitioning
+        void offer_work( const Range& r, depth_t d ) {
+            task* tasks[2];
+            allocate_sibling(static_cast<task*>(this), tasks, sizeof(start_deterministic_reduce), sizeof(finish_type));
+            new((void*)tasks[0]) finish_type(my_body);
+            new((void*)tasks[1]) start_deterministic_reduce(*this, *static_cast<finish_type*>(tasks[0]), r, d);
+            spawn(*tasks[1]);
+        }
 
         void run_body( Range &r ) { my_body(r); }
     };
 
     template<typename Range, typename Body, typename Partitioner>
     task* start_deterministic_reduce<Range,Body, Partitioner>::execute() {
-        my_partition.execute(*this, my_range);
+        execute_partition( my_partition );
         return NULL;
     }
 } // namespace internal
@@ -563,6 +626,15 @@ void parallel_deterministic_reduce( const Range& range, Body& body, const static
     internal::start_deterministic_reduce<Range, Body, const static_partitioner>::run(range, body, partitioner);
 }
 
+//! Parallel iteration with deterministic reduction and auto partitioner.
+/** The work is balanced adaptively, but the range is split and the results are joined
+    exactly as with simple partitioner, so the result does not depend on the number of threads.
+    @ingroup algorithms **/
+template<typename Range, typename Body>
+void parallel_deterministic_reduce( const Range& range, Body& body, const auto_partitioner& partitioner ) {
+    internal::start_deterministic_reduce<Range, Body, const auto_partitioner>::run(range, body, partitioner);
+}
+
 #if __TBB_TASK_GROUP_CONTEXT
 //! Parallel iteration with deterministic reduction, default simple partitioner and user-supplied context.
 /** @ingroup algorithms **/
@@ -584,6 +656,13 @@ template<typename Range, typename Body>
 void parallel_deterministic_reduce( const Range& range, Body& body, const static_partitioner& partitioner, task_group_context& context ) {
     internal::start_deterministic_reduce<Range, Body, const static_partitioner>::run(range, body, partitioner, context);
 }
+
+//! Parallel iteration with deterministic reduction, auto partitioner and user-supplied context.
+/** @ingroup algorithms **/
+template<typename Range, typename Body>
+void parallel_deterministic_reduce( const Range& range, Body& body, const auto_partitioner& partitioner, task_group_context& context ) {
+    internal::start_deterministic_reduce<Range, Body, const auto_partitioner>::run(range, body, partitioner, context);
+}
 #endif /* __TBB_TASK_GROUP_CONTEXT */
 
 /** parallel_reduce overloads that work with anonymous function objects
@@ -616,6 +695,16 @@ Value parallel_deterministic_reduce( const Range& range, const Value& identity,
         ::run(range, body, partitioner);
     return body.result();
 }
+
+//! Parallel iteration with deterministic reduction and auto partitioner.
+/** @ingroup algorithms **/
+template<typename Range, typename Value, typename RealBody, typename Reduction>
+Value parallel_deterministic_reduce( const Range& range, const Value& identity, const RealBody& real_body, const Reduction& reduction, const auto_partitioner& partitioner ) {
+    internal::lambda_reduce_body<Range, Value, RealBody, Reduction> body(identity, real_body, reduction);
+    internal::start_deterministic_reduce<Range, internal::lambda_reduce_body<Range, Value, RealBody, Reduction>, const auto_partitioner>
+        ::run(range, body, partitioner);
+    return body.result();
+}
 #if __TBB_TASK_GROUP_CONTEXT
 //! Parallel iteration with deterministic reduction, default simple partitioner and user-supplied context.
 /** @ingroup algorithms **/
@@ -646,6 +735,17 @@ Value parallel_deterministic_reduce( const Range& range, const Value& identity,
         ::run(range, body, partitioner, context);
     return body.result();
 }
+
+//! Parallel iteration with deterministic reduction, auto partitioner and user-supplied context.
+/** @ingroup algorithms **/
+template<typename Range, typename Value, typename RealBody, typename Reduction>
+Value parallel_deterministic_reduce( const Range& range, const Value& identity, const RealBody& real_body, const Reduction& reduction,
+    const auto_partitioner& partitioner, task_group_context& context ) {
+    internal::lambda_reduce_body<Range, Value, RealBody, Reduction> body(identity, real_body, reduction);
+    internal::start_deterministic_reduce<Range, internal::lambda_reduce_body<Range, Value, RealBody, Reduction>, const auto_partitioner>
+        ::run(range, body, partitioner, context);
+    return body.result();
+}
 #endif /* __TBB_TASK_GROUP_CONTEXT */
 //@}
 
@@ -24,6 +24,13 @@
 #include "aligned_space.h"
 #include <new>
 #include "partitioner.h"
+#include "parallel_for.h"
+#include "blocked_range.h"
+#include "tbb_allocator.h"
+#include "task_arena.h"
+#include <iterator>
+#include <functional>
+#include <limits>
 
 namespace tbb {
 
@@ -334,6 +341,181 @@ namespace internal {
             return my_sum;
         }
     };
+
+    //! Number of the elements in a block of parallel_inclusive_scan and parallel_exclusive_scan
+    const size_t scan_block_size = 1<<14;
+
+    template<typename InputIterator, typename T, typename BinaryOp>
+    T serial_reduce( InputIterator first, InputIterator last, T sum, const BinaryOp& op ) {
+        for( ; first != last; ++first )
+            sum = op( sum, *first );
+        return sum;
+    }
+
+    //! Operations on a block of the scan that use the binary operation in the order of the elements
+    template<typename InputIterator, typename T, typename BinaryOp>
+    struct scan_block_ops {
+        static T reduce( InputIterator first, InputIterator last, T sum, const BinaryOp& op ) {
+            return serial_reduce( first, last, sum, op );
+        }
+    };
+
+    //! Operations on a block of the scan of arithmetic types with std::plus
+    /** The block is reduced into several independent sums, so that the compiler can vectorize the loop.
+        Other types are reduced in the order of the elements, so they need nothing but operator+. */
+    template<typename InputIterator, typename T>
+    struct scan_block_ops<InputIterator, T, std::plus<T> > {
+        static T reduce( InputIterator first, InputIterator last, T sum, const std::plus<T>& op ) {
+            return reduce( first, last, sum, op, bool_constant<std::numeric_limits<T>::is_specialized>() );
+        }
+    private:
+        static T reduce( InputIterator first, InputIterator last, T sum, const std::plus<T>& op, true_type ) {
+            const int lanes = 8;
+            T s[lanes];
+            for( int k = 0; k < lanes; ++k )
+                s[k] = T();
+            for( ; last-first >= lanes; first += lanes )
+                for( int k = 0; k < lanes; ++k )
+                    s[k] += first[k];
+            for( int k = 0; k < lanes; ++k )
+                sum += s[k];
+            return serial_reduce( first, last, sum, op );
+        }
+        static T reduce( InputIterator first, InputIterator last, T sum, const std::plus<T>& op, false_type ) {
+            return serial_reduce( first, last, sum, op );
+        }
+    };
+
+    //! Three-phase scan of [first,last) into result by the blocks of scan_block_size elements
+    /** The first phase reduces the blocks except the last one in parallel, the second one scans
+        the sums of the blocks serially, and the third one scans the blocks in parallel starting
+        with the sums of the preceding blocks. The parallel phases use the same affinity_partitioner,
+        so that a block is processed by the same thread in both. */
+    template<typename InputIterator, typename OutputIterator, typename T, typename BinaryOp>
+    class block_scan : no_assign {
+        typedef scan_block_ops<InputIterator, T, BinaryOp> ops;
+
+        const InputIterator my_first;
+        const OutputIterator my_result;
+        const size_t my_size;
+        const size_t my_num_blocks;
+        const BinaryOp& my_op;
+        //! The initial value, or NULL for an inclusive scan without it
+        const T* const my_init;
+        const bool my_exclusive;
+        //! Sums of the blocks in the first phase, and sums of the preceding blocks in the third one
+        T* my_sums;
+
+        size_t block_begin( size_t b ) const { return b*my_size/my_num_blocks; }
+
+        //! Scans the elements [i,j); the scan starts with sum, or with the first element if sum is NULL
+        void scan_elements( size_t i, size_t j, const T* sum ) const {
+            InputIterator first = my_first + i;
+            InputIterator last = my_first + j;
+            OutputIterator out = my_result + i;
+            if( !sum ) {
+                T acc( *first );
+                *out = acc;
+                for( ++first, ++out; first != last; ++first, ++out ) {
+                    acc = my_op( acc, *first );
+                    *out = acc;
+                }
+            } else if( my_exclusive ) {
+                T acc( *sum );
+                for( ; first != last; ++first, ++out ) {
+                    // The input is read before the output is written, so that they can be the same
+                    T next = my_op( acc, *first );
+                    *out = acc;
+                    acc = next;
+                }
+            } else {
+                T acc( *sum );
+                for( ; first != last; ++first, ++out ) {
+                    acc = my_op( acc, *first );
+                    *out = acc;
+                }
+            }
+        }
+
+    public:
+        block_scan( InputIterator first, InputIterator last, OutputIterator result, const BinaryOp& op, const T* init, bool exclusive )
+            : my_first(first), my_result(result), my_size(last-first),
+              my_num_blocks( (my_size+scan_block_size-1)/scan_block_size ),
+              my_op(op), my_init(init), my_exclusive(exclusive), my_sums(NULL) {}
+
+        //! The first phase
+        class reduce_body : no_assign {
+            const block_scan& my_scan;
+        public:
+            reduce_body( const block_scan& s ) : my_scan(s) {}
+            void operator()( const blocked_range<size_t>& r ) const {
+                // The last block is not reduced
+                const size_t e = r.end() < my_scan.my_num_blocks ? r.end() : my_scan.my_num_blocks-1;
+                for( size_t b = r.begin(); b < e; ++b ) {
+                    InputIterator first = my_scan.my_first + my_scan.block_begin( b );
+                    InputIterator last = my_scan.my_first + my_scan.block_begin( b+1 );
+                    T head( *first );
+                    new( my_scan.my_sums + b ) T( ops::reduce( ++first, last, head, my_scan.my_op ) );
+                }
+            }
+        };
+
+        //! The third phase
+        class scan_body : no_assign {
+            const block_scan& my_scan;
+        public:
+            scan_body( const block_scan& s ) : my_scan(s) {}
+            void operator()( const blocked_range<size_t>& r ) const {
+                for( size_t b = r.begin(); b != r.end(); ++b )
+                    my_scan.scan_elements( my_scan.block_begin( b ), my_scan.block_begin( b+1 ),
+                                           b || my_scan.my_init ? my_scan.my_sums + b : NULL );
+            }
+        };
+
+        OutputIterator run() {
+            // The serial scan reads the data once, while the parallel one reads them twice
+            if( my_num_blocks <= 1 || this_task_arena::max_concurrency() == 1 ) {
+                if( my_size )
+                    scan_elements( 0, my_size, my_init );
+                return my_result + my_size;
+            }
+            tbb_allocator<T> allocator;
+            my_sums = allocator.allocate( my_num_blocks );
+            affinity_partitioner partitioner;
+            // The both phases process the same range, so that the partitioner maps the blocks to the same threads
+            const blocked_range<size_t> blocks( 0, my_num_blocks );
+            parallel_for( blocks, reduce_body( *this ), partitioner );
+            // The place of the last block keeps the sum of the preceding blocks
+            // Turn the sums of the blocks into the sums of the preceding blocks with the initial value
+            T* sums = my_sums;
+            size_t b = 0;
+            if( !my_init ) {
+                // Block 0 starts with its first element
+                new( sums + my_num_blocks-1 ) T( sums[0] );
+                ++b;
+            } else {
+                new( sums + my_num_blocks-1 ) T( *my_init );
+            }
+            T acc( sums[my_num_blocks-1] );
+            for( ; b < my_num_blocks-1; ++b ) {
+                T next = my_op( acc, sums[b] );
+                sums[b] = acc;
+                acc = next;
+            }
+            sums[my_num_blocks-1] = acc;
+            parallel_for( blocks, scan_body( *this ), partitioner );
+            for( b = 0; b < my_num_blocks; ++b )
+                sums[b].~T();
+            allocator.deallocate( my_sums, my_num_blocks );
+            return my_result + my_size;
+        }
+    };
+
+    template<typename InputIterator, typename OutputIterator, typename T, typename BinaryOp>
+    OutputIterator parallel_block_scan( InputIterator first, InputIterator last, OutputIterator result,
+                                        const BinaryOp& op, const T* init, bool exclusive ) {
+        return block_scan<InputIterator, OutputIterator, T, BinaryOp>( first, last, result, op, init, exclusive ).run();
+    }
 } // namespace internal
 //! @endcond
 
@@ -407,6 +589,53 @@ Value parallel_scan( const Range& range, const Value& identity, const Scan& scan
 
 //@}
 
+/** \name parallel_inclusive_scan and parallel_exclusive_scan
+    The prefix sums of a sequence with the same results as std::inclusive_scan and std::exclusive_scan.
+    The binary operation must be associative. The iterators must be random access. The output may
+    be the same as the input. Unlike parallel_scan, the sequence is processed in two parallel passes
+    over the fixed blocks of the data: the first reduces the blocks, and the second scans them.
+    For std::plus of arithmetic types, the reduction of a block is vectorizable. **/
+//@{
+
+//! Computes the inclusive prefix sums of [first,last) with op, starting with init, into result
+/** Returns the end of the output.
+    @ingroup algorithms **/
+template<typename InputIterator, typename OutputIterator, typename BinaryOp, typename T>
+OutputIterator parallel_inclusive_scan( InputIterator first, InputIterator last, OutputIterator result, BinaryOp op, T init ) {
+    return internal::parallel_block_scan( first, last, result, op, &init, false );
+}
+
+//! Computes the inclusive prefix sums of [first,last) with op into result
+/** @ingroup algorithms **/
+template<typename InputIterator, typename OutputIterator, typename BinaryOp>
+OutputIterator parallel_inclusive_scan( InputIterator first, InputIterator last, OutputIterator result, BinaryOp op ) {
+    typedef typename std::iterator_traits<InputIterator>::value_type value_type;
+    return internal::parallel_block_scan( first, last, result, op, static_cast<const value_type*>(NULL), false );
+}
+
+//! Computes the inclusive prefix sums of [first,last) into result
+/** @ingroup algorithms **/
+template<typename InputIterator, typename OutputIterator>
+OutputIterator parallel_inclusive_scan( InputIterator first, InputIterator last, OutputIterator result ) {
+    typedef typename std::iterator_traits<InputIterator>::value_type value_type;
+    return parallel_inclusive_scan( first, last, result, std::plus<value_type>() );
+}
+
+//! Computes the exclusive prefix sums of [first,last) with op, starting with init, into result
+/** @ingroup algorithms **/
+template<typename InputIterator, typename OutputIterator, typename T, typename BinaryOp>
+OutputIterator parallel_exclusive_scan( InputIterator first, InputIterator last, OutputIterator result, T init, BinaryOp op ) {
+    return internal::parallel_block_scan( first, last, result, op, &init, true );
+}
+
+//! Computes the exclusive prefix sums of [first,last), starting with init, into result
+/** @ingroup algorithms **/
+template<typename InputIterator, typename OutputIterator, typename T>
+OutputIterator parallel_exclusive_scan( InputIterator first, InputIterator last, OutputIterator result, T init ) {
+    return parallel_exclusive_scan( first, last, result, init, std::plus<T>() );
+}
+//@}
+
 } // namespace tbb
 
 #include "internal/_warning_suppress_disable_notice.h"
@@ -21,11 +21,20 @@
 #include "internal/_warning_suppress_enable_notice.h"
 
 #include "parallel_for.h"
+#include "parallel_invoke.h"
 #include "blocked_range.h"
+#include "aligned_space.h"
+#include "tbb_allocator.h"
+#include "task_arena.h"
 #include "internal/_range_iterator.h"
 #include <algorithm>
 #include <iterator>
 #include <functional>
+#include <cstring>
+#include <new>
+#if __TBB_CPP11_DECLTYPE_PRESENT || __TBB_CPP11_TYPE_PROPERTIES_PRESENT
+    #include <type_traits>
+#endif
 #if __TBB_TASK_GROUP_CONTEXT
     #include "tbb_profiling.h"
 #endif
@@ -185,6 +194,396 @@ do_parallel_quick_sort:
                       auto_partitioner() );
 }
 
+//! Size of the subsequences that parallel_stable_sort sorts with std::stable_sort
+const size_t stable_sort_grainsize = 500;
+
+//! Size of the merged subsequences that parallel_stable_sort merges serially
+const size_t merge_grainsize = 2000;
+
+//! Destroys the elements of the buffer of parallel_stable_sort
+template<typename T>
+void destroy_range( T* first, T* last ) {
+    for( ; first != last; ++first )
+        first->~T();
+}
+
+//! Moves [first,last) into the uninitialized memory at dst
+template<typename RandomAccessIterator, typename T>
+void uninitialized_move( RandomAccessIterator first, RandomAccessIterator last, T* dst ) {
+    for( ; first != last; ++first, ++dst )
+        new( dst ) T( tbb::internal::move( *first ) );
+}
+
+//! Merges the sorted sequences [xs,xe) and [ys,ye) into zs by moving the elements
+/** The elements of x precede the equal elements of y. If destroy is true, the elements of x
+    and y are destroyed after the move; in that case they are in the buffer. */
+template<typename RandomAccessIterator1, typename RandomAccessIterator2, typename Compare>
+void serial_move_merge( RandomAccessIterator1 xs, RandomAccessIterator1 xe, RandomAccessIterator1 ys, RandomAccessIterator1 ye,
+                        RandomAccessIterator2 zs, bool destroy, const Compare& comp ) {
+    RandomAccessIterator1 x = xs, y = ys;
+    if( x != xe && y != ye ) {
+        for(;;) {
+            if( comp( *y, *x ) ) {
+                *zs = tbb::internal::move( *y );
+                ++zs;
+                if( ++y == ye ) break;
+            } else {
+                *zs = tbb::internal::move( *x );
+                ++zs;
+                if( ++x == xe ) break;
+            }
+        }
+    }
+    for( ; x != xe; ++x, ++zs )
+        *zs = tbb::internal::move( *x );
+    for( ; y != ye; ++y, ++zs )
+        *zs = tbb::internal::move( *y );
+    if( destroy ) {
+        destroy_range( &*xs, &*xs + (xe-xs) );
+        destroy_range( &*ys, &*ys + (ye-ys) );
+    }
+}
+
+template<typename RandomAccessIterator1, typename RandomAccessIterator2, typename Compare>
+void parallel_move_merge( RandomAccessIterator1 xs, RandomAccessIterator1 xe, RandomAccessIterator1 ys, RandomAccessIterator1 ye,
+                          RandomAccessIterator2 zs, bool destroy, const Compare& comp );
+
+//! Body of parallel_invoke that merges a part of the sequences
+template<typename RandomAccessIterator1, typename RandomAccessIterator2, typename Compare>
+class parallel_merge_body : no_assign {
+    const RandomAccessIterator1 xs, xe, ys, ye;
+    const RandomAccessIterator2 zs;
+    const bool destroy;
+    const Compare& comp;
+public:
+    parallel_merge_body( RandomAccessIterator1 xs_, RandomAccessIterator1 xe_, RandomAccessIterator1 ys_, RandomAccessIterator1 ye_,
+                         RandomAccessIterator2 zs_, bool destroy_, const Compare& comp_ )
+        : xs(xs_), xe(xe_), ys(ys_), ye(ye_), zs(zs_), destroy(destroy_), comp(comp_) {}
+    void operator()() const { parallel_move_merge( xs, xe, ys, ye, zs, destroy, comp ); }
+};
+
+//! Merges the sequences as serial_move_merge in parallel
+/** The longer sequence is split in the middle, and the shorter one is split by a binary search
+    for the middle element, so that the both parts can be merged independently. */
+template<typename RandomAccessIterator1, typename RandomAccessIterator2, typename Compare>
+void parallel_move_merge( RandomAccessIterator1 xs, RandomAccessIterator1 xe, RandomAccessIterator1 ys, RandomAccessIterator1 ye,
+                          RandomAccessIterator2 zs, bool destroy, const Compare& comp ) {
+    if( size_t( (xe-xs) + (ye-ys) ) <= merge_grainsize ) {
+        serial_move_merge( xs, xe, ys, ye, zs, destroy, comp );
+        return;
+    }
+    RandomAccessIterator1 xm, ym;
+    if( xe-xs < ye-ys ) {
+        ym = ys + (ye-ys)/2;
+        xm = std::upper_bound( xs, xe, *ym, comp );
+    } else {
+        xm = xs + (xe-xs)/2;
+        ym = std::lower_bound( ys, ye, *xm, comp );
+    }
+    RandomAccessIterator2 zm = zs + ((xm-xs) + (ym-ys));
+    typedef parallel_merge_body<RandomAccessIterator1, RandomAccessIterator2, Compare> body_type;
+    parallel_invoke( body_type( xs, xm, ys, ym, zs, destroy, comp ), body_type( xm, xe, ym, ye, zm, destroy, comp ) );
+}
+
+//! Sorts [xs,xe) stably with the buffer zs of the same size
+/** The result goes to zs if inplace is 0, and to xs otherwise. The buffer holds the elements after
+    the call unless inplace is 2; it is uninitialized before the call unless inplace is 2. */
+template<typename RandomAccessIterator, typename T, typename Compare>
+void parallel_stable_sort_aux( RandomAccessIterator xs, RandomAccessIterator xe, T* zs, int inplace, const Compare& comp );
+
+template<typename RandomAccessIterator, typename T, typename Compare>
+class parallel_stable_sort_body : no_assign {
+    const RandomAccessIterator xs, xe;
+    T* const zs;
+    const int inplace;
+    const Compare& comp;
+public:
+    parallel_stable_sort_body( RandomAccessIterator xs_, RandomAccessIterator xe_, T* zs_, int inplace_, const Compare& comp_ )
+        : xs(xs_), xe(xe_), zs(zs_), inplace(inplace_), comp(comp_) {}
+    void operator()() const { parallel_stable_sort_aux( xs, xe, zs, inplace, comp ); }
+};
+
+template<typename RandomAccessIterator, typename T, typename Compare>
+void parallel_stable_sort_aux( RandomAccessIterator xs, RandomAccessIterator xe, T* zs, int inplace, const Compare& comp ) {
+    if( size_t(xe-xs) <= stable_sort_grainsize ) {
+        T* ze = zs + (xe-xs);
+        if( inplace == 2 ) {
+            std::stable_sort( xs, xe, comp );
+        } else if( inplace == 0 ) {
+            std::stable_sort( xs, xe, comp );
+            uninitialized_move( xs, xe, zs );
+        } else {
+            // The buffer must hold the elements after the call, so the sort goes through it
+            uninitialized_move( xs, xe, zs );
+            std::stable_sort( zs, ze, comp );
+            for( T* z = zs; z != ze; ++z, ++xs )
+                *xs = tbb::internal::move( *z );
+        }
+        return;
+    }
+    RandomAccessIterator xm = xs + (xe-xs)/2;
+    T* zm = zs + (xm-xs);
+    T* ze = zs + (xe-xs);
+    typedef parallel_stable_sort_body<RandomAccessIterator, T, Compare> body_type;
+    parallel_invoke( body_type( xs, xm, zs, !inplace, comp ), body_type( xm, xe, zm, !inplace, comp ) );
+    if( inplace )
+        parallel_move_merge( zs, zm, zm, ze, xs, inplace == 2, comp );
+    else
+        parallel_move_merge( xs, xm, xm, xe, zs, false, comp );
+}
+
+//! Maps the keys of parallel_radix_sort to unsigned integers of the same order
+template<typename Key>
+struct radix_key_traits;
+
+#define __TBB_RADIX_UNSIGNED_KEY( K )                                                           \
+    template<> struct radix_key_traits<K> {                                                     \
+        typedef K type;                                                                         \
+        static type encode( K k ) { return k; }                                                 \
+    };
+#define __TBB_RADIX_SIGNED_KEY( K, U )                                                          \
+    template<> struct radix_key_traits<K> {                                                     \
+        typedef U type;                                                                         \
+        static type encode( K k ) { return type( type(k) ^ type(1) << (8*sizeof(type)-1) ); }   \
+    };
+
+__TBB_RADIX_UNSIGNED_KEY( unsigned char )
+__TBB_RADIX_UNSIGNED_KEY( unsigned short )
+__TBB_RADIX_UNSIGNED_KEY( unsigned int )
+__TBB_RADIX_UNSIGNED_KEY( unsigned long )
+__TBB_RADIX_UNSIGNED_KEY( unsigned long long )
+__TBB_RADIX_SIGNED_KEY( signed char, unsigned char )
+__TBB_RADIX_SIGNED_KEY( short, unsigned short )
+__TBB_RADIX_SIGNED_KEY( int, unsigned int )
+__TBB_RADIX_SIGNED_KEY( long, unsigned long )
+__TBB_RADIX_SIGNED_KEY( long long, unsigned long long )
+
+#undef __TBB_RADIX_UNSIGNED_KEY
+#undef __TBB_RADIX_SIGNED_KEY
+
+template<>
+struct radix_key_traits<char> {
+    typedef unsigned char type;
+    static type encode( char k ) { return type(k) ^ type( char(-1) < 0 ? 0x80 : 0 ); }
+};
+
+//! The negative numbers are ordered by inverting all the bits, and the positive ones by setting the sign bit
+template<typename Float, typename U>
+struct radix_float_key_traits {
+    typedef U type;
+    static type encode( Float k ) {
+        __TBB_STATIC_ASSERT( sizeof(Float) == sizeof(U), "unsupported floating point format" );
+        U u;
+        std::memcpy( &u, &k, sizeof(u) );
+        const U sign = U(1) << (8*sizeof(U)-1);
+        return u & sign ? U(~u) : U(u | sign);
+    }
+};
+
+template<> struct radix_key_traits<float> : radix_float_key_traits<float, tbb::internal::uint32_t> {};
+template<> struct radix_key_traits<double> : radix_float_key_traits<double, tbb::internal::uint64_t> {};
+
+template<typename T>
+struct radix_identity_key {
+    const T& operator()( const T& x ) const { return x; }
+};
+
+//! Maps the elements to the unsigned integer keys of radix sort
+template<typename T, typename Key, typename KeyFunction>
+class radix_encoder {
+    KeyFunction my_key;
+public:
+    typedef typename radix_key_traits<Key>::type key_type;
+    radix_encoder( const KeyFunction& key ) : my_key(key) {}
+    key_type operator()( const T& x ) const { return radix_key_traits<Key>::encode( my_key( x ) ); }
+    bool operator()( const T& x, const T& y ) const { return (*this)( x ) < (*this)( y ); }
+};
+
+//! Number of the bits in a digit of parallel_radix_sort
+const unsigned radix_bits = 8;
+const size_t radix_size = size_t(1) << radix_bits;
+
+//! The minimal number of elements per block of parallel_radix_sort
+const size_t radix_sort_min_block = 1<<14;
+
+//! Sequences up to this size are sorted by std::stable_sort
+const size_t radix_sort_cutoff = 64;
+
+//! Blocks of parallel_radix_sort
+/** The sequence is divided into the same blocks in each pass. Each block has its own histogram
+    of the digits, so that the blocks are counted and scattered in parallel. */
+template<typename T, typename Encoder>
+struct radix_sort_blocks : no_assign {
+    typedef typename Encoder::key_type key_type;
+    static const unsigned num_passes = sizeof(key_type)*8/radix_bits;
+    //! Number of the elements in the write-combining buffer of a digit
+    static const size_t wc_size = sizeof(T) <= 32 ? 64/sizeof(T) : 1;
+
+    const Encoder& encode;
+    const size_t n;
+    const size_t num_blocks;
+    //! Counters of the digits, [block][pass][digit]
+    size_t* const counts;
+
+    radix_sort_blocks( const Encoder& e, size_t n_, size_t num_blocks_, size_t* counts_ )
+        : encode(e), n(n_), num_blocks(num_blocks_), counts(counts_) {}
+
+    size_t first( size_t b ) const { return n/num_blocks*b + (b < n%num_blocks ? b : n%num_blocks); }
+    size_t* block_counts( size_t b, unsigned pass ) const { return counts + (b*num_passes + pass)*radix_size; }
+    static size_t digit( key_type k, unsigned pass ) { return size_t( k >> (pass*radix_bits) ) & (radix_size-1); }
+
+    //! Counts the digits of the blocks for the given pass, or for all the passes if all_passes is true
+    void count( const T* src, size_t b, unsigned pass, bool all_passes ) const {
+        const unsigned last_pass = all_passes ? num_passes : pass+1;
+        for( unsigned p = pass; p < last_pass; ++p )
+            std::fill_n( block_counts( b, p ), radix_size, size_t(0) );
+        for( size_t i = first( b ), e = first( b+1 ); i < e; ++i ) {
+            const key_type k = encode( src[i] );
+            for( unsigned p = pass; p < last_pass; ++p )
+                ++block_counts( b, p )[digit( k, p )];
+        }
+    }
+
+    //! Moves the elements of the block to the positions in dst given by its counts for the pass
+    /** The elements are collected in a buffer for each digit and are written by whole buffers. */
+    void scatter( const T* src, T* dst, size_t b, unsigned pass ) const {
+        size_t* pos = block_counts( b, pass );
+        const size_t e = first( b+1 );
+        if( wc_size == 1 ) {
+            for( size_t i = first( b ); i < e; ++i )
+                std::memcpy( static_cast<void*>( dst + pos[digit( encode( src[i] ), pass )]++ ), src+i, sizeof(T) );
+            return;
+        }
+        aligned_space<T, radix_size*wc_size> buffer;
+        unsigned char fill[radix_size] = {};
+        for( size_t i = first( b ); i < e; ++i ) {
+            const size_t d = digit( encode( src[i] ), pass );
+            T* slot = buffer.begin() + d*wc_size;
+            std::memcpy( static_cast<void*>( slot + fill[d] ), src+i, sizeof(T) );
+            if( ++fill[d] == wc_size ) {
+                std::memcpy( static_cast<void*>( dst + pos[d] ), slot, wc_size*sizeof(T) );
+                pos[d] += wc_size;
+                fill[d] = 0;
+            }
+        }
+        for( size_t d = 0; d < radix_size; ++d )
+            std::memcpy( static_cast<void*>( dst + pos[d] ), buffer.begin() + d*wc_size, fill[d]*sizeof(T) );
+    }
+};
+
+template<typename T, typename Encoder>
+class radix_count_body : no_assign {
+    const radix_sort_blocks<T, Encoder>& blocks;
+    const T* const src;
+    const unsigned pass;
+    const bool all_passes;
+public:
+    radix_count_body( const radix_sort_blocks<T, Encoder>& b, const T* s, unsigned p, bool all )
+        : blocks(b), src(s), pass(p), all_passes(all) {}
+    void operator()( const blocked_range<size_t>& r ) const {
+        for( size_t b = r.begin(); b != r.end(); ++b )
+            blocks.count( src, b, pass, all_passes );
+    }
+};
+
+template<typename T, typename Encoder>
+class radix_scatter_body : no_assign {
+    const radix_sort_blocks<T, Encoder>& blocks;
+    const T* const src;
+    T* const dst;
+    const unsigned pass;
+public:
+    radix_scatter_body( const radix_sort_blocks<T, Encoder>& b, const T* s, T* d, unsigned p )
+        : blocks(b), src(s), dst(d), pass(p) {}
+    void operator()( const blocked_range<size_t>& r ) const {
+        for( size_t b = r.begin(); b != r.end(); ++b )
+            blocks.scatter( src, dst, b, pass );
+    }
+};
+
+template<typename T>
+class radix_copy_body : no_assign {
+    const T* const src;
+    T* const dst;
+public:
+    radix_copy_body( const T* s, T* d ) : src(s), dst(d) {}
+    void operator()( const blocked_range<size_t>& r ) const {
+        std::memcpy( static_cast<void*>( dst + r.begin() ), src + r.begin(), r.size()*sizeof(T) );
+    }
+};
+
+//! LSD radix sort of [data,data+n) by the keys of encode
+/** The digits of all the passes are counted at once first. The passes in which all the elements
+    have the same digit are skipped; the blocks are recounted for the other passes after the first
+    scatter. The elements are scattered between data and a buffer of tbb_allocator. */
+template<typename T, typename Encoder>
+void parallel_radix_sort_impl( T* data, size_t n, const Encoder& encode ) {
+#if __TBB_CPP11_TYPE_PROPERTIES_PRESENT
+    __TBB_STATIC_ASSERT( std::is_trivially_copyable<T>::value, "parallel_radix_sort requires trivially copyable elements" );
+#endif
+    typedef radix_sort_blocks<T, Encoder> blocks_type;
+    const unsigned num_passes = blocks_type::num_passes;
+    const size_t max_blocks = 4*size_t( tbb::this_task_arena::max_concurrency() );
+    size_t num_blocks = n/radix_sort_min_block;
+    num_blocks = num_blocks < 1 ? 1 : num_blocks > max_blocks ? max_blocks : num_blocks;
+
+    tbb_allocator<size_t> counts_allocator;
+    const size_t counts_size = (num_blocks+1)*num_passes*radix_size;
+    size_t* counts = counts_allocator.allocate( counts_size );
+    blocks_type blocks( encode, n, num_blocks, counts );
+    const blocked_range<size_t> all_blocks( 0, num_blocks, 1 );
+    parallel_for( all_blocks, radix_count_body<T, Encoder>( blocks, data, 0, true ), simple_partitioner() );
+
+    // The totals of the digits over all the blocks are kept after the block counters
+    size_t* totals = counts + num_blocks*num_passes*radix_size;
+    std::fill_n( totals, num_passes*radix_size, size_t(0) );
+    for( size_t b = 0; b < num_blocks; ++b )
+        for( size_t i = 0; i < num_passes*radix_size; ++i )
+            totals[i] += counts[b*num_passes*radix_size + i];
+
+    tbb_allocator<T> buffer_allocator;
+    T* buffer = NULL;
+    T* src = data;
+    for( unsigned pass = 0; pass < num_passes; ++pass ) {
+        const size_t* pass_totals = totals + pass*radix_size;
+        if( std::find( pass_totals, pass_totals+radix_size, n ) != pass_totals+radix_size )
+            continue; // all the elements have the same digit
+        if( !buffer )
+            buffer = buffer_allocator.allocate( n );
+        else
+            parallel_for( all_blocks, radix_count_body<T, Encoder>( blocks, src, pass, false ), simple_partitioner() );
+        // The position of the digit d of the block b follows the digits less than d and the digits d of the blocks before b
+        for( size_t d = 0, position = 0; d < radix_size; ++d ) {
+            for( size_t b = 0; b < num_blocks; ++b ) {
+                size_t& c = blocks.block_counts( b, pass )[d];
+                const size_t count = c;
+                c = position;
+                position += count;
+            }
+        }
+        T* dst = src == data ? buffer : data;
+        parallel_for( all_blocks, radix_scatter_body<T, Encoder>( blocks, src, dst, pass ), simple_partitioner() );
+        src = dst;
+    }
+    if( src != data )
+        parallel_for( blocked_range<size_t>( 0, n, radix_sort_min_block ), radix_copy_body<T>( src, data ) );
+    if( buffer )
+        buffer_allocator.deallocate( buffer, n );
+    counts_allocator.deallocate( counts, counts_size );
+}
+
+template<typename RandomAccessIterator, typename Key, typename KeyFunction>
+void parallel_radix_sort( RandomAccessIterator begin, RandomAccessIterator end, const KeyFunction& key ) {
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+    if( end-begin < 2 )
+        return;
+    radix_encoder<T, Key, KeyFunction> encoder( key );
+    if( size_t(end-begin) <= radix_sort_cutoff )
+        std::stable_sort( begin, end, encoder );
+    else
+        parallel_radix_sort_impl( &*begin, size_t(end-begin), encoder );
+}
+
 } // namespace internal
 //! @endcond
 } // namespace interfaceX
@@ -247,6 +646,81 @@ inline void parallel_sort( T * begin, T * end ) {
 }
 //@}
 
+/** \name parallel_stable_sort
+    The requirements on the iterators are the same as for std::stable_sort. **/
+//@{
+
+//! Sorts the data in [begin,end) using the given comparator, preserving the order of the equal elements
+/** The data are sorted by parallel merge sort with a buffer of the same size, allocated by tbb_allocator.
+    The subsequences are merged in parallel: the longer one is split in the middle, and the shorter
+    one by a binary search for the middle element. Neither the comparator nor the move of an element
+    may throw an exception.
+    @ingroup algorithms **/
+template<typename RandomAccessIterator, typename Compare>
+void parallel_stable_sort( RandomAccessIterator begin, RandomAccessIterator end, const Compare& comp ) {
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+    const size_t n = end-begin;
+    if( n <= interface9::internal::stable_sort_grainsize ) {
+        std::stable_sort( begin, end, comp );
+    } else {
+        tbb_allocator<T> allocator;
+        T* buffer = allocator.allocate( n );
+        interface9::internal::parallel_stable_sort_aux( begin, end, buffer, 2, comp );
+        allocator.deallocate( buffer, n );
+    }
+}
+
+//! Sorts the data in [begin,end) stably with a default comparator \c std::less<RandomAccessIterator>
+/** @ingroup algorithms **/
+template<typename RandomAccessIterator>
+inline void parallel_stable_sort( RandomAccessIterator begin, RandomAccessIterator end ) {
+    parallel_stable_sort( begin, end, std::less< typename std::iterator_traits<RandomAccessIterator>::value_type >() );
+}
+
+//! Sorts the data in rng stably using the given comparator
+/** @ingroup algorithms **/
+template<typename Range, typename Compare>
+void parallel_stable_sort( Range& rng, const Compare& comp ) {
+    parallel_stable_sort( tbb::internal::first(rng), tbb::internal::last(rng), comp );
+}
+
+//! Sorts the data in rng stably with a default comparator
+/** @ingroup algorithms **/
+template<typename Range>
+void parallel_stable_sort( Range& rng ) {
+    parallel_stable_sort( tbb::internal::first(rng), tbb::internal::last(rng) );
+}
+//@}
+
+/** \name parallel_radix_sort
+    The iterators must point to contiguous storage of trivially copyable elements. The keys can be of any
+    integral type except bool and wchar_t, \c float or \c double. The floating point keys are ordered
+    by their bits, so -0.0 precedes +0.0, and NaNs with the sign bit set precede all the other keys. **/
+//@{
+
+//! Sorts the numbers in [begin,end) in ascending order
+/** The sort is LSD radix sort with 8-bit digits, and it is stable. The sequence is divided into blocks,
+    and each pass counts the digits in the blocks and then moves the elements of the blocks to their
+    positions in parallel. The moves go through small buffers per digit, so that each write fills
+    a cache line. A buffer of the same size as the data is allocated by tbb_allocator.
+    @ingroup algorithms **/
+template<typename RandomAccessIterator>
+void parallel_radix_sort( RandomAccessIterator begin, RandomAccessIterator end ) {
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+    interface9::internal::parallel_radix_sort<RandomAccessIterator, T>( begin, end, interface9::internal::radix_identity_key<T>() );
+}
+
+#if __TBB_CPP11_DECLTYPE_PRESENT
+//! Sorts the elements of [begin,end) stably in the ascending order of the numeric keys returned by key(element)
+/** @ingroup algorithms **/
+template<typename RandomAccessIterator, typename KeyFunction>
+void parallel_radix_sort( RandomAccessIterator begin, RandomAccessIterator end, const KeyFunction& key ) {
+    typedef typename std::decay<decltype( key( *begin ) )>::type key_type;
+    interface9::internal::parallel_radix_sort<RandomAccessIterator, key_type>( begin, end, key );
+}
+#endif /* __TBB_CPP11_DECLTYPE_PRESENT */
+//@}
+
 
 } // namespace tbb
 
@@ -22,7 +22,11 @@
 
 #include "atomic.h"
 #include "task.h"
+#include "task_arena.h"
 #include "tbb_allocator.h"
+#include "cache_aligned_allocator.h"
+#include "tick_count.h"
+#include "internal/_template_helpers.h"
 #include <cstddef>
 
 #if __TBB_CPP11_TYPE_PROPERTIES_PRESENT
@@ -46,6 +50,7 @@ class stage_task;
 class input_buffer;
 class pipeline_root_task;
 class pipeline_cleaner;
+class token_limit_controller;
 
 } // namespace internal
 
@@ -174,6 +179,7 @@ private:
 
     friend class internal::stage_task;
     friend class internal::pipeline_root_task;
+    friend class internal::token_limit_controller;
     friend class pipeline;
     friend class thread_bound_filter;
 
@@ -230,6 +236,81 @@ private:
     result_type internal_process_item(bool is_blocking);
 };
 
+//! Adaptive limit of the number of live tokens for a run of a pipeline
+/** The run starts with twice as many tokens as there are threads in the arena, and changes
+    the number of tokens between min_tokens and max_tokens as it goes:
+    - tokens are added when the input filter waits for tokens while the threads are not all
+      busy and no serial filter is busy all the time, so more items in flight would give
+      work to the idle threads;
+    - tokens are retired when the input filter never waits for them, so some of them are idle;
+    - the number of tokens does not exceed the memory budget, if it is set.
+    The limit and the timing of the filters are published while the pipeline runs,
+    and are final when it returns. Pipelines with thread-bound filters use max_tokens.
+    @ingroup algorithms */
+class adaptive_token_limit: internal::no_copy {
+public:
+    //! Timing of a filter
+    struct stage_statistics {
+        //! Number of invocations of the filter
+        size_t items;
+        //! Total time spent in the filter, in seconds
+        double busy_time;
+        //! busy_time divided by the duration of the run; exceeds 1 for parallel filters run by several threads
+        double utilization;
+    };
+
+    adaptive_token_limit( size_t min_tokens_, size_t max_tokens_ ) :
+        my_min_tokens(min_tokens_), my_max_tokens(max_tokens_),
+        my_memory_budget(0), my_bytes_per_token(0), my_items_per_token(1),
+        my_stages(NULL), my_stage_count(0)
+    {
+        __TBB_ASSERT( min_tokens_>0 && min_tokens_<=max_tokens_, "invalid range of tokens" );
+        my_current_limit = 0;
+    }
+    ~adaptive_token_limit() {
+        if( my_stages )
+            cache_aligned_allocator<stage_statistics>().deallocate( my_stages, my_stage_count );
+    }
+
+    //! Keep the memory of the items in flight within the given number of bytes
+    /** bytes_per_token is the memory an item in flight takes. min_tokens overrides the budget. */
+    void set_memory_budget( size_t bytes, size_t bytes_per_token ) {
+        my_memory_budget = bytes;
+        my_bytes_per_token = bytes_per_token;
+    }
+
+    size_t min_tokens() const { return my_min_tokens; }
+    size_t max_tokens() const { return my_max_tokens; }
+
+    //! The limit chosen for the current or the last run; 0 before the first run
+    size_t current_limit() const { return my_current_limit; }
+
+    //! Number of filters in the last run
+    size_t number_of_stages() const { return my_stage_count; }
+
+    //! Timing of the i-th filter in the last run
+    const stage_statistics& stage( size_t i ) const {
+        __TBB_ASSERT( i<my_stage_count, "no such stage" );
+        return my_stages[i];
+    }
+
+private:
+    friend class pipeline;
+    friend class internal::token_limit_controller;
+    friend class interface6::internal::pipeline_proxy;
+
+    size_t my_min_tokens;
+    size_t my_max_tokens;
+    size_t my_memory_budget;
+    size_t my_bytes_per_token;
+    //! Number of items a token carries; set by parallel_pipeline for batches of items
+    size_t my_items_per_token;
+    atomic<size_t> my_current_limit;
+    //! Allocated by the run of the pipeline
+    stage_statistics* my_stages;
+    size_t my_stage_count;
+};
+
 //! A processing pipeline that applies filters to items.
 /** @ingroup algorithms */
 class __TBB_DEPRECATED_MSG("tbb::pipeline is deprecated, use tbb::parallel_pipeline") pipeline {
@@ -252,6 +333,14 @@ public:
     void __TBB_EXPORTED_METHOD run( size_t max_number_of_live_tokens, tbb::task_group_context& context );
 #endif
 
+    //! Run the pipeline to completion, changing the number of live tokens within the limit.
+    void __TBB_EXPORTED_METHOD run( adaptive_token_limit& limit );
+
+#if __TBB_TASK_GROUP_CONTEXT
+    //! Run the pipeline to completion with user-supplied context, changing the number of live tokens within the limit.
+    void __TBB_EXPORTED_METHOD run( adaptive_token_limit& limit, tbb::task_group_context& context );
+#endif
+
     //! Remove all filters from the pipeline.
     void __TBB_EXPORTED_METHOD clear();
 
@@ -261,6 +350,7 @@ private:
     friend class filter;
     friend class thread_bound_filter;
     friend class internal::pipeline_cleaner;
+    friend class internal::token_limit_controller;
     friend class tbb::interface6::internal::pipeline_proxy;
 
     //! Pointer to first filter in the pipeline.
@@ -294,6 +384,13 @@ private:
     //! Does clean up if pipeline is cancelled or exception occurred
     void clear_filters();
 #endif
+
+    //! Runs the pipeline with max_number_of_live_tokens, or with the number adjusted by controller if it is not NULL
+    void internal_run( size_t max_number_of_live_tokens, internal::token_limit_controller* controller
+#if __TBB_TASK_GROUP_CONTEXT
+        , tbb::task_group_context& context
+#endif
+        );
 };
 
 //------------------------------------------------------------------------
@@ -310,6 +407,8 @@ namespace interface6 {
 
 namespace internal {
     template<typename T, typename U, typename Body> class concrete_filter;
+    template<typename T, typename U, typename Body> class concrete_batch_filter;
+    template<typename T, typename U, typename Body> class filter_node_leaf;
 }
 
 //! input_filter control to signal end-of-input for parallel_pipeline
@@ -317,11 +416,46 @@ class flow_control {
     bool is_pipeline_stopped;
     flow_control() { is_pipeline_stopped = false; }
     template<typename T, typename U, typename Body> friend class internal::concrete_filter;
+    template<typename T, typename U, typename Body> friend class internal::concrete_batch_filter;
     template<typename Output> friend class flow::interface11::input_node;
 public:
     void stop() { is_pipeline_stopped = true; }
 };
 
+//! Batching of items in parallel_pipeline
+/** Given to make_filter of the input filter, it makes the pipeline group consecutive items
+    into batches, and pass each batch through the filters as a single token. Every filter still
+    receives the items one by one, and serial_in_order filters receive them in the order
+    of the input. The overhead of passing a token between the filters is thus paid once per batch.
+
+    A fixed batch holds max_size items, except for the last one. The size of an adaptive batch
+    changes between 1 and max_size so that each filter spends at least tens of microseconds
+    on a batch.
+
+    max_number_of_live_tokens of parallel_pipeline counts items rather than batches.
+    max_size is reduced to that limit divided by the concurrency of the arena, so that every
+    thread has a token to work on. Only the input filter can be given a batch. */
+class filter_batch {
+public:
+    enum kind {
+        //! all batches have max_size items
+        fixed,
+        //! the size of batches follows the time spent on them
+        adaptive
+    };
+    explicit filter_batch( size_t max_size_, kind kind_ = fixed ) : my_max_size(max_size_), my_kind(kind_) {
+        __TBB_ASSERT( max_size_>0, "a batch must hold at least one item" );
+    }
+    size_t max_size() const { return my_max_size; }
+    bool is_adaptive() const { return my_kind==adaptive; }
+private:
+    template<typename T, typename U, typename Body> friend class internal::filter_node_leaf;
+    //! Used by filters that do not make batches
+    static filter_batch no_batch() { filter_batch b(1); b.my_max_size = 0; return b; }
+    size_t my_max_size;
+    kind my_kind;
+};
+
 //! @cond INTERNAL
 namespace internal {
 
@@ -510,17 +644,230 @@ public:
     concrete_filter(filter::mode filter_mode, const Body& body) : filter(filter_mode), my_body(body) {}
 };
 
+//! Chooses the size of adaptive batches
+/** The filters report the time they spend on batches; the shortest time is compared with
+    the target time. The size grows while the time is too short to hide the overhead of
+    passing a token between the filters, and shrinks when the time is several times longer. */
+class batch_control: tbb::internal::no_copy {
+    tbb::atomic<size_t> my_size;
+    const size_t my_max_size;
+public:
+    //! Time a batch should take in the filters, in seconds
+    static double target_time() { return 2e-5; }
+    explicit batch_control( size_t max_size ) : my_max_size(max_size) { my_size = 1; }
+    size_t size() const { return my_size; }
+    void update( size_t size, double seconds ) {
+        if( seconds<target_time() ) {
+            if( size>=my_size && size<my_max_size )
+                my_size = 2*size<my_max_size ? 2*size : my_max_size;
+        } else if( seconds>4*target_time() ) {
+            if( size<=my_size && size>1 )
+                my_size = size/2;
+        }
+    }
+};
+
+//! A batch of items passed between the filters as a single token
+/** The items are represented the same way as single items are by token_helper.
+    A filter converts the items in place, so items before my_processed have the output type
+    of the filter that works on the batch, and the rest have its input type. */
+class token_batch: tbb::internal::no_copy {
+    token_batch() {}
+    ~token_batch() {}
+public:
+    size_t my_size;
+    size_t my_capacity;
+    size_t my_processed;
+    //! NULL for fixed batches
+    batch_control* my_control;
+    //! The shortest time a filter spent on the batch
+    double my_min_time;
+    void* my_items[1];
+
+    static size_t bytes( size_t capacity ) { return sizeof(token_batch) + (capacity-1)*sizeof(void*); }
+    static token_batch* allocate( size_t capacity, batch_control* control ) {
+        token_batch* b = static_cast<token_batch*>( (void*)tbb::tbb_allocator<char>().allocate( bytes(capacity) ) );
+        b->my_size = 0;
+        b->my_capacity = capacity;
+        b->my_processed = 0;
+        b->my_control = control;
+        b->my_min_time = 1e9;
+        return b;
+    }
+    static void deallocate( token_batch* b ) {
+        tbb::tbb_allocator<char>().deallocate( (char*)(void*)b, bytes(b->my_capacity) );
+    }
+    void note_time( tick_count start ) {
+        if( my_control ) {
+            double t = (tick_count::now()-start).seconds();
+            if( t<my_min_time ) my_min_time = t;
+        }
+    }
+};
+
+// intermediate
+template<typename T, typename U, typename Body>
+class concrete_batch_filter: public tbb::filter {
+    const Body& my_body;
+    typedef token_helper<T,use_allocator<T>::value> t_helper;
+    typedef typename t_helper::pointer t_pointer;
+    typedef token_helper<U,use_allocator<U>::value> u_helper;
+    typedef typename u_helper::pointer u_pointer;
+
+    void* operator()(void* input) __TBB_override {
+        token_batch* b = static_cast<token_batch*>(input);
+        tick_count start = b->my_control ? tick_count::now() : tick_count();
+        for( ; b->my_processed<b->my_size; ++b->my_processed ) {
+            t_pointer temp_input = t_helper::cast_from_void_ptr(b->my_items[b->my_processed]);
+            u_pointer output_u = u_helper::create_token(my_body(tbb::internal::move(t_helper::token(temp_input))));
+            t_helper::destroy_token(temp_input);
+            b->my_items[b->my_processed] = u_helper::cast_to_void_ptr(output_u);
+        }
+        b->my_processed = 0;
+        b->note_time(start);
+        return b;
+    }
+
+    void finalize(void* input) __TBB_override {
+        token_batch* b = static_cast<token_batch*>(input);
+        for( size_t i = 0; i<b->my_processed; ++i )
+            u_helper::destroy_token(u_helper::cast_from_void_ptr(b->my_items[i]));
+        for( size_t i = b->my_processed; i<b->my_size; ++i )
+            t_helper::destroy_token(t_helper::cast_from_void_ptr(b->my_items[i]));
+        token_batch::deallocate(b);
+    }
+
+public:
+    concrete_batch_filter(tbb::filter::mode filter_mode, const Body& body, const filter_batch&) : filter(filter_mode), my_body(body) {}
+};
+
+// input
+template<typename U, typename Body>
+class concrete_batch_filter<void,U,Body>: public filter {
+    const Body& my_body;
+    batch_control my_control;
+    const size_t my_max_size;
+    const bool my_is_adaptive;
+    //! Set when the body stops the input in the middle of a batch
+    tbb::atomic<bool> my_is_stopped;
+    typedef token_helper<U, use_allocator<U>::value> u_helper;
+    typedef typename u_helper::pointer u_pointer;
+
+    void* operator()(void*) __TBB_override {
+        if( !my_is_stopped ) {
+            const size_t size = my_is_adaptive ? my_control.size() : my_max_size;
+            token_batch* b = token_batch::allocate( my_max_size, my_is_adaptive ? &my_control : NULL );
+            tick_count start = my_is_adaptive ? tick_count::now() : tick_count();
+            __TBB_TRY {
+                while( b->my_size<size ) {
+                    flow_control control;
+                    u_pointer output_u = u_helper::create_token(my_body(control));
+                    if(control.is_pipeline_stopped) {
+                        u_helper::destroy_token(output_u);
+                        my_is_stopped = true;
+                        break;
+                    }
+                    b->my_items[b->my_size++] = u_helper::cast_to_void_ptr(output_u);
+                }
+            } __TBB_CATCH(...) {
+                finalize(b);
+                __TBB_RETHROW();
+            }
+            if( b->my_size ) {
+                b->note_time(start);
+                return b;
+            }
+            token_batch::deallocate(b);
+        }
+        set_end_of_input();
+        return NULL;
+    }
+
+    void finalize(void* input) __TBB_override {
+        token_batch* b = static_cast<token_batch*>(input);
+        for( size_t i = 0; i<b->my_size; ++i )
+            u_helper::destroy_token(u_helper::cast_from_void_ptr(b->my_items[i]));
+        token_batch::deallocate(b);
+    }
+
+public:
+    concrete_batch_filter(tbb::filter::mode filter_mode, const Body& body, const filter_batch& batch) :
+        filter(static_cast<tbb::filter::mode>(filter_mode | filter_may_emit_null)),
+        my_body(body), my_control(batch.max_size()), my_max_size(batch.max_size()), my_is_adaptive(batch.is_adaptive())
+    {
+        my_is_stopped = false;
+    }
+};
+
+// output
+template<typename T, typename Body>
+class concrete_batch_filter<T,void,Body>: public filter {
+    const Body& my_body;
+    typedef token_helper<T, use_allocator<T>::value> t_helper;
+    typedef typename t_helper::pointer t_pointer;
+
+    void* operator()(void* input) __TBB_override {
+        token_batch* b = static_cast<token_batch*>(input);
+        tick_count start = b->my_control ? tick_count::now() : tick_count();
+        for( ; b->my_processed<b->my_size; ++b->my_processed ) {
+            t_pointer temp_input = t_helper::cast_from_void_ptr(b->my_items[b->my_processed]);
+            my_body(tbb::internal::move(t_helper::token(temp_input)));
+            t_helper::destroy_token(temp_input);
+        }
+        if( batch_control* control = b->my_control ) {
+            b->note_time(start);
+            control->update(b->my_size, b->my_min_time);
+        }
+        token_batch::deallocate(b);
+        return NULL;
+    }
+    void finalize(void* input) __TBB_override {
+        token_batch* b = static_cast<token_batch*>(input);
+        for( size_t i = b->my_processed; i<b->my_size; ++i )
+            t_helper::destroy_token(t_helper::cast_from_void_ptr(b->my_items[i]));
+        token_batch::deallocate(b);
+    }
+
+public:
+    concrete_batch_filter(tbb::filter::mode filter_mode, const Body& body, const filter_batch&) : filter(filter_mode), my_body(body) {}
+};
+
+//! A single filter has nothing to pass to other filters, so it does not make batches
+template<typename Body>
+class concrete_batch_filter<void,void,Body>: public concrete_filter<void,void,Body> {
+public:
+    concrete_batch_filter(filter::mode filter_mode, const Body& body, const filter_batch&) :
+        concrete_filter<void,void,Body>(filter_mode, body) {}
+};
+
 //! The class that represents an object of the pipeline for parallel_pipeline().
 /** It primarily serves as RAII class that deletes heap-allocated filter instances. */
 class pipeline_proxy {
     tbb::pipeline my_pipe;
+    //! Number of tokens to run the pipeline with
+    size_t my_tokens;
+    //! Number of items a token carries
+    size_t my_items_per_token;
 public:
-    pipeline_proxy( const filter_t<void,void>& filter_chain );
+    pipeline_proxy( const filter_t<void,void>& filter_chain, size_t max_number_of_live_tokens );
     ~pipeline_proxy() {
         while( filter* f = my_pipe.filter_list )
             delete f; // filter destructor removes it from the pipeline
     }
     tbb::pipeline* operator->() { return &my_pipe; }
+    size_t number_of_tokens() const { return my_tokens; }
+    void run( adaptive_token_limit& limit
+#if __TBB_TASK_GROUP_CONTEXT
+        , tbb::task_group_context& context
+#endif
+        ) {
+        limit.my_items_per_token = my_items_per_token;
+        my_pipe.run( limit
+#if __TBB_TASK_GROUP_CONTEXT
+            , context
+#endif
+            );
+    }
 };
 
 //! Abstract base class that represents a node in a parse tree underlying a filter_t.
@@ -537,7 +884,10 @@ protected:
     }
 public:
     //! Add concrete_filter to pipeline
-    virtual void add_to( pipeline& ) = 0;
+    /** batch_size is the maximal number of items in a batch if the filters pass batches, and 0 otherwise. */
+    virtual void add_to( pipeline&, size_t batch_size ) = 0;
+    //! The maximal batch size requested by the first filter of the chain, or 0 if items are not batched
+    virtual size_t batch_size() const = 0;
     //! Increment reference count
     void add_ref() { ++ref_count; }
     //! Decrement reference count and delete if it becomes zero.
@@ -558,12 +908,20 @@ template<typename T, typename U, typename Body>
 class filter_node_leaf: public filter_node {
     const tbb::filter::mode mode;
     const Body body;
-    void add_to( pipeline& p ) __TBB_override {
-        concrete_filter<T,U,Body>* f = new concrete_filter<T,U,Body>(mode,body);
+    //! Batching given to make_filter; max_size() is 0 if none
+    const filter_batch batch;
+    void add_to( pipeline& p, size_t batch_size ) __TBB_override {
+        filter* f;
+        if( batch_size )
+            f = new concrete_batch_filter<T,U,Body>(mode,body,filter_batch(batch_size, batch.is_adaptive() ? filter_batch::adaptive : filter_batch::fixed));
+        else
+            f = new concrete_filter<T,U,Body>(mode,body);
         p.add_filter( *f );
     }
+    size_t batch_size() const __TBB_override { return batch.max_size(); }
 public:
-    filter_node_leaf( tbb::filter::mode m, const Body& b ) : mode(m), body(b) {}
+    filter_node_leaf( tbb::filter::mode m, const Body& b ) : mode(m), body(b), batch(filter_batch::no_batch()) {}
+    filter_node_leaf( tbb::filter::mode m, const Body& b, const filter_batch& fb ) : mode(m), body(b), batch(fb) {}
 };
 
 //! Node in parse tree representing join of two filters.
@@ -575,10 +933,11 @@ class filter_node_join: public filter_node {
        left.remove_ref();
        right.remove_ref();
     }
-    void add_to( pipeline& p ) __TBB_override {
-        left.add_to(p);
-        right.add_to(p);
+    void add_to( pipeline& p, size_t batch_size ) __TBB_override {
+        left.add_to(p, batch_size);
+        right.add_to(p, batch_size);
     }
+    size_t batch_size() const __TBB_override { return left.batch_size(); }
 public:
     filter_node_join( filter_node& x, filter_node& y ) : left(x), right(y) {
        left.add_ref();
@@ -595,6 +954,14 @@ filter_t<T,U> make_filter(tbb::filter::mode mode, const Body& body) {
     return new internal::filter_node_leaf<T,U,Body>(mode, body);
 }
 
+//! Create the input filter of parallel_pipeline that groups the items into batches
+/** The batching applies to the whole chain that starts with the filter. */
+template<typename T, typename U, typename Body>
+filter_t<T,U> make_filter(tbb::filter::mode mode, const Body& body, const filter_batch& batch) {
+    __TBB_STATIC_ASSERT( (tbb::internal::is_same_type<T,void>::value), "only the input filter can make batches" );
+    return new internal::filter_node_leaf<T,U,Body>(mode, body, batch);
+}
+
 template<typename T, typename V, typename U>
 filter_t<T,U> operator& (const filter_t<T,V>& left, const filter_t<V,U>& right) {
     __TBB_ASSERT(left.root,"cannot use default-constructed filter_t as left argument of '&'");
@@ -613,6 +980,8 @@ class filter_t {
     friend class internal::pipeline_proxy;
     template<typename T_, typename U_, typename Body>
     friend filter_t<T_,U_> make_filter(tbb::filter::mode, const Body& );
+    template<typename T_, typename U_, typename Body>
+    friend filter_t<T_,U_> make_filter(tbb::filter::mode, const Body&, const filter_batch& );
     template<typename T_, typename V_, typename U_>
     friend filter_t<T_,U_> operator& (const filter_t<T_,V_>& , const filter_t<V_,U_>& );
 public:
@@ -648,9 +1017,21 @@ public:
     }
 };
 
-inline internal::pipeline_proxy::pipeline_proxy( const filter_t<void,void>& filter_chain ) : my_pipe() {
+inline internal::pipeline_proxy::pipeline_proxy( const filter_t<void,void>& filter_chain, size_t max_number_of_live_tokens ) :
+    my_pipe(), my_tokens(max_number_of_live_tokens), my_items_per_token(1)
+{
     __TBB_ASSERT( filter_chain.root, "cannot apply parallel_pipeline to default-constructed filter_t"  );
-    filter_chain.root->add_to(my_pipe);
+    size_t batch_size = filter_chain.root->batch_size();
+    if( batch_size ) {
+        // The limit counts items, and a token carries up to batch_size of them.
+        // Fewer tokens than threads would leave threads idle, also while adaptive batches are small.
+        const size_t max_batch_size = max_number_of_live_tokens/size_t(tbb::this_task_arena::max_concurrency());
+        if( batch_size>max_batch_size )
+            batch_size = max_batch_size>0 ? max_batch_size : 1;
+        my_tokens = max_number_of_live_tokens/batch_size;
+        my_items_per_token = batch_size;
+    }
+    filter_chain.root->add_to(my_pipe, batch_size);
 }
 
 inline void parallel_pipeline(size_t max_number_of_live_tokens, const filter_t<void,void>& filter_chain
@@ -658,9 +1039,9 @@ inline void parallel_pipeline(size_t max_number_of_live_tokens, const filter_t<v
     , tbb::task_group_context& context
 #endif
     ) {
-    internal::pipeline_proxy pipe(filter_chain);
+    internal::pipeline_proxy pipe(filter_chain, max_number_of_live_tokens);
     // tbb::pipeline::run() is called via the proxy
-    pipe->run(max_number_of_live_tokens
+    pipe->run(pipe.number_of_tokens()
 #if __TBB_TASK_GROUP_CONTEXT
               , context
 #endif
@@ -674,9 +1055,32 @@ inline void parallel_pipeline(size_t max_number_of_live_tokens, const filter_t<v
 }
 #endif // __TBB_TASK_GROUP_CONTEXT
 
+//! Run parallel_pipeline with the number of live tokens adjusted within the limit
+/** With batches of items, the limit counts items. */
+inline void parallel_pipeline(adaptive_token_limit& limit, const filter_t<void,void>& filter_chain
+#if __TBB_TASK_GROUP_CONTEXT
+    , tbb::task_group_context& context
+#endif
+    ) {
+    internal::pipeline_proxy pipe(filter_chain, limit.max_tokens());
+    pipe.run(limit
+#if __TBB_TASK_GROUP_CONTEXT
+             , context
+#endif
+    );
+}
+
+#if __TBB_TASK_GROUP_CONTEXT
+inline void parallel_pipeline(adaptive_token_limit& limit, const filter_t<void,void>& filter_chain) {
+    tbb::task_group_context context;
+    parallel_pipeline(limit, filter_chain, context);
+}
+#endif // __TBB_TASK_GROUP_CONTEXT
+
 } // interface6
 
 using interface6::flow_control;
+using interface6::filter_batch;
 using interface6::filter_t;
 using interface6::make_filter;
 using interface6::parallel_pipeline;
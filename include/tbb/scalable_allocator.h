@@ -96,9 +96,38 @@ typedef enum {
     TBBMALLOC_SET_SOFT_HEAP_LIMIT,
     /* Lower bound for the size (Bytes), that is interpreted as huge
      * and not released during regular cleanup operations. */
-    TBBMALLOC_SET_HUGE_SIZE_THRESHOLD
+    TBBMALLOC_SET_HUGE_SIZE_THRESHOLD,
+    /* value turns batching of objects freed by a thread other than
+       the allocating one on and off */
+    TBBMALLOC_USE_REMOTE_FREE_BATCHING,
+    /* value turns carving of slabs and large blocks from huge page
+       sized regions on and off */
+    TBBMALLOC_USE_HUGE_PAGE_SLABS,
+    /* value selects the size classes of objects from 1KB to 8KB, one of
+       ScalableSizeClasses; has effect only before the first allocation.
+       Setting TBB_MALLOC_SIZE_CLASSES environment variable to "classic"
+       selects the classic size classes. */
+    TBBMALLOC_SET_SIZE_CLASSES,
+    /* value turns counting of live objects and of large object cache hits
+       on and off, see TBBMALLOC_GET_STATISTICS. Setting
+       TBB_MALLOC_COLLECT_STATISTICS environment variable to 1 turns it on. */
+    TBBMALLOC_COLLECT_STATISTICS,
+    /* value (Bytes) is the mean interval between the allocations sampled
+       by the heap profiler, 0 turns it off; see TBBMALLOC_DUMP_HEAP_PROFILE.
+       Setting TBB_MALLOC_HEAP_PROFILE_SAMPLING environment variable to
+       the interval turns it on. Returns TBBMALLOC_NO_EFFECT if the stacks
+       cannot be captured on the platform. */
+    TBBMALLOC_SET_HEAP_PROFILE_SAMPLING
 } AllocationModeParam;
 
+/* Size classes of objects from 1KB to 8KB */
+typedef enum {
+    /* 13 classes, for every number of objects from 14 to 2 in a 16KB slab (default) */
+    TBBMALLOC_SIZE_CLASSES_FINE,
+    /* 5 classes, for 9, 6, 4, 3 and 2 objects in a slab */
+    TBBMALLOC_SIZE_CLASSES_CLASSIC
+} ScalableSizeClasses;
+
 /** Set TBB allocator-specific allocation modes.
     @ingroup memory_allocation */
 int __TBB_EXPORTED_FUNC scalable_allocation_mode(int param, intptr_t value);
@@ -110,9 +139,52 @@ typedef enum {
     TBBMALLOC_CLEAN_ALL_BUFFERS,
     /* Clean internal allocator buffer for current thread only.
        Return values same as for TBBMALLOC_CLEAN_ALL_BUFFERS. */
-    TBBMALLOC_CLEAN_THREAD_BUFFERS
+    TBBMALLOC_CLEAN_THREAD_BUFFERS,
+    /* Fill the ScalableAllocationStatistics pointed to by param.
+       Returns TBBMALLOC_INVALID_PARAM if param is NULL. */
+    TBBMALLOC_GET_STATISTICS,
+    /* Write the sampled allocations that are not freed yet, grouped by
+       call stacks, to the file named by param in the pprof heap profile
+       format. Returns TBBMALLOC_INVALID_PARAM if param is NULL or the file
+       cannot be written, TBBMALLOC_NO_EFFECT if the heap profiler is not
+       supported. Setting TBB_MALLOC_HEAP_PROFILE_FILE environment variable
+       to a file name writes the profile at process shutdown. */
+    TBBMALLOC_DUMP_HEAP_PROFILE
 } ScalableAllocationCmd;
 
+/* The number of size classes of objects that are not large in ScalableAllocationStatistics */
+#define TBBMALLOC_STATISTICS_BINS 40
+
+/* Objects of a size class; the objects and the bytes are counted only
+   while TBBMALLOC_COLLECT_STATISTICS is on, and only in the slabs that
+   have been empty since it was turned on. So the objects allocated before
+   are never counted, nor are the later ones that share a slab with them. */
+typedef struct {
+    size_t objectSize;   /* the size of the objects, 0 for an unused class */
+    size_t slabs;        /* 16KB slabs holding the objects */
+    size_t liveObjects;  /* objects allocated and not freed yet */
+    size_t liveBytes;    /* their total size */
+    size_t cachedBytes;  /* the size of the free objects in the slabs */
+} ScalableBinStatistics;
+
+/* A snapshot of the default memory pool. It is not taken atomically, so
+   allocations and deallocations by other threads make it approximate. */
+typedef struct {
+    int collecting;                /* nonzero if TBBMALLOC_COLLECT_STATISTICS is on */
+    unsigned numBins;              /* the size classes in use */
+    ScalableBinStatistics bins[TBBMALLOC_STATISTICS_BINS];
+    size_t threads;                /* threads that have allocator caches */
+    size_t threadCachedBytes;      /* free slabs and large objects in the caches of the threads */
+    size_t maxThreadCachedBytes;   /* the largest of these caches */
+    size_t orphanedSlabs;          /* slabs of exited threads kept for reuse */
+    size_t largeLiveBytes;         /* large objects in use */
+    size_t largeCachedBytes;       /* large objects in the global large object cache */
+    size_t largeCacheHits;         /* large objects taken from the caches */
+    size_t largeCacheMisses;       /* large objects taken from the backend */
+    size_t backendRegions;         /* memory regions obtained from the OS */
+    size_t backendBytes;           /* their total size */
+} ScalableAllocationStatistics;
+
 /** Call TBB allocator-specific commands.
     @ingroup memory_allocation */
 int __TBB_EXPORTED_FUNC scalable_allocation_command(int cmd, void *param);
@@ -45,12 +45,18 @@
 #endif
 #include "cache_aligned_allocator.h"
 #include "combinable.h"
+#if TBB_PREVIEW_CONCURRENT_FLAT_MAP
+#include "concurrent_flat_map.h"
+#endif
 #include "concurrent_hash_map.h"
 #if TBB_PREVIEW_CONCURRENT_LRU_CACHE
 #include "concurrent_lru_cache.h"
 #endif
 #include "concurrent_priority_queue.h"
 #include "concurrent_queue.h"
+#if TBB_PREVIEW_CONCURRENT_RING_QUEUE
+#include "concurrent_ring_queue.h"
+#endif
 #include "concurrent_unordered_map.h"
 #include "concurrent_unordered_set.h"
 #if TBB_PREVIEW_CONCURRENT_ORDERED_CONTAINERS
@@ -60,6 +66,9 @@
 #include "concurrent_vector.h"
 #include "critical_section.h"
 #include "enumerable_thread_specific.h"
+#if TBB_PREVIEW_FILE_READER
+#include "file_reader.h"
+#endif
 #include "flow_graph.h"
 #include "global_control.h"
 #include "iterators.h"
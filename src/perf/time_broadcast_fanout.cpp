@@ -0,0 +1,94 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Measures the messages per second that threads put into one broadcast_node with many successors,
+// for 1 to the given number of threads. The successors are lightweight unlimited function_nodes,
+// that run their trivial bodies inside the put, so the time is spent walking the successors.
+//
+// Usage: time_broadcast_fanout [threads] [successors] [messages per thread] [repeats]
+
+#define HARNESS_CUSTOM_MAIN 1
+#define HARNESS_NO_PARSE_COMMAND_LINE 1
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "tbb/flow_graph.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/tick_count.h"
+#include "../test/harness.h"
+
+using namespace tbb::flow;
+
+typedef tbb::enumerable_thread_specific<long> Counter;
+
+struct CountBody {
+    Counter* my_count;
+    CountBody( Counter& count ) : my_count(&count) {}
+    continue_msg operator()( int ) const { ++my_count->local(); return continue_msg(); }
+};
+
+class PutBody : NoAssign {
+    broadcast_node<int>& my_node;
+    int my_n;
+public:
+    PutBody( broadcast_node<int>& node, int n ) : my_node(node), my_n(n) {}
+    void operator()( int ) const {
+        for( int i = 0; i < my_n; ++i )
+            my_node.try_put( i );
+    }
+};
+
+double Run( int nthread, int fanout, int n ) {
+    typedef function_node<int, continue_msg, lightweight> sink_type;
+    graph g;
+    Counter count;
+    broadcast_node<int> start( g );
+    std::vector<sink_type*> sinks;
+    for( int i = 0; i < fanout; ++i ) {
+        sinks.push_back( new sink_type( g, unlimited, CountBody( count ) ) );
+        make_edge( start, *sinks.back() );
+    }
+    tbb::tick_count t0 = tbb::tick_count::now();
+    NativeParallelFor( nthread, PutBody( start, n ) );
+    g.wait_for_all();
+    double t = (tbb::tick_count::now()-t0).seconds();
+    long total = count.combine( std::plus<long>() );
+    if( total != long(nthread)*n*fanout )
+        REPORT( "Error: %ld of %ld messages delivered\n", total, long(nthread)*n*fanout );
+    for( int i = 0; i < fanout; ++i )
+        delete sinks[i];
+    return t;
+}
+
+int main( int argc, char* argv[] ) {
+    const int nthread = argc > 1 ? std::atoi( argv[1] ) : tbb::task_scheduler_init::default_num_threads();
+    const int fanout = argc > 2 ? std::atoi( argv[2] ) : 64;
+    const int n = argc > 3 ? std::atoi( argv[3] ) : 100000;
+    const int repeats = argc > 4 ? std::atoi( argv[4] ) : 3;
+    tbb::task_scheduler_init init( nthread );
+    printf( "%d successors, %d messages per thread\n", fanout, n );
+    for( int p = 1; p <= nthread; ++p ) {
+        double best = 0;
+        for( int r = 0; r < repeats; ++r ) {
+            double t = Run( p, fanout, n );
+            best = r == 0 || t < best ? t : best;
+        }
+        printf( "%3d threads %10.2f Mmsg/s to each successor\n", p, best > 0 ? double(p)*n/best*1e-6 : 0. );
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Compares the sums of an array of doubles by parallel_reduce with auto_partitioner and by
+// parallel_deterministic_reduce with simple_partitioner and with auto_partitioner. The work per
+// element is uneven, to show the cost of giving up load balancing. The deterministic sums are
+// checked to have the same bits in every run.
+//
+// Usage: time_deterministic_reduce [threads] [elements] [grainsize] [repeats]
+
+#define HARNESS_CUSTOM_MAIN 1
+#define HARNESS_NO_PARSE_COMMAND_LINE 1
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include "tbb/parallel_reduce.h"
+#include "tbb/blocked_range.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/tick_count.h"
+#include "../test/harness.h"
+
+class SumBody {
+    const double* my_array;
+public:
+    double my_sum;
+    SumBody( const double* array ) : my_array(array), my_sum(0) {}
+    SumBody( SumBody& b, tbb::split ) : my_array(b.my_array), my_sum(0) {}
+    void operator()( const tbb::blocked_range<size_t>& r ) {
+        double sum = my_sum;
+        for( size_t i = r.begin(); i < r.end(); ++i ) {
+            double x = my_array[i];
+            // every fourth million of the elements costs more
+            if( ( i >> 20 & 3 ) == 3 )
+                x = std::sqrt( x*x + 1 ) - 1;
+            sum += x;
+        }
+        my_sum = sum;
+    }
+    void join( SumBody& b ) { my_sum += b.my_sum; }
+};
+
+enum Method { Reduce, DeterministicSimple, DeterministicAuto };
+static const char* const MethodNames[] = {
+    "parallel_reduce", "deterministic simple_partitioner", "deterministic auto_partitioner"
+};
+
+double Run( Method m, const std::vector<double>& array, size_t grainsize ) {
+    SumBody body( &array[0] );
+    tbb::blocked_range<size_t> range( 0, array.size(), grainsize );
+    switch( m ) {
+    case Reduce:
+        tbb::parallel_reduce( tbb::blocked_range<size_t>( 0, array.size() ), body, tbb::auto_partitioner() );
+        break;
+    case DeterministicSimple:
+        tbb::parallel_deterministic_reduce( range, body, tbb::simple_partitioner() );
+        break;
+    case DeterministicAuto:
+        tbb::parallel_deterministic_reduce( range, body, tbb::auto_partitioner() );
+        break;
+    }
+    return body.my_sum;
+}
+
+int main( int argc, char* argv[] ) {
+    const int nthread = argc > 1 ? std::atoi( argv[1] ) : tbb::task_scheduler_init::default_num_threads();
+    const size_t n = argc > 2 ? std::strtoul( argv[2], NULL, 0 ) : 50000000;
+    const size_t grainsize = argc > 3 ? std::strtoul( argv[3], NULL, 0 ) : 10000;
+    const int repeats = argc > 4 ? std::atoi( argv[4] ) : 5;
+    tbb::task_scheduler_init init( nthread );
+    std::vector<double> array( n );
+    Harness::FastRandom rnd( 42 );
+    for( size_t i = 0; i < n; ++i )
+        array[i] = rnd.get() * ( i % 5 ? 1e-3 : 1e7 );
+    printf( "%d threads, %lu elements, grainsize %lu\n", nthread, (unsigned long)n, (unsigned long)grainsize );
+    for( int m = Reduce; m <= DeterministicAuto; ++m ) {
+        double best = 0, first = 0;
+        bool reproducible = true;
+        for( int r = 0; r < repeats; ++r ) {
+            tbb::tick_count t0 = tbb::tick_count::now();
+            double sum = Run( Method(m), array, grainsize );
+            double t = (tbb::tick_count::now()-t0).seconds();
+            if( r == 0 )
+                first = sum;
+            else if( std::memcmp( &sum, &first, sizeof(double) ) != 0 )
+                reproducible = false;
+            best = r == 0 || t < best ? t : best;
+        }
+        if( m != Reduce && !reproducible )
+            REPORT( "Error: %s is not reproducible\n", MethodNames[m] );
+        printf( "%-34s best %8.3f s   sum %.17g%s\n", MethodNames[m], best, first, reproducible ? "" : " (varies)" );
+    }
+    return 0;
+}
@@ -0,0 +1,209 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Compares the input stages of the pipeline of examples/pipeline/square, that squares the
+// decimal integers of a text file. The reference input filter is the one of the example: it
+// freads the file into a newly allocated slice and copies the partial number at its end into
+// the next slice. The others are file_reader in the positional_read and memory_map modes.
+// The squares are formatted into the output slices as in the example, but not written.
+// The input file is generated if it does not exist.
+//
+// Usage: time_file_reader [threads] [file] [megabytes] [chunk size]
+
+#define HARNESS_CUSTOM_MAIN 1
+#define HARNESS_NO_PARSE_COMMAND_LINE 1
+#define TBB_PREVIEW_FILE_READER 1
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include "tbb/file_reader.h"
+#include "tbb/pipeline.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/tbb_allocator.h"
+#include "tbb/tick_count.h"
+#include "tbb/atomic.h"
+#include "../test/harness.h"
+
+static size_t ChunkSize = 4000;
+
+//! TextSlice of the square example
+class TextSlice {
+    char* logical_end;
+    char* physical_end;
+public:
+    static TextSlice* allocate( size_t max_size ) {
+        TextSlice* t = (TextSlice*)tbb::tbb_allocator<char>().allocate( sizeof(TextSlice)+max_size+1 );
+        t->logical_end = t->begin();
+        t->physical_end = t->begin()+max_size;
+        return t;
+    }
+    void free() {
+        tbb::tbb_allocator<char>().deallocate( (char*)this, sizeof(TextSlice)+(physical_end-begin())+1 );
+    }
+    char* begin() { return (char*)(this+1); }
+    char* end() { return logical_end; }
+    size_t size() const { return logical_end-(char*)(this+1); }
+    size_t avail() const { return physical_end-logical_end; }
+    void append( const char* first, const char* last ) {
+        memcpy( logical_end, first, last-first );
+        logical_end += last-first;
+    }
+    void set_end( char* p ) { logical_end = p; }
+};
+
+//! The input filter of the square example
+class FreadInput {
+    FILE* my_file;
+    TextSlice** my_next;
+public:
+    FreadInput( FILE* f, TextSlice** next ) : my_file(f), my_next(next) {}
+    TextSlice* operator()( tbb::flow_control& fc ) const {
+        TextSlice*& next_slice = *my_next;
+        if( !next_slice )
+            next_slice = TextSlice::allocate( ChunkSize );
+        size_t m = next_slice->avail();
+        size_t n = fread( next_slice->end(), 1, m, my_file );
+        if( !n && next_slice->size() == 0 ) {
+            fc.stop();
+            return NULL;
+        }
+        TextSlice* t = next_slice;
+        next_slice = TextSlice::allocate( ChunkSize );
+        char* p = t->end()+n;
+        if( n == m ) {
+            while( p > t->begin() && isdigit( p[-1] ) )
+                --p;
+            next_slice->append( p, t->end()+n );
+        }
+        t->set_end( p );
+        return t;
+    }
+};
+
+//! Squares the numbers of [first,last) into a new slice, as the transform filter of the square example
+TextSlice* Square( const char* p, const char* last ) {
+    TextSlice* out = TextSlice::allocate( 2*(last-p) );
+    char* q = out->begin();
+    while( p != last ) {
+        while( p < last && !isdigit( *p ) )
+            *q++ = *p++;
+        if( p == last )
+            break;
+        long x = 0;
+        while( p < last && isdigit( *p ) )
+            x = 10*x + (*p++ - '0');
+        q += sprintf( q, "%ld", x*x );
+    }
+    out->set_end( q );
+    return out;
+}
+
+struct FreadSquare {
+    TextSlice* operator()( TextSlice* in ) const {
+        TextSlice* out = Square( in->begin(), in->end() );
+        in->free();
+        return out;
+    }
+};
+
+struct ChunkSquare {
+    TextSlice* operator()( tbb::file_chunk c ) const {
+        return Square( c.begin(), c.end() );
+    }
+};
+
+class Output {
+    size_t* my_bytes;
+public:
+    Output( size_t* bytes ) : my_bytes(bytes) {}
+    void operator()( TextSlice* out ) const {
+        *my_bytes += out->size();
+        out->free();
+    }
+};
+
+void Report( const char* name, tbb::tick_count t0, size_t input, size_t output ) {
+    double t = (tbb::tick_count::now()-t0).seconds();
+    printf( "%-28s %8.3f s %10.1f MB/s  %lu bytes out\n", name, t, input/t*1e-6, (unsigned long)output );
+}
+
+void MeasureFread( const char* file_name, int ntoken, size_t input ) {
+    FILE* f = fopen( file_name, "r" );
+    TextSlice* next = NULL;
+    size_t bytes = 0;
+    tbb::tick_count t0 = tbb::tick_count::now();
+    tbb::parallel_pipeline( ntoken,
+        tbb::make_filter<void,TextSlice*>( tbb::filter::serial_in_order, FreadInput( f, &next ) ) &
+        tbb::make_filter<TextSlice*,TextSlice*>( tbb::filter::parallel, FreadSquare() ) &
+        tbb::make_filter<TextSlice*,void>( tbb::filter::serial_in_order, Output( &bytes ) ) );
+    Report( "fread (square example)", t0, input, bytes );
+    if( next )
+        next->free();
+    fclose( f );
+}
+
+void MeasureReader( const char* file_name, int ntoken, size_t input, tbb::file_reader::io_mode mode ) {
+    size_t bytes = 0;
+    tbb::tick_count t0 = tbb::tick_count::now();
+    // A line ends with a whole number, so the chunks end at the new lines
+    tbb::file_reader reader( file_name, '\n', ChunkSize, mode );
+    tbb::parallel_pipeline( ntoken,
+        reader.make_input_filter() &
+        tbb::make_filter<tbb::file_chunk,TextSlice*>( tbb::filter::parallel, ChunkSquare() ) &
+        tbb::make_filter<TextSlice*,void>( tbb::filter::serial_in_order, Output( &bytes ) ) );
+    Report( mode == tbb::file_reader::memory_map ? "file_reader memory_map" : "file_reader positional_read",
+            t0, input, bytes );
+}
+
+//! Writes random integers, a few per line, as gen_input of the square example
+size_t Generate( const char* file_name, long megabytes ) {
+    if( FILE* f = fopen( file_name, "r" ) ) {
+        fseek( f, 0, SEEK_END );
+        long size = ftell( f );
+        fclose( f );
+        if( size > 0 )
+            return size_t(size);
+    }
+    FILE* f = fopen( file_name, "w" );
+    if( !f ) {
+        REPORT( "Error: cannot create %s\n", file_name );
+        exit( 1 );
+    }
+    size_t size = 0;
+    for( long i = 0; size < size_t(megabytes) << 20; ++i )
+        size += fprintf( f, i % 8 == 7 ? "%d\n" : "%d ", rand() % 1000000 );
+    fclose( f );
+    return size;
+}
+
+int main( int argc, char* argv[] ) {
+    const int nthread = argc > 1 ? std::atoi( argv[1] ) : tbb::task_scheduler_init::default_num_threads();
+    const char* file_name = argc > 2 ? argv[2] : "time_file_reader.txt";
+    const long megabytes = argc > 3 ? std::atol( argv[3] ) : 256;
+    ChunkSize = argc > 4 ? std::strtoul( argv[4], NULL, 0 ) : 4000;
+    tbb::task_scheduler_init init( nthread );
+    const size_t input = Generate( file_name, megabytes );
+    printf( "%d threads, %lu bytes of input, %lu bytes per chunk\n", nthread, (unsigned long)input, (unsigned long)ChunkSize );
+    for( int repeat = 0; repeat < 2; ++repeat ) {
+        MeasureFread( file_name, 4*nthread, input );
+        MeasureReader( file_name, 4*nthread, input, tbb::file_reader::positional_read );
+        MeasureReader( file_name, 4*nthread, input, tbb::file_reader::memory_map );
+    }
+    return 0;
+}
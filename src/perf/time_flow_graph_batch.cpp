@@ -0,0 +1,106 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Measures the messages per second that go from a broadcast_node through an unlimited
+// function_node into a serial function_node with trivial bodies, when the messages are put one
+// by one, when they are put with try_put_batch, and when a coalescing_node in front of the
+// broadcast_node makes the batches. A batch is run in a single task by each function_node.
+//
+// Usage: time_flow_graph_batch [threads] [messages] [batch size] [repeats]
+
+#define HARNESS_CUSTOM_MAIN 1
+#define HARNESS_NO_PARSE_COMMAND_LINE 1
+#define TBB_PREVIEW_FLOW_GRAPH_NODES 1
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "tbb/flow_graph.h"
+#include "tbb/atomic.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/tick_count.h"
+#include "../test/harness.h"
+
+using namespace tbb::flow;
+
+struct PassBody {
+    int operator()( int v ) const { return v; }
+};
+
+struct CountBody {
+    long* my_count;
+    CountBody( long& count ) : my_count(&count) {}
+    continue_msg operator()( int ) const { ++*my_count; return continue_msg(); }
+};
+
+enum Method { Single, Batch, Coalescing };
+static const char* const MethodNames[] = { "try_put", "try_put_batch", "coalescing_node" };
+
+double Run( Method m, int n, int batch_size ) {
+    graph g;
+    long count = 0;
+    broadcast_node<int> start( g );
+    function_node<int, int> pass( g, unlimited, PassBody() );
+    function_node<int, continue_msg> sink( g, serial, CountBody( count ) );
+    coalescing_node<int> coalesce( g, batch_size );
+    make_edge( start, pass );
+    make_edge( pass, sink );
+    make_edge( coalesce, start );
+    std::vector<int> items( batch_size );
+    tbb::tick_count t0 = tbb::tick_count::now();
+    switch( m ) {
+    case Single:
+        for( int i = 0; i < n; ++i )
+            start.try_put( i );
+        break;
+    case Batch:
+        for( int i = 0; i < n; i += batch_size ) {
+            const int k = n - i < batch_size ? n - i : batch_size;
+            for( int j = 0; j < k; ++j )
+                items[j] = i + j;
+            start.try_put_batch( &items[0], k );
+        }
+        break;
+    case Coalescing:
+        for( int i = 0; i < n; ++i )
+            coalesce.try_put( i );
+        coalesce.flush();
+        break;
+    }
+    g.wait_for_all();
+    double t = (tbb::tick_count::now()-t0).seconds();
+    if( count != n )
+        REPORT( "Error: %s delivered %ld of %d messages\n", MethodNames[m], count, n );
+    return t;
+}
+
+int main( int argc, char* argv[] ) {
+    const int nthread = argc > 1 ? std::atoi( argv[1] ) : tbb::task_scheduler_init::default_num_threads();
+    const int n = argc > 2 ? std::atoi( argv[2] ) : 2000000;
+    const int batch_size = argc > 3 ? std::atoi( argv[3] ) : 64;
+    const int repeats = argc > 4 ? std::atoi( argv[4] ) : 3;
+    tbb::task_scheduler_init init( nthread );
+    printf( "%d threads, %d messages, batch size %d\n", nthread, n, batch_size );
+    for( int m = Single; m <= Coalescing; ++m ) {
+        double best = 0;
+        for( int r = 0; r < repeats; ++r ) {
+            double t = Run( Method(m), n, batch_size );
+            best = r == 0 || t < best ? t : best;
+        }
+        printf( "%-16s %10.2f Mmsg/s\n", MethodNames[m], best > 0 ? n/best*1e-6 : 0. );
+    }
+    return 0;
+}
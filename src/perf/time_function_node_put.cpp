@@ -0,0 +1,159 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Measures the messages per second that a parallel loop puts into a function_node or a
+// multifunction_node with a trivial body, for unlimited concurrency and for limited concurrency
+// with the queueing and the rejecting policies, with and without the lightweight policy. A thread
+// puts a chunk of messages before it runs the bodies, so with the default limit, that is above
+// the chunks of all threads, a rejecting node takes the concurrency without the aggregator and
+// does not reject; the puts it rejects anyway are counted. The last case pulls the messages from
+// a queue_node into a serial rejecting node.
+//
+// Usage: time_function_node_put [threads] [messages] [concurrency limit] [repeats]
+
+#define HARNESS_CUSTOM_MAIN 1
+#define HARNESS_NO_PARSE_COMMAND_LINE 1
+
+#include <cstdio>
+#include <cstdlib>
+#include "tbb/flow_graph.h"
+#include "tbb/parallel_for.h"
+#include "tbb/partitioner.h"
+#include "tbb/blocked_range.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "tbb/atomic.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/tick_count.h"
+#include "../test/harness.h"
+
+using namespace tbb::flow;
+
+typedef tbb::enumerable_thread_specific<long> Counter;
+
+//! The messages a thread puts before it runs the bodies
+const int ChunkSize = 64;
+
+struct CountBody {
+    Counter* my_count;
+    CountBody( Counter& count ) : my_count(&count) {}
+    int operator()( int v ) const { ++my_count->local(); return v; }
+};
+
+struct MultiCountBody {
+    Counter* my_count;
+    MultiCountBody( Counter& count ) : my_count(&count) {}
+    template<typename Ports>
+    void operator()( int v, Ports& ) const { ++my_count->local(); (void)v; }
+};
+
+template<typename Node>
+class PutBody {
+    Node& my_node;
+    tbb::atomic<long>& my_rejected;
+public:
+    PutBody( Node& node, tbb::atomic<long>& rejected ) : my_node(node), my_rejected(rejected) {}
+    void operator()( const tbb::blocked_range<int>& r ) const {
+        long rejected = 0;
+        for( int i = r.begin(); i != r.end(); ++i )
+            if( !my_node.try_put( i ) )
+                ++rejected;
+        if( rejected )
+            my_rejected += rejected;
+    }
+};
+
+struct Result {
+    double seconds;
+    long processed, rejected;
+};
+
+template<typename Node>
+Result Put( graph& g, Node& node, Counter& count, int n ) {
+    tbb::atomic<long> rejected;
+    rejected = 0;
+    tbb::tick_count t0 = tbb::tick_count::now();
+    tbb::parallel_for( tbb::blocked_range<int>( 0, n, ChunkSize ), PutBody<Node>( node, rejected ), tbb::simple_partitioner() );
+    g.wait_for_all();
+    Result res = { (tbb::tick_count::now()-t0).seconds(), count.combine( std::plus<long>() ), rejected };
+    return res;
+}
+
+template<typename Policy>
+Result RunFunctionNode( size_t concurrency, int n ) {
+    graph g;
+    Counter count;
+    function_node<int, int, Policy> node( g, concurrency, CountBody( count ) );
+    return Put( g, node, count, n );
+}
+
+template<typename Policy>
+Result RunMultifunctionNode( size_t concurrency, int n ) {
+    graph g;
+    Counter count;
+    multifunction_node<int, tuple<int>, Policy> node( g, concurrency, MultiCountBody( count ) );
+    return Put( g, node, count, n );
+}
+
+Result RunPull( int n ) {
+    graph g;
+    Counter count;
+    queue_node<int> queue( g );
+    function_node<int, int, rejecting> node( g, serial, CountBody( count ) );
+    make_edge( queue, node );
+    return Put( g, queue, count, n );
+}
+
+template<typename Run>
+void Measure( const char* name, Run run, int n, int repeats ) {
+    double best = 0;
+    Result res = Result();
+    for( int r = 0; r < repeats; ++r ) {
+        res = run( n );
+        if( res.processed + res.rejected != n )
+            REPORT( "Error: %s processed %ld and rejected %ld of %d messages\n", name, res.processed, res.rejected, n );
+        best = r == 0 || res.seconds < best ? res.seconds : best;
+    }
+    printf( "%-40s %10.2f Mmsg/s %8.2f%% rejected\n", name, best > 0 ? n/best*1e-6 : 0., 100.*res.rejected/n );
+}
+
+// Binds the policy and the concurrency limit of a case
+template<typename Policy, bool Multi>
+struct Case {
+    size_t my_concurrency;
+    Case( size_t concurrency ) : my_concurrency(concurrency) {}
+    Result operator()( int n ) const {
+        return Multi ? RunMultifunctionNode<Policy>( my_concurrency, n ) : RunFunctionNode<Policy>( my_concurrency, n );
+    }
+};
+
+int main( int argc, char* argv[] ) {
+    const int nthread = argc > 1 ? std::atoi( argv[1] ) : tbb::task_scheduler_init::default_num_threads();
+    const int n = argc > 2 ? std::atoi( argv[2] ) : 10000000;
+    const size_t limit = argc > 3 ? std::strtoul( argv[3], NULL, 0 ) : 4*ChunkSize*nthread;
+    const int repeats = argc > 4 ? std::atoi( argv[4] ) : 3;
+    tbb::task_scheduler_init init( nthread );
+    printf( "%d threads, %d messages, concurrency limit %lu\n", nthread, n, (unsigned long)limit );
+
+    Measure( "function_node unlimited", Case<queueing, false>( unlimited ), n, repeats );
+    Measure( "function_node queueing", Case<queueing, false>( limit ), n, repeats );
+    Measure( "function_node rejecting", Case<rejecting, false>( limit ), n, repeats );
+    Measure( "function_node queueing lightweight", Case<queueing_lightweight, false>( limit ), n, repeats );
+    Measure( "function_node rejecting lightweight", Case<rejecting_lightweight, false>( limit ), n, repeats );
+    Measure( "multifunction_node queueing", Case<queueing, true>( limit ), n, repeats );
+    Measure( "multifunction_node rejecting", Case<rejecting, true>( limit ), n, repeats );
+    Measure( "queue_node to serial rejecting node", RunPull, n, repeats );
+    return 0;
+}
@@ -28,6 +28,9 @@
 #define TESTTABLE 0
 #define TESTTABLEHEADER "tbb/concurrent_unordered_map.h"
 
+//! enable/disable open addressing map tests
+#define FLATTABLE 1
+
 //! avoid erase()
 #define TEST_ERASE 1
 
@@ -73,6 +76,37 @@ namespace version_current {
 }
 typedef version_current::tbb::concurrent_hash_map<int,int> IntTable;
 
+//! Counts the bytes of the arrays of more than one element, which are the buckets of a table
+static tbb::atomic<ptrdiff_t> BucketBytes;
+
+template<typename T>
+class BucketBytesAllocator : public tbb::tbb_allocator<T> {
+    typedef tbb::tbb_allocator<T> base_type;
+public:
+    typedef typename base_type::pointer pointer;
+    typedef typename base_type::size_type size_type;
+    template<typename U> struct rebind {
+        typedef BucketBytesAllocator<U> other;
+    };
+    BucketBytesAllocator() {}
+    template<typename U> BucketBytesAllocator( const BucketBytesAllocator<U>& ) {}
+    pointer allocate( size_type n, const void* = NULL ) {
+        if( n > 1 ) BucketBytes += n*sizeof(T);
+        return base_type::allocate( n );
+    }
+    void deallocate( pointer p, size_type n ) {
+        if( n > 1 ) BucketBytes -= n*sizeof(T);
+        base_type::deallocate( p, n );
+    }
+};
+typedef version_current::tbb::concurrent_hash_map<int,int,tbb::tbb_hash_compare<int>,BucketBytesAllocator<std::pair<const int,int> > > ShrinkTable;
+
+#if FLATTABLE
+#define TBB_PREVIEW_CONCURRENT_FLAT_MAP 1
+#include "tbb/concurrent_flat_map.h"
+typedef tbb::concurrent_flat_map<int,int> FlatTable;
+#endif
+
 #if OLDTABLE
 #undef __TBB_concurrent_hash_map_H
 namespace version_base {
@@ -147,6 +181,108 @@ struct TestTBBMap : TesterBase {
     }
 };
 
+static const char *batch_testnames[] = {
+    "1.insert-batch", "2.find-batch", "3.find-batch-absent", "4.erase-batch"
+};
+
+//! Same as TestTBBMap, but the keys are processed by the batch operations
+template<typename TableType>
+struct TestTBBMapBatch : TesterBase {
+    enum { batch_size = 1024 };
+    TableType Table;
+    int n_items;
+
+    TestTBBMapBatch() : TesterBase(4), Table(MaxThread*4) {}
+    void init() { n_items = value/threads_count; }
+
+    std::string get_name(int testn) {
+        return std::string(batch_testnames[testn]);
+    }
+
+    double test(int test, int t)
+    {
+        std::vector<std::pair<int,int> > items;
+        std::vector<int> keys, values;
+        std::vector<bool> found;
+        for(int b = t*n_items, e = (t+1)*n_items; b < e; b += batch_size) {
+            int be = std::min(b + batch_size, e);
+            items.clear(); keys.clear(); values.clear(); found.clear();
+            for(int i = b; i < be; i++) {
+                items.push_back( std::make_pair(i,i) );
+                keys.push_back( test == 2 ? i + value : i );
+            }
+            switch(test) {
+              case 0: // fill
+                Table.insert( items.begin(), items.end() );
+                break;
+              case 1: // work1
+              case 2: // work2
+                {
+                    size_t c = Table.find_batch( keys.begin(), keys.end(), std::back_inserter(values), std::back_inserter(found) );
+                    ASSERT( c == (test == 1 ? keys.size() : 0), NULL);
+                }
+                break;
+              case 3: // clean
+                {
+                    size_t c = Table.erase_batch( keys.begin(), keys.end() );
+                    ASSERT( c == keys.size(), NULL);
+                }
+            }
+        }
+        return 0;
+    }
+};
+
+static const char *shrink_testnames[] = {
+    "1.grow", "2.erase-shrink", "3.count-shrunk", "4.regrow", "5.erase-all"
+};
+
+//! Grows the table, erases 7/8 of the items so that the table shrinks, and grows it back
+/** With the verbose option, the memory of the buckets is reported, so TableType must use BucketBytesAllocator. */
+template<typename TableType>
+struct TestTBBMapShrink : TesterBase {
+    TableType Table;
+    int n_items;
+
+    TestTBBMapShrink() : TesterBase(5), Table(MaxThread*4) { Table.min_load_factor( 0.25f ); }
+    void init() { n_items = value/threads_count; }
+
+    std::string get_name(int testn) {
+        return std::string(shrink_testnames[testn]);
+    }
+
+    double test(int test, int t)
+    {
+        const int kept = n_items/8;
+        switch(test) {
+          case 0: // grow
+          case 3: // regrow
+            for(int i = t*n_items + (test? kept : 0), e = (t+1)*n_items; i < e; i++) {
+                Table.insert( std::make_pair(i,i) );
+            }
+            break;
+          case 1: // erase the most of items, the table shrinks concurrently
+            for(int i = t*n_items + kept, e = (t+1)*n_items; i < e; i++) {
+                ASSERT( Table.erase( i ), NULL);
+            }
+            break;
+          case 2: // access the shrunk table
+            for(int i = t*n_items, e = t*n_items + kept; i < e; i++) {
+                size_t c = Table.count( i );
+                ASSERT( c == 1, NULL);
+            }
+            break;
+          case 4: // clean
+            for(int i = t*n_items, e = (t+1)*n_items; i < e; i++) {
+                ASSERT( Table.erase( i ), NULL);
+            }
+        }
+        if( Verbose && !t )
+            printf("%s: %d items in %ld KB of buckets\n", get_name(test).c_str(), int(Table.size()), long(BucketBytes>>10));
+        return 0;
+    }
+};
+
 template<typename M>
 struct TestSTLMap : TesterBase {
     std::map<int, int> Table;
@@ -225,6 +361,11 @@ public:
             run("old::hmap", new NanosecPerValue<TestTBBMap<OldTable> >() ),
 #endif
             run("tbb::hmap", new NanosecPerValue<TestTBBMap<IntTable> >() ),
+            run("tbb::hmap-batch", new NanosecPerValue<TestTBBMapBatch<IntTable> >() ),
+            run("tbb::hmap-shrink", new NanosecPerValue<TestTBBMapShrink<ShrinkTable> >() ),
+#if FLATTABLE
+            run("tbb::flat", new NanosecPerValue<TestTBBMap<FlatTable> >() ),
+#endif
 #if TESTTABLE
             run("new::hmap", new NanosecPerValue<TestTBBMap<TestTable> >() ),
 #endif
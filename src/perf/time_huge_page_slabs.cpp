@@ -0,0 +1,90 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Measures the cost of random pointer chasing over a heap of small objects allocated
+// by tbbmalloc, that is dominated by dTLB misses for large heaps. Run it with mode 1
+// to place slabs in huge page regions (TBBMALLOC_USE_HUGE_PAGE_SLABS) and with mode 0
+// to compare with the default backend.
+
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+
+#include "tbb/scalable_allocator.h"
+#include "tbb/tick_count.h"
+
+struct Node {
+    Node* next;
+    size_t payload;
+};
+
+static volatile size_t Sink;
+
+int main( int argc, char* argv[] ) {
+    const int mode = argc > 1 ? std::atoi( argv[1] ) : 1;
+    const size_t N = argc > 2 ? std::strtoul( argv[2], NULL, 0 ) : 4 * 1024 * 1024;
+    const size_t objSize = argc > 3 ? std::strtoul( argv[3], NULL, 0 ) : 64;
+    const int numRepeats = argc > 4 ? std::atoi( argv[4] ) : 5;
+
+    if ( scalable_allocation_mode( TBBMALLOC_USE_HUGE_PAGE_SLABS, mode ) != TBBMALLOC_OK )
+        std::cout << "Huge page slabs are not supported, running with the default backend" << std::endl;
+
+    tbb::tick_count t0 = tbb::tick_count::now();
+    std::vector<Node*> nodes( N );
+    for ( size_t i = 0; i < N; ++i )
+        nodes[i] = (Node*)scalable_malloc( std::max( objSize, sizeof(Node) ) );
+    tbb::tick_count t1 = tbb::tick_count::now();
+
+    // Link the objects into a single cycle in random order.
+    std::vector<size_t> order( N );
+    for ( size_t i = 0; i < N; ++i )
+        order[i] = i;
+    std::srand( 42 );
+    for ( size_t i = N - 1; i > 0; --i )
+        std::swap( order[i], order[((size_t)std::rand() * RAND_MAX + std::rand()) % (i + 1)] );
+    for ( size_t i = 0; i < N; ++i ) {
+        nodes[order[i]]->next = nodes[order[(i + 1) % N]];
+        nodes[order[i]]->payload = i;
+    }
+
+    std::vector<double> times;
+    for ( int r = 0; r < numRepeats; ++r ) {
+        tbb::tick_count s0 = tbb::tick_count::now();
+        Node* p = nodes[order[0]];
+        size_t sum = 0;
+        for ( size_t i = 0; i < N; ++i ) {
+            sum += p->payload;
+            p = p->next;
+        }
+        Sink = sum;
+        tbb::tick_count s1 = tbb::tick_count::now();
+        times.push_back( (s1 - s0).seconds() * 1e+9 / N );
+    }
+    std::sort( times.begin(), times.end() );
+
+    tbb::tick_count t2 = tbb::tick_count::now();
+    for ( size_t i = 0; i < N; ++i )
+        scalable_free( nodes[i] );
+    tbb::tick_count t3 = tbb::tick_count::now();
+
+    std::cout << "Mode " << mode << ", " << N << " objects of " << objSize << " bytes" << std::endl
+        << "alloc " << (t1 - t0).seconds() * 1e+3 << " ms " << std::endl
+        << "free " << (t3 - t2).seconds() * 1e+3 << " ms " << std::endl
+        << "chase min " << times[0] << " ns/hop " << std::endl
+        << "chase med " << times[times.size() / 2] << " ns/hop " << std::endl;
+    return 0;
+}
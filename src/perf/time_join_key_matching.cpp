@@ -0,0 +1,99 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Measures the tuples per second that a key_matching join_node with four ports produces when
+// each port is fed by its own thread, for 1 to 4 threads. With fewer than four threads, a thread
+// feeds several ports. The successor is a lightweight unlimited function_node that counts the tuples.
+//
+// Usage: time_join_key_matching [keys] [repeats]
+
+#define HARNESS_CUSTOM_MAIN 1
+#define HARNESS_NO_PARSE_COMMAND_LINE 1
+
+#include <cstdio>
+#include <cstdlib>
+#include "tbb/flow_graph.h"
+#include "tbb/atomic.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/tick_count.h"
+#include "../test/harness.h"
+
+using namespace tbb::flow;
+
+typedef tuple<int, int, int, int> tuple_type;
+typedef join_node<tuple_type, key_matching<int> > join_type;
+
+struct KeyBody {
+    int operator()( int v ) const { return v; }
+};
+
+struct CountBody {
+    tbb::atomic<long>* my_count;
+    CountBody( tbb::atomic<long>& count ) : my_count(&count) {}
+    continue_msg operator()( const tuple_type& ) const { ++*my_count; return continue_msg(); }
+};
+
+class PutBody : NoAssign {
+    join_type& my_join;
+    int my_nthread, my_n;
+    void put( int port, int k ) const {
+        switch( port ) {
+        case 0: input_port<0>( my_join ).try_put( k ); break;
+        case 1: input_port<1>( my_join ).try_put( k ); break;
+        case 2: input_port<2>( my_join ).try_put( k ); break;
+        case 3: input_port<3>( my_join ).try_put( k ); break;
+        }
+    }
+public:
+    PutBody( join_type& j, int nthread, int n ) : my_join(j), my_nthread(nthread), my_n(n) {}
+    void operator()( int t ) const {
+        for( int i = 0; i < my_n; ++i )
+            for( int port = t; port < 4; port += my_nthread )
+                put( port, i );
+    }
+};
+
+double Run( int nthread, int n ) {
+    graph g;
+    tbb::atomic<long> count;
+    count = 0;
+    join_type j( g, KeyBody(), KeyBody(), KeyBody(), KeyBody() );
+    function_node<tuple_type, continue_msg, lightweight> sink( g, unlimited, CountBody( count ) );
+    make_edge( j, sink );
+    tbb::tick_count t0 = tbb::tick_count::now();
+    NativeParallelFor( nthread, PutBody( j, nthread, n ) );
+    g.wait_for_all();
+    double t = (tbb::tick_count::now()-t0).seconds();
+    if( count != n )
+        REPORT( "Error: %ld of %d tuples produced\n", long(count), n );
+    return t;
+}
+
+int main( int argc, char* argv[] ) {
+    const int n = argc > 1 ? std::atoi( argv[1] ) : 1000000;
+    const int repeats = argc > 2 ? std::atoi( argv[2] ) : 3;
+    tbb::task_scheduler_init init( 4 );
+    printf( "%d keys\n", n );
+    for( int p = 1; p <= 4; ++p ) {
+        double best = 0;
+        for( int r = 0; r < repeats; ++r ) {
+            double t = Run( p, n );
+            best = r == 0 || t < best ? t : best;
+        }
+        printf( "%3d threads %10.2f Mtuples/s\n", p, best > 0 ? n/best*1e-6 : 0. );
+    }
+    return 0;
+}
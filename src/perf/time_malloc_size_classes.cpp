@@ -0,0 +1,248 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Replays an allocation trace against tbbmalloc with each table of the size classes of objects
+// from 1KB to 8KB (TBBMALLOC_SET_SIZE_CLASSES), in a separate process per table, as the table
+// can be selected only before the first allocation. Every thread replays the whole trace. The
+// first replay touches the objects and measures the peak resident memory and the bytes
+// requested and given at the peak of the live objects; the others measure the throughput.
+//
+// A trace file has a line per operation: "a <id> <size>" allocates an object and "f <id>" frees
+// it. Without a file, a trace of the given number of operations is generated, with most of the
+// objects from 1KB to 3KB, as the messages of an RPC service.
+//
+// Usage: time_malloc_size_classes [threads] [trace file or -] [operations] [repeats]
+
+#define HARNESS_CUSTOM_MAIN 1
+#define HARNESS_NO_PARSE_COMMAND_LINE 1
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <map>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "tbb/scalable_allocator.h"
+#include "tbb/tick_count.h"
+#include "../test/harness.h"
+
+struct Operation {
+    unsigned slot;
+    //! 0 for a deallocation
+    unsigned size;
+};
+
+struct Trace {
+    std::vector<Operation> operations;
+    unsigned numSlots;
+};
+
+bool Load( Trace& trace, const char* file_name ) {
+    FILE* f = fopen( file_name, "r" );
+    if( !f )
+        return false;
+    std::map<unsigned long, unsigned> slots;
+    std::vector<unsigned> freeSlots;
+    trace.numSlots = 0;
+    char kind;
+    unsigned long id, size;
+    while( fscanf( f, " %c %lu", &kind, &id ) == 2 ) {
+        Operation op;
+        if( kind == 'a' && fscanf( f, "%lu", &size ) == 1 ) {
+            if( freeSlots.empty() )
+                freeSlots.push_back( trace.numSlots++ );
+            op.slot = slots[id] = freeSlots.back();
+            op.size = unsigned( size ? size : 1 );
+            freeSlots.pop_back();
+        } else if( kind == 'f' && slots.count( id ) ) {
+            op.slot = slots[id];
+            op.size = 0;
+            freeSlots.push_back( op.slot );
+            slots.erase( id );
+        } else
+            continue;
+        trace.operations.push_back( op );
+    }
+    fclose( f );
+    return true;
+}
+
+//! Generates a trace that keeps about liveObjects objects allocated
+void Generate( Trace& trace, size_t n, size_t liveObjects ) {
+    Harness::FastRandom rnd( 42 );
+    std::vector<unsigned> live, freeSlots;
+    trace.numSlots = 0;
+    trace.operations.resize( n );
+    for( size_t i = 0; i < n; ++i ) {
+        Operation& op = trace.operations[i];
+        if( live.size() < liveObjects/2 || ( live.size() < 2*liveObjects && rnd.get() % 2 ) ) {
+            if( freeSlots.empty() )
+                freeSlots.push_back( trace.numSlots++ );
+            op.slot = freeSlots.back();
+            freeSlots.pop_back();
+            unsigned r = rnd.get() % 100;
+            // 65% from 1KB to 3KB, 20% from 3KB to 8KB and 15% smaller
+            op.size = r < 65 ? 1024 + rnd.get() % 2048 : r < 85 ? 3072 + rnd.get() % 5120 : 16 + rnd.get() % 1008;
+            live.push_back( op.slot );
+        } else {
+            size_t k = rnd.get() % live.size();
+            op.slot = live[k];
+            op.size = 0;
+            live[k] = live.back();
+            live.pop_back();
+            freeSlots.push_back( op.slot );
+        }
+    }
+}
+
+//! Returns the value of the field of /proc/self/status in bytes
+size_t ReadStatus( const char* field ) {
+    size_t kb = 0;
+    if( FILE* f = fopen( "/proc/self/status", "r" ) ) {
+        char line[256];
+        const size_t len = strlen( field );
+        while( fgets( line, sizeof(line), f ) )
+            if( !strncmp( line, field, len ) && line[len] == ':' ) {
+                kb = strtoul( line+len+1, NULL, 10 );
+                break;
+            }
+        fclose( f );
+    }
+    return kb*1024;
+}
+
+struct Usage {
+    size_t requested, usable;
+    size_t peakRequested, usableAtPeak;
+    Usage() : requested(0), usable(0), peakRequested(0), usableAtPeak(0) {}
+};
+
+//! Replays the trace and frees the objects left; with Measure, touches the objects and counts the bytes
+template<bool Measure>
+void Replay( const Trace& trace, std::vector<void*>& slots, std::vector<unsigned>& sizes, Usage& u ) {
+    const Operation* ops = &trace.operations[0];
+    for( size_t i = 0, n = trace.operations.size(); i < n; ++i ) {
+        void*& p = slots[ops[i].slot];
+        if( ops[i].size ) {
+            p = scalable_malloc( ops[i].size );
+            if( Measure ) {
+                memset( p, 0, ops[i].size );
+                sizes[ops[i].slot] = ops[i].size;
+                u.requested += ops[i].size;
+                u.usable += scalable_msize( p );
+                if( u.requested > u.peakRequested ) {
+                    u.peakRequested = u.requested;
+                    u.usableAtPeak = u.usable;
+                }
+            }
+        } else {
+            if( Measure ) {
+                u.requested -= sizes[ops[i].slot];
+                u.usable -= scalable_msize( p );
+            }
+            scalable_free( p );
+            p = NULL;
+        }
+    }
+    for( size_t i = 0; i < slots.size(); ++i ) {
+        scalable_free( slots[i] );
+        slots[i] = NULL;
+    }
+}
+
+class ReplayBody {
+    const Trace& my_trace;
+    std::vector<Usage>* my_usage;
+public:
+    ReplayBody( const Trace& trace, std::vector<Usage>* usage ) : my_trace(trace), my_usage(usage) {}
+    void operator()( int i ) const {
+        std::vector<void*> slots( my_trace.numSlots );
+        std::vector<unsigned> sizes;
+        if( my_usage ) {
+            sizes.resize( my_trace.numSlots );
+            Replay<true>( my_trace, slots, sizes, (*my_usage)[i] );
+        } else {
+            Usage u;
+            Replay<false>( my_trace, slots, sizes, u );
+        }
+    }
+};
+
+static const char* const TableNames[] = { "fine", "classic" };
+
+void Measure( ScalableSizeClasses table, const Trace& trace, int nthread, int repeats ) {
+    if( scalable_allocation_mode( TBBMALLOC_SET_SIZE_CLASSES, table ) != TBBMALLOC_OK ) {
+        REPORT( "Error: the %s size classes cannot be selected\n", TableNames[table] );
+        return;
+    }
+    const size_t rssBefore = ReadStatus( "VmRSS" );
+    std::vector<Usage> usage( nthread );
+    NativeParallelFor( nthread, ReplayBody( trace, &usage ) );
+    const size_t peakRss = ReadStatus( "VmHWM" );
+    Usage total;
+    for( int i = 0; i < nthread; ++i ) {
+        total.peakRequested += usage[i].peakRequested;
+        total.usableAtPeak += usage[i].usableAtPeak;
+    }
+    double best = 0;
+    for( int r = 0; r < repeats; ++r ) {
+        tbb::tick_count t0 = tbb::tick_count::now();
+        NativeParallelFor( nthread, ReplayBody( trace, NULL ) );
+        double t = (tbb::tick_count::now()-t0).seconds();
+        best = r == 0 || t < best ? t : best;
+    }
+    const double mb = 1./(1<<20);
+    printf( "%-8s %10.2f Mops/s %12.1f MB peak RSS %12.1f MB requested %12.1f MB given (+%.1f%%)\n",
+            TableNames[table], repeats ? trace.operations.size()*nthread/best*1e-6 : 0.,
+            peakRss > rssBefore ? ( peakRss-rssBefore )*mb : 0., total.peakRequested*mb, total.usableAtPeak*mb,
+            total.peakRequested ? 100.*( total.usableAtPeak-total.peakRequested )/total.peakRequested : 0. );
+}
+
+int main( int argc, char* argv[] ) {
+    const int nthread = argc > 1 ? std::atoi( argv[1] ) : 1;
+    const char* file_name = argc > 2 && strcmp( argv[2], "-" ) ? argv[2] : NULL;
+    const size_t n = argc > 3 ? std::strtoul( argv[3], NULL, 0 ) : 10000000;
+    const int repeats = argc > 4 ? std::atoi( argv[4] ) : 3;
+    // The trace is kept in the memory of the C++ library, so that tbbmalloc is not initialized
+    Trace trace;
+    if( file_name ) {
+        if( !Load( trace, file_name ) ) {
+            REPORT( "Error: cannot read %s\n", file_name );
+            return 1;
+        }
+    } else
+        Generate( trace, n, 100000 );
+    if( trace.operations.empty() ) {
+        REPORT( "Error: the trace is empty\n" );
+        return 1;
+    }
+    printf( "%d threads, %lu operations, %u objects at most\n", nthread,
+            (unsigned long)trace.operations.size(), trace.numSlots );
+    for( int table = TBBMALLOC_SIZE_CLASSES_FINE; table <= TBBMALLOC_SIZE_CLASSES_CLASSIC; ++table ) {
+        fflush( stdout );
+        pid_t pid = fork();
+        if( pid == 0 ) {
+            Measure( ScalableSizeClasses(table), trace, nthread, repeats );
+            fflush( stdout );
+            _exit( 0 );
+        }
+        int status;
+        if( pid < 0 || waitpid( pid, &status, 0 ) != pid || !WIFEXITED( status ) )
+            REPORT( "Error: the measurement of the %s size classes failed\n", TableNames[table] );
+    }
+    return 0;
+}
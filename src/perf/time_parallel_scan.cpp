@@ -0,0 +1,110 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Measures the prefix sums of a large array by std::partial_sum, by parallel_scan with
+// a body, and by parallel_inclusive_scan into another array and in place. Each run is
+// repeated and the best and the worst times are reported, to show both the speed and
+// its variation.
+//
+// Usage: time_parallel_scan [threads] [elements] [repeats]
+
+#define HARNESS_CUSTOM_MAIN 1
+#define HARNESS_NO_PARSE_COMMAND_LINE 1
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <numeric>
+#include "tbb/parallel_scan.h"
+#include "tbb/blocked_range.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/tick_count.h"
+#include "../test/harness.h"
+
+typedef long long value_type;
+
+class ScanBody {
+    value_type my_sum;
+    const value_type* const my_input;
+    value_type* const my_output;
+public:
+    ScanBody( const value_type* input, value_type* output ) : my_sum(0), my_input(input), my_output(output) {}
+    ScanBody( ScanBody& b, tbb::split ) : my_sum(0), my_input(b.my_input), my_output(b.my_output) {}
+    template<typename Tag>
+    void operator()( const tbb::blocked_range<size_t>& r, Tag ) {
+        value_type sum = my_sum;
+        for( size_t i = r.begin(); i < r.end(); ++i ) {
+            sum += my_input[i];
+            if( Tag::is_final_scan() )
+                my_output[i] = sum;
+        }
+        my_sum = sum;
+    }
+    void reverse_join( ScanBody& a ) { my_sum = a.my_sum + my_sum; }
+    void assign( ScanBody& b ) { my_sum = b.my_sum; }
+};
+
+enum Method { PartialSum, ParallelScan, InclusiveScan, InclusiveScanInPlace };
+static const char* const MethodNames[] = {
+    "std::partial_sum", "parallel_scan", "parallel_inclusive_scan", "parallel_inclusive_scan in place"
+};
+
+void Run( Method m, std::vector<value_type>& input, std::vector<value_type>& output ) {
+    switch( m ) {
+    case PartialSum:
+        std::partial_sum( input.begin(), input.end(), output.begin() );
+        break;
+    case ParallelScan: {
+        ScanBody body( &input[0], &output[0] );
+        tbb::parallel_scan( tbb::blocked_range<size_t>( 0, input.size() ), body );
+        break;
+    }
+    case InclusiveScan:
+        tbb::parallel_inclusive_scan( input.begin(), input.end(), output.begin() );
+        break;
+    case InclusiveScanInPlace:
+        tbb::parallel_inclusive_scan( output.begin(), output.end(), output.begin() );
+        break;
+    }
+}
+
+int main( int argc, char* argv[] ) {
+    const int nthread = argc > 1 ? std::atoi( argv[1] ) : tbb::task_scheduler_init::default_num_threads();
+    const size_t n = argc > 2 ? std::strtoul( argv[2], NULL, 0 ) : 100000000;
+    const int repeats = argc > 3 ? std::atoi( argv[3] ) : 5;
+    tbb::task_scheduler_init init( nthread );
+    std::vector<value_type> input( n ), output( n ), expected( n );
+    for( size_t i = 0; i < n; ++i )
+        input[i] = value_type( i % 1000 );
+    std::partial_sum( input.begin(), input.end(), expected.begin() );
+    printf( "%d threads, %lu elements of %d bytes\n", nthread, (unsigned long)n, int(sizeof(value_type)) );
+    for( int m = PartialSum; m <= InclusiveScanInPlace; ++m ) {
+        double best = 0, worst = 0;
+        for( int r = 0; r < repeats; ++r ) {
+            if( m == InclusiveScanInPlace )
+                output = input;
+            tbb::tick_count t0 = tbb::tick_count::now();
+            Run( Method(m), input, output );
+            double t = (tbb::tick_count::now()-t0).seconds();
+            if( output != expected )
+                REPORT( "Error: %s gives a wrong result\n", MethodNames[m] );
+            best = r == 0 || t < best ? t : best;
+            worst = t > worst ? t : worst;
+        }
+        printf( "%-34s best %8.3f s %8.2f Gelements/s   worst %8.3f s\n", MethodNames[m], best, n/best*1e-9, worst );
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Measures the throughput of a pipeline whose items pass the input buffers of serial filters.
+// The pipeline is a serial input filter followed by the given number of stages, where each
+// stage is a parallel filter with a small amount of work and a serial filter that only
+// checks the order of the items. The throughput is reported in items per second for
+// serial_in_order and serial_out_of_order stages, for 1 to the given number of stages.
+//
+// Usage: time_pipeline_stages [threads] [stages] [items] [tokens] [work]
+
+#define HARNESS_CUSTOM_MAIN 1
+#define HARNESS_NO_PARSE_COMMAND_LINE 1
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "tbb/pipeline.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/tick_count.h"
+#include "../test/harness.h"
+
+static int Work = 100;
+
+class InputBody {
+    long* my_next;
+    long my_count;
+public:
+    InputBody( long* next, long count ) : my_next(next), my_count(count) {}
+    long operator()( tbb::flow_control& fc ) const {
+        if( *my_next == my_count ) {
+            fc.stop();
+            return 0;
+        }
+        return (*my_next)++;
+    }
+};
+
+struct ParallelBody {
+    long operator()( long item ) const {
+        volatile long x = item;
+        for( int i = 0; i < Work; ++i )
+            x = x + i;
+        return item;
+    }
+};
+
+class SerialBody {
+    long* my_expected;
+public:
+    SerialBody( long* expected ) : my_expected(expected) {}
+    long operator()( long item ) const {
+        if( my_expected ) {
+            if( item != *my_expected )
+                REPORT("Error: item %ld arrived in place of %ld\n", item, *my_expected);
+            ++*my_expected;
+        }
+        return item;
+    }
+};
+
+struct OutputBody {
+    void operator()( long ) const {}
+};
+
+double Measure( int nstage, tbb::filter::mode mode, long nitem, size_t ntoken ) {
+    long next = 0;
+    std::vector<long> expected( nstage, 0 );
+    tbb::filter_t<void,long> pipe = tbb::make_filter<void,long>( tbb::filter::serial_in_order, InputBody( &next, nitem ) );
+    for( int s = 0; s < nstage; ++s )
+        pipe = pipe & tbb::make_filter<long,long>( tbb::filter::parallel, ParallelBody() )
+                    & tbb::make_filter<long,long>( mode, SerialBody( mode == tbb::filter::serial_in_order ? &expected[s] : NULL ) );
+    tbb::filter_t<void,void> all = pipe & tbb::make_filter<long,void>( tbb::filter::serial_out_of_order, OutputBody() );
+    tbb::tick_count t0 = tbb::tick_count::now();
+    tbb::parallel_pipeline( ntoken, all );
+    tbb::tick_count t1 = tbb::tick_count::now();
+    return nitem/(t1-t0).seconds();
+}
+
+int main( int argc, char* argv[] ) {
+    const int nthread = argc > 1 ? std::atoi( argv[1] ) : tbb::task_scheduler_init::default_num_threads();
+    const int nstage = argc > 2 ? std::atoi( argv[2] ) : 8;
+    const long nitem = argc > 3 ? std::atol( argv[3] ) : 1000000;
+    const size_t ntoken = argc > 4 ? std::strtoul( argv[4], NULL, 0 ) : 4*nthread;
+    Work = argc > 5 ? std::atoi( argv[5] ) : 100;
+    tbb::task_scheduler_init init( nthread );
+    printf( "%d threads, %ld items, %lu tokens, %d iterations of work per parallel stage\n",
+            nthread, nitem, (unsigned long)ntoken, Work );
+    printf( "%8s %22s %22s\n", "stages", "serial_in_order", "serial_out_of_order" );
+    for( int s = 1; s <= nstage; ++s ) {
+        double in_order = Measure( s, tbb::filter::serial_in_order, nitem, ntoken );
+        double out_of_order = Measure( s, tbb::filter::serial_out_of_order, nitem, ntoken );
+        printf( "%8d %16.3f Mitems/s %16.3f Mitems/s\n", s, in_order*1e-6, out_of_order*1e-6 );
+    }
+    return 0;
+}
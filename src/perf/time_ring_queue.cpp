@@ -0,0 +1,158 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Measures the latency of passing items from producers to consumers through a queue.
+// Every item carries the time of its push; consumers collect the time from push to pop
+// into a histogram with power of two buckets in nanoseconds. The run is repeated for
+// concurrent_ring_queue, concurrent_bounded_queue and concurrent_queue (polled by try_pop).
+//
+// Usage: time_ring_queue [producers] [consumers] [items per producer] [capacity]
+
+#define HARNESS_CUSTOM_MAIN 1
+#define HARNESS_NO_PARSE_COMMAND_LINE 1
+#define TBB_PREVIEW_CONCURRENT_RING_QUEUE 1
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "tbb/concurrent_ring_queue.h"
+#include "tbb/concurrent_queue.h"
+#include "tbb/tick_count.h"
+#include "tbb/atomic.h"
+#include "../test/harness.h"
+
+struct Stamp {
+    tbb::tick_count pushed;
+    long value;
+};
+
+const int NumBuckets = 32;
+
+struct Histogram {
+    long counts[NumBuckets];
+    double max_ns;
+    Histogram() : max_ns(0) { std::fill( counts, counts+NumBuckets, 0 ); }
+    void add( double ns ) {
+        int b = 0;
+        for( double bound = 1; b < NumBuckets-1 && ns >= bound; bound *= 2 )
+            ++b;
+        ++counts[b];
+        if( ns > max_ns ) max_ns = ns;
+    }
+    void merge( const Histogram& other ) {
+        for( int b = 0; b < NumBuckets; ++b )
+            counts[b] += other.counts[b];
+        if( other.max_ns > max_ns ) max_ns = other.max_ns;
+    }
+    //! The upper bound of the bucket that contains the given quantile
+    double quantile( double q ) const {
+        long total = 0;
+        for( int b = 0; b < NumBuckets; ++b ) total += counts[b];
+        long seen = 0;
+        for( int b = 0; b < NumBuckets; ++b ) {
+            seen += counts[b];
+            if( seen >= q*total )
+                return double(1L<<b);
+        }
+        return max_ns;
+    }
+};
+
+//! Adapters that give the same blocking interface to the queues under test
+struct RingQueue {
+    static const char* name() { return "concurrent_ring_queue"; }
+    tbb::concurrent_ring_queue<Stamp> q;
+    RingQueue( size_t capacity ) : q( capacity ) {}
+    void push( const Stamp& s ) { q.push( s ); }
+    void pop( Stamp& s ) { q.pop( s ); }
+};
+
+struct BoundedQueue {
+    static const char* name() { return "concurrent_bounded_queue"; }
+    tbb::concurrent_bounded_queue<Stamp> q;
+    BoundedQueue( size_t capacity ) { q.set_capacity( capacity ); }
+    void push( const Stamp& s ) { q.push( s ); }
+    void pop( Stamp& s ) { q.pop( s ); }
+};
+
+struct UnboundedQueue {
+    static const char* name() { return "concurrent_queue"; }
+    tbb::concurrent_queue<Stamp> q;
+    UnboundedQueue( size_t ) {}
+    void push( const Stamp& s ) { q.push( s ); }
+    void pop( Stamp& s ) { while( !q.try_pop( s ) ) __TBB_Yield(); }
+};
+
+template<typename Queue>
+class LatencyBody: NoAssign {
+    Queue& my_queue;
+    const int my_producers, my_consumers;
+    const long my_items;
+    std::vector<Histogram>& my_histograms;
+public:
+    LatencyBody( Queue& q, int producers, int consumers, long items, std::vector<Histogram>& h )
+        : my_queue(q), my_producers(producers), my_consumers(consumers), my_items(items), my_histograms(h) {}
+    void operator()( int k ) const {
+        if( k < my_producers ) {
+            for( long i = 0; i < my_items; ++i ) {
+                Stamp s;
+                s.value = i;
+                s.pushed = tbb::tick_count::now();
+                my_queue.push( s );
+            }
+        } else {
+            const long total = my_items*my_producers;
+            const int c = k-my_producers;
+            long n = total/my_consumers + (c == my_consumers-1 ? total%my_consumers : 0);
+            Histogram& h = my_histograms[c];
+            for( Stamp s; n > 0; --n ) {
+                my_queue.pop( s );
+                h.add( (tbb::tick_count::now()-s.pushed).seconds()*1e+9 );
+            }
+        }
+    }
+};
+
+template<typename Queue>
+void Measure( int producers, int consumers, long items, size_t capacity ) {
+    Queue queue( capacity );
+    std::vector<Histogram> histograms( consumers );
+    tbb::tick_count t0 = tbb::tick_count::now();
+    NativeParallelFor( producers+consumers, LatencyBody<Queue>( queue, producers, consumers, items, histograms ) );
+    tbb::tick_count t1 = tbb::tick_count::now();
+    Histogram h;
+    for( int c = 0; c < consumers; ++c )
+        h.merge( histograms[c] );
+    printf( "%-26s %8.1f Mitems/s  p50 < %8.0f ns  p99 < %8.0f ns  p99.9 < %8.0f ns  max %10.0f ns\n",
+            Queue::name(), items*producers/(t1-t0).seconds()*1e-6,
+            h.quantile( 0.5 ), h.quantile( 0.99 ), h.quantile( 0.999 ), h.max_ns );
+    for( int b = 0; b < NumBuckets; ++b )
+        if( h.counts[b] )
+            printf( "    < %10ld ns %10ld\n", 1L<<b, h.counts[b] );
+}
+
+int main( int argc, char* argv[] ) {
+    const int producers = argc > 1 ? std::atoi( argv[1] ) : 2;
+    const int consumers = argc > 2 ? std::atoi( argv[2] ) : 2;
+    const long items = argc > 3 ? std::atol( argv[3] ) : 1000000;
+    const size_t capacity = argc > 4 ? std::strtoul( argv[4], NULL, 0 ) : 1024;
+    printf( "%d producers, %d consumers, %ld items per producer, capacity %lu\n",
+            producers, consumers, items, (unsigned long)capacity );
+    Measure<RingQueue>( producers, consumers, items, capacity );
+    Measure<BoundedQueue>( producers, consumers, items, capacity );
+    Measure<UnboundedQueue>( producers, consumers, items, capacity );
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Compares parallel_sort, parallel_stable_sort and parallel_radix_sort on keys of different
+// widths and distributions. The throughput is reported in millions of keys per second, and
+// each result is checked against std::sort.
+//
+// Usage: time_sort [threads] [keys]
+
+#define HARNESS_CUSTOM_MAIN 1
+#define HARNESS_NO_PARSE_COMMAND_LINE 1
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include "tbb/parallel_sort.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/tick_count.h"
+#include "../test/harness.h"
+
+enum Distribution { Uniform, SmallRange, Sorted, Reversed, FewUnique };
+
+static const char* const DistributionNames[] = { "uniform", "small range", "sorted", "reversed", "few unique" };
+
+template<typename T>
+void Generate( std::vector<T>& v, Distribution d ) {
+    Harness::FastRandom rnd( 42 );
+    for( size_t i = 0; i < v.size(); ++i ) {
+        unsigned long long x = (unsigned long long)rnd.get() << 48 ^ (unsigned long long)rnd.get() << 32
+                             ^ (unsigned long long)rnd.get() << 16 ^ rnd.get();
+        switch( d ) {
+        case SmallRange: x %= 1000; break;
+        case FewUnique: x %= 16; x <<= 20; break;
+        default: break;
+        }
+        v[i] = T( x );
+        // non-integral values of the floating point types
+        if( T(3)/T(2) > T(1) )
+            v[i] /= T(7);
+    }
+    if( d == Sorted || d == Reversed )
+        std::sort( v.begin(), v.end() );
+    if( d == Reversed )
+        std::reverse( v.begin(), v.end() );
+}
+
+struct QuickSort {
+    static const char* name() { return "parallel_sort"; }
+    template<typename T> static void sort( std::vector<T>& v ) { tbb::parallel_sort( v.begin(), v.end() ); }
+};
+
+struct StableSort {
+    static const char* name() { return "parallel_stable_sort"; }
+    template<typename T> static void sort( std::vector<T>& v ) { tbb::parallel_stable_sort( v.begin(), v.end() ); }
+};
+
+struct RadixSort {
+    static const char* name() { return "parallel_radix_sort"; }
+    template<typename T> static void sort( std::vector<T>& v ) { tbb::parallel_radix_sort( v.begin(), v.end() ); }
+};
+
+template<typename Sort, typename T>
+double Measure( const std::vector<T>& input, const std::vector<T>& expected ) {
+    std::vector<T> v( input );
+    tbb::tick_count t0 = tbb::tick_count::now();
+    Sort::sort( v );
+    double t = (tbb::tick_count::now()-t0).seconds();
+    if( v != expected )
+        REPORT( "Error: %s gives a wrong result\n", Sort::name() );
+    return input.size()/t*1e-6;
+}
+
+template<typename T>
+void MeasureType( const char* name, size_t n ) {
+    for( int d = Uniform; d <= FewUnique; ++d ) {
+        std::vector<T> input( n );
+        Generate( input, Distribution(d) );
+        std::vector<T> expected( input );
+        std::sort( expected.begin(), expected.end() );
+        double quick = Measure<QuickSort>( input, expected );
+        double stable = Measure<StableSort>( input, expected );
+        double radix = Measure<RadixSort>( input, expected );
+        printf( "%-20s %-12s %22.1f %22.1f %22.1f\n", name, DistributionNames[d], quick, stable, radix );
+    }
+}
+
+int main( int argc, char* argv[] ) {
+    const int nthread = argc > 1 ? std::atoi( argv[1] ) : tbb::task_scheduler_init::default_num_threads();
+    const size_t n = argc > 2 ? std::strtoul( argv[2], NULL, 0 ) : 10000000;
+    tbb::task_scheduler_init init( nthread );
+    printf( "%d threads, %lu keys; millions of keys per second\n", nthread, (unsigned long)n );
+    printf( "%-20s %-12s %22s %22s %22s\n", "key", "distribution", QuickSort::name(), StableSort::name(), RadixSort::name() );
+    MeasureType<unsigned char>( "unsigned char", n );
+    MeasureType<unsigned short>( "unsigned short", n );
+    MeasureType<int>( "int", n );
+    MeasureType<unsigned long long>( "unsigned long long", n );
+    MeasureType<float>( "float", n );
+    MeasureType<double>( "double", n );
+    return 0;
+}
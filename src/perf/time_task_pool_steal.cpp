@@ -0,0 +1,100 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Measures the throughput of stealing from a single producer and the latency between
+// spawning a task and the start of its execution. Build the library with
+// -D__TBB_LOCKFREE_TASK_POOL=1 and without it to compare the lock-free task pool
+// with the default one.
+
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+
+#include "tbb/task.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/tick_count.h"
+
+static volatile int Sink;
+
+class LeafTask : public tbb::task {
+    tbb::tick_count my_spawn_time;
+    double* my_latency;
+    int my_grain;
+    tbb::task* execute() __TBB_override {
+        *my_latency = (tbb::tick_count::now() - my_spawn_time).seconds()*1e+6;
+        for ( int i = 0; i < my_grain; ++i )
+            Sink = Sink + i;
+        return NULL;
+    }
+public:
+    LeafTask( double* latency, int grain ) : my_spawn_time(tbb::tick_count::now()), my_latency(latency), my_grain(grain) {}
+};
+
+//! Spawns all the leaves one by one, so that every worker has to steal from the producer.
+class ProducerTask : public tbb::task {
+    std::vector<double>& my_latencies;
+    int my_grain;
+    tbb::task* execute() __TBB_override {
+        const int n = (int)my_latencies.size();
+        set_ref_count( n + 1 );
+        for ( int i = 0; i < n; ++i )
+            spawn( *new( allocate_child() ) LeafTask( &my_latencies[i], my_grain ) );
+        wait_for_all();
+        return NULL;
+    }
+public:
+    ProducerTask( std::vector<double>& latencies, int grain ) : my_latencies(latencies), my_grain(grain) {}
+};
+
+void test( int threads, const int N, const int grain, const int numRepeats ) {
+    tbb::task_scheduler_init init( threads );
+    std::vector<double> latencies( N );
+    std::vector<double> all_latencies;
+    std::vector<double> rates;
+    all_latencies.reserve( (size_t)N * numRepeats );
+    rates.reserve( numRepeats );
+
+    for ( int i = 0; i < numRepeats; ++i ) {
+        tbb::tick_count t0 = tbb::tick_count::now();
+        tbb::task::spawn_root_and_wait( *new( tbb::task::allocate_root() ) ProducerTask( latencies, grain ) );
+        tbb::tick_count t1 = tbb::tick_count::now();
+        rates.push_back( N / (t1 - t0).seconds() * 1e-6 );
+        all_latencies.insert( all_latencies.end(), latencies.begin(), latencies.end() );
+    }
+
+    std::sort( rates.begin(), rates.end() );
+    std::sort( all_latencies.begin(), all_latencies.end() );
+    const size_t n = all_latencies.size();
+    std::cout << "Threads " << threads << std::endl
+        << "throughput med " << rates[rates.size() / 2] << " Mtasks/s " << std::endl
+        << "latency p50 " << all_latencies[n / 2] << " us " << std::endl
+        << "latency p99 " << all_latencies[n - n / 100 - 1] << " us " << std::endl
+        << "latency p99.9 " << all_latencies[n - n / 1000 - 1] << " us " << std::endl
+        << "latency max " << all_latencies[n - 1] << " us " << std::endl;
+}
+
+int main( int argc, char* argv[] ) {
+    const int N = argc > 1 ? std::atoi( argv[1] ) : 100 * 1000;
+    const int grain = argc > 2 ? std::atoi( argv[2] ) : 100;
+    const int numRepeats = argc > 3 ? std::atoi( argv[3] ) : 10;
+    const int maxThreads = argc > 4 ? std::atoi( argv[4] ) : tbb::task_scheduler_init::default_num_threads();
+
+    for ( int p = 1; p <= maxThreads; p *= 2 )
+        test( p, N, grain, numRepeats );
+
+    return 0;
+}
@@ -208,6 +208,63 @@ public:
     }
 };
 
+/************************************************************************/
+/* TEST4                                                                */
+/************************************************************************/
+static volatile double Sink;
+
+class vector_test4 {
+    typedef tbb::concurrent_vector<double> vector_t;
+    const char *mode;
+    const bool contiguous;
+    static const int ntrial = 10;
+    StatisticsCollector &stat;
+
+    struct fill_body {
+        vector_t &v;
+        fill_body(vector_t &vector) : v(vector) {}
+        void operator()(const tbb::blocked_range<size_t> &r) const {
+            for (size_t i = r.begin(); i != r.end(); ++i)
+                v.push_back( double(i) );
+        }
+    };
+
+public:
+    vector_test4(const char *m, bool c, StatisticsCollector &s)  :  mode(m), contiguous(c), stat(s) {}
+
+    vector_test4 &operator()(size_t len) {
+        if(Verbose) printf("test4<%s>(%u): concurrent growth and traversal\n", mode, unsigned(len));
+        StatisticsCollector::TestCase fill_key = stat.SetTestCase("concurrent push_back", mode, len);
+        StatisticsCollector::TestCase index_key = stat.SetTestCase("sum by index", mode, len);
+        StatisticsCollector::TestCase data_key = stat.SetTestCase("sum by data()", mode, len);
+        for (int i = 0; i < ntrial; i++) {
+            Timer timer0;
+            vector_t *v = contiguous ? new vector_t(tbb::contiguous_reserve(), len) : new vector_t;
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, len, 1024), fill_body(*v));
+            Timer timer1;
+            double sum = 0;
+            for (size_t j = 0; j < len; j++)
+                sum += (*v)[j];
+            Timer timer2;
+            // only the contiguous storage can be traversed as a plain array, that the compiler can vectorize
+            if (const double *p = v->data()) {
+                double data_sum = 0;
+                for (size_t j = 0; j < len; j++)
+                    data_sum += p[j];
+                stat.AddRoundResult( data_key, timer2.get_time()*1e+3 );
+                ASSERT( data_sum == sum, NULL );
+            }
+            Sink = sum;
+            stat.AddRoundResult( fill_key, timer0.diff_time(timer1)*1e+3 );
+            stat.AddRoundResult( index_key, timer1.diff_time(timer2)*1e+3 );
+            delete v;
+        }
+        stat.SetStatisticFormula("1Average", "=AVERAGE(ROUNDS)");
+        stat.SetStatisticFormula("2+/-", "=(MAX(ROUNDS)-MIN(ROUNDS))/2");
+        return *this;
+    }
+};
+
 /************************************************************************/
 /* TYPES SET FOR TESTS                                                  */
 /************************************************************************/
@@ -238,6 +295,12 @@ int main(int argc, char* argv[]) {
         types_set(2, ("Vectors performance test #2 for %d", MaxThread), (MaxThread) )
     if(!MinThread || MinThread == 3)
         types_set(3, ("Vectors performance test #3 for %d", MaxThread), (MaxThread) )
+    if(!MinThread || MinThread == 4) {
+        StatisticsCollector Collector("time_vector4"); Collector.SetTitle("Vectors performance test #4 for %d", MaxThread);
+        vector_test4("TBB:segmented", false, Collector)(MaxThread);
+        vector_test4("TBB:contiguous", true, Collector)(MaxThread);
+        Collector.Print(StatisticsCollector::Stdout|StatisticsCollector::HTMLFile|StatisticsCollector::ExcelXML);
+    }
 
     if(!Verbose) printf("done\n");
     return 0;
@@ -82,7 +82,12 @@ void generic_scheduler::attach_arena( arena* a, size_t index, bool is_master ) {
     my_arena = a;
     my_arena_index = index;
     my_arena_slot = a->my_slots + index;
+#if __TBB_NUMA_SUPPORT
+    __TBB_ASSERT( my_arena_slot->my_scheduler == this, "The slot must be occupied before attaching to it" );
+    my_numa_steal_failures = 0;
+#endif /*__TBB_NUMA_SUPPORT*/
     attach_mailbox( affinity_id(index+1) );
+    TRACE_SCHEDULER_EVENT( *this, tek_arena_enter, a, index );
     if ( is_master && my_inbox.is_idle_state( true ) ) {
         // Master enters an arena with its own task to be executed. It means that master is not
         // going to enter stealing loop and take affinity tasks.
@@ -108,8 +113,27 @@ void generic_scheduler::attach_arena( arena* a, size_t index, bool is_master ) {
 #endif /* __TBB_TASK_PRIORITY */
 }
 
-inline static bool occupy_slot( generic_scheduler*& slot, generic_scheduler& s ) {
-    return !slot && as_atomic( slot ).compare_and_swap( &s, NULL ) == NULL;
+bool arena::occupy_slot( size_t index, generic_scheduler& s ) {
+    arena_slot& slot = my_slots[index];
+    if ( slot.my_scheduler || as_atomic( slot.my_scheduler ).compare_and_swap( &s, NULL ) != NULL )
+        return false;
+#if __TBB_NUMA_SUPPORT
+    if ( my_numa_aware_stealing ) {
+        // The node is queried once per thread, so it is precise only for threads bound to NUMA nodes.
+        if ( s.my_numa_node == generic_scheduler::not_sampled_numa_node )
+            s.my_numa_node = numa_topology::current_node();
+        slot.my_numa_node = s.my_numa_node;
+    }
+#endif /*__TBB_NUMA_SUPPORT*/
+    return true;
+}
+
+void arena::release_slot( size_t index ) {
+    __TBB_ASSERT( my_slots[index].my_scheduler, "A slot is already empty" );
+#if __TBB_NUMA_SUPPORT
+    my_slots[index].my_numa_node = -1;
+#endif /*__TBB_NUMA_SUPPORT*/
+    __TBB_store_with_release( my_slots[index].my_scheduler, (generic_scheduler*)NULL );
 }
 
 size_t arena::occupy_free_slot_in_range( generic_scheduler& s, size_t lower, size_t upper ) {
@@ -120,9 +144,9 @@ size_t arena::occupy_free_slot_in_range( generic_scheduler& s, size_t lower, siz
     __TBB_ASSERT( index >= lower && index < upper, NULL );
     // Find a free slot
     for ( size_t i = index; i < upper; ++i )
-        if ( occupy_slot(my_slots[i].my_scheduler, s) ) return i;
+        if ( occupy_slot(i, s) ) return i;
     for ( size_t i = lower; i < index; ++i )
-        if ( occupy_slot(my_slots[i].my_scheduler, s) ) return i;
+        if ( occupy_slot(i, s) ) return i;
     return out_of_arena;
 }
 
@@ -204,12 +228,13 @@ void arena::process( generic_scheduler& s ) {
     if ( s.my_offloaded_tasks )
         orphan_offloaded_tasks( s );
 #endif /* __TBB_TASK_PRIORITY */
+    TRACE_SCHEDULER_EVENT( s, tek_arena_leave, this, index );
 #if __TBB_STATISTICS
     ++s.my_counters.arena_roundtrips;
     *my_slots[index].my_counters += s.my_counters;
     s.my_counters.reset();
 #endif /* __TBB_STATISTICS */
-    __TBB_store_with_release( my_slots[index].my_scheduler, (generic_scheduler*)NULL );
+    release_slot( index );
     s.my_arena_slot = 0; // detached from slot
     s.my_inbox.detach();
     __TBB_ASSERT( s.my_inbox.is_idle_state(true), NULL );
@@ -241,6 +266,9 @@ arena::arena ( market& m, unsigned num_slots, unsigned num_reserved_slots ) {
     my_bottom_priority = my_top_priority = normalized_normal_priority;
 #endif /* __TBB_TASK_PRIORITY */
     my_aba_epoch = m.my_arenas_aba_epoch;
+#if __TBB_NUMA_SUPPORT
+    my_numa_aware_stealing = global_control::active_value(global_control::numa_aware_stealing) != 0;
+#endif /*__TBB_NUMA_SUPPORT*/
 #if __TBB_ARENA_OBSERVER
     my_observers.my_arena = this;
 #endif
@@ -260,6 +288,9 @@ arena::arena ( market& m, unsigned num_slots, unsigned num_reserved_slots ) {
         mailbox(i+1).construct();
         ITT_SYNC_CREATE(&mailbox(i+1), SyncType_Scheduler, SyncObj_Mailbox);
         my_slots[i].hint_for_pop = i;
+#if __TBB_NUMA_SUPPORT
+        my_slots[i].my_numa_node = -1;
+#endif /*__TBB_NUMA_SUPPORT*/
 #if __TBB_PREVIEW_CRITICAL_TASKS
         my_slots[i].hint_for_critical = i;
 #endif
@@ -613,6 +644,11 @@ void arena::enqueue_task( task& t, intptr_t prio, FastRandom &random )
     }
     __TBB_ASSERT(t.prefix().affinity==affinity_id(0), "affinity is ignored for enqueued tasks");
 #endif /* TBB_USE_ASSERT */
+#if __TBB_SCHEDULER_TRACE
+    if( scheduler_trace::enabled() )
+        if( generic_scheduler* s = governor::local_scheduler_if_initialized() )
+            TRACE_SCHEDULER_EVENT( *s, tek_enqueue, &t, 0 );
+#endif /* __TBB_SCHEDULER_TRACE */
 #if __TBB_PREVIEW_CRITICAL_TASKS
 
 #if __TBB_TASK_PRIORITY
@@ -763,9 +799,9 @@ void generic_scheduler::nested_arena_exit() {
 #endif
     if( !is_worker() && my_arena_index >= my_arena->my_num_reserved_slots )
         my_arena->my_market->adjust_demand(*my_arena, 1);
+    TRACE_SCHEDULER_EVENT( *this, tek_arena_leave, my_arena, my_arena_index );
     // Free the master slot.
-    __TBB_ASSERT(my_arena->my_slots[my_arena_index].my_scheduler, "A slot is already empty");
-    __TBB_store_with_release(my_arena->my_slots[my_arena_index].my_scheduler, (generic_scheduler*)NULL);
+    my_arena->release_slot( my_arena_index );
     my_arena->my_exit_monitors.notify_one(); // do not relax!
 }
 
@@ -1154,8 +1190,7 @@ void task_arena_base::internal_wait() const {
                 s->wait_until_empty();
     } else for(;;) {
         while( my_arena->my_pool_state != arena::SNAPSHOT_EMPTY ) {
-            if( !__TBB_load_with_acquire(my_arena->my_slots[0].my_scheduler) // TODO TEMP: one master, make more masters
-                && as_atomic(my_arena->my_slots[0].my_scheduler).compare_and_swap(s, NULL) == NULL ) {
+            if( my_arena->occupy_slot(0, *s) ) { // TODO TEMP: one master, make more masters
                 nested_arena_context a(s, my_arena, 0, scheduler_properties::worker, false);
                 s->wait_until_empty();
             } else {
@@ -202,6 +202,10 @@ struct arena_base : padded<intrusive_list_node> {
 #if __TBB_NUMA_SUPPORT
     //! Pointer to internal observer that allows to bind threads in arena to certain NUMA node.
     numa_binding_observer* my_numa_binding_observer;
+
+    //! Threads steal from victims on their own NUMA node first.
+    /** Taken from global_control::numa_aware_stealing when the arena is created. **/
+    bool my_numa_aware_stealing;
 #endif /*__TBB_NUMA_SUPPORT*/
 
 #if __TBB_TASK_PRIORITY
@@ -385,6 +389,10 @@ public:
     size_t occupy_free_slot( generic_scheduler& s );
     //! Tries to occupy a slot in the specified range.
     size_t occupy_free_slot_in_range( generic_scheduler& s, size_t lower, size_t upper );
+    //! Tries to occupy the slot with the given index. Records the NUMA node of the thread in the occupied slot.
+    bool occupy_slot( size_t index, generic_scheduler& s );
+    //! Makes the slot with the given index free.
+    void release_slot( size_t index );
 
     /** Must be the last data field */
     arena_slot my_slots[1];
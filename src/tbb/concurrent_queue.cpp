@@ -20,6 +20,8 @@
 // Define required to satisfy test in internal file.
 #define  __TBB_concurrent_queue_H
 #include "tbb/internal/_concurrent_queue_impl.h"
+#define TBB_PREVIEW_CONCURRENT_RING_QUEUE 1
+#include "tbb/concurrent_ring_queue.h"
 #include "concurrent_monitor.h"
 #include "itt_notify.h"
 #include <new>
@@ -665,6 +667,77 @@ concurrent_queue_iterator_base_v3::~concurrent_queue_iterator_base_v3() {
     my_rep = NULL;
 }
 
+//------------------------------------------------------------------------
+// concurrent_ring_queue_base
+//------------------------------------------------------------------------
+//! Blocked threads of concurrent_ring_queue
+struct concurrent_ring_queue_rep {
+    concurrent_monitor items_avail;
+    concurrent_monitor slots_avail;
+};
+
+concurrent_ring_queue_base_v1::concurrent_ring_queue_base_v1() {
+    my_tail = 0;
+    my_head = 0;
+    my_items_waiters = 0;
+    my_slots_waiters = 0;
+    my_mask = 0;
+    my_abort_counter = 0;
+    concurrent_ring_queue_rep* r = cache_aligned_allocator<concurrent_ring_queue_rep>().allocate(1);
+    new ( &r->items_avail ) concurrent_monitor();
+    new ( &r->slots_avail ) concurrent_monitor();
+    my_rep = r;
+}
+
+concurrent_ring_queue_base_v1::~concurrent_ring_queue_base_v1() {
+    concurrent_ring_queue_rep* r = static_cast<concurrent_ring_queue_rep*>(my_rep);
+    r->items_avail.~concurrent_monitor();
+    r->slots_avail.~concurrent_monitor();
+    cache_aligned_allocator<concurrent_ring_queue_rep>().deallocate(r, 1);
+}
+
+void concurrent_ring_queue_base_v1::internal_wait( bool for_items, unsigned abort_counter ) {
+    concurrent_ring_queue_rep& r = *static_cast<concurrent_ring_queue_rep*>(my_rep);
+    concurrent_monitor& monitor = for_items ? r.items_avail : r.slots_avail;
+    atomic<size_type>& waiters = for_items ? my_items_waiters : my_slots_waiters;
+    // The increment of the counter is ordered before the check of the positions below, and the update of
+    // a position by the other side is ordered before its check of the counter, so either this thread sees
+    // the new position or the other side sees the waiter and notifies the monitor.
+    ++waiters;
+    concurrent_monitor::thread_context thr_ctx;
+    monitor.prepare_wait( thr_ctx );
+    bool ready = for_items ? intptr_t(my_tail-my_head) > 0 : intptr_t(my_tail-my_head) <= intptr_t(my_mask);
+    if( ready || my_abort_counter != abort_counter ) {
+        monitor.cancel_wait( thr_ctx );
+    } else {
+        __TBB_TRY {
+            monitor.commit_wait( thr_ctx );
+        } __TBB_CATCH(...) {
+            --waiters;
+            __TBB_RETHROW();
+        }
+    }
+    --waiters;
+    if( my_abort_counter != abort_counter )
+        throw_exception( eid_user_abort );
+}
+
+void concurrent_ring_queue_base_v1::internal_notify( bool items, bool all ) {
+    concurrent_ring_queue_rep& r = *static_cast<concurrent_ring_queue_rep*>(my_rep);
+    concurrent_monitor& monitor = items ? r.items_avail : r.slots_avail;
+    if( all )
+        monitor.notify_all();
+    else
+        monitor.notify_one();
+}
+
+void concurrent_ring_queue_base_v1::internal_abort() {
+    concurrent_ring_queue_rep& r = *static_cast<concurrent_ring_queue_rep*>(my_rep);
+    ++my_abort_counter;
+    r.items_avail.abort_all();
+    r.slots_avail.abort_all();
+}
+
 } // namespace internal
 
 } // namespace tbb
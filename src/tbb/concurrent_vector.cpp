@@ -29,6 +29,19 @@
 #include <cstring>
 #include <memory> //for uninitialized_fill_n
 
+#if _WIN32||_WIN64
+#include "tbb/machine/windows_api.h"
+#else
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+// macOS* defines MAP_ANON, which is deprecated in Linux*.
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+#endif /* _WIN32||_WIN64 */
+
 #if defined(_MSC_VER) && defined(_Wp64)
     // Workaround for overzealous compiler warnings in /Wp64 mode
     #pragma warning (disable: 4267)
@@ -78,6 +91,24 @@ public:
         return ptr;
     }
 
+    //! Commit the pages of segment k that is a part of the first block starting at array0.
+    /** Only a contiguous storage needs it: on Windows* internal_map_contiguous reserves its pages
+        without committing them, while other OSes commit the pages on the first touch. */
+    inline static bool commit_first_block_segment( void *array0, segment_index_t k, size_type element_size ) {
+#if _WIN32||_WIN64
+        MEMORY_BASIC_INFORMATION info;
+        // the contiguous storage starts its reservation, while the allocated blocks follow a header
+        if( VirtualQuery( array0, &info, sizeof(info) ) && info.AllocationBase == array0 ) {
+            size_type n = k ? segment_size( k ) : 2;
+            return VirtualAlloc( static_cast<char*>(array0) + segment_base( k )*element_size,
+                                 n*element_size, MEM_COMMIT, PAGE_READWRITE ) != NULL;
+        }
+#else
+        suppress_unused_warning( array0, k, element_size );
+#endif
+        return true;
+    }
+
     //! Publish segment so other threads can see it.
     template<typename argument_type>
     inline static void publish_segment( segment_t& s, argument_type rhs ) {
@@ -265,6 +296,8 @@ concurrent_vector_base_v3::size_type concurrent_vector_base_v3::helper::enable_s
 
         segment_scope_guard k_segment_guard(s[k], false);
         enforce_segment_allocated(array0); // initial segment should be allocated
+        if( !commit_first_block_segment( array0.pointer<void>(), k, element_size ) )
+            throw_exception(eid_bad_alloc);
         k_segment_guard.dismiss();
 
         publish_segment( s[k],
@@ -272,7 +305,12 @@ concurrent_vector_base_v3::size_type concurrent_vector_base_v3::helper::enable_s
         );
     } else {
         segment_scope_guard k_segment_guard(s[k], mark_as_not_used_on_failure);
-        publish_segment(s[k], allocate_segment(v, size_to_allocate));
+        void *array = allocate_segment(v, size_to_allocate);
+        if( !k && !commit_first_block_segment( array, 0, element_size ) ) {
+            internal_unmap_contiguous( array, size_to_allocate*element_size );
+            throw_exception(eid_bad_alloc);
+        }
+        publish_segment(s[k], array);
         k_segment_guard.dismiss();
     }
     return size_of_enabled_segment;
@@ -289,9 +327,14 @@ void concurrent_vector_base_v3::helper::cleanup() {
             if(segment0 != segment_allocated())
                 for(; k_start < first_block && k_start <= k_end; ++k_start )
                     publish_segment(table[k_start], segment_allocation_failed());
-            else for(; k_start < first_block && k_start <= k_end; ++k_start )
+            else for(; k_start < first_block && k_start <= k_end; ++k_start ) {
+                    if( !commit_first_block_segment( segment0.pointer<void>(), k_start, element_size ) ) {
+                        publish_segment(table[k_start], segment_allocation_failed());
+                        continue;
+                    }
                     publish_segment(table[k_start], static_cast<void*>(
                         (segment0.pointer<char>()) + segment_base(k_start)*element_size) );
+                }
         }
         for(; k_start <= k_end; ++k_start ) // not in first block
             if(table[k_start].load<acquire>() == segment_not_used())
@@ -583,7 +626,9 @@ void concurrent_vector_base_v3::internal_swap(concurrent_vector_base_v3& v)
 {
     size_type my_sz = my_early_size.load<acquire>();
     size_type v_sz = v.my_early_size.load<relaxed>();
-    if(!my_sz && !v_sz) return;
+    // empty vectors are swapped too if they keep a storage, e.g. the contiguous one
+    if(!my_sz && !v_sz && my_segment[0].load<relaxed>() == segment_not_used()
+        && v.my_segment[0].load<relaxed>() == segment_not_used()) return;
 
     bool my_was_short = (my_segment.load<relaxed>() == my_storage);
     bool v_was_short  = (v.my_segment.load<relaxed>() == v.my_storage);
@@ -605,6 +650,26 @@ void concurrent_vector_base_v3::internal_swap(concurrent_vector_base_v3& v)
     v.my_early_size.store<release>(my_sz);
 }
 
+void* concurrent_vector_base_v3::internal_map_contiguous( size_type size ) {
+    // Only the address space is reserved, the pages are committed by the OS on the first touch
+#if _WIN32||_WIN64
+    // Windows* does not commit the pages on demand, so the segments commit them when enabled
+    return VirtualAlloc( NULL, size, MEM_RESERVE, PAGE_READWRITE );
+#else
+    void *p = mmap( NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0 );
+    return p == MAP_FAILED ? NULL : p;
+#endif
+}
+
+void concurrent_vector_base_v3::internal_unmap_contiguous( void *ptr, size_type size ) {
+#if _WIN32||_WIN64
+    suppress_unused_warning( size );
+    VirtualFree( ptr, 0, MEM_RELEASE );
+#else
+    munmap( ptr, size );
+#endif
+}
+
 } // namespace internal
 
 } // tbb
@@ -471,7 +471,17 @@ bool custom_scheduler<SchedulerTraits>::process_bypass_loop(
             GATHER_STATISTIC( my_counters.avg_market_prio += my_market->my_global_top_priority );
 #endif /* __TBB_TASK_PRIORITY */
             ITT_STACK(SchedulerTraits::itt_possible, callee_enter, t->prefix().context->itt_caller);
+#if __TBB_SCHEDULER_TRACE
+            // The type name is taken in advance, as the task can be destroyed by execute()
+            trace_buffer* trace = tracer();
+            const trace_time_t trace_begin = trace ? trace_clock() : 0;
+            const char* trace_name = trace ? typeid(*t).name() : NULL;
+#endif /* __TBB_SCHEDULER_TRACE */
             t_next = t->execute();
+#if __TBB_SCHEDULER_TRACE
+            if( trace )
+                trace->record( tek_task_execute, trace_begin, trace_clock(), t, trace_name, 0 );
+#endif /* __TBB_SCHEDULER_TRACE */
             ITT_STACK(SchedulerTraits::itt_possible, callee_leave, t->prefix().context->itt_caller);
             if (t_next) {
                 assert_task_valid(t_next);
@@ -183,9 +183,11 @@ namespace tbb
                     __TBB_ASSERT(s->my_ref_count == 1, "weakly initialized scheduler must have refcount equal to 1");
                     __TBB_ASSERT(!s->my_arena, "weakly initialized scheduler  must have no arena");
                     __TBB_ASSERT(s->my_auto_initialized, "weakly initialized scheduler is supposed to be auto-initialized");
-                    s->attach_arena(market::create_arena(default_num_threads(), 1, 0), 0, /*is_master*/ true);
+                    arena *a = market::create_arena(default_num_threads(), 1, 0);
+                    bool occupied = a->occupy_slot(0, *s);
+                    __TBB_ASSERT_EX(occupied, "The first slot of a new arena must be free");
+                    s->attach_arena(a, 0, /*is_master*/ true);
                     __TBB_ASSERT(s->my_arena_index == 0, "Master thread must occupy the first slot in its arena");
-                    s->my_arena_slot->my_scheduler = s;
 #if __TBB_TASK_GROUP_CONTEXT
                     s->my_arena->my_default_ctx = s->default_context(); // it also transfers implied ownership
 #endif
@@ -327,6 +329,7 @@ namespace tbb
 #pragma weak deallocate_binding_handler
 #pragma weak bind_to_node
 #pragma weak restore_affinity
+#pragma weak current_numa_node
 
         extern "C"
         {
@@ -338,6 +341,8 @@ namespace tbb
 
             void bind_to_node(binding_handler *handler_ptr, int slot_num, int numa_id);
             void restore_affinity(binding_handler *handler_ptr, int slot_num);
+
+            int current_numa_node();
         }
 #endif /* __TBB_WEAK_SYMBOLS_PRESENT */
 
@@ -347,12 +352,14 @@ namespace tbb
 
         static void (*bind_to_node_ptr)(binding_handler *handler_ptr, int slot_num, int numa_id) = NULL;
         static void (*restore_affinity_ptr)(binding_handler *handler_ptr, int slot_num) = NULL;
+        static int (*current_numa_node_ptr)() = NULL;
 
         // Stubs that will be used if TBBbind library is unavailable.
         static binding_handler *dummy_allocate_binding_handler(int) { return NULL; }
         static void dummy_deallocate_binding_handler(binding_handler *) {}
         static void dummy_bind_to_node(binding_handler *, int, int) {}
         static void dummy_restore_affinity(binding_handler *, int) {}
+        static int dummy_current_numa_node() { return -1; }
 
         // Representation of NUMA topology information on the TBB side.
         // NUMA topology may be initialized by third-party component (e.g. hwloc)
@@ -375,6 +382,25 @@ namespace tbb
             {
                 governor::one_time_init();
 
+#if __TBB_WEAK_SYMBOLS_PRESENT
+                // TBBbind entry points are resolved only if it is linked into the application.
+                if (initialize_numa_topology && allocate_binding_handler && deallocate_binding_handler &&
+                    bind_to_node && restore_affinity && current_numa_node)
+                {
+                    // Weak symbols are not used on Windows, so there is a single processor group.
+                    initialize_numa_topology(/*groups_num*/1,
+                        numa_nodes_count, numa_indexes, default_concurrency_list);
+
+                    allocate_binding_handler_ptr = allocate_binding_handler;
+                    deallocate_binding_handler_ptr = deallocate_binding_handler;
+
+                    bind_to_node_ptr = bind_to_node;
+                    restore_affinity_ptr = restore_affinity;
+                    current_numa_node_ptr = current_numa_node;
+                    return;
+                }
+#endif /* __TBB_WEAK_SYMBOLS_PRESENT */
+
                 static int dummy_index = -1;
                 static int dummy_concurrency = governor::default_num_threads();
 
@@ -387,6 +413,7 @@ namespace tbb
 
                 bind_to_node_ptr = dummy_bind_to_node;
                 restore_affinity_ptr = dummy_restore_affinity;
+                current_numa_node_ptr = dummy_current_numa_node;
             }
 
             void initialize()
@@ -419,6 +446,12 @@ namespace tbb
                 return governor::default_num_threads();
             }
 
+            int current_node()
+            {
+                initialize();
+                return current_numa_node_ptr();
+            }
+
         } // namespace numa_topology
 
         binding_handler *construct_binding_handler(int slot_num)
@@ -654,6 +654,11 @@ void market::adjust_demand ( arena& a, int delta ) {
     // Must be called outside of any locks
     my_server->adjust_job_count_estimate( delta );
     GATHER_STATISTIC( governor::local_scheduler_if_initialized() ? ++governor::local_scheduler_if_initialized()->my_counters.gate_switches : 0 );
+#if __TBB_SCHEDULER_TRACE
+    if( delta && scheduler_trace::enabled() )
+        if( generic_scheduler* s = governor::local_scheduler_if_initialized() )
+            TRACE_SCHEDULER_EVENT( *s, tek_workers_request, &a, delta );
+#endif /* __TBB_SCHEDULER_TRACE */
 }
 
 void market::process( job& j ) {
@@ -661,6 +666,9 @@ void market::process( job& j ) {
     // s.my_arena can be dead. Don't access it until arena_in_need is called
     arena *a = s.my_arena;
     __TBB_ASSERT( governor::is_set(&s), NULL );
+#if __TBB_SCHEDULER_TRACE
+    const trace_time_t trace_begin = scheduler_trace::enabled() ? trace_clock() : 0;
+#endif /* __TBB_SCHEDULER_TRACE */
 
     for (int i = 0; i < 2; ++i) {
         while ( (a = arena_in_need(a)) ) {
@@ -676,6 +684,10 @@ void market::process( job& j ) {
     }
 
     GATHER_STATISTIC( ++s.my_counters.market_roundtrips );
+#if __TBB_SCHEDULER_TRACE
+    if( trace_buffer* trace = s.tracer() )
+        trace->record( tek_worker_active, trace_begin, trace_clock(), &s, NULL, 0 );
+#endif /* __TBB_SCHEDULER_TRACE */
 }
 
 void market::cleanup( job& j ) {
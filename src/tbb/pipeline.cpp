@@ -16,7 +16,10 @@
 
 #include "tbb/pipeline.h"
 #include "tbb/spin_mutex.h"
+#include "tbb/atomic.h"
 #include "tbb/cache_aligned_allocator.h"
+#include "tbb/task_arena.h"
+#include "tbb/tick_count.h"
 #include "itt_notify.h"
 #include "semaphore.h"
 #include "tls.h"  // for parallel filters that do not use NULL as end_of_input
@@ -43,8 +46,23 @@ struct task_info {
         is_valid = false;
     }
 };
+
+//! A slot of the lock-free ring of input_buffer
+/** Each token is handed over to the filter through the slot it maps to. Two parties meet
+    at the slot: the task that brings the item with the token, and the task that finishes
+    the previous token and so frees the filter for this token. The one that comes first
+    marks the slot; the one that comes second sees the mark and processes the item. **/
+struct input_slot {
+    //! The token the slot is assigned to, shifted left by 2, combined with the hand-off state
+    atomic<Token> state;
+    task_info info;
+};
+
 //! A buffer of input items for a filter.
-/** Each item is a task_info, inserted into a position in the buffer corresponding to a Token. */
+/** Each item is a task_info, inserted into a position in the buffer corresponding to a Token.
+    A buffer of a serial filter in a pipeline without thread-bound filters uses the lock-free
+    "ring" when a run of the pipeline has few enough tokens, and "array" guarded by "array_mutex"
+    otherwise. The ring has a slot per live token, so it never needs to grow during the run. */
 class input_buffer : no_copy {
     friend class tbb::internal::pipeline_root_task;
     friend class tbb::filter;
@@ -80,7 +98,7 @@ class input_buffer : no_copy {
     static const size_type initial_buffer_size = 4;
 
     //! Used for out of order buffer, and for assigning my_token if is_ordered and my_token not already assigned
-    Token high_token;
+    atomic<Token> high_token;
 
     //! True for ordered filter, false otherwise.
     bool is_ordered;
@@ -93,6 +111,31 @@ class input_buffer : no_copy {
     end_of_input_tls_t end_of_input_tls;
     bool end_of_input_tls_allocated; // no way to test pthread creation of TLS
 
+    //! Ring of slots used instead of "array" when the buffer is lock-free
+    input_slot* ring;
+
+    //! Size of "ring", a power of 2, or 0 if the buffer uses "array"
+    size_type ring_size;
+
+    //! Maximal size of "ring"; runs with more tokens use "array"
+    static const size_type max_ring_size = 1<<14;
+
+    //! Hand-off states of a slot
+    enum {
+        //! Nobody has come to the slot
+        slot_pending = 0,
+        //! The item is put into the slot, and the filter will pick it up
+        slot_parked = 1,
+        //! The filter is free for the token, and the task that brings the item will process it
+        slot_filter_free = 2
+    };
+
+    static Token slot_state( Token token, Token handoff ) { return token<<2 | handoff; }
+
+    //! Lay out the ring for tokens starting from low_token
+    /** Must be called when no tokens are in flight. */
+    void reset_ring();
+
     void create_sema(size_t initial_tokens) { __TBB_ASSERT(!my_sem,NULL); my_sem = new internal::semaphore(initial_tokens); }
     void free_sema() { __TBB_ASSERT(my_sem,NULL); delete my_sem; }
     void sema_P() { __TBB_ASSERT(my_sem,NULL); my_sem->P(); }
@@ -102,9 +145,10 @@ public:
     //! Construct empty buffer.
     input_buffer( bool is_ordered_, bool is_bound_ ) :
             array(NULL), my_sem(NULL), array_size(0),
-            low_token(0), high_token(0),
+            low_token(0),
             is_ordered(is_ordered_), is_bound(is_bound_),
-            end_of_input_tls_allocated(false) {
+            end_of_input_tls_allocated(false), ring(NULL), ring_size(0) {
+        high_token = 0;
         grow(initial_buffer_size);
         __TBB_ASSERT( array, NULL );
         if(is_bound) create_sema(0);
@@ -115,6 +159,8 @@ public:
         __TBB_ASSERT( array, NULL );
         cache_aligned_allocator<task_info>().deallocate(array,array_size);
         poison_pointer( array );
+        if( ring )
+            cache_aligned_allocator<input_slot>().deallocate(ring,ring_size);
         if(my_sem) {
             free_sema();
         }
@@ -133,6 +179,34 @@ public:
         in the buffer.
     */
     bool put_token( task_info& info_, bool force_put = false ) {
+        if( ring_size ) {
+            __TBB_ASSERT( !is_bound && !force_put, "pipelines with thread-bound filters use the array" );
+            Token token;
+            if( is_ordered ) {
+                if( !info_.my_token_ready ) {
+                    info_.my_token = high_token++;
+                    info_.my_token_ready = true;
+                }
+                token = info_.my_token;
+            } else
+                token = high_token++;
+            input_slot& s = ring[token&(ring_size-1)];
+            Token state = s.state;
+            if( state!=slot_state(token, slot_filter_free) ) {
+                __TBB_ASSERT( state==slot_state(token, slot_pending), "the ring is too small for the number of tokens" );
+                s.info = info_;
+                s.info.is_valid = true;
+                ITT_NOTIFY( sync_releasing, this );
+                state = s.state.compare_and_swap( slot_state(token, slot_parked), slot_state(token, slot_pending) );
+                if( state==slot_state(token, slot_pending) )
+                    return true;
+                __TBB_ASSERT( state==slot_state(token, slot_filter_free), NULL );
+                s.info.is_valid = false;
+            }
+            // The filter has finished the previous token, so the caller goes on with this one.
+            s.state = slot_state(token+ring_size, slot_pending);
+            return false;
+        }
         {
             info_.is_valid = true;
             spin_mutex::scoped_lock lock( array_mutex );
@@ -172,6 +246,26 @@ public:
     // of the current token in the buffer keeps another stage from being spawned.
     template<typename StageTask>
     void note_done( Token token, StageTask& spawner ) {
+        if( ring_size ) {
+            // Only the task that processes the current token modifies low_token.
+            __TBB_ASSERT( !is_ordered || token==low_token, NULL );
+            suppress_unused_warning( token );
+            const Token next = ++low_token;
+            input_slot& s = ring[next&(ring_size-1)];
+            Token state = s.state;
+            if( state==slot_state(next, slot_pending) ) {
+                state = s.state.compare_and_swap( slot_state(next, slot_filter_free), slot_state(next, slot_pending) );
+                if( state==slot_state(next, slot_pending) )
+                    return; // the task that brings the next token will process it
+            }
+            __TBB_ASSERT( state==slot_state(next, slot_parked), "the ring is too small for the number of tokens" );
+            ITT_NOTIFY( sync_acquired, this );
+            task_info wakee = s.info;
+            s.info.is_valid = false;
+            s.state = slot_state(next+ring_size, slot_pending);
+            spawner.spawn_stage_task(wakee);
+            return;
+        }
         task_info wakee;
         wakee.reset();
         {
@@ -199,9 +293,50 @@ public:
                 temp.is_valid = false;
             }
         }
+        if( ring_size ) {
+            for( size_type i=0; i<ring_size; ++i ) {
+                task_info& temp = ring[i].info;
+                if( temp.is_valid ) {
+                    my_filter->finalize(temp.my_object);
+                    temp.is_valid = false;
+                }
+            }
+        }
     }
 #endif
 
+    //! Restart the tokens from 0, like for the first run of the pipeline
+    /** A cancelled run leaves tokens that never came to the filter. Called when no tokens are in flight. */
+    void reset_tokens() {
+        low_token = 0;
+        high_token = 0;
+        if( ring_size )
+            reset_ring();
+    }
+
+    //! Choose between the ring and the array for the next run of the pipeline
+    /** Called when no tokens are in flight. */
+    void prepare_run( size_type max_number_of_live_tokens, bool may_use_ring ) {
+        if( may_use_ring && max_number_of_live_tokens<=max_ring_size ) {
+            size_type new_size = initial_buffer_size;
+            while( new_size<max_number_of_live_tokens )
+                new_size*=2;
+            if( new_size!=ring_size ) {
+                if( ring )
+                    cache_aligned_allocator<input_slot>().deallocate(ring,ring_size);
+                ring = NULL;
+                ring_size = 0;
+                ring = cache_aligned_allocator<input_slot>().allocate(new_size);
+                ring_size = new_size;
+            }
+            reset_ring();
+        } else if( ring ) {
+            cache_aligned_allocator<input_slot>().deallocate(ring,ring_size);
+            ring = NULL;
+            ring_size = 0;
+        }
+    }
+
     //! return an item, invalidate the queued item, but only advance if the filter
     // is parallel (as indicated by advance == true). If the filter is serial, leave the
     // item in the buffer to keep another stage from being spawned.
@@ -228,6 +363,18 @@ public:
     void set_my_tls_end_of_input() { end_of_input_tls.set(1); }
 };
 
+void input_buffer::reset_ring() {
+    __TBB_ASSERT( ring_size && !(ring_size&(ring_size-1)), NULL );
+    Token t = low_token;
+    for( size_type i=0; i<ring_size; ++i, ++t ) {
+        input_slot& s = ring[t&(ring_size-1)];
+        s.info.reset();
+        s.state = slot_state(t, i ? slot_pending : slot_filter_free);
+    }
+    if( !is_ordered )
+        high_token = low_token;
+}
+
 void input_buffer::grow( size_type minimum_size ) {
     size_type old_size = array_size;
     size_type new_size = old_size ? 2*old_size : initial_buffer_size;
@@ -246,6 +393,212 @@ void input_buffer::grow( size_type minimum_size ) {
         cache_aligned_allocator<task_info>().deallocate(old_array,old_size);
 }
 
+//! Adjusts the number of tokens of a pipeline run with adaptive_token_limit
+/** The filters report the time they take, and the input filter reports when it runs out of
+    tokens. The task that brings a token to the end of the pipeline reviews the reports once
+    per review period, then adds tokens or marks some of them for retirement. A token marked
+    for retirement is not given back to the input filter when it reaches the end of the pipeline. */
+class token_limit_controller: no_copy {
+    struct stage_counters {
+        //! Total time spent in the filter, in nanoseconds
+        atomic<int64_t> busy_ns;
+        atomic<size_t> items;
+        //! busy_ns at the start of the review period; protected by my_mutex
+        int64_t period_busy_ns;
+        bool is_serial;
+    };
+    typedef padded<stage_counters> padded_stage_counters;
+
+    adaptive_token_limit& my_limit;
+    padded_stage_counters* my_stages;
+    const size_t my_stage_count;
+    size_t my_min_tokens;
+    size_t my_max_tokens;
+    //! The number of tokens in the run, not counting those marked for retirement; protected by my_mutex
+    size_t my_tokens;
+    //! Number of tokens to retire when they reach the end of the pipeline
+    atomic<intptr_t> my_tokens_to_retire;
+    //! Number of tokens that reached the end of the pipeline
+    atomic<size_t> my_completed;
+    //! Number of times the input filter took the last token
+    atomic<size_t> my_stalls;
+    //! Serializes reviews
+    spin_mutex my_mutex;
+    tick_count my_start;
+    tick_count my_period_start;
+    size_t my_period_stalls;
+    const int my_concurrency;
+
+    //! Minimal time between reviews, in seconds
+    static double review_period() { return 1e-3; }
+
+    //! Number of tokens between the checks of the review period
+    static const size_t review_check_interval = 16;
+
+    //! Returns the number of tokens to add
+    size_t review( tick_count now );
+    void publish( tick_count now );
+
+public:
+    token_limit_controller( adaptive_token_limit& limit, pipeline& p );
+    ~token_limit_controller();
+
+    size_t initial_tokens() const { return my_tokens; }
+    size_t max_tokens() const { return my_max_tokens; }
+
+    void note_busy( size_t stage, tick_count start ) {
+        __TBB_ASSERT( stage<my_stage_count, NULL );
+        stage_counters& s = my_stages[stage];
+        s.busy_ns += int64_t( (tick_count::now()-start).seconds()*1e9 );
+        ++s.items;
+    }
+    void note_stall() { ++my_stalls; }
+
+    //! Returns the number of tokens to give to the input filter when a token reaches the end of the pipeline
+    size_t token_done();
+
+    //! Publishes the final statistics of the run
+    void finish() {
+        spin_mutex::scoped_lock lock( my_mutex );
+        publish( tick_count::now() );
+    }
+};
+
+token_limit_controller::token_limit_controller( adaptive_token_limit& limit, pipeline& p ) :
+    my_limit(limit), my_stages(NULL), my_stage_count(0),
+    my_concurrency(this_task_arena::max_concurrency())
+{
+    size_t n = 0;
+    for( filter* f = p.filter_list; f; f = f->next_filter_in_pipeline )
+        ++n;
+    const_cast<size_t&>(my_stage_count) = n;
+    my_stages = cache_aligned_allocator<padded_stage_counters>().allocate( n );
+    n = 0;
+    for( filter* f = p.filter_list; f; f = f->next_filter_in_pipeline, ++n ) {
+        stage_counters& s = my_stages[n];
+        s.busy_ns = 0;
+        s.items = 0;
+        s.period_busy_ns = 0;
+        s.is_serial = f->is_serial();
+    }
+    if( limit.my_stage_count!=my_stage_count ) {
+        if( limit.my_stages )
+            cache_aligned_allocator<adaptive_token_limit::stage_statistics>().deallocate( limit.my_stages, limit.my_stage_count );
+        limit.my_stages = NULL;
+        limit.my_stage_count = 0;
+        limit.my_stages = cache_aligned_allocator<adaptive_token_limit::stage_statistics>().allocate( my_stage_count );
+        limit.my_stage_count = my_stage_count;
+    }
+    for( size_t i = 0; i<my_stage_count; ++i ) {
+        limit.my_stages[i].items = 0;
+        limit.my_stages[i].busy_time = 0;
+        limit.my_stages[i].utilization = 0;
+    }
+    // The limit counts items, and a token can carry a batch of them
+    const size_t items_per_token = limit.my_items_per_token ? limit.my_items_per_token : 1;
+    my_min_tokens = limit.my_min_tokens/items_per_token;
+    if( !my_min_tokens )
+        my_min_tokens = 1;
+    my_max_tokens = limit.my_max_tokens/items_per_token;
+    if( limit.my_memory_budget && limit.my_bytes_per_token ) {
+        size_t budget_tokens = limit.my_memory_budget/limit.my_bytes_per_token/items_per_token;
+        if( budget_tokens<my_max_tokens )
+            my_max_tokens = budget_tokens;
+    }
+    if( my_max_tokens<my_min_tokens )
+        my_max_tokens = my_min_tokens;
+    my_tokens = 2*size_t(my_concurrency);
+    if( my_tokens<my_min_tokens )
+        my_tokens = my_min_tokens;
+    if( my_tokens>my_max_tokens )
+        my_tokens = my_max_tokens;
+    my_tokens_to_retire = 0;
+    my_completed = 0;
+    my_stalls = 0;
+    my_period_stalls = 0;
+    my_start = my_period_start = tick_count::now();
+    my_limit.my_current_limit = my_tokens*items_per_token;
+}
+
+token_limit_controller::~token_limit_controller() {
+    cache_aligned_allocator<padded_stage_counters>().deallocate( my_stages, my_stage_count );
+}
+
+size_t token_limit_controller::token_done() {
+    for( intptr_t k = my_tokens_to_retire; k>0; k = my_tokens_to_retire )
+        if( my_tokens_to_retire.compare_and_swap( k-1, k )==k )
+            return 0;
+    if( ++my_completed % review_check_interval )
+        return 1;
+    spin_mutex::scoped_lock lock;
+    if( !lock.try_acquire( my_mutex ) )
+        return 1;
+    tick_count now = tick_count::now();
+    if( (now-my_period_start).seconds()<review_period() )
+        return 1;
+    return 1+review( now );
+}
+
+size_t token_limit_controller::review( tick_count now ) {
+    const double period = (now-my_period_start).seconds();
+    double busy = 0, max_serial_utilization = 0;
+    for( size_t i = 0; i<my_stage_count; ++i ) {
+        stage_counters& s = my_stages[i];
+        const int64_t busy_ns = s.busy_ns;
+        const double t = double(busy_ns-s.period_busy_ns)*1e-9;
+        s.period_busy_ns = busy_ns;
+        busy += t;
+        if( s.is_serial && t/period>max_serial_utilization )
+            max_serial_utilization = t/period;
+    }
+    const size_t stalls = my_stalls;
+    const bool stalled = stalls!=my_period_stalls;
+    my_period_stalls = stalls;
+    my_period_start = now;
+
+    size_t target = my_tokens;
+    if( stalled ) {
+        // More items in flight help only if some threads are idle, and no serial filter
+        // limits the throughput.
+        if( busy/period<0.9*my_concurrency && max_serial_utilization<0.9 )
+            target = my_tokens + my_tokens/2 + 1;
+    } else {
+        // The input filter always found a token, so some tokens are idle
+        target = my_tokens - (my_tokens/8 ? my_tokens/8 : 1);
+    }
+    if( target<my_min_tokens )
+        target = my_min_tokens;
+    if( target>my_max_tokens )
+        target = my_max_tokens;
+
+    size_t added = 0;
+    if( target>my_tokens ) {
+        added = target-my_tokens;
+        // Tokens marked for retirement are kept first
+        for( intptr_t k = my_tokens_to_retire; k>0 && added; k = my_tokens_to_retire ) {
+            intptr_t kept = k<intptr_t(added) ? k : intptr_t(added);
+            if( my_tokens_to_retire.compare_and_swap( k-kept, k )==k )
+                added -= kept;
+        }
+    } else if( target<my_tokens ) {
+        my_tokens_to_retire += intptr_t(my_tokens-target);
+    }
+    my_tokens = target;
+    publish( now );
+    return added;
+}
+
+void token_limit_controller::publish( tick_count now ) {
+    const double duration = (now-my_start).seconds();
+    for( size_t i = 0; i<my_stage_count; ++i ) {
+        adaptive_token_limit::stage_statistics& stats = my_limit.my_stages[i];
+        stats.items = my_stages[i].items;
+        stats.busy_time = double(my_stages[i].busy_ns)*1e-9;
+        stats.utilization = duration>0 ? stats.busy_time/duration : 0;
+    }
+    my_limit.my_current_limit = my_tokens*(my_limit.my_items_per_token ? my_limit.my_items_per_token : 1);
+}
+
 class stage_task: public task, public task_info {
 private:
     friend class tbb::pipeline;
@@ -253,6 +606,22 @@ private:
     filter* my_filter;
     //! True if this task has not yet read the input.
     bool my_at_start;
+    //! Index of my_filter in the pipeline
+    size_t my_stage;
+
+    //! The controller of the running pipeline, or NULL if the number of tokens is fixed
+    static token_limit_controller* controller_of( pipeline& p );
+
+    //! Applies my_filter to my_object, timing it if the number of tokens is adaptive
+    void process_item( token_limit_controller* controller ) {
+        if( controller ) {
+            tick_count start = tick_count::now();
+            my_object = (*my_filter)(my_object);
+            controller->note_busy( my_stage, start );
+        } else {
+            my_object = (*my_filter)(my_object);
+        }
+    }
 
 public:
     //! Construct stage_task for first stage in a pipeline.
@@ -260,22 +629,25 @@ public:
     stage_task( pipeline& pipeline ) :
         my_pipeline(pipeline),
         my_filter(pipeline.filter_list),
-        my_at_start(true)
+        my_at_start(true),
+        my_stage(0)
     {
         task_info::reset();
     }
     //! Construct stage_task for a subsequent stage in a pipeline.
-    stage_task( pipeline& pipeline, filter* filter_, const task_info& info ) :
+    stage_task( pipeline& pipeline, filter* filter_, const task_info& info, size_t stage = 0 ) :
         task_info(info),
         my_pipeline(pipeline),
         my_filter(filter_),
-        my_at_start(false)
+        my_at_start(false),
+        my_stage(stage)
     {}
     //! Roughly equivalent to the constructor of input stage task
     void reset() {
         task_info::reset();
         my_filter = my_pipeline.filter_list;
         my_at_start = true;
+        my_stage = 0;
     }
     //! The virtual task execution method
     task* execute() __TBB_override;
@@ -293,7 +665,7 @@ public:
     void spawn_stage_task(const task_info& info)
     {
         stage_task* clone = new (allocate_additional_child_of(*parent()))
-                                stage_task( my_pipeline, my_filter, info );
+                                stage_task( my_pipeline, my_filter, info, my_stage );
         spawn(*clone);
     }
 };
@@ -301,9 +673,10 @@ public:
 task* stage_task::execute() {
     __TBB_ASSERT( !my_at_start || !my_object, NULL );
     __TBB_ASSERT( !my_filter->is_bound(), NULL );
+    token_limit_controller* const controller = controller_of( my_pipeline );
     if( my_at_start ) {
         if( my_filter->is_serial() ) {
-            my_object = (*my_filter)(my_object);
+            process_item( controller );
             if( my_object || ( my_filter->object_may_be_null() && !my_pipeline.end_of_input) )
             {
                 if( my_filter->is_ordered() ) {
@@ -320,6 +693,8 @@ task* stage_task::execute() {
                     ITT_NOTIFY( sync_releasing, &my_pipeline.input_tokens );
                     if( --my_pipeline.input_tokens>0 )
                         spawn( *new( allocate_additional_child_of(*parent()) ) stage_task( my_pipeline ) );
+                    else if( controller )
+                        controller->note_stall();
                 }
             } else {
                 my_pipeline.end_of_input = true;
@@ -335,7 +710,9 @@ task* stage_task::execute() {
             ITT_NOTIFY( sync_releasing, &my_pipeline.input_tokens );
             if( --my_pipeline.input_tokens>0 )
                 spawn( *new( allocate_additional_child_of(*parent()) ) stage_task( my_pipeline ) );
-            my_object = (*my_filter)(my_object);
+            else if( controller )
+                controller->note_stall();
+            process_item( controller );
             if( !my_object && (!my_filter->object_may_be_null() || my_filter->my_input_buffer->my_tls_end_of_input()) )
             {
                 my_pipeline.end_of_input = true;
@@ -348,11 +725,12 @@ task* stage_task::execute() {
         }
         my_at_start = false;
     } else {
-        my_object = (*my_filter)(my_object);
+        process_item( controller );
         if( my_filter->is_serial() )
             my_filter->my_input_buffer->note_done(my_token, *this);
     }
     my_filter = my_filter->next_filter_in_pipeline;
+    ++my_stage;
     if( my_filter ) {
         // There is another filter to execute.
         if( my_filter->is_serial() ) {
@@ -363,6 +741,7 @@ task* stage_task::execute() {
                     // Find the next non-thread-bound filter
                     do {
                         my_filter = my_filter->next_filter_in_pipeline;
+                        ++my_stage;
                     } while( my_filter && my_filter->is_bound() );
                     // Check if there is an item ready to process
                     if( my_filter && my_filter->my_input_buffer->return_item(*this, !my_filter->is_serial()))
@@ -374,14 +753,18 @@ task* stage_task::execute() {
         }
     } else {
         // Reached end of the pipe.
-        size_t ntokens_avail = ++my_pipeline.input_tokens;
+        // The controller can retire the token, or add more tokens along with it.
+        const size_t ntokens_returned = controller ? controller->token_done() : 1;
+        if( !ntokens_returned )
+            return NULL;
+        size_t ntokens_avail = my_pipeline.input_tokens += ntokens_returned;
         if(my_pipeline.filter_list->is_bound() ) {
             if(ntokens_avail == 1) {
                 my_pipeline.filter_list->my_input_buffer->sema_V();
             }
             return NULL;
         }
-        if( ntokens_avail>1  // Only recycle if there is one available token
+        if( ntokens_avail>ntokens_returned  // Only recycle if there were no available tokens
                 || my_pipeline.end_of_input ) {
             return NULL; // No need to recycle for new input
         }
@@ -398,8 +781,10 @@ process_another_stage:
 }
 
 class pipeline_root_task: public task {
+    friend class stage_task;
     pipeline& my_pipeline;
     bool do_segment_scanning;
+    token_limit_controller* const my_controller;
 
     task* execute() __TBB_override {
         if( !my_pipeline.end_of_input )
@@ -469,7 +854,8 @@ class pipeline_root_task: public task {
         }
     }
 public:
-    pipeline_root_task( pipeline& pipeline ): my_pipeline(pipeline), do_segment_scanning(false)
+    pipeline_root_task( pipeline& pipeline, token_limit_controller* controller ):
+        my_pipeline(pipeline), do_segment_scanning(false), my_controller(controller)
     {
         __TBB_ASSERT( my_pipeline.filter_list, NULL );
         filter* first = my_pipeline.filter_list;
@@ -490,6 +876,10 @@ public:
     }
 };
 
+inline token_limit_controller* stage_task::controller_of( pipeline& p ) {
+    return static_cast<pipeline_root_task*>(p.end_counter)->my_controller;
+}
+
 #if _MSC_VER && !defined(__INTEL_COMPILER)
     // Workaround for overzealous compiler warnings
     // Suppress compiler warning about constant conditional expression
@@ -521,10 +911,13 @@ void pipeline::inject_token( task& ) {
 #if __TBB_TASK_GROUP_CONTEXT
 void pipeline::clear_filters() {
     for( filter* f = filter_list; f; f = f->next_filter_in_pipeline ) {
-        if ((f->my_filter_mode & filter::version_mask) >= __TBB_PIPELINE_VERSION(4))
-            if( internal::input_buffer* b = f->my_input_buffer )
+        if( internal::input_buffer* b = f->my_input_buffer ) {
+            if ((f->my_filter_mode & filter::version_mask) >= __TBB_PIPELINE_VERSION(4))
                 b->clear(f);
+            b->reset_tokens();
+        }
     }
+    token_counter = 0;
 }
 #endif
 
@@ -640,6 +1033,44 @@ void pipeline::remove_filter( filter& filter_ ) {
 }
 
 void pipeline::run( size_t max_number_of_live_tokens
+#if __TBB_TASK_GROUP_CONTEXT
+    , tbb::task_group_context& context
+#endif
+    ) {
+    internal_run( max_number_of_live_tokens, NULL
+#if __TBB_TASK_GROUP_CONTEXT
+        , context
+#endif
+        );
+}
+
+void pipeline::run( adaptive_token_limit& limit
+#if __TBB_TASK_GROUP_CONTEXT
+    , tbb::task_group_context& context
+#endif
+    ) {
+    if( !filter_list )
+        return;
+    if( has_thread_bound_filters ) {
+        // The threads that run thread-bound filters do not report to the controller
+        limit.my_current_limit = limit.max_tokens();
+        internal_run( limit.max_tokens(), NULL
+#if __TBB_TASK_GROUP_CONTEXT
+            , context
+#endif
+            );
+        return;
+    }
+    internal::token_limit_controller controller( limit, *this );
+    internal_run( controller.initial_tokens(), &controller
+#if __TBB_TASK_GROUP_CONTEXT
+        , context
+#endif
+        );
+    controller.finish();
+}
+
+void pipeline::internal_run( size_t max_number_of_live_tokens, internal::token_limit_controller* controller
 #if __TBB_TASK_GROUP_CONTEXT
     , tbb::task_group_context& context
 #endif
@@ -650,6 +1081,13 @@ void pipeline::run( size_t max_number_of_live_tokens
         internal::pipeline_cleaner my_pipeline_cleaner(*this);
         end_of_input = false;
         input_tokens = internal::Token(max_number_of_live_tokens);
+        // The buffers have room for the maximal number of tokens the controller can give.
+        const size_t buffer_tokens = controller ? controller->max_tokens() : max_number_of_live_tokens;
+        // The input filter does not use its buffer for hand-off, and the buffers of pipelines
+        // with thread-bound filters are also filled with force_put and drained with return_item.
+        for( filter* f = filter_list; f; f = f->next_filter_in_pipeline )
+            if( internal::input_buffer* b = f->my_input_buffer )
+                b->prepare_run( buffer_tokens, f!=filter_list && f->is_serial() && !has_thread_bound_filters );
         if(has_thread_bound_filters) {
             // release input filter if thread-bound
             if(filter_list->is_bound()) {
@@ -657,9 +1095,9 @@ void pipeline::run( size_t max_number_of_live_tokens
             }
         }
 #if __TBB_TASK_GROUP_CONTEXT
-        end_counter = new( task::allocate_root(context) ) internal::pipeline_root_task( *this );
+        end_counter = new( task::allocate_root(context) ) internal::pipeline_root_task( *this, controller );
 #else
-        end_counter = new( task::allocate_root() ) internal::pipeline_root_task( *this );
+        end_counter = new( task::allocate_root() ) internal::pipeline_root_task( *this, controller );
 #endif
         // Start execution of tasks
         task::spawn_root_and_wait( *end_counter );
@@ -686,6 +1124,16 @@ void pipeline::run( size_t max_number_of_live_tokens ) {
         run(max_number_of_live_tokens, context);
     }
 }
+
+void pipeline::run( adaptive_token_limit& limit ) {
+    if( filter_list ) {
+        uintptr_t ctx_traits = filter_list->my_filter_mode & filter::exact_exception_propagation ?
+                task_group_context::default_traits :
+                task_group_context::default_traits & ~task_group_context::exact_exception;
+        task_group_context context(task_group_context::bound, ctx_traits);
+        run(limit, context);
+    }
+}
 #endif // __TBB_TASK_GROUP_CONTEXT
 
 bool filter::has_more_work() {
@@ -110,6 +110,9 @@ generic_scheduler::generic_scheduler( market& m, bool genuine )
     suppress_unused_warning(genuine);
 #endif
     my_properties.outermost = true;
+#if __TBB_NUMA_SUPPORT
+    my_numa_node = not_sampled_numa_node;
+#endif /*__TBB_NUMA_SUPPORT*/
 #if __TBB_TASK_PRIORITY
     my_ref_top_priority = &m.my_global_top_priority;
     my_ref_reload_epoch = &m.my_global_reload_epoch;
@@ -130,6 +133,20 @@ generic_scheduler::generic_scheduler( market& m, bool genuine )
 #endif // warning 4355 is back
 
 #if TBB_USE_ASSERT > 1
+#if __TBB_LOCKFREE_TASK_POOL
+void generic_scheduler::assert_task_pool_valid() const {
+    if ( !my_arena_slot )
+        return;
+    // Thieves do not lock the lock-free task pool, so the tasks themselves cannot be inspected.
+    if ( my_arena_slot->my_task_pool_size ) {
+        __TBB_ASSERT( my_arena_slot->my_task_pool_size >= min_task_pool_size, NULL );
+        __TBB_ASSERT( header_of_task_pool( my_arena_slot->task_pool_ptr ).mask == my_arena_slot->my_task_pool_size - 1, NULL );
+    }
+    const size_t H = __TBB_load_relaxed(my_arena_slot->head); // mirror
+    const size_t T = __TBB_load_relaxed(my_arena_slot->tail); // mirror
+    __TBB_ASSERT( (intptr_t)(T - H) >= 0 && T - H <= my_arena_slot->my_task_pool_size, NULL );
+}
+#else /* !__TBB_LOCKFREE_TASK_POOL */
 void generic_scheduler::assert_task_pool_valid() const {
     if ( !my_arena_slot )
         return;
@@ -153,6 +170,7 @@ void generic_scheduler::assert_task_pool_valid() const {
         __TBB_ASSERT( tp[i] == poisoned_ptr, "Task pool corrupted" );
     release_task_pool();
 }
+#endif /* !__TBB_LOCKFREE_TASK_POOL */
 #endif /* TBB_USE_ASSERT > 1 */
 
 void generic_scheduler::init_stack_info () {
@@ -303,6 +321,10 @@ void generic_scheduler::cleanup_scheduler() {
     cleanup_local_context_list();
 #endif /* __TBB_TASK_GROUP_CONTEXT */
     free_task<small_local_task>( *my_dummy_task );
+#if __TBB_SCHEDULER_TRACE
+    if( my_trace_buffer )
+        scheduler_trace::release_buffer( my_trace_buffer );
+#endif /* __TBB_SCHEDULER_TRACE */
 
 #if __TBB_HOARD_NONLOCAL_TASKS
     while( task* t = my_nonlocal_free_list ) {
@@ -436,6 +458,58 @@ void generic_scheduler::free_nonlocal_small_task( task& t ) {
     }
 }
 
+#if __TBB_LOCKFREE_TASK_POOL
+inline size_t generic_scheduler::prepare_task_pool ( size_t num_tasks ) {
+    size_t T = __TBB_load_relaxed(my_arena_slot->tail); // mirror
+    if ( !my_arena_slot->my_task_pool_size ) {
+        __TBB_ASSERT( !is_task_pool_published() && is_quiescent_local_task_pool_reset(), NULL );
+        __TBB_ASSERT( !my_arena_slot->task_pool_ptr, NULL );
+        size_t new_size = num_tasks;
+        if ( num_tasks < min_task_pool_size ) new_size = min_task_pool_size;
+        my_arena_slot->allocate_task_pool( new_size );
+        return T;
+    }
+    // Thieves only advance the head, so a stale value can only overestimate the number
+    // of tasks in the pool. Tasks never move, and there are no holes to compact.
+    size_t H = __TBB_load_relaxed( my_arena_slot->head ); // mirror
+    if ( T - H + num_tasks > my_arena_slot->my_task_pool_size )
+        my_arena_slot->grow_task_pool( H, T, T - H + num_tasks ); // updates my_task_pool_size
+    assert_task_pool_valid();
+    return T;
+}
+
+inline task* generic_scheduler::pop_task_pool() {
+    size_t T = __TBB_load_relaxed( my_arena_slot->tail );
+    if ( (intptr_t)(T - __TBB_load_relaxed( my_arena_slot->head )) <= 0 )
+        return NULL;
+    __TBB_store_relaxed( my_arena_slot->tail, --T );
+    atomic_fence();
+    size_t H = __TBB_load_relaxed( my_arena_slot->head );
+    if ( (intptr_t)(T - H) < 0 ) {
+        // A thief has taken the last task.
+        __TBB_store_relaxed( my_arena_slot->tail, T + 1 );
+        return NULL;
+    }
+    task* result = my_arena_slot->task_pool_ptr[T & (my_arena_slot->my_task_pool_size - 1)];
+    if ( H == T ) {
+        // There is only one task in the task pool. Compete with thieves for it by
+        // advancing the head the same way they do.
+        if ( as_atomic( my_arena_slot->head ).compare_and_swap( H + 1, H ) != H )
+            result = NULL;
+        __TBB_store_relaxed( my_arena_slot->tail, T + 1 );
+    }
+    __TBB_ASSERT( !result || !is_poisoned( result ), "The poisoned task is going to be processed" );
+    return result;
+}
+
+template<typename TaskVector>
+void generic_scheduler::return_tasks_to_pool( const TaskVector& tasks ) {
+    size_t num_tasks = tasks.size();
+    size_t T = prepare_task_pool( num_tasks );
+    tasks.copy_memory( my_arena_slot->task_pool_ptr, T, my_arena_slot->my_task_pool_size - 1 );
+    commit_spawned_tasks( T + num_tasks );
+}
+#else /* !__TBB_LOCKFREE_TASK_POOL */
 inline size_t generic_scheduler::prepare_task_pool ( size_t num_tasks ) {
     size_t T = __TBB_load_relaxed(my_arena_slot->tail); // mirror
     if ( T + num_tasks <= my_arena_slot->my_task_pool_size )
@@ -590,6 +664,7 @@ inline void generic_scheduler::unlock_task_pool( arena_slot* victim_arena_slot,
     ITT_NOTIFY(sync_releasing, victim_arena_slot);
     __TBB_store_with_release( victim_arena_slot->task_pool, victim_task_pool );
 }
+#endif /* !__TBB_LOCKFREE_TASK_POOL */
 
 
 inline task* generic_scheduler::prepare_for_spawning( task* t ) {
@@ -671,10 +746,15 @@ void generic_scheduler::local_spawn( task* first, task*& next ) {
 #endif
         {
             size_t T = prepare_task_pool( 1 );
+#if __TBB_LOCKFREE_TASK_POOL
+            my_arena_slot->task_pool_ptr[T & (my_arena_slot->my_task_pool_size - 1)] = prepare_for_spawning( first );
+#else
             my_arena_slot->task_pool_ptr[T] = prepare_for_spawning( first );
+#endif
             commit_spawned_tasks( T + 1 );
             if ( !is_task_pool_published() )
                 publish_task_pool();
+            TRACE_SCHEDULER_EVENT( *this, tek_spawn, first, 1 );
         }
     }
     else {
@@ -707,10 +787,15 @@ void generic_scheduler::local_spawn( task* first, task*& next ) {
         }
         if( size_t num_tasks = tasks.size() ) {
             size_t T = prepare_task_pool( num_tasks );
+#if __TBB_LOCKFREE_TASK_POOL
+            tasks.copy_memory( my_arena_slot->task_pool_ptr, T, my_arena_slot->my_task_pool_size - 1 );
+#else
             tasks.copy_memory( my_arena_slot->task_pool_ptr + T );
+#endif
             commit_spawned_tasks( T + num_tasks );
             if ( !is_task_pool_published() )
                 publish_task_pool();
+            TRACE_SCHEDULER_EVENT( *this, tek_spawn, first, num_tasks );
         }
     }
     my_arena->advertise_new_work<arena::work_spawned>();
@@ -761,6 +846,33 @@ public:
     ~auto_indicator () { my_indicator = false; }
 };
 
+#if __TBB_LOCKFREE_TASK_POOL
+task* generic_scheduler::winnow_task_pool( __TBB_ISOLATION_EXPR( isolation_tag isolation ) ) {
+    GATHER_STATISTIC( ++my_counters.prio_winnowings );
+    __TBB_ASSERT( is_task_pool_published(), NULL );
+    __TBB_ASSERT( my_offloaded_tasks, "At least one task is expected to be already offloaded" );
+    auto_indicator indicator( my_pool_reshuffling_pending );
+
+    // Drain the task pool from the tail and put back the tasks of the current
+    // priority in their original order. Thieves may grab some tasks meanwhile.
+    task *arr[min_task_pool_size];
+    fast_reverse_vector<task*> tasks(arr, min_task_pool_size);
+    while ( task *t = pop_task_pool() ) {
+        // We cannot offload a proxy task (check the priority of it) because it can be already consumed.
+        if ( !is_proxy( *t ) ) {
+            intptr_t p = priority( *t );
+            if ( p<*my_ref_top_priority ) {
+                offload_task( *t, p );
+                continue;
+            }
+        }
+        tasks.push_back( t );
+    }
+    if ( tasks.size() )
+        return_tasks_to_pool( tasks );
+    return get_task( __TBB_ISOLATION_EXPR( isolation ) );
+}
+#else /* !__TBB_LOCKFREE_TASK_POOL */
 task *generic_scheduler::get_task_and_activate_task_pool( size_t H0, __TBB_ISOLATION_ARG( size_t T0, isolation_tag isolation ) ) {
     __TBB_ASSERT( is_local_task_pool_quiescent(), NULL );
 
@@ -858,6 +970,7 @@ task* generic_scheduler::winnow_task_pool( __TBB_ISOLATION_EXPR( isolation_tag i
     my_arena_slot->fill_with_canary_pattern( max( T1, H0 ), T0 );
     return get_task_and_activate_task_pool( 0, __TBB_ISOLATION_ARG( T1, isolation ) );
 }
+#endif /* !__TBB_LOCKFREE_TASK_POOL */
 
 task* generic_scheduler::reload_tasks ( task*& offloaded_tasks, task**& offloaded_task_list_link, __TBB_ISOLATION_ARG( intptr_t top_priority, isolation_tag isolation ) ) {
     GATHER_STATISTIC( ++my_counters.prio_reloads );
@@ -866,7 +979,9 @@ task* generic_scheduler::reload_tasks ( task*& offloaded_tasks, task**& offloade
     // state. However, isolation allows entering stealing loop with non-empty task pool.
     // In principle, it is possible to process reloaded tasks without locking but it will
     // complicate the logic of get_task_and_activate_task_pool (TODO: evaluate).
+#if !__TBB_LOCKFREE_TASK_POOL
     acquire_task_pool();
+#endif
 #else
     __TBB_ASSERT( !is_task_pool_published(), NULL );
 #endif
@@ -904,17 +1019,28 @@ task* generic_scheduler::reload_tasks ( task*& offloaded_tasks, task**& offloade
     __TBB_ASSERT( link, NULL );
     size_t num_tasks = tasks.size();
     if ( !num_tasks ) {
+#if !__TBB_LOCKFREE_TASK_POOL
         __TBB_ISOLATION_EXPR( release_task_pool() );
+#endif
         return NULL;
     }
 
     // Copy found tasks into the task pool.
     GATHER_STATISTIC( ++my_counters.prio_tasks_reloaded );
+#if __TBB_LOCKFREE_TASK_POOL
+    return_tasks_to_pool( tasks );
+    if ( !is_task_pool_published() )
+        publish_task_pool();
+
+    // Find a task available for execution.
+    task *t = get_task( __TBB_ISOLATION_EXPR( isolation ) );
+#else
     size_t T = prepare_task_pool( num_tasks );
     tasks.copy_memory( my_arena_slot->task_pool_ptr + T );
 
     // Find a task available for execution.
     task *t = get_task_and_activate_task_pool( __TBB_load_relaxed( my_arena_slot->head ), __TBB_ISOLATION_ARG( T + num_tasks, isolation ) );
+#endif
     if ( t ) --num_tasks;
     if ( num_tasks )
         my_arena->advertise_new_work<arena::work_spawned>();
@@ -955,6 +1081,53 @@ task* generic_scheduler::reload_tasks( __TBB_ISOLATION_EXPR( isolation_tag isola
 }
 #endif /* __TBB_TASK_PRIORITY */
 
+#if __TBB_LOCKFREE_TASK_POOL
+inline task* generic_scheduler::get_task( __TBB_ISOLATION_EXPR( isolation_tag isolation ) ) {
+    __TBB_ASSERT( is_task_pool_published(), NULL );
+    task* result = NULL;
+#if __TBB_TASK_ISOLATION
+    // Tasks of other isolation regions are taken out and put back afterwards,
+    // as the lock-free task pool cannot have holes.
+    task *arr[min_task_pool_size];
+    fast_reverse_vector<task*> omitted_tasks(arr, min_task_pool_size);
+#endif /* __TBB_TASK_ISOLATION */
+    while ( task* t = pop_task_pool() ) {
+#if __TBB_TASK_ISOLATION
+        if ( isolation != no_isolation && isolation != t->prefix().isolation ) {
+            omitted_tasks.push_back( t );
+            continue;
+        }
+#endif /* __TBB_TASK_ISOLATION */
+        if ( !is_proxy( *t ) ) {
+            result = t;
+            break;
+        }
+        task_proxy& tp = static_cast<task_proxy&>(*t);
+        if ( (result = tp.extract_task<task_proxy::pool_bit>()) ) {
+            GATHER_STATISTIC( ++my_counters.proxies_executed );
+            // Following assertion should be true because TBB 2.0 tasks never specify affinity, and hence are not proxied.
+            __TBB_ASSERT( is_version_3_task( *result ), "backwards compatibility with TBB 2.0 broken" );
+            my_innermost_running_task = result; // prepare for calling note_affinity()
+            result->note_affinity( my_affinity_id );
+            break;
+        }
+        // Proxy was empty, so it's our responsibility to free it
+        free_task<small_task>( tp );
+    }
+#if __TBB_TASK_ISOLATION
+    if ( omitted_tasks.size() ) {
+        return_tasks_to_pool( omitted_tasks );
+        // Synchronize with snapshot as we published some tasks.
+        my_arena->advertise_new_work<arena::wakeup>();
+    }
+#endif /* __TBB_TASK_ISOLATION */
+    // The pool can only become empty here, as thieves do not put tasks back.
+    if ( __TBB_load_relaxed( my_arena_slot->head ) == __TBB_load_relaxed( my_arena_slot->tail ) )
+        leave_task_pool();
+    __TBB_ASSERT( result || is_task_pool_published() || is_quiescent_local_task_pool_reset(), NULL );
+    return result;
+} // generic_scheduler::get_task
+#else /* !__TBB_LOCKFREE_TASK_POOL */
 #if __TBB_TASK_ISOLATION
 inline task* generic_scheduler::get_task( size_t T, isolation_tag isolation, bool& tasks_omitted )
 #else
@@ -1105,6 +1278,7 @@ inline task* generic_scheduler::get_task( __TBB_ISOLATION_EXPR( isolation_tag is
     __TBB_ASSERT( result || __TBB_ISOLATION_EXPR( tasks_omitted || ) is_quiescent_local_task_pool_reset(), NULL );
     return result;
 } // generic_scheduler::get_task
+#endif /* !__TBB_LOCKFREE_TASK_POOL */
 
 task* generic_scheduler::steal_task( __TBB_ISOLATION_EXPR(isolation_tag isolation) ) {
     // Try to steal a task from a random victim.
@@ -1117,10 +1291,41 @@ task* generic_scheduler::steal_task( __TBB_ISOLATION_EXPR(isolation_tag isolatio
     // the checks simple seems to be preferable to complicating the code.
     if( k >= my_arena_index )
         ++victim;               // Adjusts random distribution to exclude self
+#if __TBB_NUMA_SUPPORT
+    const int numa_node = my_arena_slot->my_numa_node;
+    bool local_level = numa_node >= 0 && my_numa_steal_failures < numa_local_steal_attempts;
+    for ( unsigned probe = 1; local_level && victim->my_numa_node != numa_node; ++probe ) {
+        if ( probe == numa_victim_probes ) {
+            // No thread of the same node has been found, so steal from the remote one.
+            local_level = false;
+            if ( ++my_numa_steal_failures == numa_local_steal_attempts )
+                GATHER_STATISTIC( ++my_counters.numa_escalations );
+            break;
+        }
+        k = my_random.get() % (my_arena->my_limit-1);
+        victim = &my_arena->my_slots[k];
+        if( k >= my_arena_index )
+            ++victim;
+    }
+#endif /*__TBB_NUMA_SUPPORT*/
     task **pool = victim->task_pool;
     task *t = NULL;
-    if( pool == EmptyTaskPool || !(t = steal_task_from( __TBB_ISOLATION_ARG(*victim, isolation) )) )
+    if( pool == EmptyTaskPool || !(t = steal_task_from( __TBB_ISOLATION_ARG(*victim, isolation) )) ) {
+#if __TBB_NUMA_SUPPORT
+        if ( local_level && ++my_numa_steal_failures == numa_local_steal_attempts )
+            GATHER_STATISTIC( ++my_counters.numa_escalations );
+#endif /*__TBB_NUMA_SUPPORT*/
         return NULL;
+    }
+#if __TBB_NUMA_SUPPORT
+    if ( numa_node >= 0 ) {
+        if ( victim->my_numa_node == numa_node )
+            GATHER_STATISTIC( ++my_counters.numa_local_steals );
+        else
+            GATHER_STATISTIC( ++my_counters.numa_remote_steals );
+        my_numa_steal_failures = 0;
+    }
+#endif /*__TBB_NUMA_SUPPORT*/
     if( is_proxy(*t) ) {
         task_proxy &tp = *(task_proxy*)t;
         t = tp.extract_task<task_proxy::pool_bit>();
@@ -1138,9 +1343,51 @@ task* generic_scheduler::steal_task( __TBB_ISOLATION_EXPR(isolation_tag isolatio
         t->note_affinity( my_affinity_id );
     }
     GATHER_STATISTIC( ++my_counters.steals_committed );
+    TRACE_SCHEDULER_EVENT( *this, tek_steal, t, victim - my_arena->my_slots );
     return t;
 }
 
+#if __TBB_LOCKFREE_TASK_POOL
+task* generic_scheduler::steal_task_from( __TBB_ISOLATION_ARG( arena_slot& victim_slot, isolation_tag isolation ) ) {
+    size_t H = __TBB_load_with_acquire( victim_slot.head );
+    atomic_fence();
+    size_t T = __TBB_load_with_acquire( victim_slot.tail );
+    if ( (intptr_t)(T - H) <= 0 ) {
+        GATHER_STATISTIC( ++my_counters.thief_backoffs );
+        return NULL;
+    }
+    // The array is read after the tail, so it holds the task at position H even if
+    // the owner has grown the pool since. Retired arrays are never freed while in use.
+    task** victim_pool = __TBB_load_with_acquire( victim_slot.task_pool_ptr );
+    task* result = victim_pool[H & header_of_task_pool( victim_pool ).mask];
+    if ( as_atomic( victim_slot.head ).compare_and_swap( H + 1, H ) != H ) {
+        // The owner or another thief has taken the task.
+        GATHER_STATISTIC( ++my_counters.thieves_conflicts );
+        return NULL;
+    }
+    __TBB_ASSERT( result && !is_poisoned( result ), NULL );
+    // emit "task was consumed" signal
+    ITT_NOTIFY( sync_acquired, (void*)((uintptr_t)&victim_slot+sizeof( uintptr_t )) );
+#if __TBB_PREFETCHING
+    __TBB_cl_evict(&victim_slot.head);
+    __TBB_cl_evict(&victim_slot.tail);
+#endif
+#if __TBB_TASK_ISOLATION
+    // The task can be inspected only after it has been claimed. If it belongs to another
+    // isolation region, keep it in the local task pool, from where it is available to others.
+    if ( isolation != no_isolation && isolation != result->prefix().isolation ) {
+        size_t T1 = prepare_task_pool( 1 );
+        my_arena_slot->task_pool_ptr[T1 & (my_arena_slot->my_task_pool_size - 1)] = result;
+        commit_spawned_tasks( T1 + 1 );
+        if ( !is_task_pool_published() )
+            publish_task_pool();
+        my_arena->advertise_new_work<arena::work_spawned>();
+        return NULL;
+    }
+#endif /* __TBB_TASK_ISOLATION */
+    return result;
+}
+#else /* !__TBB_LOCKFREE_TASK_POOL */
 task* generic_scheduler::steal_task_from( __TBB_ISOLATION_ARG( arena_slot& victim_slot, isolation_tag isolation ) ) {
     task** victim_pool = lock_task_pool( &victim_slot );
     if ( !victim_pool )
@@ -1205,6 +1452,7 @@ unlock:
         my_arena->advertise_new_work<arena::wakeup>();
     return result;
 }
+#endif /* !__TBB_LOCKFREE_TASK_POOL */
 
 #if __TBB_PREVIEW_CRITICAL_TASKS
 // Retrieves critical task respecting isolation level, if provided. The rule is:
@@ -1261,8 +1509,13 @@ inline void generic_scheduler::leave_task_pool() {
     __TBB_ASSERT( is_task_pool_published(), "Not in arena" );
     // Do not reset my_arena_index. It will be used to (attempt to) re-acquire the slot next time
     __TBB_ASSERT( &my_arena->my_slots[my_arena_index] == my_arena_slot, "arena slot and slot index mismatch" );
+#if __TBB_LOCKFREE_TASK_POOL
+    __TBB_ASSERT ( __TBB_load_relaxed(my_arena_slot->head) == __TBB_load_relaxed(my_arena_slot->tail),
+                   "Cannot leave arena when the task pool is not empty" );
+#else
     __TBB_ASSERT ( my_arena_slot->task_pool == LockedTaskPool, "Task pool must be locked when leaving arena" );
     __TBB_ASSERT ( is_quiescent_local_task_pool_empty(), "Cannot leave arena when the task pool is not empty" );
+#endif
     ITT_NOTIFY(sync_releasing, &my_arena->my_slots[my_arena_index]);
     // No release fence is necessary here as this assignment precludes external
     // accesses to the local task pool when becomes visible. Thus it is harmless
@@ -1306,8 +1559,9 @@ generic_scheduler* generic_scheduler::create_master( arena* a ) {
 #endif /* __TBB_TASK_GROUP_CONTEXT */
     if( a ) {
         // Master thread always occupies the first slot
+        bool occupied = a->occupy_slot( /*index*/0, *s );
+        __TBB_ASSERT_EX( occupied, "The first slot of a new arena must be free" );
         s->attach_arena( a, /*index*/0, /*is_master*/true );
-        s->my_arena_slot->my_scheduler = s;
 #if __TBB_TASK_GROUP_CONTEXT
         a->my_default_ctx = s->default_context(); // also transfers implied ownership
 #endif
@@ -1343,7 +1597,9 @@ bool generic_scheduler::cleanup_master( bool blocking_terminate ) {
     market * const m = my_market;
     __TBB_ASSERT( my_market, NULL );
     if( a && is_task_pool_published() ) {
+#if !__TBB_LOCKFREE_TASK_POOL
         acquire_task_pool();
+#endif
         if ( my_arena_slot->task_pool == EmptyTaskPool ||
              __TBB_load_relaxed(my_arena_slot->head) >= __TBB_load_relaxed(my_arena_slot->tail) )
         {
@@ -1352,7 +1608,9 @@ bool generic_scheduler::cleanup_master( bool blocking_terminate ) {
         }
         else {
             // Master's local task pool may e.g. contain proxies of affinitized tasks.
+#if !__TBB_LOCKFREE_TASK_POOL
             release_task_pool();
+#endif
             __TBB_ASSERT ( governor::is_set(this), "TLS slot is cleared before the task pool cleanup" );
             // Set refcount to make the following dispach loop infinite (it is interrupted by the cleanup logic).
             my_dummy_task->set_ref_count(2);
@@ -1376,7 +1634,7 @@ bool generic_scheduler::cleanup_master( bool blocking_terminate ) {
 #if __TBB_STATISTICS
         *my_arena_slot->my_counters += my_counters;
 #endif /* __TBB_STATISTICS */
-        __TBB_store_with_release(my_arena_slot->my_scheduler, (generic_scheduler*)NULL);
+        a->release_slot( 0 );
     }
 #if __TBB_TASK_GROUP_CONTEXT
     else { // task_group_context ownership was not transferred to arena
@@ -22,6 +22,7 @@
 #include "mailbox.h"
 #include "tbb_misc.h" // for FastRandom
 #include "itt_notify.h"
+#include "scheduler_trace.h"
 #include "../rml/include/rml_tbb.h"
 
 #include "intrusive_list.h"
@@ -174,6 +175,25 @@ public: // almost every class in TBB uses generic_scheduler
     //! Random number generator used for picking a random victim from which to steal.
     FastRandom my_random;
 
+#if __TBB_NUMA_SUPPORT
+    //! Number of consecutive failed attempts to steal from the threads of the same NUMA node.
+    /** When it reaches numa_local_steal_attempts, victims are chosen among all the threads
+        of the arena until a steal succeeds. **/
+    unsigned my_numa_steal_failures;
+
+    //! NUMA node of the thread, or not_sampled_numa_node if it has not been queried yet.
+    /** The node is queried when the thread first occupies a slot of a NUMA-aware arena,
+        and is then reused for all the slots the thread occupies. **/
+    int my_numa_node;
+
+    static const int not_sampled_numa_node = -2;
+
+    static const unsigned numa_local_steal_attempts = 8;
+
+    //! Number of random draws made to find a victim on the same NUMA node.
+    static const unsigned numa_victim_probes = 4;
+#endif /*__TBB_NUMA_SUPPORT*/
+
     //! Free list of small tasks that can be reused.
     task* my_free_list;
 
@@ -285,6 +305,18 @@ public: // almost every class in TBB uses generic_scheduler
     /** Leaving task pool automatically releases the task pool if it is locked. **/
     void leave_task_pool();
 
+#if __TBB_LOCKFREE_TASK_POOL
+    //! Takes the task at the tail of the local task pool.
+    /** Called only by the pool owner. Returns NULL if the pool is empty or if the
+        last remaining task has been taken by a thief. **/
+    inline task* pop_task_pool();
+
+    //! Puts the tasks back to the tail of the local task pool preserving their order.
+    /** The tasks must have been taken from the tail by pop_task_pool, the one taken first
+        being pushed to the vector first. **/
+    template<typename TaskVector>
+    void return_tasks_to_pool( const TaskVector& tasks );
+#else /* !__TBB_LOCKFREE_TASK_POOL */
     //! Resets head and tail indices to 0, and leaves task pool
     /** The task pool must be locked by the owner (via acquire_task_pool).**/
     inline void reset_task_pool_and_leave ();
@@ -306,6 +338,7 @@ public: // almost every class in TBB uses generic_scheduler
     /** Restores my_arena_slot->task_pool munged by acquire_task_pool. Requires
         correctly set my_arena_slot->task_pool_ptr. **/
     void release_task_pool() const;
+#endif /* !__TBB_LOCKFREE_TASK_POOL */
 
     //! Checks if t is affinitized to another thread, and if so, bundles it as proxy.
     /** Returns either t or proxy containing t. **/
@@ -314,9 +347,11 @@ public: // almost every class in TBB uses generic_scheduler
     //! Makes newly spawned tasks visible to thieves
     inline void commit_spawned_tasks( size_t new_tail );
 
+#if !__TBB_LOCKFREE_TASK_POOL
     //! Makes relocated tasks visible to thieves and releases the local task pool.
     /** Obviously, the task pool must be locked when calling this method. **/
     inline void commit_relocated_tasks( size_t new_tail );
+#endif
 
     //! Get a task from the local pool.
     /** Called only by the pool owner.
@@ -324,6 +359,7 @@ public: // almost every class in TBB uses generic_scheduler
         Resets the pool if it is empty. **/
     task* get_task( __TBB_ISOLATION_EXPR( isolation_tag isolation ) );
 
+#if !__TBB_LOCKFREE_TASK_POOL
     //! Get a task from the local pool at specified location T.
     /** Returns the pointer to the task or NULL if the task cannot be executed,
         e.g. proxy has been deallocated or isolation constraint is not met.
@@ -335,6 +371,7 @@ public: // almost every class in TBB uses generic_scheduler
 #else
     task* get_task( size_t T );
 #endif /* __TBB_TASK_ISOLATION */
+#endif /* !__TBB_LOCKFREE_TASK_POOL */
     //! Attempt to get a task from the mailbox.
     /** Gets a task only if it has not been executed by its sender or a thief
         that has stolen it from the sender's task pool. Otherwise returns NULL.
@@ -532,9 +569,11 @@ public:
     /** Returns the next execution candidate task or NULL. **/
     task* winnow_task_pool ( __TBB_ISOLATION_EXPR( isolation_tag isolation ) );
 
+#if !__TBB_LOCKFREE_TASK_POOL
     //! Get a task from locked or empty pool in range [H0, T0). Releases or unlocks the task pool.
     /** Returns the found task or NULL. **/
     task *get_task_and_activate_task_pool( size_t H0 , __TBB_ISOLATION_ARG( size_t T0, isolation_tag isolation ) );
+#endif
 
     //! Unconditionally moves the task into offload area.
     inline void offload_task ( task& t, intptr_t task_priority );
@@ -613,6 +652,21 @@ public:
     mutable statistics_counters my_counters;
 #endif /* __TBB_STATISTICS */
 
+#if __TBB_SCHEDULER_TRACE
+    //! Buffer of the scheduler trace events of this thread
+    /** Acquired when the thread records its first event. **/
+    trace_buffer* my_trace_buffer;
+
+    //! Returns the trace buffer of this thread, or NULL if the trace is off
+    trace_buffer* tracer() {
+        if( !scheduler_trace::enabled() )
+            return NULL;
+        if( !my_trace_buffer )
+            my_trace_buffer = scheduler_trace::acquire_buffer( is_worker() );
+        return my_trace_buffer;
+    }
+#endif /* __TBB_SCHEDULER_TRACE */
+
 }; // class generic_scheduler
 
 
@@ -633,7 +687,12 @@ inline bool generic_scheduler::is_task_pool_published () const {
 inline bool generic_scheduler::is_local_task_pool_quiescent () const {
     __TBB_ASSERT(my_arena_slot, 0);
     task** tp = my_arena_slot->task_pool;
+#if __TBB_LOCKFREE_TASK_POOL
+    // Thieves never lock the lock-free task pool, so only an unpublished pool is quiescent.
+    return tp == EmptyTaskPool;
+#else
     return tp == EmptyTaskPool || tp == LockedTaskPool;
+#endif
 }
 
 inline bool generic_scheduler::is_quiescent_local_task_pool_empty () const {
@@ -643,7 +702,12 @@ inline bool generic_scheduler::is_quiescent_local_task_pool_empty () const {
 
 inline bool generic_scheduler::is_quiescent_local_task_pool_reset () const {
     __TBB_ASSERT( is_local_task_pool_quiescent(), "Task pool is not quiescent" );
+#if __TBB_LOCKFREE_TASK_POOL
+    // The indices of the lock-free task pool are never reset, so an empty pool is as good as reset.
+    return __TBB_load_relaxed(my_arena_slot->head) == __TBB_load_relaxed(my_arena_slot->tail);
+#else
     return __TBB_load_relaxed(my_arena_slot->head) == 0 && __TBB_load_relaxed(my_arena_slot->tail) == 0;
+#endif
 }
 
 inline bool generic_scheduler::outermost_level () const {
@@ -699,16 +763,23 @@ inline intptr_t generic_scheduler::get_task_node_count( bool count_arena_workers
 }
 #endif /* __TBB_COUNT_TASK_NODES */
 
+#if !__TBB_LOCKFREE_TASK_POOL
 inline void generic_scheduler::reset_task_pool_and_leave () {
     __TBB_ASSERT( my_arena_slot->task_pool == LockedTaskPool, "Task pool must be locked when resetting task pool" );
     __TBB_store_relaxed( my_arena_slot->tail, 0 );
     __TBB_store_relaxed( my_arena_slot->head, 0 );
     leave_task_pool();
 }
+#endif /* !__TBB_LOCKFREE_TASK_POOL */
 
 //TODO: move to arena_slot
 inline void generic_scheduler::commit_spawned_tasks( size_t new_tail ) {
+#if __TBB_LOCKFREE_TASK_POOL
+    __TBB_ASSERT ( new_tail - __TBB_load_relaxed(my_arena_slot->head) <= my_arena_slot->my_task_pool_size,
+                   "task deque end was overwritten" );
+#else
     __TBB_ASSERT ( new_tail <= my_arena_slot->my_task_pool_size, "task deque end was overwritten" );
+#endif
     // emit "task was released" signal
     ITT_NOTIFY(sync_releasing, (void*)((uintptr_t)my_arena_slot+sizeof(uintptr_t)));
     // Release fence is necessary to make sure that previously stored task pointers
@@ -716,6 +787,7 @@ inline void generic_scheduler::commit_spawned_tasks( size_t new_tail ) {
     __TBB_store_with_release( my_arena_slot->tail, new_tail );
 }
 
+#if !__TBB_LOCKFREE_TASK_POOL
 void generic_scheduler::commit_relocated_tasks ( size_t new_tail ) {
     __TBB_ASSERT( is_local_task_pool_quiescent(),
                   "Task pool must be locked when calling commit_relocated_tasks()" );
@@ -725,6 +797,7 @@ void generic_scheduler::commit_relocated_tasks ( size_t new_tail ) {
     __TBB_store_release( my_arena_slot->tail, new_tail );
     release_task_pool();
 }
+#endif /* !__TBB_LOCKFREE_TASK_POOL */
 
 template<free_task_hint hint>
 void generic_scheduler::free_task( task& t ) {
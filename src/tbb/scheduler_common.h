@@ -342,6 +342,12 @@ struct arena_slot_line1 {
     /** Modified by thieves, and by the owner during compaction/reallocation **/
     __TBB_atomic size_t head;
 
+#if __TBB_NUMA_SUPPORT
+    //! NUMA node of the thread attached to the slot.
+    /** -1 if the node is unknown or the arena does not use NUMA-aware stealing. **/
+    int my_numa_node;
+#endif /*__TBB_NUMA_SUPPORT*/
+
 #if __TBB_PREVIEW_RESUMABLE_TASKS
     //! The flag is raised when the original owner of the scheduler should return to this scheduler (for resume).
     tbb::atomic<bool>* my_scheduler_is_recalled;
@@ -374,7 +380,75 @@ struct arena_slot_line2 {
 #endif /* __TBB_STATISTICS */
 };
 
+#if __TBB_LOCKFREE_TASK_POOL
+//! Bookkeeping data placed in front of each circular array of the lock-free task pool.
+struct task_pool_header {
+    //! Index mask of the array, i.e. its capacity minus one. The capacity is a power of two.
+    size_t mask;
+
+    //! The array that was replaced by this one when the task pool grew.
+    /** Thieves can still read retired arrays, so they are freed only together with the slot. **/
+    task** retired;
+};
+
+inline task_pool_header& header_of_task_pool( task** pool ) {
+    return ((task_pool_header*)pool)[-1];
+}
+#endif /* __TBB_LOCKFREE_TASK_POOL */
+
 struct arena_slot : padded<arena_slot_line1>, padded<arena_slot_line2> {
+#if __TBB_LOCKFREE_TASK_POOL
+    /** In this mode task_pool_ptr is a circular array indexed by head and tail modulo its
+        capacity. The indices only grow (they are never reset to 0), so that a thief holding
+        a stale copy of the head cannot succeed in claiming a task. The task_pool member only
+        marks the pool as published or empty; it is never locked. **/
+    void fill_with_canary_pattern ( size_t, size_t ) {}
+
+    static task** allocate_circular_task_pool( size_t capacity, task** retired ) {
+        __TBB_ASSERT( capacity && !(capacity & (capacity - 1)), "capacity must be a power of two" );
+        task_pool_header* h = (task_pool_header*)NFS_Allocate( 1, sizeof(task_pool_header) + capacity * sizeof(task*), NULL );
+        h->mask = capacity - 1;
+        h->retired = retired;
+        return (task**)(h + 1);
+    }
+
+    void allocate_task_pool( size_t n ) {
+        size_t capacity = 1;
+        while ( capacity < n )
+            capacity *= 2;
+        my_task_pool_size = capacity;
+        task_pool_ptr = allocate_circular_task_pool( capacity, NULL );
+    }
+
+    //! Replaces the circular array with a larger one holding at least n elements.
+    /** Only the owner calls this method. Tasks in range [h, t) keep their indices. **/
+    void grow_task_pool( size_t h, size_t t, size_t n ) {
+        task** old_pool = task_pool_ptr;
+        const size_t old_mask = my_task_pool_size - 1;
+        size_t capacity = 2 * my_task_pool_size;
+        while ( capacity < n )
+            capacity *= 2;
+        task** new_pool = allocate_circular_task_pool( capacity, old_pool );
+        for ( size_t i = h; i != t; ++i )
+            new_pool[i & (capacity - 1)] = old_pool[i & old_mask];
+        my_task_pool_size = capacity;
+        // Thieves read the array pointer after the tail, so the copied tasks must be
+        // visible before the tail moves past them.
+        __TBB_store_with_release( task_pool_ptr, new_pool );
+    }
+
+    //! Deallocate task pool that was allocated by means of allocate_task_pool.
+    void free_task_pool( ) {
+        task** pool = task_pool_ptr;
+        while ( pool ) {
+            task_pool_header& h = header_of_task_pool( pool );
+            pool = h.retired;
+            NFS_Free( &h );
+        }
+        task_pool_ptr = NULL;
+        my_task_pool_size = 0;
+    }
+#else /* !__TBB_LOCKFREE_TASK_POOL */
 #if TBB_USE_ASSERT
     void fill_with_canary_pattern ( size_t first, size_t last ) {
         for ( size_t i = first; i < last; ++i )
@@ -404,6 +478,7 @@ struct arena_slot : padded<arena_slot_line1>, padded<arena_slot_line2> {
            my_task_pool_size = 0;
         }
     }
+#endif /* !__TBB_LOCKFREE_TASK_POOL */
 };
 
 #if !__TBB_CPU_CTL_ENV_PRESENT
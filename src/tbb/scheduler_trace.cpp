@@ -0,0 +1,244 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "scheduler_trace.h"
+
+#if __TBB_SCHEDULER_TRACE
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "tbb/spin_mutex.h"
+#include "tbb/cache_aligned_allocator.h"
+#include "tbb_environment.h"
+
+#if __GNUC__
+#include <cxxabi.h>
+#endif
+
+namespace tbb {
+namespace internal {
+
+bool scheduler_trace::is_enabled;
+
+//! Protects the list of the buffers and the state of the trace
+static spin_mutex trace_mutex;
+
+//! List of all the buffers, owned by threads and free
+static trace_buffer* trace_buffers;
+
+static unsigned trace_buffer_count;
+
+//! Number of the events kept per thread, a power of two
+static size_t trace_buffer_size = 32 * 1024;
+
+//! True if the trace is turned on by TBB_TRACE_FILE
+static bool trace_env_enabled;
+
+//! True if global_control::scheduler_tracing is active
+static bool trace_control_active;
+
+//! The clock and the time when the trace was turned on
+/** The events recorded earlier are left out of the output. **/
+static trace_time_t trace_start_clock;
+static tick_count trace_start_time;
+
+//! Titles of the events defined by trace_event_kind, except for tasks that are named by their types
+static const char* const trace_event_titles[] = {
+    "task", "spawn", "enqueue", "steal", "arena enter", "arena leave", "worker active", "workers request"
+};
+
+//! Names of the values of the events defined by trace_event_kind
+static const char* const trace_value_titles[] = {
+    NULL, "count", NULL, "victim", "slot", "slot", NULL, "delta"
+};
+
+static const char* trace_file_name() {
+#if __TBB_WIN8UI_SUPPORT
+    return NULL;
+#else
+    const char* name = std::getenv( "TBB_TRACE_FILE" );
+    return name && *name ? name : NULL;
+#endif
+}
+
+void scheduler_trace::initialize() {
+    long size = GetIntegralEnvironmentVariable( "TBB_TRACE_BUFFER_SIZE" );
+    if( size > 0 ) {
+        size_t n = 2;
+        while( n < size_t(size) && n < max_trace_buffer_size )
+            n <<= 1;
+        trace_buffer_size = n;
+    }
+    if( trace_file_name() ) {
+        spin_mutex::scoped_lock lock( trace_mutex );
+        trace_env_enabled = true;
+        if( !trace_control_active )
+            start();
+    }
+}
+
+void scheduler_trace::finalize() {
+    spin_mutex::scoped_lock lock( trace_mutex );
+    if( trace_env_enabled ) {
+        __TBB_store_relaxed( is_enabled, false );
+        trace_env_enabled = false;
+        if( const char* name = trace_file_name() )
+            dump( name );
+    }
+    // The buffers of the threads that are still alive are left in place.
+    for( trace_buffer** link = &trace_buffers; trace_buffer* b = *link; ) {
+        if( b->my_is_owned ) {
+            link = &b->my_next;
+        } else {
+            *link = b->my_next;
+            NFS_Free( b->my_events );
+            NFS_Free( b );
+        }
+    }
+}
+
+void scheduler_trace::set_control_active( bool active ) {
+    spin_mutex::scoped_lock lock( trace_mutex );
+    trace_control_active = active;
+    // The trace turned on for the whole run is not affected
+    if( trace_env_enabled )
+        return;
+    if( active ) {
+        start();
+    } else {
+        __TBB_store_relaxed( is_enabled, false );
+        const char* name = trace_file_name();
+        dump( name ? name : "tbb_trace.json" );
+    }
+}
+
+void scheduler_trace::start() {
+    trace_start_time = tick_count::now();
+    trace_start_clock = trace_clock();
+    __TBB_store_with_release( is_enabled, true );
+}
+
+trace_buffer* scheduler_trace::acquire_buffer( bool is_worker ) {
+    spin_mutex::scoped_lock lock( trace_mutex );
+    for( trace_buffer* b = trace_buffers; b; b = b->my_next ) {
+        if( !b->my_is_owned ) {
+            b->my_is_owned = true;
+            return b;
+        }
+    }
+    trace_buffer* b = NULL;
+    __TBB_TRY {
+        b = new( NFS_Allocate( 1, sizeof(trace_buffer), NULL ) ) trace_buffer;
+        b->my_events = (trace_event*)NFS_Allocate( trace_buffer_size, sizeof(trace_event), NULL );
+    } __TBB_CATCH( std::bad_alloc& ) {
+        if( b )
+            NFS_Free( b );
+        return NULL;
+    }
+    b->my_index = trace_buffer_count++;
+    b->my_is_owned = true;
+    b->my_is_worker = is_worker;
+    b->my_mask = trace_buffer_size - 1;
+    b->my_count = 0;
+    b->my_next = trace_buffers;
+    trace_buffers = b;
+    return b;
+}
+
+void scheduler_trace::release_buffer( trace_buffer* buffer ) {
+    spin_mutex::scoped_lock lock( trace_mutex );
+    __TBB_ASSERT( buffer->my_is_owned, NULL );
+    buffer->my_is_owned = false;
+}
+
+//! Demangles the names of the task types, reusing the result for the repeated names
+class trace_name_cache : no_copy {
+    const char* my_raw;
+    char* my_demangled;
+public:
+    trace_name_cache() : my_raw(NULL), my_demangled(NULL) {}
+    ~trace_name_cache() { std::free( my_demangled ); }
+    const char* get( const char* raw ) {
+#if __GNUC__
+        if( raw != my_raw ) {
+            std::free( my_demangled );
+            int status = 0;
+            my_demangled = abi::__cxa_demangle( raw, NULL, NULL, &status );
+            my_raw = raw;
+        }
+        return my_demangled ? my_demangled : raw;
+#else
+        return raw;
+#endif
+    }
+};
+
+void scheduler_trace::dump( const char* file_name ) {
+    std::FILE* f = std::fopen( file_name, "w" );
+    if( !f ) {
+        runtime_warning( "cannot open the scheduler trace file %s", file_name );
+        return;
+    }
+#ifdef __TBB_time_stamp
+    // The time stamp counter is assumed to run at a constant rate.
+    // Measure it over at least 10 ms to get a precise rate.
+    tick_count now;
+    trace_time_t clock;
+    do {
+        now = tick_count::now();
+        clock = trace_clock();
+    } while( (now - trace_start_time).seconds() < 0.01 );
+    const double clocks_per_us = double( clock - trace_start_clock ) / ( (now - trace_start_time).seconds() * 1e6 );
+#else
+    const double clocks_per_us = 1e3;
+#endif
+    trace_name_cache names;
+    std::fprintf( f, "{\"traceEvents\":[" );
+    const char* separator = "\n";
+    for( trace_buffer* b = trace_buffers; b; b = b->my_next ) {
+        std::fprintf( f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"TBB %s %u\"}}",
+                      separator, b->my_index, b->my_is_worker ? "worker" : "master", b->my_index );
+        separator = ",\n";
+        // The owner can go on recording, the events overwritten meanwhile are skipped
+        // by the checks below.
+        const size_t count = __TBB_load_with_acquire( b->my_count );
+        const size_t n = count < b->my_mask + 1 ? count : b->my_mask + 1;
+        for( size_t i = count - n; i != count; ++i ) {
+            const trace_event& e = b->my_events[i & b->my_mask];
+            if( e.kind < 0 || e.kind >= tek_num_kinds || e.begin < trace_start_clock || e.end < e.begin )
+                continue;
+            const double ts = double( e.begin - trace_start_clock ) / clocks_per_us;
+            const char* title = e.kind == tek_task_execute && e.name ? names.get( e.name ) : trace_event_titles[e.kind];
+            std::fprintf( f, ",\n{\"name\":\"%s\",\"cat\":\"tbb\",\"pid\":1,\"tid\":%u,\"ts\":%.3f", title, b->my_index, ts );
+            if( e.kind == tek_task_execute || e.kind == tek_worker_active )
+                std::fprintf( f, ",\"ph\":\"X\",\"dur\":%.3f", double( e.end - e.begin ) / clocks_per_us );
+            else
+                std::fprintf( f, ",\"ph\":\"i\",\"s\":\"t\"" );
+            std::fprintf( f, ",\"args\":{\"object\":\"%p\"", e.object );
+            if( const char* value_title = trace_value_titles[e.kind] )
+                std::fprintf( f, ",\"%s\":%ld", value_title, long( e.value ) );
+            std::fprintf( f, "}}" );
+        }
+    }
+    std::fprintf( f, "\n],\"displayTimeUnit\":\"ns\"}\n" );
+    std::fclose( f );
+}
+
+} // namespace internal
+} // namespace tbb
+
+#endif /* __TBB_SCHEDULER_TRACE */
@@ -0,0 +1,189 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _TBB_scheduler_trace_H
+#define _TBB_scheduler_trace_H
+
+/**
+    This file defines the runtime trace of the task scheduler activity.
+
+    Each thread with a scheduler records the events into its own ring buffer, so
+    recording takes neither locks nor read-modify-write operations. When the buffer
+    is full, the oldest events are overwritten. The buffers are written into a file
+    in the Chrome trace event format (JSON) that can be opened by chrome://tracing
+    or by Perfetto UI.
+
+    The trace is off by default. It is turned on
+    - for the whole run, by TBB_TRACE_FILE environment variable set to the name of
+      the output file. The trace is written when the library is unloaded.
+    - for a region of the program, by global_control::scheduler_tracing. The trace
+      is written when the last such global_control object is destroyed, to the file
+      named by TBB_TRACE_FILE or to "tbb_trace.json" in the current directory.
+    TBB_TRACE_BUFFER_SIZE sets the number of the events kept per thread.
+
+    When the trace is off, a trace point costs the load of a global flag and a branch.
+    Define __TBB_SCHEDULER_TRACE to 0 to remove the trace points at compile time.
+**/
+
+#include "tbb/tbb_stddef.h"
+#include "tbb/tbb_machine.h"
+
+#ifndef __TBB_SCHEDULER_TRACE
+#define __TBB_SCHEDULER_TRACE 1
+#endif /* __TBB_SCHEDULER_TRACE */
+
+#if __TBB_SCHEDULER_TRACE
+
+#include "tbb/tick_count.h"
+
+namespace tbb {
+namespace internal {
+
+//! Timestamp of trace events
+/** The time stamp counter is used where available, because it is several times cheaper
+    than the system clock. It is converted to the time by a calibration against
+    tick_count when the trace is written. **/
+typedef uint64_t trace_time_t;
+
+inline trace_time_t trace_clock() {
+#ifdef __TBB_time_stamp
+    return __TBB_time_stamp();
+#else
+    return trace_time_t( (tick_count::now() - tick_count()).seconds() * 1e9 );
+#endif
+}
+
+enum trace_event_kind {
+    //! Execution of a task. The object is the task, the name is its dynamic type.
+    tek_task_execute,
+    //! Spawn of tasks. The value is the number of the tasks.
+    tek_spawn,
+    //! Enqueue of a task into the arena. The object is the task.
+    tek_enqueue,
+    //! Successful steal. The object is the task, the value is the index of the victim slot.
+    tek_steal,
+    //! A thread occupies a slot of an arena. The object is the arena, the value is the slot index.
+    tek_arena_enter,
+    //! A thread leaves an arena. The object is the arena, the value is the slot index.
+    tek_arena_leave,
+    //! A worker is busy with arenas between its wake up by RML and its return to RML.
+    tek_worker_active,
+    //! The market changes the number of workers requested from RML. The value is the change.
+    tek_workers_request,
+    tek_num_kinds
+};
+
+struct trace_event {
+    trace_time_t begin;
+    //! Equals to begin for instant events
+    trace_time_t end;
+    const void* object;
+    const char* name;
+    intptr_t value;
+    trace_event_kind kind;
+};
+
+//! Ring buffer of the events recorded by a single thread
+class trace_buffer : no_copy {
+    friend class scheduler_trace;
+
+    //! Next buffer in the list of all the buffers
+    trace_buffer* my_next;
+
+    //! Used as a thread id in the trace
+    unsigned my_index;
+
+    //! True if the buffer is given to a thread
+    bool my_is_owned;
+
+    //! True if the first owner of the buffer is a worker
+    bool my_is_worker;
+
+    //! Number of the events in the buffer minus 1, that is a power of two minus 1
+    size_t my_mask;
+
+    //! Number of the events recorded since the buffer creation; written by the owner only
+    size_t my_count;
+
+    trace_event* my_events;
+
+public:
+    void record( trace_event_kind kind, trace_time_t begin, trace_time_t end,
+                 const void* object, const char* name, intptr_t value ) {
+        trace_event& e = my_events[my_count & my_mask];
+        e.begin = begin;
+        e.end = end;
+        e.object = object;
+        e.name = name;
+        e.value = value;
+        e.kind = kind;
+        // The event is written before the count, so that the writer of the trace file
+        // running concurrently reads complete events except those overwritten just now.
+        __TBB_store_with_release( my_count, my_count + 1 );
+    }
+
+    void record_instant( trace_event_kind kind, const void* object, intptr_t value ) {
+        trace_time_t now = trace_clock();
+        record( kind, now, now, object, NULL, value );
+    }
+};
+
+//! Control of the trace and its output
+class scheduler_trace {
+public:
+    static bool enabled() { return __TBB_load_relaxed( is_enabled ); }
+
+    //! Turns the trace on if TBB_TRACE_FILE is set; called by the one-time initialization
+    static void initialize();
+
+    //! Writes the trace if it is on for the whole run and frees the buffers of finished threads
+    /** Called when the library is unloaded, and again when the last reference
+        to the resources is removed. **/
+    static void finalize();
+
+    //! Called when global_control::scheduler_tracing becomes (in)active
+    static void set_control_active( bool active );
+
+    //! Gives a free buffer to a thread; returns NULL if the memory is exhausted
+    static trace_buffer* acquire_buffer( bool is_worker );
+
+    //! Returns the buffer of a thread that is finishing. The events are kept until written.
+    static void release_buffer( trace_buffer* buffer );
+
+private:
+    static bool is_enabled;
+
+    //! Upper limit for TBB_TRACE_BUFFER_SIZE
+    static const size_t max_trace_buffer_size = size_t(1) << 24;
+
+    static void start();
+    static void dump( const char* file_name );
+};
+
+} // namespace internal
+} // namespace tbb
+
+//! Records an instant event into the trace buffer of scheduler s if the trace is on
+#define TRACE_SCHEDULER_EVENT( s, kind, object, value ) \
+    do { if( tbb::internal::trace_buffer* _trace = (s).tracer() ) _trace->record_instant( kind, object, value ); } while( 0 )
+
+#else /* !__TBB_SCHEDULER_TRACE */
+
+#define TRACE_SCHEDULER_EVENT( s, kind, object, value ) ((void)0)
+
+#endif /* !__TBB_SCHEDULER_TRACE */
+
+#endif /* _TBB_scheduler_trace_H */
@@ -102,6 +102,21 @@ public:
         }
     }
 
+    //! Copies the contents of the vector into the circular array dst starting from position pos.
+    /** The array capacity must be a power of two, mask is the capacity minus one.
+        Same restrictions on T as for the copy_memory above apply. **/
+    void copy_memory ( T* dst, size_t pos, size_t mask ) const
+    {
+        for ( size_t i = m_pos; i < m_cur_segment_size; ++i )
+            dst[pos++ & mask] = m_cur_segment[i];
+        size_t sz = m_cur_segment_size / 2;
+        for ( long i = (long)m_num_segments - 2; i >= 0; --i ) {
+            for ( size_t j = 0; j < sz; ++j )
+                dst[pos++ & mask] = m_segments[i][j];
+            sz /= 2;
+        }
+    }
+
 protected:
     //! The current (not completely filled) segment
     T       *m_cur_segment;
@@ -220,6 +220,27 @@ public:
             "Trying to get affinity mask for uninitialized NUMA node");
         return affinity_masks_list[node_index];
     }
+
+    // Returns the index of the NUMA node the calling thread was last running on,
+    // or -1 if it cannot be determined.
+    int get_current_node_index() {
+        if ( !is_topology_parsed() ) {
+            return -1;
+        }
+        int result = -1;
+        hwloc_cpuset_t current_cpu = hwloc_bitmap_alloc();
+        if ( hwloc_get_last_cpu_location(topology, current_cpu, HWLOC_CPUBIND_THREAD) >= 0 ) {
+            for (int i = 0; i < numa_nodes_count; i++) {
+                int node_index = numa_indexes_list[i];
+                if ( hwloc_bitmap_intersects(affinity_masks_list[node_index], current_cpu) ) {
+                    result = node_index;
+                    break;
+                }
+            }
+        }
+        hwloc_bitmap_free(current_cpu);
+        return result;
+    }
 };
 
 class binding_handler {
@@ -294,6 +315,10 @@ void restore_affinity(binding_handler* handler_ptr, int slot_num) {
     handler_ptr->restore_previous_affinity_mask(slot_num);
 }
 
+int current_numa_node() {
+    return platform_topology::instance().get_current_node_index();
+}
+
 } // extern "C"
 
 } // namespace internal
@@ -21,6 +21,7 @@
 #include "market.h"
 #include "tbb_misc.h"
 #include "itt_notify.h"
+#include "scheduler_trace.h"
 
 namespace tbb
 {
@@ -128,6 +129,9 @@ namespace tbb
             __TBB_ASSERT(k >= 0, "removed __TBB_InitOnce ref that was not added?");
             if (k == 0)
             {
+#if __TBB_SCHEDULER_TRACE
+                scheduler_trace::finalize();
+#endif
                 governor::release_resources();
                 ITT_FINI_ITTLIB();
             }
@@ -244,6 +248,9 @@ namespace tbb
                 initialize_cache_aligned_allocator();
                 governor::initialize_rml_factory();
                 Scheduler_OneTimeInitialization(itt_present);
+#if __TBB_SCHEDULER_TRACE
+                scheduler_trace::initialize();
+#endif
                 // Force processor groups support detection
                 governor::default_num_threads();
                 // Force OS regular page size detection
@@ -543,10 +550,35 @@ namespace tbb
             }
         };
 
+        class numa_stealing_control : public padded<control_storage>
+        {
+            virtual size_t default_value() const __TBB_override
+            {
+                return 0; // NUMA-oblivious stealing by default
+            }
+        };
+
+        class scheduler_tracing_control : public padded<control_storage>
+        {
+            virtual size_t default_value() const __TBB_override
+            {
+                return 0; // no trace by default
+            }
+            virtual void apply_active() const __TBB_override
+            {
+#if __TBB_SCHEDULER_TRACE
+                scheduler_trace::set_control_active(my_active_value != 0);
+#endif
+            }
+        };
+
         static allowed_parallelism_control allowed_parallelism_ctl;
         static stack_size_control stack_size_ctl;
+        static numa_stealing_control numa_stealing_ctl;
+        static scheduler_tracing_control scheduler_tracing_ctl;
 
-        static control_storage *controls[] = {&allowed_parallelism_ctl, &stack_size_ctl};
+        static control_storage *controls[] = {&allowed_parallelism_ctl, &stack_size_ctl, &numa_stealing_ctl,
+                                              &scheduler_tracing_ctl};
 
         unsigned market::app_parallelism_limit()
         {
@@ -20,6 +20,7 @@
 #include "tbb/atomic.h"
 #include "governor.h"
 #include "tbb_environment.h"
+#include "scheduler_trace.h"
 
 namespace tbb {
 
@@ -72,6 +73,10 @@ public:
     /** This is not necessarily the last reference if other threads are still running. **/
     ~__TBB_InitOnce() {
         governor::terminate_auto_initialized_scheduler(); // TLS dtor not called for the main thread
+#if __TBB_SCHEDULER_TRACE
+        // Workers of a market released asynchronously can hold the last reference past this point
+        scheduler_trace::finalize();
+#endif
         remove_ref();
         // We assume that InitializationDone is not set after file-scope destructors
         // start running, and thus no race on InitializationDone is possible.
@@ -282,6 +282,8 @@ namespace numa_topology {
     bool is_initialized();
     void initialize();
     void destroy();
+    //! Returns the NUMA node index of the calling thread, or -1 if it is unknown.
+    int current_node();
 }
 
 #endif /*__TBB_NUMA_SUPPORT*/
@@ -42,7 +42,7 @@ const char* StatGroupTitles[] = {
 const char* StatFieldTitles[] = {
     /*task objects*/        "active", "freed", "big", NULL,
     /*tasks executed*/      "total", "w/o spawn", NULL,
-    /*stealing attempts*/   "succeeded", "failed", "conflicts", "backoffs", NULL,
+    /*stealing attempts*/   "succeeded", "failed", "conflicts", "backoffs", "node.local", "node.remote", "escalated", NULL,
     /*task proxies*/        "mailed", "revoked", "stolen", "bypassed", "ignored", NULL,
     /*arena*/               "switches", "roundtrips", "avg.conc", "avg.allot", NULL,
     /*market*/              "roundtrips", NULL,
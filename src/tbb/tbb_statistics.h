@@ -141,6 +141,12 @@ struct statistics_counters {
     counter_type thieves_conflicts;
     //! Number of times thief backed off because of the collision with the owner
     counter_type thief_backoffs;
+    //! Number of tasks stolen from the threads of the same NUMA node
+    counter_type numa_local_steals;
+    //! Number of tasks stolen from the threads of other NUMA nodes
+    counter_type numa_remote_steals;
+    //! Number of times a thief gave up stealing from its own NUMA node only
+    counter_type numa_escalations;
 
     // Group: sg_affinity
 
@@ -166,6 +166,47 @@ int UnmapMemory(void *area, size_t bytes)
     return ret;
 }
 
+#define MEMORY_RESERVATION_SUPPORTED 1
+// Reserve address space aligned on huge page size, no memory is committed.
+// The alignment excess is left reserved, as the reservation is never released.
+void* ReserveMemory(size_t bytes)
+{
+    int prevErrno = errno;
+    void *result = mmap(NULL, bytes + HUGE_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (result == MAP_FAILED) {
+        errno = prevErrno;
+        return 0;
+    }
+    return (void*)alignUp((uintptr_t)result, HUGE_PAGE_SIZE);
+}
+
+// Make a part of reserved address space usable. Ask for transparent huge pages,
+// the kernel silently uses regular pages if they are not available.
+bool CommitMemory(void *area, size_t bytes)
+{
+    int prevErrno = errno;
+    if (mprotect(area, bytes, PROT_READ | PROT_WRITE)) {
+        errno = prevErrno;
+        return false;
+    }
+#ifdef MADV_HUGEPAGE
+    if (madvise(area, bytes, MADV_HUGEPAGE))
+        errno = prevErrno;
+#endif
+    return true;
+}
+
+// Return memory of a part of reserved address space to OS, keeping the reservation
+bool DecommitMemory(void *area, size_t bytes)
+{
+    int prevErrno = errno;
+    if (madvise(area, bytes, MADV_DONTNEED) || mprotect(area, bytes, PROT_NONE)) {
+        errno = prevErrno;
+        return false;
+    }
+    return true;
+}
+
 #elif (_WIN32 || _WIN64) && !__TBB_WIN8UI_SUPPORT
 #include <windows.h>
 
@@ -198,6 +239,23 @@ int UnmapMemory(void *area, size_t /*bytes*/)
 
 #endif /* OS dependent */
 
+#if !MEMORY_RESERVATION_SUPPORTED
+void* ReserveMemory(size_t)
+{
+    return 0;
+}
+
+bool CommitMemory(void *, size_t)
+{
+    return false;
+}
+
+bool DecommitMemory(void *, size_t)
+{
+    return false;
+}
+#endif
+
 #if MALLOC_CHECK_RECURSION && MEMORY_MAPPING_USES_MALLOC
 #error Impossible to protect against malloc recursion when memory mapping uses malloc.
 #endif
@@ -15,7 +15,7 @@
 */
 
 #define MAX_THREADS 1024
-#define NUM_OF_BINS 30
+#define NUM_OF_BINS 40
 #define ThreadCommonCounters NUM_OF_BINS
 
 enum counter_type {
@@ -40,7 +40,9 @@ enum common_counter_type {
     cacheLargeObj,
     freeLargeObj,
     lockPublicFreeList,
-    freeToOtherThread
+    freeToOtherThread,
+    freeToRemoteCache,
+    flushRemoteCache
 };
 
 #if COLLECT_STATISTICS
@@ -118,6 +120,8 @@ static inline void STAT_print(int thread)
     fprintf(outfile, ", freeLargeObject %5d", ctrs.counter[freeLargeObj]);
     fprintf(outfile, ", lockPublicFreeList %5d", ctrs.counter[lockPublicFreeList]);
     fprintf(outfile, ", freeToOtherThread %10d", ctrs.counter[freeToOtherThread]);
+    fprintf(outfile, ", freeToRemoteCache %10d", ctrs.counter[freeToRemoteCache]);
+    fprintf(outfile, ", flushRemoteCache %10d", ctrs.counter[flushRemoteCache]);
     fprintf(outfile, "\n");
 
     fclose(outfile);
@@ -80,6 +80,80 @@ void Backend::UsedAddressRange::registerFree(uintptr_t left, uintptr_t right)
 // Initialized in frontend inside defaultMemPool
 extern HugePagesStatus hugePages;
 
+#if USE_DEFAULT_MEMORY_MAPPING && MEMORY_RESERVATION_SUPPORTED \
+    && (__ARCH_x86_64 || __ARCH_ipf || __aarch64__ || __powerpc64__)
+static const size_t hugePageArenaSize = (size_t)256*1024*1024*1024;
+#else
+static const size_t hugePageArenaSize = 0;
+#endif
+
+/* Address space reserved once for the huge page slab mode of the default pool.
+   It is divided into huge page sized and aligned regions, so the region
+   of any block inside the arena is found by aligning the block address down.
+   Memory of a region is committed when the region is taken and returned
+   to OS when the region is released, while the address space stays reserved.
+   Object must reside in zero-initialized memory. */
+class HugePageArena {
+    static const unsigned regionsNum = hugePageArenaSize ? hugePageArenaSize/HUGE_PAGE_SIZE : 1;
+
+    uintptr_t   base;         // zero till the address space is reserved
+    bool        reserveFailed;
+    unsigned    untouchedIdx; // regions starting from this one were never used
+    size_t      committedNum;
+    MallocMutex lock;
+    BitMaskMin<regionsNum> released; // regions used before and then returned to OS
+public:
+    bool inArena(const void *ptr) const {
+        return base && (uintptr_t)ptr - base < hugePageArenaSize;
+    }
+    void *allocRegion() {
+        if (!hugePageArenaSize)
+            return NULL;
+        MallocMutex::scoped_lock scoped_cs(lock);
+        if (!base) {
+            if (reserveFailed)
+                return NULL;
+            if (!(base = (uintptr_t)ReserveMemory(hugePageArenaSize))) {
+                reserveFailed = true;
+                return NULL;
+            }
+        }
+        int idx = released.getMinTrue(0);
+        if (idx != -1)
+            released.set(idx, false);
+        else if (untouchedIdx < regionsNum)
+            idx = untouchedIdx++;
+        else
+            return NULL; // the arena is exhausted, regular regions to be used
+        void *region = (void*)(base + (size_t)idx*HUGE_PAGE_SIZE);
+        if (!CommitMemory(region, HUGE_PAGE_SIZE)) {
+            released.set(idx, true);
+            return NULL;
+        }
+        committedNum++;
+        return region;
+    }
+    bool freeRegion(void *region) {
+        MALLOC_ASSERT(inArena(region) && isAligned(region, HUGE_PAGE_SIZE), ASSERT_TEXT);
+        bool res = DecommitMemory(region, HUGE_PAGE_SIZE);
+        MallocMutex::scoped_lock scoped_cs(lock);
+        released.set(((uintptr_t)region - base)/HUGE_PAGE_SIZE, true);
+        committedNum--;
+        return res;
+    }
+#if __TBB_MALLOC_WHITEBOX_TEST
+    size_t getCommittedNum() const { return committedNum; }
+    bool isReserveFailed() const { return reserveFailed; }
+#endif
+};
+
+static HugePageArena hugePageArena;
+
+bool Backend::useHugePageSlabs() const
+{
+    return hugePages.isSlabModeEnabled && !inUserPool();
+}
+
 void *Backend::allocRawMem(size_t &size)
 {
     void *res = NULL;
@@ -131,6 +205,18 @@ void *Backend::allocRawMem(size_t &size)
     return res;
 }
 
+void *Backend::allocHugePageRegion(size_t &size)
+{
+    MALLOC_ASSERT(size <= HUGE_PAGE_SIZE, ASSERT_TEXT);
+    void *res = hugePageArena.allocRegion();
+    if (res) {
+        size = HUGE_PAGE_SIZE;
+        usedAddrRange.registerAlloc((uintptr_t)res, (uintptr_t)res+size);
+        AtomicAdd((intptr_t&)totalMemSize, size);
+    }
+    return res;
+}
+
 bool Backend::freeRawMem(void *object, size_t size)
 {
     bool fail;
@@ -144,7 +230,8 @@ bool Backend::freeRawMem(void *object, size_t size)
         fail = (*extMemPool->rawFree)(extMemPool->poolId, object, size);
     } else {
         usedAddrRange.registerFree((uintptr_t)object, (uintptr_t)object + size);
-        fail = freeRawMemory(object, size);
+        fail = hugePageArena.inArena(object) ? !hugePageArena.freeRegion(object)
+            : freeRawMemory(object, size);
     }
     // TODO: use result in all freeRawMem() callers
     return !fail;
@@ -200,6 +287,7 @@ struct MemRegion {
                           // regions.
     size_t     allocSz,   // got from pool callback
                blockSz;   // initial and maximal inner block size
+    intptr_t   occupancy; // size of blocks in use, maintained for huge page regions only
     MemRegionType type;
 };
 
@@ -282,6 +370,20 @@ struct LastFreeBlock : public FreeBlock {
 
 const size_t FreeBlock::minBlockSize = sizeof(FreeBlock);
 
+// The largest block that fits into a huge page region with large blocks
+static const size_t maxHugePageRegionBlock = HUGE_PAGE_SIZE - (sizeof(MemRegion) + largeObjectAlignment
+                                                               + sizeof(FreeBlock) + sizeof(LastFreeBlock));
+
+// Account blocks that are taken from and returned to huge page regions
+static inline void updateOccupancy(FreeBlock *fBlock, intptr_t delta)
+{
+    if (hugePageArena.inArena(fBlock)) {
+        MemRegion *region = (MemRegion*)alignDown(fBlock, HUGE_PAGE_SIZE);
+        MALLOC_ASSERT(region->occupancy + delta >= 0, ASSERT_TEXT);
+        AtomicAdd(region->occupancy, delta);
+    }
+}
+
 inline bool BackendSync::waitTillBlockReleased(intptr_t startModifiedCnt)
 {
     AtomicBackoff backoff;
@@ -674,7 +776,10 @@ FreeBlock *Backend::askMemFromOS(size_t blockSize, intptr_t startModifiedCnt,
             return releaseMemInCaches(startModifiedCnt, lockedBinsThreshold, numOfLockedBins);
         *splittableRet = false;
     } else {
-        const size_t regSz_sizeBased = alignUp(4*maxRequestedSize, 1024*1024);
+        size_t regSz_sizeBased = alignUp(4*maxRequestedSize, 1024*1024);
+        // in the huge page slab mode a region is a single huge page, if the block fits it
+        if (blockSize <= maxHugePageRegionBlock && useHugePageSlabs())
+            regSz_sizeBased = maxHugePageRegionBlock;
         // Another thread is modifying backend while we can't get the block.
         // Wait while it leaves and re-do the scan
         // before trying other ways to extend the backend.
@@ -841,6 +946,7 @@ FreeBlock *Backend::genericGetBlock(int num, size_t size, bool needAlignedBlock)
     }
     // matched blockConsumed() from startUseBlock()
     bkndSync.blockReleased();
+    updateOccupancy(block, totalReqSize);
 
     return block;
 }
@@ -900,6 +1006,7 @@ void Backend::removeBlockFromBin(FreeBlock *fBlock)
 
 void Backend::genericPutBlock(FreeBlock *fBlock, size_t blockSz, bool slabAligned)
 {
+    updateOccupancy(fBlock, -(intptr_t)blockSz);
     bkndSync.blockConsumed();
     coalescAndPut(fBlock, blockSz, slabAligned);
     bkndSync.blockReleased();
@@ -1015,6 +1122,8 @@ void *Backend::remap(void *ptr, size_t oldSize, size_t newSize, size_t alignment
 
 void Backend::releaseRegion(MemRegion *memRegion)
 {
+    MALLOC_ASSERT(!hugePageArena.inArena(memRegion) || !memRegion->occupancy,
+                  "Only empty huge page region can be released.");
     regionList.remove(memRegion);
     freeRawMem(memRegion, memRegion->allocSz);
 }
@@ -1296,6 +1405,15 @@ void MemRegionList::remove(MemRegion *r)
         r->prev->next = r->next;
 }
 
+size_t MemRegionList::size()
+{
+    size_t regNum = 0;
+    MallocMutex::scoped_lock lock(regionListLock);
+    for (MemRegion *curr = head; curr; curr = curr->next)
+        regNum++;
+    return regNum;
+}
+
 #if __TBB_MALLOC_BACKEND_STAT
 int MemRegionList::reportStat(FILE *f)
 {
@@ -1322,7 +1440,11 @@ FreeBlock *Backend::addNewRegion(size_t size, MemRegionType memRegType, bool add
              +  FreeBlock::minBlockSize + sizeof(LastFreeBlock);
 
     size_t rawSize = requestSize;
-    MemRegion *region = (MemRegion*)allocRawMem(rawSize);
+    MemRegion *region = NULL;
+    if (memRegType != MEMREG_ONE_BLOCK && requestSize <= HUGE_PAGE_SIZE && useHugePageSlabs())
+        region = (MemRegion*)allocHugePageRegion(rawSize);
+    if (!region)
+        region = (MemRegion*)allocRawMem(rawSize);
     if (!region) {
         MALLOC_ASSERT(rawSize==requestSize, "getRawMem has not allocated memory but changed the allocated size.");
         return NULL;
@@ -1335,6 +1457,7 @@ FreeBlock *Backend::addNewRegion(size_t size, MemRegionType memRegType, bool add
 
     region->type = memRegType;
     region->allocSz = rawSize;
+    region->occupancy = 0;
     FreeBlock *fBlock = findBlockInRegion(region, size);
     if (!fBlock) {
         if (!extMemPool->fixedPool)
@@ -102,6 +102,7 @@ public:
     MemRegion  *head;
     void add(MemRegion *r);
     void remove(MemRegion *r);
+    size_t size();
     int reportStat(FILE *f);
 };
 
@@ -304,6 +305,9 @@ private:
     /*------------------------- Raw memory accessors ------------------------------*/
     void *allocRawMem(size_t &size);
     bool freeRawMem(void *object, size_t size);
+    // Huge page sized region for the huge page slab mode
+    void *allocHugePageRegion(size_t &size);
+    bool useHugePageSlabs() const;
 
     /*------------------------------ Cleanup functions ----------------------------*/
     // Clean all memory from all caches (extMemPool hard cleanup)
@@ -368,9 +372,8 @@ public:
     size_t getMaxBinnedSize() const;
 
     /*-------------------------- Testing, statistics ------------------------------*/
-#if __TBB_MALLOC_WHITEBOX_TEST
     size_t getTotalMemSize() const { return totalMemSize; }
-#endif
+    size_t getRegionsNum() { return regionList.size(); }
 #if __TBB_MALLOC_BACKEND_STAT
     void reportStat(FILE *f);
 private:
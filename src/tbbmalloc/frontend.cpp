@@ -46,6 +46,16 @@ static void NTAPI mallocThreadShutdownNotification(void *);
 
 #define FREELIST_NONBLOCKING 1
 
+// The heap profiler needs backtrace() to capture the call stacks
+#if __linux__ && __GLIBC__
+#define MALLOC_HEAP_PROFILER 1
+#include <execinfo.h> // backtrace()
+#include <fcntl.h>    // open()
+#include <stdarg.h>
+#else
+#define MALLOC_HEAP_PROFILER 0
+#endif
+
 namespace rml
 {
     class MemoryPool;
@@ -307,6 +317,14 @@ namespace rml
         // TODO: move huge page status to default pool, because that's its states
         HugePagesStatus hugePages;
         static bool usedBySrcIncluded = false;
+        static bool remoteFreeBatching = false;
+        bool collectAllocationStatistics = false;
+        // changed each time collectAllocationStatistics is turned on, never 0 while it is on
+        static uint16_t allocationStatisticsEpoch;
+        static AllocControlledMode statisticsMode;
+        static AllocControlledMode heapProfileMode;
+        // mean bytes between the allocations sampled by the heap profiler, 0 if it is off
+        static intptr_t heapProfileInterval;
 
         // Padding helpers
         template <size_t padd>
@@ -350,6 +368,9 @@ namespace rml
             BackRefIdx backRefIdx;
             uint16_t allocatedCount; /* Number of objects allocated (obviously by the owning thread) */
             uint16_t objectSize;
+            /* allocationStatisticsEpoch when the block was last empty while statistics were collected;
+               the live objects of the block are counted only while it is current */
+            uint16_t statisticsEpoch;
             bool isFull;
 
             friend class FreeBlockPool;
@@ -382,6 +403,7 @@ namespace rml
 
             bool freeListNonNull() { return freeList; }
             void freePublicObject(FreeObject *objectToFree);
+            void freePublicObjects(FreeObject *head, FreeObject *tail);
             inline void freeOwnObject(void *object);
             void reset();
             void privatizePublicFreeList(bool reset = true);
@@ -396,6 +418,7 @@ namespace rml
                 return isStartupAllocObject() ? 0 : objectSize;
             }
             const BackRefIdx *getBackRefIdx() const { return &backRefIdx; }
+            bool liveObjectsCounted() const { return statisticsEpoch == allocationStatisticsEpoch; }
             inline bool isOwnedByCurrentThread() const;
             bool isStartupAllocObject() const { return objectSize == startupAllocObjSizeMark; }
             inline FreeObject *findObjectToFree(const void *object) const;
@@ -441,6 +464,7 @@ namespace rml
             static const float emptyEnoughRatio; /* Threshold on free space needed to "reactivate" a block */
 
             inline FreeObject *allocateFromBumpPtr();
+            inline void countAllocation();
             inline FreeObject *findAllocatedObject(const void *address) const;
             inline bool isProperlyPlaced(const void *object) const;
             inline void markOwned(TLSData *tls)
@@ -516,33 +540,76 @@ namespace rml
         const uint32_t maxSegregatedObjectSize = 1024;
 
         /*
-         * And there are 5 bins with allocation sizes that are multiples of estimatedCacheLineSize
-         * and selected to fit 9, 6, 4, 3, and 2 allocations in a block.
+         * And there are bins with allocation sizes that are multiples of estimatedCacheLineSize
+         * and selected to fit a given number of allocations in a block. A table of the bins is
+         * declared by the numbers of allocations per block, in decreasing order; the last bin
+         * of every table fits 2 allocations, so the tables differ only up to minLargeObjectSize.
          */
-        const uint32_t minFittingIndex = minSegregatedObjectIndex + numSegregatedObjectBins;
-        const uint32_t numFittingBins = 5;
-
         const uint32_t fittingAlignment = estimatedCacheLineSize;
 
 #define SET_FITTING_SIZE(N) ((slabSize - sizeof(Block)) / N) & ~(fittingAlignment - 1)
         // For blockSize=16*1024, sizeof(Block)=2*estimatedCacheLineSize and fittingAlignment=estimatedCacheLineSize,
-        // the comments show the fitting sizes and the amounts left unused for estimatedCacheLineSize=64/128:
-        const uint32_t fittingSize1 = SET_FITTING_SIZE(9); // 1792/1792 128/000
-        const uint32_t fittingSize2 = SET_FITTING_SIZE(6); // 2688/2688 128/000
-        const uint32_t fittingSize3 = SET_FITTING_SIZE(4); // 4032/3968 128/256
-        const uint32_t fittingSize4 = SET_FITTING_SIZE(3); // 5376/5376 128/000
-        const uint32_t fittingSize5 = SET_FITTING_SIZE(2); // 8128/8064 000/000
+        // the comments show the fitting sizes for estimatedCacheLineSize=64/128.
+        // The fine table has a bin for each number of allocations from 14 to 2:
+        // 1152/1152 1216/1152 1344/1280 1472/1408 1600/1536 1792/1792 1984/1920 2304/2304 2688/2688 3200/3200 4032/3968 5376/5376 8128/8064
+#define FINE_FITTING_BINS(BIN) BIN(14) BIN(13) BIN(12) BIN(11) BIN(10) BIN(9) BIN(8) BIN(7) BIN(6) BIN(5) BIN(4) BIN(3) BIN(2)
+        // The classic table has 5 bins, with the amounts left unused of 128/000 128/000 128/256 128/000 000/000:
+        // 1792/1792 2688/2688 4032/3968 5376/5376 8128/8064
+#define CLASSIC_FITTING_BINS(BIN) BIN(9) BIN(6) BIN(4) BIN(3) BIN(2)
+#define FITTING_BIN_SIZE(N) SET_FITTING_SIZE(N),
+#define FITTING_BIN_COUNT(N) + 1
+
+        const uint32_t fineFittingSizes[] = { FINE_FITTING_BINS(FITTING_BIN_SIZE) };
+        const uint32_t classicFittingSizes[] = { CLASSIC_FITTING_BINS(FITTING_BIN_SIZE) };
+        const uint32_t numFineFittingBins = 0 FINE_FITTING_BINS(FITTING_BIN_COUNT);
+        const uint32_t numClassicFittingBins = 0 CLASSIC_FITTING_BINS(FITTING_BIN_COUNT);
+        const uint32_t maxFittingSize = SET_FITTING_SIZE(2);
+
+#undef FITTING_BIN_COUNT
+#undef FITTING_BIN_SIZE
+#undef CLASSIC_FITTING_BINS
+#undef FINE_FITTING_BINS
 #undef SET_FITTING_SIZE
 
+        const uint32_t minFittingIndex = minSegregatedObjectIndex + numSegregatedObjectBins;
+        const uint32_t maxNumFittingBins = numFineFittingBins > numClassicFittingBins ? numFineFittingBins : numClassicFittingBins;
+
+        /*
+         * The table of fitting bins in use. It is selected before the first allocation
+         * by TBB_MALLOC_SIZE_CLASSES or by scalable_allocation_mode, and is not changed after that.
+         */
+        class FittingBins
+        {
+            const uint32_t *sizes;
+            uint32_t num;
+
+        public:
+            // Works before select(), as the object is zero-initialized; the fine table is the default
+            const uint32_t *getSizes() const { return sizes ? sizes : fineFittingSizes; }
+            uint32_t getNum() const { return sizes ? num : numFineFittingBins; }
+            bool isSelected() const { return sizes; }
+            bool isClassic() const { return sizes == classicFittingSizes; }
+            void select(bool classic)
+            {
+                sizes = classic ? classicFittingSizes : fineFittingSizes;
+                num = classic ? numClassicFittingBins : numFineFittingBins;
+                MALLOC_ASSERT(sizes[0] > maxSegregatedObjectSize && sizes[num - 1] == maxFittingSize, ASSERT_TEXT);
+            }
+        };
+
+        static FittingBins fittingBins;
+
         /*
          * The total number of thread-specific Block-based bins
          */
-        const uint32_t numBlockBins = minFittingIndex + numFittingBins;
+        const uint32_t numBlockBins = minFittingIndex + maxNumFittingBins;
 
         /*
          * Objects of this size and larger are considered large objects.
          */
-        const uint32_t minLargeObjectSize = fittingSize5 + 1;
+        const uint32_t minLargeObjectSize = maxFittingSize + 1;
+
+        MALLOC_STATIC_ASSERT(numBlockBins <= numBlockBinLimit, "Too many bins for TLSData");
 
         /*
          * Per-thread pool of slab blocks. Idea behind it is to not share with other
@@ -575,6 +642,8 @@ namespace rml
             ResOfGet getBlock();
             void returnBlock(Block *block);
             bool externalCleanup(); // can be called by another thread
+            // can be called by another thread; size is not corrected after externalCleanup
+            size_t getCachedSize() const { return __TBB_load_with_acquire(head) ? size * slabSize : 0; }
         };
 
         template <int LOW_MARK, int HIGH_MARK>
@@ -592,6 +661,8 @@ namespace rml
             bool put(LargeMemoryBlock *object, ExtMemoryPool *extMemPool);
             LargeMemoryBlock *get(size_t size);
             bool externalCleanup(ExtMemoryPool *extMemPool);
+            // can be called by another thread; totalSize is not corrected after externalCleanup
+            size_t getCachedSize() const { return __TBB_load_with_acquire(head) ? totalSize : 0; }
 #if __TBB_MALLOC_WHITEBOX_TEST
             LocalLOCImpl() : head(NULL), tail(NULL), totalSize(0), numOfBlocks(0) {}
             static size_t getMaxSize() { return MAX_TOTAL_SIZE; }
@@ -603,6 +674,66 @@ namespace rml
 
         typedef LocalLOCImpl<8, 32> LocalLOC; // set production code parameters
 
+        /* Objects released by a thread that does not own their slab are collected
+           here per slab and returned to it as one linked list, so the public free list
+           of the slab is modified once per batch instead of once per object.
+           Used only by the thread the cache belongs to. */
+        template <unsigned NUM_SLOTS, unsigned MAX_BATCH>
+        class RemoteFreeCacheImpl
+        {
+            struct Slot
+            {
+                Block *block;
+                FreeObject *head;
+                FreeObject *tail;
+                unsigned count;
+            };
+            Slot slot[NUM_SLOTS];
+
+            static void flushSlot(Slot *s)
+            {
+                s->block->freePublicObjects(s->head, s->tail);
+                STAT_increment(getThreadId(), ThreadCommonCounters, flushRemoteCache);
+                s->block = NULL;
+            }
+
+        public:
+            void put(Block *block, FreeObject *object)
+            {
+                Slot *s = slot + ((uintptr_t)block / slabSize) % NUM_SLOTS;
+                if (s->block != block)
+                {
+                    if (s->block)
+                        flushSlot(s);
+                    s->block = block;
+                    s->tail = object;
+                    s->count = 0;
+                }
+                else
+                {
+                    object->next = s->head;
+                }
+                s->head = object;
+                STAT_increment(getThreadId(), ThreadCommonCounters, freeToRemoteCache);
+                if (++s->count == MAX_BATCH)
+                    flushSlot(s);
+            }
+            bool flush()
+            {
+                bool flushed = false;
+                for (unsigned i = 0; i < NUM_SLOTS; i++)
+                    if (slot[i].block)
+                    {
+                        flushSlot(slot + i);
+                        flushed = true;
+                    }
+                return flushed;
+            }
+            // no ctor, object must be created in zero-initialized memory
+        };
+
+        typedef RemoteFreeCacheImpl<8, 32> RemoteFreeCache;
+
         class TLSData : public TLSRemote
         {
             MemoryPool *memPool;
@@ -611,7 +742,16 @@ namespace rml
             Bin bin[numBlockBinLimit];
             FreeBlockPool freeSlabBlocks;
             LocalLOC lloc;
+            RemoteFreeCache remoteFreeCache;
             unsigned currCacheIdx;
+            // objects allocated minus objects freed by the thread in the counted blocks,
+            // valid only while liveObjectsEpoch is the current allocationStatisticsEpoch
+            intptr_t liveObjects[numBlockBinLimit];
+            uint16_t liveObjectsEpoch;
+            // bytes to allocate before the next allocation sampled by the heap profiler
+            intptr_t bytesUntilSample;
+            // state of the generator of the sampling intervals
+            uint64_t sampleRandom;
 
         private:
             bool unused;
@@ -634,6 +774,17 @@ namespace rml
             bool cleanupBlockBins();
             void markUsed() { unused = false; }  // called by owner when TLS touched
             void markUnused() { unused = true; } // can be called by not owner thread
+            bool liveObjectsCounted() const { return liveObjectsEpoch == allocationStatisticsEpoch; }
+            // called by the thread of the TLS only; the counts of an earlier epoch are dropped
+            void countLiveObjects(unsigned index, intptr_t num)
+            {
+                if (!liveObjectsCounted())
+                {
+                    memset(liveObjects, 0, sizeof(liveObjects));
+                    liveObjectsEpoch = allocationStatisticsEpoch;
+                }
+                liveObjects[index] += num;
+            }
         };
 
         TLSData *TLSKey::createTLS(MemoryPool *memPool, Backend *backend)
@@ -655,7 +806,8 @@ namespace rml
 
         bool TLSData::cleanupBlockBins()
         {
-            bool released = false;
+            // objects of other threads kept by this thread can make their blocks empty
+            bool released = remoteFreeCache.flush();
             for (uint32_t i = 0; i < numBlockBinLimit; i++)
             {
                 released |= bin[i].cleanPublicFreeLists();
@@ -731,6 +883,23 @@ namespace rml
                 static_cast<TLSData *>(curr)->markUnused();
         }
 
+        void AllLocalCaches::reportStatistics(ScalableAllocationStatistics *stat, intptr_t *liveObjects)
+        {
+            MallocMutex::scoped_lock lock(listLock);
+            for (TLSRemote *curr = head; curr; curr = curr->next)
+            {
+                TLSData *tls = static_cast<TLSData *>(curr);
+                size_t cached = tls->freeSlabBlocks.getCachedSize() + tls->lloc.getCachedSize();
+                stat->threads++;
+                stat->threadCachedBytes += cached;
+                if (cached > stat->maxThreadCachedBytes)
+                    stat->maxThreadCachedBytes = cached;
+                if (tls->liveObjectsCounted())
+                    for (uint32_t i = 0; i < numBlockBinLimit; i++)
+                        liveObjects[i] += tls->liveObjects[i];
+            }
+        }
+
 #if MALLOC_CHECK_RECURSION
         MallocMutex RecursiveMallocCallProtector::rmc_mutex;
         pthread_t RecursiveMallocCallProtector::owner_thread;
@@ -756,7 +925,7 @@ namespace rml
         bool isLargeObject(void *object);
         static void *internalMalloc(size_t size);
         static void internalFree(void *object);
-        static void *internalPoolMalloc(MemoryPool *mPool, size_t size);
+        static void *internalPoolMalloc(MemoryPool *mPool, size_t size, bool canSample = true);
         static bool internalPoolFree(MemoryPool *mPool, void *object, size_t size);
 
 #if !MALLOC_DEBUG
@@ -863,33 +1032,19 @@ namespace rml
             }
             else
             {
-                if (size <= fittingSize3)
+                // binary search for the smallest fitting size that is not less than size
+                MALLOC_ASSERT(size < minLargeObjectSize, ASSERT_TEXT);
+                const uint32_t *sizes = fittingBins.getSizes();
+                unsigned int first = 0, last = fittingBins.getNum() - 1;
+                while (first < last)
                 {
-                    if (size <= fittingSize2)
-                    {
-                        if (size <= fittingSize1)
-                            return indexRequest ? minFittingIndex : fittingSize1;
-                        else
-                            return indexRequest ? minFittingIndex + 1 : fittingSize2;
-                    }
+                    unsigned int middle = (first + last) / 2;
+                    if (size <= sizes[middle])
+                        last = middle;
                     else
-                        return indexRequest ? minFittingIndex + 2 : fittingSize3;
-                }
-                else
-                {
-                    if (size <= fittingSize5)
-                    {
-                        if (size <= fittingSize4)
-                            return indexRequest ? minFittingIndex + 3 : fittingSize4;
-                        else
-                            return indexRequest ? minFittingIndex + 4 : fittingSize5;
-                    }
-                    else
-                    {
-                        MALLOC_ASSERT(0, ASSERT_TEXT); // this should not happen
-                        return ~0U;
-                    }
+                        first = middle + 1;
                 }
+                return indexRequest ? minFittingIndex + first : sizes[first];
             }
         }
 
@@ -1008,6 +1163,15 @@ namespace rml
             return block;
         }
 
+        size_t LifoList::size()
+        {
+            size_t num = 0;
+            MallocMutex::scoped_lock scoped_cs(lock);
+            for (Block *block = top; block; block = block->next)
+                num++;
+            return num;
+        }
+
         /********* Thread and block related code      *************/
 
         template <bool poolDestroy>
@@ -1109,12 +1273,15 @@ namespace rml
             }
             MALLOC_ASSERT(result, ASSERT_TEXT);
             result->initEmptyBlock(tls, size);
+            extMemPool.stats.addSlab(getIndex(result->objectSize));
             STAT_increment(getThreadId(), getIndex(result->objectSize), allocBlockNew);
             return result;
         }
 
         void MemoryPool::returnEmptyBlock(Block *block, bool poolTheBlock)
         {
+            if (!block->isStartupAllocObject())
+                extMemPool.stats.removeSlab(getIndex(block->getSize()));
             block->reset();
             if (poolTheBlock)
             {
@@ -1458,6 +1625,8 @@ namespace rml
         void Block::freeOwnObject(void *object)
         {
             tlsPtr->markUsed();
+            if (collectAllocationStatistics && liveObjectsCounted())
+                tlsPtr->countLiveObjects(getIndex(objectSize), -1);
             allocatedCount--;
             MALLOC_ASSERT(allocatedCount < (slabSize - sizeof(Block)) / objectSize, ASSERT_TEXT);
 #if COLLECT_STATISTICS
@@ -1483,6 +1652,14 @@ namespace rml
         }
 
         void Block::freePublicObject(FreeObject *objectToFree)
+        {
+            freePublicObjects(objectToFree, objectToFree);
+            STAT_increment(getThreadId(), ThreadCommonCounters, freeToOtherThread);
+            STAT_increment(ownerTid, getIndex(objectSize), freeByOtherThread);
+        }
+
+        // Push the list of objects linked from head to tail to the public free list at once
+        void Block::freePublicObjects(FreeObject *head, FreeObject *tail)
         {
             FreeObject *localPublicFreeList;
 
@@ -1491,18 +1668,18 @@ namespace rml
             FreeObject *temp = publicFreeList;
             do
             {
-                localPublicFreeList = objectToFree->next = temp;
+                localPublicFreeList = tail->next = temp;
                 temp = (FreeObject *)AtomicCompareExchange(
                     (intptr_t &)publicFreeList,
-                    (intptr_t)objectToFree, (intptr_t)localPublicFreeList);
+                    (intptr_t)head, (intptr_t)localPublicFreeList);
                 // no backoff necessary because trying to make change, not waiting for a change
             } while (temp != localPublicFreeList);
 #else
             STAT_increment(getThreadId(), ThreadCommonCounters, lockPublicFreeList);
             {
                 MallocMutex::scoped_lock scoped_cs(publicFreeListLock);
-                localPublicFreeList = objectToFree->next = publicFreeList;
-                publicFreeList = objectToFree;
+                localPublicFreeList = tail->next = publicFreeList;
+                publicFreeList = head;
             }
 #endif
 
@@ -1522,8 +1699,6 @@ namespace rml
                     theBin->addPublicFreeListBlock(this);
                 }
             }
-            STAT_increment(getThreadId(), ThreadCommonCounters, freeToOtherThread);
-            STAT_increment(ownerTid, getIndex(objectSize), freeByOtherThread);
         }
 
         // Make objects freed by other threads available for use again
@@ -1653,6 +1828,7 @@ namespace rml
             previous = NULL;
             freeList = NULL;
             allocatedCount = 0;
+            statisticsEpoch = 0;
             isFull = false;
             tlsPtr = NULL;
 
@@ -1719,6 +1895,7 @@ namespace rml
                     block->privatizePublicFreeList(/*reset=*/false); // do not set publicFreeList to NULL
                     if (block->empty())
                     {
+                        block->getMemPool()->extMemPool.stats.removeSlab(i);
                         block->reset();
                         // slab blocks in user's pools do not have valid backRefIdx
                         if (!backend->inUserPool())
@@ -1737,6 +1914,14 @@ namespace rml
             return released;
         }
 
+        size_t OrphanedBlocks::size()
+        {
+            size_t num = 0;
+            for (uint32_t i = 0; i < numBlockBinLimit; i++)
+                num += bins[i].size();
+            return num;
+        }
+
         FreeBlockPool::ResOfGet FreeBlockPool::getBlock()
         {
             Block *b = (Block *)AtomicFetchStore(&head, 0);
@@ -1874,7 +2059,12 @@ namespace rml
 
         void TLSData::release()
         {
+            remoteFreeCache.flush();
             memPool->extMemPool.allLocalCaches.unregisterThread(this);
+            if (liveObjectsCounted())
+                for (unsigned index = 0; index < numBlockBins; index++)
+                    if (liveObjects[index])
+                        memPool->extMemPool.stats.addLiveObjects(index, liveObjects[index]);
             externalCleanup(/*cleanOnlyUnused=*/false, /*cleanBins=*/false);
 
             for (unsigned index = 0; index < numBlockBins; index++)
@@ -2179,6 +2369,33 @@ namespace rml
                 // of library static section not initialized at this call yet.
                 defaultMemPool = (MemoryPool *)defaultMemPool_space;
             }
+            // The size classes must be known before the first block is initialized
+            if (!fittingBins.isSelected())
+            {
+#if !__TBB_WIN8UI_SUPPORT
+                const char *sizeClasses = getenv("TBB_MALLOC_SIZE_CLASSES");
+                fittingBins.select(sizeClasses && !strcmp(sizeClasses, "classic"));
+#else
+                fittingBins.select(/*classic=*/false);
+#endif
+            }
+            statisticsMode.initReadEnv("TBB_MALLOC_COLLECT_STATISTICS", 0);
+            if (statisticsMode.get() && !allocationStatisticsEpoch)
+                allocationStatisticsEpoch = 1;
+            collectAllocationStatistics = statisticsMode.get();
+            if (!heapProfileMode.ready())
+            {
+                intptr_t interval = 0;
+#if MALLOC_HEAP_PROFILER
+                if (const char *envVal = getenv("TBB_MALLOC_HEAP_PROFILE_SAMPLING"))
+                {
+                    long val = strtol(envVal, NULL, 10);
+                    interval = val > 0 ? val : 0;
+                }
+#endif
+                heapProfileMode.set(interval);
+            }
+            heapProfileInterval = heapProfileMode.get();
             bool initOk = defaultMemPool->extMemPool.init(0, NULL, NULL, granularity,
                                                           /*keepAllMemory=*/false, /*fixedPool=*/false);
             // TODO: extMemPool.init() to not allocate memory
@@ -2254,11 +2471,23 @@ namespace rml
             freeList = result->next;
             MALLOC_ASSERT(allocatedCount < (slabSize - sizeof(Block)) / objectSize, ASSERT_TEXT);
             allocatedCount++;
+            if (collectAllocationStatistics)
+                countAllocation();
             STAT_increment(getThreadId(), getIndex(objectSize), allocFreeListUsed);
 
             return result;
         }
 
+        void Block::countAllocation()
+        {
+            // An empty block has no objects allocated before collection was turned on,
+            // so from now on all its objects are counted.
+            if (allocatedCount == 1)
+                statisticsEpoch = allocationStatisticsEpoch;
+            if (liveObjectsCounted())
+                tlsPtr->countLiveObjects(getIndex(objectSize), 1);
+        }
+
         FreeObject *Block::allocateFromBumpPtr()
         {
             FreeObject *result = bumpPtr;
@@ -2271,6 +2500,8 @@ namespace rml
                 }
                 MALLOC_ASSERT(allocatedCount < (slabSize - sizeof(Block)) / objectSize, ASSERT_TEXT);
                 allocatedCount++;
+                if (collectAllocationStatistics)
+                    countAllocation();
                 STAT_increment(getThreadId(), getIndex(objectSize), allocBumpPtrUsed);
             }
             return result;
@@ -2431,6 +2662,262 @@ namespace rml
             return false;
         }
 
+        /********* The heap profiler **************/
+
+        /*
+         * The heap profiler samples allocations from the default pool in the way of tcmalloc:
+         * every thread counts down the bytes it allocates to the next sampled allocation, and
+         * the intervals between the samples are drawn from the exponential distribution with
+         * the mean of heapProfileInterval. So an allocation of N bytes is sampled with the
+         * probability of 1-exp(-N/mean), what pprof expects to scale the samples back.
+         * A sampled object is allocated as a large object, whose block refers to the bucket
+         * of the call stack of the allocation until the object is freed, so the free path
+         * of small objects is not changed.
+         */
+        struct HeapProfileBucket
+        {
+            HeapProfileBucket *next; // in the chain of the hash table
+            uintptr_t hash;
+            // counted atomically, not under the lock of the table
+            intptr_t liveObjects,
+                liveBytes,
+                allocatedObjects,
+                allocatedBytes;
+            int depth;
+            void *stack[1]; // return addresses, depth in total
+        };
+
+        class HeapProfiler
+        {
+            static const unsigned tableSize = 4096;
+            static const int maxDepth = 64;
+            // when the profiler is off, a thread checks it after allocating this many bytes
+            static const intptr_t offCheckInterval = 1024 * 1024;
+
+            MallocMutex tableLock;
+            // the buckets are never removed, so they can be read without the lock
+            HeapProfileBucket *table[tableSize];
+
+            HeapProfileBucket *getBucket(void *const *stack, int depth);
+            static intptr_t nextInterval(TLSData *tls, intptr_t mean);
+
+        public:
+            void *sample(MemoryPool *memPool, TLSData *tls, size_t size, size_t alignment);
+            void registerRealloc(void *object, HeapProfileBucket *bucket, size_t oldSize);
+            void registerFree(LargeMemoryBlock *lmb);
+            bool dump(const char *fileName);
+            // no ctor, object must be created in zero-initialized memory
+        };
+
+        static HeapProfiler heapProfiler;
+
+        /* Counts down the bytes to the next sampled allocation, returns NULL if not sampled */
+        inline void *sampleAllocation(MemoryPool *memPool, TLSData *tls, size_t size, size_t alignment)
+        {
+            if (tls && (tls->bytesUntilSample -= (intptr_t)size) < 0)
+                return heapProfiler.sample(memPool, tls, size, alignment);
+            return NULL;
+        }
+
+        intptr_t HeapProfiler::nextInterval(TLSData *tls, intptr_t mean)
+        {
+            // 26 random bits make q from (0, 1], and the interval is -ln(q)*mean
+            tls->sampleRandom = tls->sampleRandom * 6364136223846793005ULL + 1442695040888963407ULL;
+            const uintptr_t bits = (uintptr_t)(tls->sampleRandom >> 38) + 1;
+            const intptr_t exp = BitScanRev(bits);
+            // ln(m) for m from [1, 2) is 2*atanh((m-1)/(m+1)), and the series converges fast
+            const double m = (double)bits / ((uintptr_t)1 << exp);
+            const double s = (m - 1) / (m + 1);
+            const double lnM = 2 * s * (1 + s * s * (1. / 3 + s * s * (1. / 5 + s * s / 7)));
+            const double interval = ((26 - exp) * 0.6931471805599453 - lnM) * mean;
+            const intptr_t maxInterval = (intptr_t)(~(uintptr_t)0 >> 2);
+            return interval < 1 ? 1 : interval > maxInterval ? maxInterval : (intptr_t)interval;
+        }
+
+        HeapProfileBucket *HeapProfiler::getBucket(void *const *stack, int depth)
+        {
+            uintptr_t hash = 0;
+            for (int i = 0; i < depth; i++)
+            {
+                hash += (uintptr_t)stack[i];
+                hash += hash << 10;
+                hash ^= hash >> 6;
+            }
+            hash += hash << 3;
+            hash ^= hash >> 11;
+            HeapProfileBucket **head = table + hash % tableSize;
+
+            MallocMutex::scoped_lock lock(tableLock);
+            for (HeapProfileBucket *b = *head; b; b = b->next)
+                if (b->hash == hash && b->depth == depth && !memcmp(b->stack, stack, depth * sizeof(void *)))
+                    return b;
+            HeapProfileBucket *b = (HeapProfileBucket *)internalPoolMalloc(
+                defaultMemPool, sizeof(HeapProfileBucket) + (depth - 1) * sizeof(void *));
+            if (!b)
+                return NULL;
+            memset(b, 0, sizeof(HeapProfileBucket));
+            b->next = *head;
+            b->hash = hash;
+            b->depth = depth;
+            memcpy(b->stack, stack, depth * sizeof(void *));
+            // publish the filled bucket for dump()
+            __TBB_store_with_release(*head, b);
+            return b;
+        }
+
+        void *HeapProfiler::sample(MemoryPool *memPool, TLSData *tls, size_t size, size_t alignment)
+        {
+            const intptr_t mean = FencedLoad(heapProfileInterval);
+            if (!mean || memPool != defaultMemPool)
+            {
+                tls->bytesUntilSample = offCheckInterval;
+                return NULL;
+            }
+            // the allocations below, including the ones of backtrace(), are not sampled
+            tls->bytesUntilSample = (intptr_t)(~(uintptr_t)0 >> 1);
+            if (!tls->sampleRandom)
+                tls->sampleRandom = (uintptr_t)tls;
+
+            void *object = NULL;
+#if MALLOC_HEAP_PROFILER
+            void *stack[maxDepth];
+            // skip the frame of this function
+            const int depth = backtrace(stack, maxDepth) - 1;
+            HeapProfileBucket *bucket = depth > 0 ? getBucket(stack + 1, depth) : NULL;
+            if (bucket && (object = memPool->getFromLLOCache(tls, size, alignment)))
+            {
+                ((LargeObjectHdr *)object - 1)->memoryBlock->profileBucket = bucket;
+                AtomicAdd(bucket->liveObjects, 1);
+                AtomicAdd(bucket->liveBytes, size);
+                AtomicAdd(bucket->allocatedObjects, 1);
+                AtomicAdd(bucket->allocatedBytes, size);
+            }
+#endif
+            tls->bytesUntilSample = nextInterval(tls, mean);
+            return object;
+        }
+
+        /* The sampled object is resized in place or remapped */
+        void HeapProfiler::registerRealloc(void *object, HeapProfileBucket *bucket, size_t oldSize)
+        {
+            LargeMemoryBlock *lmb = ((LargeObjectHdr *)object - 1)->memoryBlock;
+            lmb->profileBucket = bucket;
+            AtomicAdd(bucket->liveBytes, (intptr_t)lmb->objectSize - (intptr_t)oldSize);
+        }
+
+        void HeapProfiler::registerFree(LargeMemoryBlock *lmb)
+        {
+            HeapProfileBucket *bucket = lmb->profileBucket;
+            lmb->profileBucket = NULL;
+            AtomicAdd(bucket->liveObjects, -1);
+            AtomicAdd(bucket->liveBytes, -(intptr_t)lmb->objectSize);
+        }
+
+#if MALLOC_HEAP_PROFILER
+        /* Buffered output to a file descriptor without allocations */
+        class ProfileWriter
+        {
+            int fd;
+            bool failed;
+            size_t used;
+            char buf[4096];
+
+        public:
+            ProfileWriter(int fd_) : fd(fd_), failed(false), used(0) {}
+            void write(const char *data, size_t len)
+            {
+                while (len && !failed)
+                {
+                    if (used == sizeof(buf))
+                        flush();
+                    size_t n = len < sizeof(buf) - used ? len : sizeof(buf) - used;
+                    memcpy(buf + used, data, n);
+                    used += n;
+                    data += n;
+                    len -= n;
+                }
+            }
+            void print(const char *format, ...)
+            {
+                char line[128];
+                va_list args;
+                va_start(args, format);
+                int len = vsnprintf(line, sizeof(line), format, args);
+                va_end(args);
+                if (len > 0)
+                    write(line, (size_t)len < sizeof(line) ? len : sizeof(line) - 1);
+            }
+            bool flush()
+            {
+                for (size_t done = 0; done < used && !failed;)
+                {
+                    ssize_t n = ::write(fd, buf + done, used - done);
+                    if (n > 0)
+                        done += n;
+                    else if (n < 0 && errno != EINTR)
+                        failed = true;
+                }
+                used = 0;
+                return !failed;
+            }
+        };
+#endif
+
+        /*
+         * Writes the live sampled objects in the legacy text format of the heap profiles of
+         * gperftools, that pprof reads. The counters are not read atomically, so the totals
+         * might disagree a bit with the sum of the buckets if the objects are allocated or
+         * freed meanwhile.
+         */
+        bool HeapProfiler::dump(const char *fileName)
+        {
+#if MALLOC_HEAP_PROFILER
+            int fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+                return false;
+            ProfileWriter out(fd);
+            intptr_t total[4] = {0, 0, 0, 0};
+            for (unsigned i = 0; i < tableSize; i++)
+                for (HeapProfileBucket *b = __TBB_load_with_acquire(table[i]); b; b = b->next)
+                {
+                    total[0] += b->liveObjects;
+                    total[1] += b->liveBytes;
+                    total[2] += b->allocatedObjects;
+                    total[3] += b->allocatedBytes;
+                }
+            out.print("heap profile: %ld: %ld [%ld: %ld] @ heap_v2/%ld\n", (long)total[0], (long)total[1],
+                      (long)total[2], (long)total[3], (long)FencedLoad(heapProfileInterval));
+            for (unsigned i = 0; i < tableSize; i++)
+                for (HeapProfileBucket *b = __TBB_load_with_acquire(table[i]); b; b = b->next)
+                {
+                    out.print("%ld: %ld [%ld: %ld] @", (long)b->liveObjects, (long)b->liveBytes,
+                              (long)b->allocatedObjects, (long)b->allocatedBytes);
+                    for (int j = 0; j < b->depth; j++)
+                        out.print(" %p", b->stack[j]);
+                    out.write("\n", 1);
+                }
+            // pprof maps the addresses to the symbols of the loaded libraries
+            out.print("\nMAPPED_LIBRARIES:\n");
+            int maps = open("/proc/self/maps", O_RDONLY);
+            if (maps >= 0)
+            {
+                char chunk[1024];
+                ssize_t n;
+                while ((n = read(maps, chunk, sizeof(chunk))) > 0 || (n < 0 && errno == EINTR))
+                    if (n > 0)
+                        out.write(chunk, n);
+                close(maps);
+            }
+            bool written = out.flush();
+            return close(fd) == 0 && written;
+#else
+            suppress_unused_warning(fileName);
+            return false;
+#endif
+        }
+
+        /********* End of the heap profiler **************/
+
         void *MemoryPool::getFromLLOCache(TLSData *tls, size_t size, size_t alignment)
         {
             LargeMemoryBlock *lmb = NULL;
@@ -2445,6 +2932,8 @@ namespace rml
             {
                 tls->markUsed();
                 lmb = tls->lloc.get(allocationSize);
+                if (lmb && collectAllocationStatistics)
+                    extMemPool.stats.countLargeCacheHit();
             }
             if (!lmb)
                 lmb = extMemPool.mallocLargeObject(this, allocationSize);
@@ -2484,6 +2973,7 @@ namespace rml
                 setBackRef(header->backRefIdx, header);
 
                 lmb->objectSize = size;
+                lmb->profileBucket = NULL;
 
                 MALLOC_ASSERT(isLargeObject<unknownMem>(alignedArea), ASSERT_TEXT);
                 MALLOC_ASSERT(isAligned(alignedArea, alignment), ASSERT_TEXT);
@@ -2498,6 +2988,8 @@ namespace rml
             LargeObjectHdr *header = (LargeObjectHdr *)object - 1;
             // overwrite backRefIdx to simplify double free detection
             header->backRefIdx = BackRefIdx();
+            if (header->memoryBlock->profileBucket)
+                heapProfiler.registerFree(header->memoryBlock);
 
             if (tls)
             {
@@ -2528,16 +3020,22 @@ namespace rml
                 if (!doInitialization())
                     return NULL;
 
+            // the objects below must be small, as they are assumed to be aligned or are aligned
+            // by offset from the start, so a sampled object is allocated here
+            if (void *result = sampleAllocation(memPool, memPool->getTLS(/*create=*/true), size,
+                                                largeObjectAlignment > alignment ? largeObjectAlignment : alignment))
+                return result;
+
             void *result;
             if (size <= maxSegregatedObjectSize && alignment <= maxSegregatedObjectSize)
-                result = internalPoolMalloc(memPool, alignUp(size ? size : sizeof(size_t), alignment));
+                result = internalPoolMalloc(memPool, alignUp(size ? size : sizeof(size_t), alignment), /*canSample=*/false);
             else if (size < minLargeObjectSize)
             {
                 if (alignment <= fittingAlignment)
-                    result = internalPoolMalloc(memPool, size);
+                    result = internalPoolMalloc(memPool, size, /*canSample=*/false);
                 else if (size + alignment < minLargeObjectSize)
                 {
-                    void *unaligned = internalPoolMalloc(memPool, size + alignment);
+                    void *unaligned = internalPoolMalloc(memPool, size + alignment, /*canSample=*/false);
                     if (!unaligned)
                         return NULL;
                     result = alignUp(unaligned, alignment);
@@ -2579,7 +3077,10 @@ namespace rml
                     size_t threshold = isMemoryBlockHuge ? copySize / 2 : 0;
                     if (newSize > threshold)
                     {
+                        size_t oldSize = lmb->objectSize;
                         lmb->objectSize = newSize;
+                        if (lmb->profileBucket)
+                            heapProfiler.registerRealloc(ptr, lmb->profileBucket, oldSize);
                         return ptr;
                     }
                     // TODO: For large objects suitable for the backend cache,
@@ -2588,9 +3089,17 @@ namespace rml
                 // Reallocate for real
                 copySize = lmb->objectSize;
 #if BACKEND_HAS_MREMAP
+                // the block header is moved and partly overwritten
+                HeapProfileBucket *bucket = lmb->profileBucket;
                 if (void *r = memPool->extMemPool.remap(ptr, copySize, newSize,
                                                         alignment < largeObjectAlignment ? largeObjectAlignment : alignment))
+                {
+                    if (bucket)
+                        heapProfiler.registerRealloc(r, bucket, copySize);
+                    else
+                        ((LargeObjectHdr *)r - 1)->memoryBlock->profileBucket = NULL;
                     return r;
+                }
 #endif
                 result = alignment ? allocateAligned(memPool, newSize, alignment) : internalPoolMalloc(memPool, newSize);
             }
@@ -2712,11 +3221,28 @@ namespace rml
             else
             { /* Slower path to add to the shared list, the allocatedCount is updated by the owner thread in malloc. */
                 FreeObject *objectToFree = block->findObjectToFree(object);
-                block->freePublicObject(objectToFree);
+                TLSData *tls;
+                // checked before the object is freed, as after that the owner can empty the block
+                // and count it again
+                if (collectAllocationStatistics && block->liveObjectsCounted())
+                {
+                    // counted by this thread, as the owner can count only its own objects
+                    unsigned index = getIndex(block->getSize());
+                    if ((tls = block->getMemPool()->getTLS(/*create=*/false)))
+                        tls->countLiveObjects(index, -1);
+                    else
+                        block->getMemPool()->extMemPool.stats.addLiveObjects(index, -1);
+                }
+                // the cache must belong to the pool of the block, so it is not destroyed earlier
+                if (remoteFreeBatching && (tls = block->getMemPool()->getTLS(/*create=*/true)))
+                    tls->remoteFreeCache.put(block, objectToFree);
+                else
+                    block->freePublicObject(objectToFree);
             }
         }
 
-        static void *internalPoolMalloc(MemoryPool *memPool, size_t size)
+        // canSample is false if the caller needs a small object
+        static void *internalPoolMalloc(MemoryPool *memPool, size_t size, bool canSample)
         {
             Bin *bin;
             Block *mallocBlock;
@@ -2729,6 +3255,10 @@ namespace rml
 
             TLSData *tls = memPool->getTLS(/*create=*/true);
 
+            if (canSample)
+                if (void *result = sampleAllocation(memPool, tls, size, largeObjectAlignment))
+                    return result;
+
             /* Allocate a large object */
             if (size >= minLargeObjectSize)
                 return memPool->getFromLLOCache(tls, size, largeObjectAlignment);
@@ -2764,7 +3294,7 @@ namespace rml
                     return result;
                 /* Else something strange happened, need to retry from the beginning; */
                 TRACEF(("[ScalableMalloc trace] Something is wrong: no objects in public free list; reentering.\n"));
-                return internalPoolMalloc(memPool, size);
+                return internalPoolMalloc(memPool, size, /*canSample=*/false);
             }
 
             /*
@@ -2792,7 +3322,7 @@ namespace rml
                     return result;
                 /* Else something strange happened, need to retry from the beginning; */
                 TRACEF(("[ScalableMalloc trace] Something is wrong: no objects in empty block; reentering.\n"));
-                return internalPoolMalloc(memPool, size);
+                return internalPoolMalloc(memPool, size, /*canSample=*/false);
             }
             /*
              * else nothing works so return NULL
@@ -3078,6 +3608,11 @@ extern "C" void __TBB_mallocProcessShutdownNotification(bool windows_process_dyi
     if (!isMallocInitialized())
         return;
 
+#if MALLOC_HEAP_PROFILER
+    if (const char *fileName = getenv("TBB_MALLOC_HEAP_PROFILE_FILE"))
+        heapProfiler.dump(fileName);
+#endif
+
     // Don't clean allocator internals if the entire process is exiting
     if (!windows_process_dying)
     {
@@ -3525,11 +4060,147 @@ extern "C" int scalable_allocation_mode(int param, intptr_t value)
         defaultMemPool->extMemPool.loc.setHugeSizeThreshold((size_t)value);
         return TBBMALLOC_OK;
     }
+    else if (param == TBBMALLOC_USE_HUGE_PAGE_SLABS)
+    {
+#if __linux__
+        switch (value)
+        {
+        case 0:
+        case 1:
+            hugePages.setSlabMode(value);
+            return TBBMALLOC_OK;
+        default:
+            return TBBMALLOC_INVALID_PARAM;
+        }
+#else
+        return TBBMALLOC_NO_EFFECT;
+#endif
+    }
+    else if (param == TBBMALLOC_SET_SIZE_CLASSES)
+    {
+        if (value != TBBMALLOC_SIZE_CLASSES_FINE && value != TBBMALLOC_SIZE_CLASSES_CLASSIC)
+            return TBBMALLOC_INVALID_PARAM;
+        bool classic = value == TBBMALLOC_SIZE_CLASSES_CLASSIC;
+        MallocMutex::scoped_lock lock(initMutex);
+        // blocks of the current size classes might exist after initialization
+        if (mallocInitialized)
+            return fittingBins.isClassic() == classic ? TBBMALLOC_OK : TBBMALLOC_NO_EFFECT;
+        fittingBins.select(classic);
+        return TBBMALLOC_OK;
+    }
+    else if (param == TBBMALLOC_USE_REMOTE_FREE_BATCHING)
+    {
+        switch (value)
+        {
+        case 0:
+        case 1:
+            remoteFreeBatching = value;
+            return TBBMALLOC_OK;
+        default:
+            return TBBMALLOC_INVALID_PARAM;
+        }
+    }
+    else if (param == TBBMALLOC_SET_HEAP_PROFILE_SAMPLING)
+    {
+        if (value < 0)
+            return TBBMALLOC_INVALID_PARAM;
+#if MALLOC_HEAP_PROFILER
+        // under the lock not to be overwritten by the environment variable at initialization
+        MallocMutex::scoped_lock lock(initMutex);
+        heapProfileMode.set(value);
+        FencedStore(heapProfileInterval, value);
+        return TBBMALLOC_OK;
+#else
+        return TBBMALLOC_NO_EFFECT;
+#endif
+    }
+    else if (param == TBBMALLOC_COLLECT_STATISTICS)
+    {
+        switch (value)
+        {
+        case 0:
+        case 1:
+        {
+            // under the lock not to be overwritten by the environment variable at initialization
+            MallocMutex::scoped_lock lock(initMutex);
+            statisticsMode.set(value);
+            if (value && !collectAllocationStatistics)
+            {
+                // the objects allocated before are not counted, so neither are their deallocations
+                if (!++allocationStatisticsEpoch)
+                    allocationStatisticsEpoch = 1;
+                if (isMallocInitialized())
+                    defaultMemPool->extMemPool.stats.resetCollected();
+            }
+            collectAllocationStatistics = value;
+            return TBBMALLOC_OK;
+        }
+        default:
+            return TBBMALLOC_INVALID_PARAM;
+        }
+    }
     return TBBMALLOC_INVALID_PARAM;
 }
 
+/* Fills the snapshot of the pool for TBBMALLOC_GET_STATISTICS */
+static void reportStatistics(ExtMemoryPool *extMemPool, ScalableAllocationStatistics *stat)
+{
+    memset(stat, 0, sizeof(ScalableAllocationStatistics));
+    stat->collecting = collectAllocationStatistics;
+    stat->numBins = minFittingIndex + fittingBins.getNum();
+    MALLOC_STATIC_ASSERT(TBBMALLOC_STATISTICS_BINS >= numBlockBins, "Too few bins in ScalableAllocationStatistics");
+    for (unsigned size = 8; size <= maxSegregatedObjectSize; size += 8)
+        stat->bins[getIndex(size)].objectSize = getObjectSize(size);
+    for (unsigned i = 0; i < fittingBins.getNum(); i++)
+        stat->bins[minFittingIndex + i].objectSize = fittingBins.getSizes()[i];
+    if (!isMallocInitialized())
+        return;
+
+    intptr_t liveObjects[numBlockBinLimit];
+    for (unsigned i = 0; i < numBlockBinLimit; i++)
+        liveObjects[i] = extMemPool->stats.getLiveObjects(i);
+    extMemPool->allLocalCaches.reportStatistics(stat, liveObjects);
+    for (unsigned i = 0; i < stat->numBins; i++)
+    {
+        ScalableBinStatistics &bin = stat->bins[i];
+        // the counters are not read atomically, so they can be inconsistent for a moment
+        intptr_t slabs = extMemPool->stats.getSlabs(i);
+        bin.slabs = slabs > 0 ? slabs : 0;
+        if (!stat->collecting || !bin.objectSize)
+            continue;
+        bin.liveObjects = liveObjects[i] > 0 ? liveObjects[i] : 0;
+        bin.liveBytes = bin.liveObjects * bin.objectSize;
+        size_t capacity = bin.slabs * ((slabSize - sizeof(Block)) / bin.objectSize) * bin.objectSize;
+        bin.cachedBytes = capacity > bin.liveBytes ? capacity - bin.liveBytes : 0;
+    }
+    stat->orphanedSlabs = extMemPool->orphanedBlocks.size();
+    stat->largeLiveBytes = extMemPool->loc.getUsedSize();
+    stat->largeCachedBytes = extMemPool->loc.getLOCSize();
+    stat->largeCacheHits = extMemPool->stats.getLargeCacheHits();
+    stat->largeCacheMisses = extMemPool->stats.getLargeCacheMisses();
+    stat->backendRegions = extMemPool->backend.getRegionsNum();
+    stat->backendBytes = extMemPool->backend.getTotalMemSize();
+}
+
 extern "C" int scalable_allocation_command(int cmd, void *param)
 {
+    if (cmd == TBBMALLOC_GET_STATISTICS)
+    {
+        if (!param)
+            return TBBMALLOC_INVALID_PARAM;
+        reportStatistics(&defaultMemPool->extMemPool, (ScalableAllocationStatistics *)param);
+        return TBBMALLOC_OK;
+    }
+    if (cmd == TBBMALLOC_DUMP_HEAP_PROFILE)
+    {
+#if MALLOC_HEAP_PROFILER
+        if (!param)
+            return TBBMALLOC_INVALID_PARAM;
+        return heapProfiler.dump((const char *)param) ? TBBMALLOC_OK : TBBMALLOC_INVALID_PARAM;
+#else
+        return TBBMALLOC_NO_EFFECT;
+#endif
+    }
     if (param)
         return TBBMALLOC_INVALID_PARAM;
 
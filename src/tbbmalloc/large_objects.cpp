@@ -741,7 +741,6 @@ void LargeObjectCacheImpl<Props>::reset() {
     bitMask.reset();
 }
 
-#if __TBB_MALLOC_WHITEBOX_TEST
 template<typename Props>
 size_t LargeObjectCacheImpl<Props>::getLOCSize() const
 {
@@ -769,7 +768,6 @@ size_t LargeObjectCache::getUsedSize() const
 {
     return largeCache.getUsedSize() + hugeCache.getUsedSize();
 }
-#endif // __TBB_MALLOC_WHITEBOX_TEST
 
 inline bool LargeObjectCache::isCleanupNeededOnRange(uintptr_t range, uintptr_t currTime)
 {
@@ -978,11 +976,15 @@ LargeMemoryBlock *ExtMemoryPool::mallocLargeObject(MemoryPool *pool, size_t allo
         lmb->backRefIdx = backRefIdx;
         lmb->pool = pool;
         STAT_increment(getThreadId(), ThreadCommonCounters, allocNewLargeObj);
+        if (collectAllocationStatistics)
+            stats.countLargeCacheMiss();
     } else {
 #if __TBB_MALLOC_LOCACHE_STAT
         AtomicIncrement(cacheHits);
         AtomicAdd(memHitKB, allocationSize/1024);
 #endif
+        if (collectAllocationStatistics)
+            stats.countLargeCacheHit();
     }
     return lmb;
 }
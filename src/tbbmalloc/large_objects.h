@@ -262,10 +262,8 @@ public:
 
     void reset();
     void reportStat(FILE *f);
-#if __TBB_MALLOC_WHITEBOX_TEST
     size_t getLOCSize() const;
     size_t getUsedSize() const;
-#endif
 };
 
 class LargeObjectCache {
@@ -345,10 +343,8 @@ public:
     void reset();
 
     void reportStat(FILE *f);
-#if __TBB_MALLOC_WHITEBOX_TEST
     size_t getLOCSize() const;
     size_t getUsedSize() const;
-#endif
 
     // Cache deals with exact-fit sizes, so need to align each size
     // to the specific bin when put object to cache
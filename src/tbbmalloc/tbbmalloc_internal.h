@@ -126,13 +126,14 @@ const size_t largeObjectAlignment = estimatedCacheLineSize;
 /*
  * This number of bins in the TLS that leads to blocks that we can allocate in.
  */
-const uint32_t numBlockBinLimit = 31;
+const uint32_t numBlockBinLimit = 40;
 
 /********** End of numeric parameters controlling allocations *********/
 
 class BlockI;
 class Block;
 struct LargeMemoryBlock;
+struct HeapProfileBucket;
 struct ExtMemoryPool;
 struct MemRegion;
 class FreeBlock;
@@ -248,15 +249,48 @@ public:
     void unregisterThread(TLSRemote *tls);
     bool cleanup(bool cleanOnlyUnused);
     void markUnused();
+    void reportStatistics(ScalableAllocationStatistics *stat, intptr_t *liveObjects);
     void reset() { head = NULL; }
 };
 
+// Is counting of live objects and large object cache hits on
+extern bool collectAllocationStatistics;
+
+// Counters of a pool for TBBMALLOC_GET_STATISTICS that are updated as the pool changes.
+// Live objects are mostly counted by threads in TLS without atomics; here are the counts
+// of the threads that exited and of deallocations by threads without TLS.
+// Must be placed in zero-initialized memory.
+class AllocationStatistics {
+    intptr_t slabs[numBlockBinLimit];
+    intptr_t liveObjects[numBlockBinLimit];
+    intptr_t largeCacheHits,
+             largeCacheMisses;
+public:
+    void addSlab(unsigned index) { AtomicIncrement(slabs[index]); }
+    void removeSlab(unsigned index) { AtomicAdd(slabs[index], -1); }
+    void addLiveObjects(unsigned index, intptr_t num) { AtomicAdd(liveObjects[index], num); }
+    void countLargeCacheHit() { AtomicIncrement(largeCacheHits); }
+    void countLargeCacheMiss() { AtomicIncrement(largeCacheMisses); }
+    intptr_t getSlabs(unsigned index) const { return slabs[index]; }
+    intptr_t getLiveObjects(unsigned index) const { return liveObjects[index]; }
+    intptr_t getLargeCacheHits() const { return largeCacheHits; }
+    intptr_t getLargeCacheMisses() const { return largeCacheMisses; }
+    void reset() { memset(this, 0, sizeof(AllocationStatistics)); }
+    // when collection is turned on again, the counts collected before are dropped
+    void resetCollected()
+    {
+        memset(liveObjects, 0, sizeof(liveObjects));
+        largeCacheHits = largeCacheMisses = 0;
+    }
+};
+
 class LifoList {
 public:
     inline LifoList();
     inline void push(Block *block);
     inline Block *pop();
     inline Block *grab();
+    size_t size();
 
 private:
     Block *top;
@@ -278,6 +312,7 @@ public:
     void put(intptr_t binTag, Block *block);
     void reset();
     bool cleanup(Backend* backend);
+    size_t size();
 };
 
 /* Large objects entities */
@@ -334,6 +369,7 @@ struct LargeMemoryBlock : public BlockI {
     size_t            objectSize;    // the size requested by a client
     size_t            unalignedSize; // the size requested from backend
     BackRefIdx        backRefIdx;    // cached here, used copy is in LargeObjectHdr
+    HeapProfileBucket *profileBucket; // call stack of an object sampled by the heap profiler
 };
 
 // Classes and methods for backend.cpp
@@ -399,6 +435,7 @@ class HugePagesStatus {
 private:
     AllocControlledMode requestedMode; // changed only by user
                                        // to keep enabled and requestedMode consistent
+    AllocControlledMode requestedSlabMode;
     MallocMutex setModeLock;
     size_t      pageSize;
     intptr_t    needActualStatusPrint;
@@ -475,12 +512,17 @@ public:
 
     // User defined value
     bool isEnabled;
+    // User defined value, slabs and large blocks are carved from huge page regions.
+    // Does not depend on huge pages availability, regular pages are used as a fallback.
+    bool isSlabModeEnabled;
 
     void init() {
         parseSystemMemInfo();
         MallocMutex::scoped_lock lock(setModeLock);
         requestedMode.initReadEnv("TBB_MALLOC_USE_HUGE_PAGES", 0);
         isEnabled = (isHPAvailable || isTHPAvailable) && requestedMode.get();
+        requestedSlabMode.initReadEnv("TBB_MALLOC_USE_HUGE_PAGE_SLABS", 0);
+        isSlabModeEnabled = requestedSlabMode.get();
     }
 
     // Could be set from user code at any place.
@@ -491,13 +533,19 @@ public:
         isEnabled = (isHPAvailable || isTHPAvailable) && newVal;
     }
 
+    void setSlabMode(intptr_t newVal) {
+        MallocMutex::scoped_lock lock(setModeLock);
+        requestedSlabMode.set(newVal);
+        isSlabModeEnabled = newVal;
+    }
+
     bool isRequested() const {
         return requestedMode.ready() ? requestedMode.get() : false;
     }
 
     void reset() {
         pageSize = needActualStatusPrint = 0;
-        isEnabled = isHPAvailable = isTHPAvailable = false;
+        isEnabled = isHPAvailable = isTHPAvailable = isSlabModeEnabled = false;
     }
 
     // If memory mapping size is a multiple of huge page size, some OS kernels
@@ -534,6 +582,7 @@ struct ExtMemoryPool {
     LargeObjectCache  loc;
     AllLocalCaches    allLocalCaches;
     OrphanedBlocks    orphanedBlocks;
+    AllocationStatistics stats;
 
     intptr_t          poolId;
     // To find all large objects. Used during user pool destruction,
@@ -565,6 +614,7 @@ struct ExtMemoryPool {
         loc.reset();
         allLocalCaches.reset();
         orphanedBlocks.reset();
+        stats.reset();
         bool ret = tlsPointerKey.destroy();
         backend.reset();
         return ret;
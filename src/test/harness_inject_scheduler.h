@@ -48,6 +48,7 @@
 #include "../tbb/observer_proxy.cpp"
 #include "../tbb/task.cpp"
 #include "../tbb/task_group_context.cpp"
+#include "../tbb/scheduler_trace.cpp"
 
 // Other dependencies
 #include "../tbb/cache_aligned_allocator.cpp"
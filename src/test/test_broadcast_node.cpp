@@ -317,6 +317,129 @@ void test_extract() {
 }
 #endif  // TBB_DEPRECATED_FLOW_NODE_EXTRACTION
 
+//! Every successor gets the whole batch in order
+void test_try_put_batch() {
+    const int n = 100;
+    tbb::flow::graph g;
+    tbb::flow::broadcast_node<int> b(g);
+    tbb::flow::queue_node<int> q1(g);
+    tbb::flow::queue_node<int> q2(g);
+    tbb::flow::make_edge( b, q1 );
+    tbb::flow::make_edge( b, q2 );
+    int items[n];
+    for ( int i = 0; i < n; ++i ) items[i] = i;
+    ASSERT( b.try_put_batch( items, n ) == n, "broadcast_node should accept the whole batch" );
+    g.wait_for_all();
+    int j;
+    for ( int i = 0; i < n; ++i ) {
+        ASSERT( q1.try_get( j ) && j == i, "missing or out of order message" );
+        ASSERT( q2.try_get( j ) && j == i, "missing or out of order message" );
+    }
+    ASSERT( !q1.try_get( j ) && !q2.try_get( j ), "extra message in queue" );
+}
+
+//! Fails if a message is put to it after the edge to it has been removed
+class removal_checking_receiver : public tbb::flow::receiver<int> {
+    tbb::flow::graph& my_graph;
+    const tbb::atomic<bool>& my_removed;
+public:
+    removal_checking_receiver( tbb::flow::graph& g, const tbb::atomic<bool>& removed ) : my_graph(g), my_removed(removed) {}
+
+    tbb::task * try_put_task( const int & ) __TBB_override {
+        // give remove_edge the chance to return while the message is being put
+        __TBB_Yield();
+        ASSERT( !my_removed, "a message was put after remove_edge returned" );
+        return const_cast<tbb::task *>(tbb::flow::internal::SUCCESSFULLY_ENQUEUED);
+    }
+
+    tbb::flow::graph& graph_reference() const __TBB_override { return my_graph; }
+
+#if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
+    built_predecessors_type mbp;
+    built_predecessors_type &built_predecessors() __TBB_override { return mbp; }
+    void internal_add_built_predecessor(predecessor_type &) __TBB_override {}
+    void internal_delete_built_predecessor(predecessor_type &) __TBB_override {}
+    void copy_predecessors(predecessor_list_type &) __TBB_override {}
+    size_t predecessor_count() __TBB_override { return 0; }
+#endif
+    void reset_receiver(tbb::flow::reset_flags /*f*/) __TBB_override { }
+};
+
+class edge_changing_body : private NoAssign {
+    tbb::flow::graph& my_graph;
+    tbb::flow::broadcast_node<int>& my_b;
+public:
+    edge_changing_body( tbb::flow::graph& g, tbb::flow::broadcast_node<int>& b ) : my_graph(g), my_b(b) {}
+
+    void operator()( int id ) const {
+        if ( id ) {
+            for ( int n = 0; n < N; ++n )
+                ASSERT( my_b.try_put( n ), NULL );
+            return;
+        }
+        for ( int i = 0; i < 100; ++i ) {
+            tbb::atomic<bool> removed;
+            removed = false;
+            removal_checking_receiver *r = new removal_checking_receiver( my_graph, removed );
+            tbb::flow::make_edge( my_b, *r );
+            __TBB_Yield();
+            tbb::flow::remove_edge( my_b, *r );
+            removed = true;
+            delete r;
+        }
+    }
+};
+
+//! The successors that are added and removed while messages are broadcast do not disturb the others
+void test_concurrent_edges( int p ) {
+    tbb::flow::graph g;
+    tbb::flow::broadcast_node<int> b(g);
+    counting_array_receiver<int> stable(g);
+    tbb::flow::make_edge( b, stable );
+    NativeParallelFor( p + 1, edge_changing_body( g, b ) );
+    for ( int n = 0; n < N; ++n )
+        ASSERT( (int)stable[n] == p, "a message was lost or duplicated" );
+}
+
+//! Adds and removes the first successor of a node while the other threads broadcast
+class first_edge_body : private NoAssign {
+    tbb::flow::graph& my_graph;
+    tbb::flow::broadcast_node<int>& my_b;
+    tbb::atomic<bool>& my_done;
+public:
+    first_edge_body( tbb::flow::graph& g, tbb::flow::broadcast_node<int>& b, tbb::atomic<bool>& done )
+        : my_graph(g), my_b(b), my_done(done) {}
+
+    void operator()( int id ) const {
+        if ( id ) {
+            while ( !my_done )
+                ASSERT( my_b.try_put( id ), NULL );
+            return;
+        }
+        tbb::atomic<bool> removed;
+        removed = false;
+        removal_checking_receiver r( my_graph, removed );
+        __TBB_Yield();
+        tbb::flow::make_edge( my_b, r );
+        __TBB_Yield();
+        tbb::flow::remove_edge( my_b, r );
+        removed = true;
+        my_done = true;
+    }
+};
+
+//! The broadcasts that start before the first make_edge of a node are waited for by remove_edge
+void test_first_edge( int p ) {
+    for ( int i = 0; i < 100; ++i ) {
+        tbb::flow::graph g;
+        tbb::flow::broadcast_node<int> b(g);
+        tbb::atomic<bool> done;
+        done = false;
+        NativeParallelFor( p + 1, first_edge_body( g, b, done ) );
+        g.wait_for_all();
+    }
+}
+
 #if __TBB_PREVIEW_FLOW_GRAPH_NODE_SET
 #include <array>
 #include <vector>
@@ -368,10 +491,13 @@ int TestMain() {
        test_parallel_broadcasts<int>(p);
        test_parallel_broadcasts<float>(p);
        test_parallel_broadcasts<int_convertable_type>(p);
+       test_concurrent_edges(p);
+       test_first_edge(p);
    }
 
    test_resets<int>();
    test_resets<float>();
+   test_try_put_batch();
 #if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
     test_extract();
 #endif
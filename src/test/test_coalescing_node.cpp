@@ -0,0 +1,235 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#define TBB_PREVIEW_FLOW_GRAPH_NODES 1
+
+#include "harness.h"
+#include "harness_graph.h"
+#include "harness_cpu.h"
+
+#include "tbb/flow_graph.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/tick_count.h"
+#include "tbb/atomic.h"
+
+#include <vector>
+
+using tbb::flow::coalescing_node;
+
+//! Records the sizes of the batches put to it; rejects everything if my_reject is set
+class batch_recorder : public tbb::flow::receiver<int> {
+    tbb::flow::graph &my_graph;
+public:
+    std::vector<size_t> my_batches;
+    std::vector<int> my_items;
+    bool my_reject;
+
+    batch_recorder( tbb::flow::graph &g ) : my_graph(g), my_reject(false) {}
+
+protected:
+    tbb::task *try_put_task( const int &v ) __TBB_override {
+        size_t accepted;
+        return try_put_task_batch( &v, 1, accepted );
+    }
+
+    tbb::task *try_put_task_batch( const int *items, size_t n, size_t &accepted ) __TBB_override {
+        accepted = 0;
+        if ( my_reject )
+            return NULL;
+        my_batches.push_back( n );
+        my_items.insert( my_items.end(), items, items + n );
+        accepted = n;
+        return const_cast<tbb::task *>(SUCCESSFULLY_ENQUEUED);
+    }
+
+    tbb::flow::graph &graph_reference() const __TBB_override { return my_graph; }
+
+    void reset_receiver( tbb::flow::reset_flags ) __TBB_override {}
+
+#if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
+    built_predecessors_type &built_predecessors() __TBB_override { return my_built_predecessors; }
+    void internal_add_built_predecessor( predecessor_type & ) __TBB_override {}
+    void internal_delete_built_predecessor( predecessor_type & ) __TBB_override {}
+    void copy_predecessors( predecessor_list_type & ) __TBB_override {}
+    size_t predecessor_count() __TBB_override { return 0; }
+    built_predecessors_type my_built_predecessors;
+#endif
+};
+
+void check_items( const batch_recorder &r, int n ) {
+    ASSERT( r.my_items.size() == size_t(n), "wrong number of messages forwarded" );
+    for ( int i = 0; i < n; ++i )
+        ASSERT( r.my_items[i] == i, "the messages are not in FIFO order" );
+}
+
+//! The messages are forwarded by batch_size, and flush forwards the rest
+void test_batch_by_count() {
+    tbb::flow::graph g;
+    coalescing_node<int> c( g, 4 );
+    batch_recorder r( g );
+    tbb::flow::make_edge( c, r );
+    for ( int i = 0; i < 10; ++i ) {
+        c.try_put( i );
+        g.wait_for_all();
+    }
+    ASSERT( r.my_batches.size() == 2 && r.my_batches[0] == 4 && r.my_batches[1] == 4, "expected two full batches" );
+    c.flush();
+    g.wait_for_all();
+    ASSERT( r.my_batches.size() == 3 && r.my_batches[2] == 2, "flush should forward the last two messages" );
+    check_items( r, 10 );
+
+    // a batch put to the node is split by batch_size
+    int items[10];
+    for ( int i = 0; i < 10; ++i ) items[i] = 10 + i;
+    ASSERT( c.try_put_batch( items, 10 ) == 10, NULL );
+    g.wait_for_all();
+    ASSERT( r.my_batches.size() == 5 && r.my_batches[3] == 4 && r.my_batches[4] == 4, "expected two more full batches" );
+    c.flush();
+    g.wait_for_all();
+    check_items( r, 20 );
+}
+
+//! The messages held are forwarded after max_wait, and wait_for_all waits for them
+void test_batch_by_wait() {
+    tbb::flow::graph g;
+    const double max_wait = 0.01;
+    coalescing_node<int> c( g, 4, tbb::tick_count::interval_t( max_wait ) );
+    batch_recorder r( g );
+    tbb::flow::make_edge( c, r );
+    tbb::tick_count t0 = tbb::tick_count::now();
+    c.try_put( 0 );
+    c.try_put( 1 );
+    g.wait_for_all();
+    ASSERT( (tbb::tick_count::now() - t0).seconds() >= max_wait, "the batch was forwarded before max_wait" );
+    ASSERT( r.my_batches.size() == 1 && r.my_batches[0] == 2, "wait_for_all returned before the batch was forwarded" );
+
+    // the messages left after a full batch wait for max_wait anew
+    for ( int i = 2; i < 8; ++i )
+        c.try_put( i );
+    g.wait_for_all();
+    ASSERT( r.my_batches.size() == 3 && r.my_batches[1] == 4 && r.my_batches[2] == 2,
+            "the messages left after a full batch were not forwarded" );
+    check_items( r, 8 );
+}
+
+//! The timer task sleeps while the messages held wait for max_wait instead of polling the node
+void test_wait_without_spinning() {
+    tbb::flow::graph g;
+    const double max_wait = 0.5;
+    coalescing_node<int> c( g, 4, tbb::tick_count::interval_t( max_wait ) );
+    batch_recorder r( g );
+    tbb::flow::make_edge( c, r );
+    c.try_put( 0 );
+    // wait_for_all is not called in the meantime, because the waiting thread spins on its own
+    const double cpu_time = GetCPUUserTime();
+    tbb::tick_count t0 = tbb::tick_count::now();
+    Harness::Sleep( int(max_wait*800) );
+    const double wait_time = (tbb::tick_count::now() - t0).seconds();
+    const double used = GetCPUUserTime() - cpu_time;
+    ASSERT( used < wait_time/4, "the messages held are waited for by spinning" );
+    REMARK( "waittime: %g; usrtime: %g\n", wait_time, used );
+    g.wait_for_all();
+    ASSERT( r.my_batches.size() == 1 && r.my_batches[0] == 1, "the batch was not forwarded after max_wait" );
+}
+
+//! The messages that are not accepted stay in the node and can be pulled one by one
+void test_rejected_batch() {
+    tbb::flow::graph g;
+    coalescing_node<int> c( g, 4 );
+    batch_recorder r( g );
+    r.my_reject = true;
+    tbb::flow::make_edge( c, r );
+    for ( int i = 0; i < 6; ++i )
+        c.try_put( i );
+    c.flush();
+    g.wait_for_all();
+    ASSERT( r.my_batches.empty(), NULL );
+    int j;
+    for ( int i = 0; i < 6; ++i )
+        ASSERT( c.try_get( j ) && j == i, "the messages were lost or reordered" );
+    ASSERT( !c.try_get( j ), NULL );
+}
+
+//! A reserving join_node reverses the edges and reserves the messages held
+void test_reserving_join() {
+    typedef tbb::flow::tuple<int, int> tuple_type;
+    tbb::flow::graph g;
+    coalescing_node<int> c0( g, 2 ), c1( g, 2 );
+    tbb::flow::join_node< tuple_type, tbb::flow::reserving > j( g );
+    tbb::flow::queue_node< tuple_type > q( g );
+    tbb::flow::make_edge( c0, tbb::flow::input_port<0>( j ) );
+    tbb::flow::make_edge( c1, tbb::flow::input_port<1>( j ) );
+    tbb::flow::make_edge( j, q );
+    for ( int i = 0; i < 4; ++i ) {
+        c0.try_put( i );
+        c1.try_put( 10 + i );
+    }
+    g.wait_for_all();
+    tuple_type t;
+    for ( int i = 0; i < 4; ++i ) {
+        ASSERT( q.try_get( t ), "missing tuple" );
+        ASSERT( tbb::flow::get<0>( t ) == i && tbb::flow::get<1>( t ) == 10 + i, "wrong tuple" );
+    }
+    ASSERT( !q.try_get( t ), "extra tuple" );
+}
+
+struct count_body {
+    tbb::atomic<int> *my_count;
+    count_body( tbb::atomic<int> &count ) : my_count(&count) {}
+    int operator()( int v ) const { ++*my_count; return v; }
+};
+
+struct parallel_puts : NoAssign {
+    coalescing_node<int> &my_node;
+    parallel_puts( coalescing_node<int> &n ) : my_node(n) {}
+    void operator()( int ) const {
+        for ( int i = 0; i < 1000; ++i )
+            ASSERT( my_node.try_put( i ), NULL );
+    }
+};
+
+//! Every message put in parallel reaches an unlimited function_node in a batch, by flush() or by max_wait
+void test_parallel( int num_threads, tbb::tick_count::interval_t max_wait ) {
+    tbb::flow::graph g;
+    tbb::atomic<int> count;
+    count = 0;
+    coalescing_node<int> c( g, 16, max_wait );
+    tbb::flow::function_node<int, int> f( g, tbb::flow::unlimited, count_body( count ) );
+    tbb::flow::make_edge( c, f );
+    NativeParallelFor( num_threads, parallel_puts( c ) );
+    if ( max_wait.seconds() <= 0 )
+        c.flush();
+    g.wait_for_all();
+    ASSERT( count == num_threads*1000, "messages were lost" );
+}
+
+int TestMain() {
+    if( MinThread<1 ) {
+        REPORT("number of threads must be positive\n");
+        exit(1);
+    }
+    test_batch_by_count();
+    test_batch_by_wait();
+    test_wait_without_spinning();
+    test_rejected_batch();
+    test_reserving_join();
+    for( int p=MinThread; p<=MaxThread; ++p ) {
+        tbb::task_scheduler_init init(p);
+        test_parallel(p, tbb::tick_count::interval_t());
+        test_parallel(p, tbb::tick_count::interval_t(0.001));
+    }
+    return Harness::Done;
+}
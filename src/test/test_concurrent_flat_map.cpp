@@ -0,0 +1,239 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#define TBB_PREVIEW_CONCURRENT_FLAT_MAP 1
+#include "tbb/concurrent_flat_map.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/atomic.h"
+#include "harness.h"
+#include "harness_barrier.h"
+
+typedef tbb::concurrent_flat_map<long, long> LongTable;
+
+//! Keys that are not sequential, so that the items do not go to the groups in order
+static long MakeKey( long i ) { return i * 7919 + 1; }
+
+void TestSerial() {
+    REMARK("testing serial operations\n");
+    const long n = 10000;
+    LongTable table;
+    ASSERT( table.empty() && table.size() == 0, NULL );
+    for( long i = 0; i < n; ++i )
+        ASSERT( table.insert( std::make_pair( MakeKey(i), i ) ), "the key is new" );
+    ASSERT( table.size() == size_t(n), NULL );
+    ASSERT( table.bucket_count() >= size_t(n), NULL );
+    for( long i = 0; i < n; ++i ) {
+        long value = -1;
+        ASSERT( table.find( MakeKey(i), value ) && value == i, "the key is lost" );
+        ASSERT( !table.insert( std::make_pair( MakeKey(i), -i ) ), "the key exists" );
+        ASSERT( table.count( MakeKey(i) ) == 1, NULL );
+        ASSERT( table.count( MakeKey(i + n) ) == 0, NULL );
+    }
+    for( long i = 0; i < n; i += 2 ) {
+        ASSERT( !table.insert_or_assign( MakeKey(i), -i ), "the key exists" );
+        ASSERT( table.erase( MakeKey(i+1) ), NULL );
+        ASSERT( !table.erase( MakeKey(i+1) ), "the key is erased twice" );
+    }
+    ASSERT( table.size() == size_t(n/2), NULL );
+
+    long sum = 0, count = 0;
+    for( LongTable::const_iterator it = table.begin(); it != table.end(); ++it, ++count ) {
+        ASSERT( it->first == MakeKey(-it->second), "the item is broken" );
+        sum += it->second;
+    }
+    ASSERT( count == n/2 && sum == -(n/2)*(n/2-1), NULL );
+
+    LongTable copy( table );
+    ASSERT( copy.size() == table.size(), NULL );
+    for( long i = 0; i < n; i += 2 ) {
+        long value = 0;
+        ASSERT( copy.find( MakeKey(i), value ) && value == -i, NULL );
+        ASSERT( !copy.count( MakeKey(i+1) ), NULL );
+    }
+    LongTable other;
+    other.insert( std::make_pair( 2L, 2L ) );
+    other = copy;
+    ASSERT( other.size() == copy.size() && other.count( MakeKey(0) ) && !other.count( 2 ), NULL );
+
+    table.rehash();
+    ASSERT( table.size() == size_t(n/2) && table.count( MakeKey(n-2) ), NULL );
+    table.clear();
+    ASSERT( table.empty() && table.begin() == table.end() && !table.count( MakeKey(0) ), NULL );
+    table.swap( other );
+    ASSERT( table.size() == size_t(n/2) && other.empty(), NULL );
+}
+
+//! Gives access to the overflow bits of the groups
+class OverflowTable : public LongTable {
+public:
+    OverflowTable( size_type n ) : LongTable( n ) {}
+    size_type groups() const { return my_table->my_mask + 1; }
+    size_type groups_with_overflow() const {
+        size_type count = 0;
+        for( size_type i = 0; i < groups(); ++i )
+            count += my_table->my_groups[i].overflow() != 0;
+        return count;
+    }
+    size_type retired_tables() const {
+        size_type count = 0;
+        for( table *t = my_retired; t; t = t->my_retired )
+            ++count;
+        return count;
+    }
+};
+
+//! The overflow bits left by the erased items are cleared, so that missing keys are not searched in the whole table
+void TestStaleOverflows() {
+    REMARK("testing the overflow bits left by erasures\n");
+    OverflowTable table( 10000 );
+    const size_t slots = table.bucket_count();
+    const long n = long(slots * 7 / 8); // the most items that do not make the table grow
+    for( long round = 0; round < 20; ++round ) {
+        for( long i = 0; i < n; ++i )
+            ASSERT( table.insert( std::make_pair( MakeKey(round*n + i), i ) ), NULL );
+        for( long i = 0; i < n; ++i )
+            ASSERT( table.erase( MakeKey(round*n + i) ), NULL );
+    }
+    ASSERT( table.empty() && table.bucket_count() == slots, "the table is grown by the erased items" );
+    ASSERT( table.groups_with_overflow() <= table.groups()/2, "the overflow bits are not cleared" );
+}
+
+//! Replaces own keys one by one, so that the table is rebuilt for the stale overflow bits without growth
+class ChurnBody: NoAssign {
+    OverflowTable &my_table;
+    const long my_n, my_ops;
+    const int my_nthread;
+public:
+    ChurnBody( OverflowTable &table, long n, long ops, int nthread )
+        : my_table(table), my_n(n), my_ops(ops), my_nthread(nthread) {}
+    void operator()( int k ) const {
+        for( long i = k; i < my_ops; i += my_nthread ) {
+            ASSERT( my_table.erase( MakeKey(i) ), NULL );
+            ASSERT( my_table.insert( std::make_pair( MakeKey(i + my_n), i ) ), NULL );
+        }
+    }
+};
+
+//! The tables replaced by the rebuilds are released while the size of the container is constant
+void TestRetiredTables( int nthread ) {
+    REMARK("testing the release of the retired tables with %d threads\n", nthread);
+    OverflowTable table( 1680 ); // 128 groups
+    // a thread erases only the keys it inserted
+    const long n = 1650 - 1650 % nthread, ops = 200000;
+    for( long i = 0; i < n; ++i )
+        table.insert( std::make_pair( MakeKey(i), i ) );
+    const size_t groups = table.groups();
+    NativeParallelFor( nthread, ChurnBody( table, n, ops, nthread ) );
+    ASSERT( table.size() == size_t(n) && table.groups() == groups, "the table is grown by the churn" );
+    // the tables retired during the churn are released by the next operations
+    for( long i = ops; i < ops + 4; ++i )
+        table.erase( MakeKey(i) );
+    ASSERT( table.retired_tables() <= 1, "the retired tables are not released" );
+}
+
+//! Inserts own keys, while finding and erasing the keys of the other threads
+class ConcurrentBody: NoAssign {
+    LongTable &my_table;
+    const long my_n;
+    const int my_nthread;
+    Harness::SpinBarrier &my_barrier;
+public:
+    ConcurrentBody( LongTable &table, long n, int nthread, Harness::SpinBarrier &barrier )
+        : my_table(table), my_n(n), my_nthread(nthread), my_barrier(barrier) {}
+    void operator()( int k ) const {
+        // the keys below my_n are inserted before and must be always found despite the growth
+        for( long i = my_n + k; i < 2*my_n; i += my_nthread ) {
+            ASSERT( my_table.insert( std::make_pair( MakeKey(i), i ) ), "the key is new" );
+            long j = (i * 31) % my_n, value = -1;
+            ASSERT( my_table.find( MakeKey(j), value ) && value == j, "the key is lost during growth" );
+        }
+        my_barrier.wait();
+        for( long i = my_n + k; i < 2*my_n; i += my_nthread ) {
+            ASSERT( my_table.erase( MakeKey(i) ), NULL );
+            long j = (i * 17) % my_n, value = -1;
+            ASSERT( my_table.find( MakeKey(j), value ) && value == j, "the key is lost during erasure" );
+        }
+    }
+};
+
+//! All threads insert the same keys, only one insertion of every key must succeed
+class SameKeysBody: NoAssign {
+    LongTable &my_table;
+    const long my_n;
+    tbb::atomic<long> &my_inserted;
+public:
+    SameKeysBody( LongTable &table, long n, tbb::atomic<long> &inserted )
+        : my_table(table), my_n(n), my_inserted(inserted) {}
+    void operator()( int ) const {
+        long inserted = 0;
+        for( long i = 0; i < my_n; ++i )
+            inserted += my_table.insert( std::make_pair( MakeKey(i), i ) );
+        my_inserted += inserted;
+    }
+};
+
+class SumBody: NoAssign {
+    tbb::atomic<long> &my_sum;
+public:
+    SumBody( tbb::atomic<long> &sum ) : my_sum(sum) {}
+    void operator()( const LongTable::range_type &r ) const {
+        long sum = 0;
+        for( LongTable::const_iterator it = r.begin(); it != r.end(); ++it )
+            sum += it->second;
+        my_sum += sum;
+    }
+};
+
+void TestConcurrency( int nthread ) {
+    REMARK("testing concurrent operations with %d threads\n", nthread);
+    const long n = 100000;
+    {
+        LongTable table;
+        for( long i = 0; i < n; ++i )
+            table.insert( std::make_pair( MakeKey(i), i ) );
+        Harness::SpinBarrier barrier( nthread );
+        NativeParallelFor( nthread, ConcurrentBody( table, n, nthread, barrier ) );
+        ASSERT( table.size() == size_t(n), NULL );
+
+        tbb::atomic<long> sum; sum = 0;
+        tbb::parallel_for( table.range( 4 ), SumBody( sum ) );
+        ASSERT( sum == n*(n-1)/2, "parallel_for over the range visits wrong items" );
+    }
+    {
+        LongTable table;
+        tbb::atomic<long> inserted; inserted = 0;
+        NativeParallelFor( nthread, SameKeysBody( table, n, inserted ) );
+        ASSERT( inserted == n && table.size() == size_t(n), "duplicates are inserted" );
+        long count = 0;
+        for( LongTable::const_iterator it = table.begin(); it != table.end(); ++it )
+            ++count;
+        ASSERT( count == n, NULL );
+    }
+}
+
+int TestMain () {
+    if( MinThread<1 ) MinThread=1;
+    if( MaxThread<2 ) MaxThread=2;
+    TestSerial();
+    TestStaleOverflows();
+    for( int nthread=MinThread; nthread<=MaxThread; ++nthread ) {
+        tbb::task_scheduler_init init( nthread );
+        TestConcurrency( nthread );
+        TestRetiredTables( nthread );
+    }
+    return Harness::Done;
+}
@@ -673,6 +673,204 @@ void TestConcurrency( int nthread ) {
     ASSERT( MyDataCount==0, "memory leak detected" );
 }
 
+typedef tbb::concurrent_hash_map<int,int> IntTable;
+
+class ShrinkGrowBody: NoAssign {
+    IntTable& my_table;
+    Harness::SpinBarrier& my_barrier;
+    const int my_nthread;
+    const int my_n;
+    void check_kept( int k ) const {
+        for( int i=k; i<my_n/16; i+=my_nthread ) {
+            IntTable::const_accessor a;
+            ASSERT( my_table.find( a, i ) && a->second==i, "item is lost by shrinking" );
+        }
+    }
+public:
+    ShrinkGrowBody( IntTable& table, Harness::SpinBarrier& barrier, int nthread, int n )
+        : my_table(table), my_barrier(barrier), my_nthread(nthread), my_n(n) {}
+    void operator()( int k ) const {
+        for( int i=k; i<my_n; i+=my_nthread )
+            ASSERT( my_table.insert( std::make_pair(i, i) ), NULL );
+        my_barrier.wait();
+        // erase all items but the first 1/16, the table shrinks while they are looked up
+        for( int i=k; i<my_n; i+=my_nthread ) {
+            if( i >= my_n/16 ) {
+                ASSERT( my_table.erase( i ), NULL );
+                ASSERT( !my_table.count( i ), "erased item is found" );
+            } else {
+                IntTable::accessor a;
+                ASSERT( my_table.find( a, i ) && a->second==i, "item is lost by shrinking" );
+            }
+        }
+        check_kept( k );
+        my_barrier.wait();
+        // grow the table again
+        for( int i=k; i<my_n; i+=my_nthread )
+            if( i >= my_n/16 )
+                ASSERT( my_table.insert( std::make_pair(i, i) ), NULL );
+        check_kept( k );
+    }
+};
+
+//! Test for shrinking of the table by erasures and its growth after that.
+void TestShrink( int nthread ) {
+    REMARK("testing shrink and growth with %d threads\n", nthread);
+    const int n = 100000;
+    IntTable table;
+    ASSERT( table.max_load_factor()==1.0f && table.min_load_factor()==0.0f, "wrong default load factors" );
+    table.min_load_factor( 0.25f );
+    for( int i=0; i<n; ++i )
+        table.insert( std::make_pair(i, i) );
+    const IntTable::size_type peak_buckets = table.bucket_count();
+    ASSERT( table.load_factor() <= table.max_load_factor(), NULL );
+    for( int i=0; i<n; ++i )
+        if( i >= n/16 ) table.erase( i );
+    ASSERT( table.bucket_count() <= peak_buckets/4, "the table is not shrunk" );
+    ASSERT( int(table.size())==n/16, NULL );
+    int count = 0;
+    for( IntTable::iterator it = table.begin(); it != table.end(); ++it, ++count )
+        ASSERT( it->first < n/16 && it->first==it->second, NULL );
+    ASSERT( count==n/16, "items are lost by shrinking" );
+    table.rehash(); // the buckets left by shrinking are already deallocated
+    ASSERT( int(table.size())==n/16, NULL );
+    table.clear();
+
+    Harness::SpinBarrier barrier( nthread );
+    NativeParallelFor( nthread, ShrinkGrowBody(table, barrier, nthread, n) );
+    ASSERT( int(table.size())==n, NULL );
+    count = 0;
+    for( IntTable::const_iterator it = table.begin(); it != table.end(); ++it, ++count )
+        ASSERT( it->first==it->second, NULL );
+    ASSERT( count==n, "items are lost by shrinking" );
+    IntTable copy( table );
+    ASSERT( copy==table, NULL );
+}
+
+//! Counts the bytes of the arrays of more than one element, which are the bucket segments of a table
+static tbb::atomic<ptrdiff_t> BucketBytes;
+
+template<typename T>
+class bucket_bytes_allocator : public tbb::tbb_allocator<T> {
+    typedef tbb::tbb_allocator<T> base_type;
+public:
+    typedef typename base_type::pointer pointer;
+    typedef typename base_type::size_type size_type;
+    template<typename U> struct rebind {
+        typedef bucket_bytes_allocator<U> other;
+    };
+    bucket_bytes_allocator() {}
+    template<typename U> bucket_bytes_allocator( const bucket_bytes_allocator<U>& ) {}
+    pointer allocate( size_type n, const void* = NULL ) {
+        if( n > 1 ) BucketBytes += n*sizeof(T);
+        return base_type::allocate( n );
+    }
+    void deallocate( pointer p, size_type n ) {
+        if( n > 1 ) BucketBytes -= n*sizeof(T);
+        base_type::deallocate( p, n );
+    }
+};
+
+typedef tbb::concurrent_hash_map<int,int,tbb::tbb_hash_compare<int>,bucket_bytes_allocator<std::pair<const int,int> > > BucketBytesTable;
+
+class EraseBody: NoAssign {
+    BucketBytesTable& my_table;
+    const int my_nthread;
+    const int my_n;
+public:
+    EraseBody( BucketBytesTable& table, int nthread, int n ) : my_table(table), my_nthread(nthread), my_n(n) {}
+    void operator()( int k ) const {
+        for( int i=k; i<my_n; i+=my_nthread )
+            if( i >= my_n/16 )
+                ASSERT( my_table.erase( i ), NULL );
+    }
+};
+
+//! Test that the bucket segments merged by a concurrent shrink are deallocated without rehash().
+void TestShrinkDeallocation( int nthread ) {
+    REMARK("testing deallocation of shrunk buckets with %d threads\n", nthread);
+    const int n = 100000;
+    BucketBytes = 0;
+    {
+        BucketBytesTable table;
+        table.min_load_factor( 0.25f );
+        for( int i=0; i<n; ++i )
+            table.insert( std::make_pair(i, i) );
+        const ptrdiff_t peak_bytes = BucketBytes;
+        const BucketBytesTable::size_type peak_buckets = table.bucket_count();
+        NativeParallelFor( nthread, EraseBody(table, nthread, n) );
+        ASSERT( int(table.size())==n/16, NULL );
+        // the last shrink can start after the last erasure, and each lookup merges a few of its buckets
+        for( int k=0; k<4; ++k )
+            for( int i=0; i<n/16; ++i )
+                ASSERT( table.count( i ), "item is lost by shrinking" );
+        ASSERT( table.bucket_count() <= peak_buckets/2, "the table is not shrunk" );
+        ASSERT( BucketBytes/double(table.bucket_count()) <= peak_bytes/double(peak_buckets),
+                "the buckets merged by shrinking are not deallocated" );
+    }
+    ASSERT( BucketBytes==0, "the buckets are leaked" );
+}
+
+#include <vector>
+
+class BatchBody: NoAssign {
+    IntTable& my_table;
+    Harness::SpinBarrier& my_barrier;
+    const int my_nthread;
+    const int my_n;
+public:
+    BatchBody( IntTable& table, Harness::SpinBarrier& barrier, int nthread, int n )
+        : my_table(table), my_barrier(barrier), my_nthread(nthread), my_n(n) {}
+    void operator()( int k ) const {
+        std::vector<std::pair<int,int> > items;
+        for( int i=k; i<my_n; i+=my_nthread )
+            items.push_back( std::make_pair(i, i) );
+        my_table.insert( items.begin(), items.end() );
+        my_barrier.wait();
+        // look up the items of the other thread mixed with the absent keys
+        std::vector<int> keys;
+        for( int i=(k+1)%my_nthread; i<my_n; i+=my_nthread ) {
+            keys.push_back( i );
+            keys.push_back( my_n+i );
+        }
+        std::vector<int> values;
+        std::vector<bool> found;
+        IntTable::size_type count = my_table.find_batch( keys.begin(), keys.end(), std::back_inserter(values), std::back_inserter(found) );
+        ASSERT( count==keys.size()/2 && values.size()==count && found.size()==keys.size(), NULL );
+        for( size_t i=0; i<keys.size(); ++i )
+            ASSERT( found[i]==(keys[i]<my_n) && (!found[i] || values[i/2]==keys[i]), "wrong result of find_batch" );
+        my_barrier.wait();
+        // erase the odd keys while the even ones are looked up
+        keys.clear();
+        for( int i=k; i<my_n; i+=my_nthread )
+            if( i&1 ) keys.push_back( i );
+        ASSERT( my_table.erase_batch( keys.begin(), keys.end() )==keys.size(), NULL );
+        ASSERT( my_table.erase_batch( keys.begin(), keys.end() )==0, "the items are erased twice" );
+        for( int i=k&~1; i<my_n; i+=2*my_nthread )
+            ASSERT( my_table.count( i ), "the item is lost by erase_batch" );
+    }
+};
+
+//! Test for the batch operations.
+void TestBatch( int nthread ) {
+    REMARK("testing batch operations with %d threads\n", nthread);
+    const int n = 100000;
+    IntTable table;
+    table.min_load_factor( 0.25f ); // the table shrinks while the items are erased
+    Harness::SpinBarrier barrier( nthread );
+    NativeParallelFor( nthread, BatchBody(table, barrier, nthread, n) );
+    ASSERT( int(table.size())==n/2, NULL );
+    for( IntTable::const_iterator it = table.begin(); it != table.end(); ++it )
+        ASSERT( !(it->first&1) && it->first==it->second, NULL );
+
+    // the batch insertion of the existing keys does not change them
+    const std::pair<int,int> items[] = { std::make_pair(0, 1), std::make_pair(1, 1), std::make_pair(1, 2) };
+    table.insert( items, items+3 );
+    IntTable::const_accessor a;
+    ASSERT( table.find( a, 0 ) && a->second==0 && table.find( a, 1 ) && a->second==1, NULL );
+    ASSERT( int(table.size())==n/2+1, NULL );
+}
+
 void TestTypes() {
     AssertSameType( static_cast<MyTable::key_type*>(0), static_cast<MyKey*>(0) );
     AssertSameType( static_cast<MyTable::mapped_type*>(0), static_cast<MyData*>(0) );
@@ -1688,6 +1886,9 @@ int TestMain () {
         tbb::task_scheduler_init init( nthread );
         TestInsertFindErase( nthread );
         TestConcurrency( nthread );
+        TestShrink( nthread );
+        TestShrinkDeallocation( nthread );
+        TestBatch( nthread );
     }
     // check linking
     if(bad_hashing) { //should be false
@@ -0,0 +1,219 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#define TBB_PREVIEW_CONCURRENT_RING_QUEUE 1
+#include "tbb/concurrent_ring_queue.h"
+#include "tbb/atomic.h"
+#include "tbb/tick_count.h"
+#include "harness.h"
+#include "harness_barrier.h"
+#include <vector>
+
+//! Counts the live instances and throws from the copy constructor on demand
+class Item {
+    long my_value;
+public:
+    static tbb::atomic<long> live, throw_countdown;
+    Item( long v = 0 ) : my_value(v) { ++live; }
+    Item( const Item& other ) : my_value(other.my_value) {
+        if( throw_countdown > 0 && --throw_countdown == 0 )
+            throw std::bad_alloc();
+        ++live;
+    }
+    ~Item() { --live; }
+    Item& operator=( const Item& other ) { my_value = other.my_value; return *this; }
+    long value() const { return my_value; }
+};
+
+tbb::atomic<long> Item::live, Item::throw_countdown;
+
+typedef tbb::concurrent_ring_queue<Item> ItemQueue;
+
+void TestSerial() {
+    REMARK("testing serial operations\n");
+    {
+        ItemQueue q( 5 );
+        ASSERT( q.capacity() == 8 && q.empty(), "the capacity is rounded up to a power of two" );
+        for( long i = 0; i < 8; ++i )
+            ASSERT( q.try_push( Item(i) ), NULL );
+        ASSERT( !q.try_push( Item(8) ) && q.size() == 8, "the queue is full" );
+        Item item;
+        for( long i = 0; i < 5; ++i )
+            ASSERT( q.try_pop( item ) && item.value() == i, "wrong order of items" );
+        ASSERT( q.size() == 3, NULL );
+
+        // the batch wraps around the end of the ring and is truncated by the capacity
+        std::vector<Item> batch;
+        for( long i = 8; i < 16; ++i )
+            batch.push_back( Item(i) );
+        ASSERT( q.try_push_n( batch.begin(), batch.size() ) == 5, NULL );
+        ASSERT( q.try_push_n( batch.begin()+5, 3 ) == 0, "the queue is full" );
+        std::vector<Item> out;
+        ASSERT( q.try_pop_n( std::back_inserter( out ), 6 ) == 6 && out.size() == 6, NULL );
+        for( long i = 0; i < 6; ++i )
+            ASSERT( out[i].value() == i+5, "wrong order of items" );
+        ASSERT( q.size() == 2, NULL );
+        out.clear();
+        ASSERT( q.try_pop_n( std::back_inserter( out ), 10 ) == 2 && out[1].value() == 12, NULL );
+        ASSERT( q.empty() && !q.try_pop( item ) && !q.try_pop_n( std::back_inserter( out ), 1 ), NULL );
+
+        q.push( Item(100) );
+        q.push( Item(101) );
+    }
+    ASSERT( Item::live == 0, "the destructor of the queue should destroy the items" );
+}
+
+void TestExceptions() {
+#if TBB_USE_EXCEPTIONS && !__TBB_THROW_ACROSS_MODULE_BOUNDARY_BROKEN
+    REMARK("testing exceptions\n");
+    {
+        ItemQueue q( 8 );
+        Item item( 1 );
+        Item::throw_countdown = 1;
+        bool caught = false;
+        try {
+            q.push( item );
+        } catch( std::bad_alloc& ) {
+            caught = true;
+        }
+        ASSERT( caught, NULL );
+        std::vector<Item> batch( 4, Item(2) );
+        Item::throw_countdown = 3;
+        caught = false;
+        try {
+            q.try_push_n( batch.begin(), batch.size() );
+        } catch( std::bad_alloc& ) {
+            caught = true;
+        }
+        ASSERT( caught && q.size() == 5, "the positions of failed items are still taken" );
+        ASSERT( q.try_push( Item(3) ), NULL );
+        std::vector<Item> out;
+        ASSERT( q.try_pop_n( std::back_inserter( out ), 8 ) == 3, "the failed items should be skipped" );
+        ASSERT( out[0].value() == 2 && out[1].value() == 2 && out[2].value() == 3, NULL );
+        ASSERT( q.empty(), NULL );
+    }
+    ASSERT( Item::live == 0, NULL );
+#endif /* TBB_USE_EXCEPTIONS && !__TBB_THROW_ACROSS_MODULE_BOUNDARY_BROKEN */
+}
+
+const long N = 100000;
+
+//! Half of the threads push, the other half pop, by single items and by batches
+class ProducerConsumerBody: NoAssign {
+    ItemQueue& my_queue;
+    const int my_nthread;
+    tbb::atomic<long>& my_sum;
+public:
+    ProducerConsumerBody( ItemQueue& q, int nthread, tbb::atomic<long>& sum )
+        : my_queue(q), my_nthread(nthread), my_sum(sum) {}
+    void operator()( int k ) const {
+        const int nproducer = my_nthread/2;
+        const long n = N/nproducer;
+        std::vector<Item> batch;
+        if( k < nproducer ) {
+            for( long i = 0; i < n; ) {
+                if( k % 2 ) {
+                    my_queue.push( Item(i++) );
+                } else {
+                    batch.clear();
+                    for( long j = i; j < n && j < i+7; ++j )
+                        batch.push_back( Item(j) );
+                    std::vector<Item>::iterator it = batch.begin();
+                    while( it != batch.end() ) {
+                        size_t m = my_queue.try_push_n( it, batch.end()-it );
+                        if( !m ) __TBB_Yield();
+                        it += m;
+                    }
+                    i += long(batch.size());
+                }
+            }
+        } else {
+            const int nconsumer = my_nthread-nproducer;
+            long count = n*nproducer/nconsumer + (k == my_nthread-1 ? n*nproducer%nconsumer : 0);
+            long sum = 0;
+            Item item;
+            while( count > 0 ) {
+                if( k % 2 ) {
+                    my_queue.pop( item );
+                    sum += item.value();
+                    --count;
+                } else {
+                    batch.clear();
+                    size_t m = my_queue.try_pop_n( std::back_inserter( batch ), count < 5 ? count : 5 );
+                    for( size_t j = 0; j < m; ++j )
+                        sum += batch[j].value();
+                    count -= long(m);
+                }
+            }
+            my_sum += sum;
+        }
+    }
+};
+
+//! Threads wait on an empty queue until abort()
+class AbortBody: NoAssign {
+    ItemQueue& my_queue;
+    Harness::SpinBarrier& my_barrier;
+    tbb::atomic<int>& my_aborted;
+public:
+    AbortBody( ItemQueue& q, Harness::SpinBarrier& barrier, tbb::atomic<int>& aborted )
+        : my_queue(q), my_barrier(barrier), my_aborted(aborted) {}
+    void operator()( int k ) const {
+        my_barrier.wait();
+        if( k == 0 ) {
+            Harness::Sleep( 50 );
+            my_queue.abort();
+        } else {
+            try {
+                Item item;
+                my_queue.pop( item );
+            } catch( tbb::user_abort& ) {
+                ++my_aborted;
+            }
+        }
+    }
+};
+
+void TestConcurrency( int nthread ) {
+    REMARK("testing concurrent operations with %d threads\n", nthread);
+    {
+        // the small capacity makes the producers block
+        ItemQueue q( 16 );
+        tbb::atomic<long> sum; sum = 0;
+        NativeParallelFor( nthread, ProducerConsumerBody( q, nthread, sum ) );
+        const long n = N/(nthread/2);
+        ASSERT( q.empty() && sum == (nthread/2)*(n*(n-1)/2), "items are lost or duplicated" );
+    }
+#if TBB_USE_EXCEPTIONS && !__TBB_THROW_ACROSS_MODULE_BOUNDARY_BROKEN
+    {
+        ItemQueue q( 4 );
+        Harness::SpinBarrier barrier( nthread );
+        tbb::atomic<int> aborted; aborted = 0;
+        NativeParallelFor( nthread, AbortBody( q, barrier, aborted ) );
+        ASSERT( aborted == nthread-1, "blocked threads are not aborted" );
+    }
+#endif
+    ASSERT( Item::live == 0, NULL );
+}
+
+int TestMain () {
+    if( MinThread<2 ) MinThread=2;
+    TestSerial();
+    TestExceptions();
+    for( int nthread=MinThread; nthread<=MaxThread; ++nthread )
+        TestConcurrency( nthread );
+    return Harness::Done;
+}
@@ -742,6 +742,77 @@ void TestConcurrentGrowBy( int nthread ) {
     ASSERT( allocations == frees, NULL);
 }
 
+template<typename MyVector>
+class GrowContiguous: NoAssign {
+    MyVector& my_vector;
+public:
+    GrowContiguous( MyVector& v ) : my_vector(v) {}
+    void operator()( const tbb::blocked_range<size_t>& r ) const {
+        // grow by the whole range or by single items to mix both kinds of growth
+        if( r.begin() % 2 ) {
+            typename MyVector::iterator it = my_vector.grow_by( r.size() );
+            for( size_t i = r.begin(); i != r.end(); ++i, ++it )
+                *it = int(i);
+        } else {
+            for( size_t i = r.begin(); i != r.end(); ++i )
+                my_vector.push_back( int(i) );
+        }
+    }
+};
+
+//! Test the vector with the contiguous storage
+void TestContiguous( int nthread ) {
+    REMARK("testing contiguous storage with %d threads\n", nthread);
+    typedef static_counting_allocator<debug_allocator<int>, std::size_t> MyAllocator;
+    typedef tbb::concurrent_vector<int, MyAllocator> MyVector;
+    MyAllocator::init_counters();
+    {
+        const size_t n = 100000;
+        MyVector v( tbb::contiguous_reserve(), n );
+        ASSERT( v.empty() && v.data() && v.max_size() >= n, NULL );
+        const int *data = v.data();
+        tbb::parallel_for( tbb::blocked_range<size_t>(0, n, 7), GrowContiguous<MyVector>( v ) );
+        ASSERT( v.size() == n && v.data() == data, "items are not in the reserved storage" );
+        std::vector<bool> found( n, false );
+        for( size_t i = 0; i < n; ++i ) {
+            ASSERT( &v[i] == data + i, "the storage is not contiguous" );
+            ASSERT( size_t(data[i]) < n && !found[data[i]], NULL );
+            found[data[i]] = true;
+        }
+        v.shrink_to_fit();
+        ASSERT( v.data() == data && v.size() == n, NULL );
+
+        MyVector copy( v );
+        ASSERT( !copy.data() && copy == v, "a copy should have the segmented storage" );
+        MyVector other;
+        other.swap( v );
+        ASSERT( !v.data() && v.empty() && other.data() == data && other.size() == n, NULL );
+        other.clear();
+        v.swap( other );
+        ASSERT( v.data() == data && !other.data(), "an empty vector should keep the storage on swap" );
+        v.resize( n );
+        ASSERT( v.data() == data && v.size() == n, NULL );
+#if TBB_USE_EXCEPTIONS && !__TBB_THROW_ACROSS_MODULE_BOUNDARY_BROKEN
+        bool caught = false;
+        try {
+            v.reserve( v.max_size() + 1 );
+        } catch( std::length_error& ) {
+            caught = true;
+        }
+        ASSERT( caught && v.data() == data, "reservation beyond the contiguous storage" );
+        caught = false;
+        try {
+            v.grow_by( v.max_size() );
+        } catch( std::bad_alloc& ) {
+            caught = true;
+        }
+        ASSERT( caught, "growth beyond the contiguous storage" );
+#endif /* TBB_USE_EXCEPTIONS && !__TBB_THROW_ACROSS_MODULE_BOUNDARY_BROKEN */
+    }
+    ASSERT( MyAllocator::items_allocated == MyAllocator::items_freed, NULL );
+    ASSERT( MyAllocator::allocations == MyAllocator::frees, NULL );
+}
+
 template <typename Vector>
 void test_grow_by_empty_range( Vector &v, typename Vector::value_type* range_begin_end ) {
     const Vector v_copy = v;
@@ -1832,6 +1903,7 @@ int TestMain () {
         TestParallelFor( nthread );
         TestConcurrentGrowToAtLeast();
         TestConcurrentGrowBy( nthread );
+        TestContiguous( nthread );
     }
     ASSERT( !FooCount, NULL );
     TestComparison();
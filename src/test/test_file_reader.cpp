@@ -0,0 +1,187 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#define TBB_PREVIEW_FILE_READER 1
+#include "tbb/file_reader.h"
+#include "tbb/pipeline.h"
+#include "tbb/atomic.h"
+#include "tbb/task_scheduler_init.h"
+#include "harness.h"
+#include <cstdio>
+#include <string>
+
+#if !__TBB_WIN8UI_SUPPORT
+
+static const char* FileName = "test_file_reader.txt";
+
+//! Writes the records with the lengths 0, 1, ..., max_length-1 repeated, and returns the content
+std::string WriteFile( long nrecord, long max_length, bool final_delimiter ) {
+    std::string content;
+    for( long i = 0; i < nrecord; ++i ) {
+        content.append( size_t(i % max_length), char('a' + i % 26) );
+        if( i < nrecord-1 || final_delimiter )
+            content += '\n';
+    }
+    FILE* f = std::fopen( FileName, "wb" );
+    ASSERT( f, "cannot create the input file" );
+    ASSERT( std::fwrite( content.data(), 1, content.size(), f ) == content.size(), NULL );
+    std::fclose( f );
+    return content;
+}
+
+//! Checks the records of a chunk; the first record of the chunk has the given number
+struct CheckRecord {
+    long* my_index;
+    long my_max_length;
+    void operator()( const char* first, const char* last ) const {
+        long i = (*my_index)++;
+        ASSERT( last-first == i % my_max_length, "wrong record length" );
+        for( const char* p = first; p != last; ++p )
+            ASSERT( *p == char('a' + i % 26), "wrong record content" );
+    }
+};
+
+//! Counts the records in a chunk and the bytes in the chunks
+class CountBody {
+    tbb::atomic<long>* my_bytes;
+public:
+    CountBody( tbb::atomic<long>& bytes ) : my_bytes(&bytes) {}
+    tbb::file_chunk operator()( tbb::file_chunk c ) const {
+        *my_bytes += long( c.size() );
+        return c;
+    }
+};
+
+//! Checks that the chunks are contiguous, consist of whole records and have the expected records
+class CheckBody {
+    const std::string* my_content;
+    size_t* my_offset;
+    long* my_index;
+    long my_max_length;
+    size_t my_chunk_size;
+public:
+    CheckBody( const std::string& content, size_t& offset, long& index, long max_length, size_t chunk_size )
+        : my_content(&content), my_offset(&offset), my_index(&index), my_max_length(max_length), my_chunk_size(chunk_size) {}
+    void operator()( tbb::file_chunk c ) const {
+        ASSERT( c.offset() == *my_offset, "the chunks are not contiguous" );
+        ASSERT( !c.empty() && c.offset()+c.size() <= my_content->size(), NULL );
+        ASSERT( my_content->compare( size_t(c.offset()), c.size(), c.data(), c.size() ) == 0, "wrong chunk content" );
+        *my_offset += c.size();
+        if( *my_offset != my_content->size() )
+            ASSERT( c.data()[c.size()-1] == '\n', "the chunk does not end at a delimiter" );
+        // a chunk is longer than chunk_size only if it has a single record
+        if( c.size() > my_chunk_size )
+            ASSERT( std::memchr( c.data(), '\n', c.size()-1 ) == NULL, "the chunk is too long" );
+        CheckRecord check = { my_index, my_max_length };
+        c.for_each_record( '\n', check );
+    }
+};
+
+void TestReader( long nrecord, long max_length, bool final_delimiter, size_t chunk_size,
+                 tbb::file_reader::io_mode mode, int ntoken ) {
+    const std::string content = WriteFile( nrecord, max_length, final_delimiter );
+    {
+        tbb::file_reader reader( FileName, '\n', chunk_size, mode );
+        ASSERT( reader.file_size() == content.size(), NULL );
+        ASSERT( mode == tbb::file_reader::automatic || reader.mode() == mode, NULL );
+        tbb::atomic<long> bytes; bytes = 0;
+        size_t offset = 0;
+        long index = 0;
+        tbb::parallel_pipeline( ntoken,
+            reader.make_input_filter() &
+            tbb::make_filter<tbb::file_chunk,tbb::file_chunk>( tbb::filter::parallel, CountBody( bytes ) ) &
+            tbb::make_filter<tbb::file_chunk,void>( tbb::filter::serial_in_order,
+                CheckBody( content, offset, index, max_length, chunk_size ) ) );
+        ASSERT( size_t(bytes) == content.size() && offset == content.size(), "the file is not read completely" );
+        ASSERT( index == (content.empty() ? 0 : nrecord), "wrong number of records" );
+        // the buffers are reused; one more is held by the reader and by the pipeline end
+        ASSERT( reader.buffer_count() <= size_t(ntoken)+2, "the buffers are not reused" );
+        tbb::file_chunk c;
+        ASSERT( !reader.read( c ) && c.empty(), "read after the end of the file" );
+    }
+    std::remove( FileName );
+}
+
+void TestChunkLifetime() {
+    REMARK("testing the lifetime of chunks\n");
+    WriteFile( 1000, 10, true );
+    {
+        tbb::file_reader reader( FileName, '\n', 64, tbb::file_reader::positional_read );
+        tbb::file_chunk a, b;
+        ASSERT( reader.read( a ) && reader.read( b ), NULL );
+        const char* data = a.data();
+        tbb::file_chunk copy( a );
+        a.release();
+        ASSERT( a.empty() && copy.data() == data, "the copy of a chunk does not keep its buffer" );
+        copy = b;
+        // the buffers of the released chunks are reused by the next reads
+        tbb::file_chunk c;
+        ASSERT( reader.read( c ), NULL );
+        size_t n = reader.buffer_count();
+        for( int i = 0; i < 20; ++i ) {
+            c.release();
+            ASSERT( reader.read( c ) && reader.buffer_count() == n, "the buffers are not reused" );
+        }
+    }
+    std::remove( FileName );
+}
+
+void TestErrors() {
+#if TBB_USE_EXCEPTIONS
+    REMARK("testing errors\n");
+    std::remove( FileName );
+    bool caught = false;
+    try {
+        tbb::file_reader reader( FileName );
+    } catch( std::runtime_error& ) {
+        caught = true;
+    }
+    ASSERT( caught, "no exception for a missing file" );
+#endif
+}
+
+int TestMain () {
+    const tbb::file_reader::io_mode modes[] = {
+        tbb::file_reader::automatic, tbb::file_reader::memory_map, tbb::file_reader::positional_read
+    };
+    for( int nthread = MinThread; nthread <= MaxThread; ++nthread ) {
+        tbb::task_scheduler_init init( nthread );
+        for( int m = 0; m < 3; ++m ) {
+            REMARK("testing mode %d with %d threads\n", m, nthread);
+            TestReader( 0, 1, true, 100, modes[m], 4 );
+            TestReader( 2, 2, false, 100, modes[m], 4 );
+            TestReader( 20000, 50, true, 1000, modes[m], 4*nthread );
+            TestReader( 20000, 50, false, 1000, modes[m], 1 );
+            // records longer than the chunks
+            TestReader( 3000, 700, true, 256, modes[m], 4*nthread );
+            TestReader( 3000, 700, false, 1, modes[m], 3 );
+            // short records after a record longer than the chunks at the end of the file
+            TestReader( 705, 700, true, 256, modes[m], 3 );
+            TestReader( 705, 700, false, 256, modes[m], 3 );
+        }
+    }
+    TestChunkLifetime();
+    TestErrors();
+    return Harness::Done;
+}
+
+#else /* __TBB_WIN8UI_SUPPORT */
+
+int TestMain () {
+    return Harness::Skipped;
+}
+
+#endif /* __TBB_WIN8UI_SUPPORT */
@@ -0,0 +1,234 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#define TBB_PREVIEW_FLOW_GRAPH_PROFILER 1
+#define TBB_PREVIEW_FLOW_GRAPH_TRACE 1
+
+#include "harness.h"
+#include "harness_graph.h"
+
+#include "tbb/flow_graph.h"
+#include "tbb/task_scheduler_init.h"
+
+#include <sstream>
+#include <string>
+
+using tbb::flow::graph_profiler;
+
+static const int N = 20;
+
+struct pass_body {
+    int operator()( int v ) const { return v; }
+};
+
+struct sleep_body {
+    int operator()( int v ) const { Harness::Sleep( 2 ); return v; }
+};
+
+struct split_body {
+    typedef tbb::flow::multifunction_node< int, tbb::flow::tuple<int, int> > node_type;
+    void operator()( int v, node_type::output_ports_type &ports ) const {
+        if ( v % 2 )
+            tbb::flow::get<1>( ports ).try_put( v );
+        else
+            tbb::flow::get<0>( ports ).try_put( v );
+    }
+};
+
+size_t index_of( const graph_profiler::report &r, const char *name ) {
+    const graph_profiler::node_statistics *n = r.find( name );
+    ASSERT( n, "the node was not profiled" );
+    return n - &r.nodes()[0];
+}
+
+size_t edge_messages( const graph_profiler::report &r, const char *from, const char *to ) {
+    const size_t i = index_of( r, from ), j = index_of( r, to );
+    for ( size_t k = 0; k < r.edges().size(); ++k )
+        if ( r.edges()[k].from == i && r.edges()[k].to == j )
+            return r.edges()[k].messages;
+    return 0;
+}
+
+//! The bodies and the edges are counted, and the critical path goes through the slow node
+void test_critical_path() {
+    tbb::flow::graph g;
+    graph_profiler profiler( g );
+    tbb::flow::broadcast_node<int> start( g );
+    tbb::flow::function_node<int, int> fast( g, tbb::flow::unlimited, pass_body() );
+    tbb::flow::function_node<int, int> slow( g, tbb::flow::unlimited, sleep_body() );
+    tbb::flow::queue_node<int> sink( g );
+    start.set_name( "start" );
+    fast.set_name( "fast" );
+    slow.set_name( "slow" );
+    sink.set_name( "sink" );
+    tbb::flow::make_edge( start, fast );
+    tbb::flow::make_edge( start, slow );
+    tbb::flow::make_edge( fast, sink );
+    tbb::flow::make_edge( slow, sink );
+
+    profiler.start();
+    ASSERT( profiler.is_active(), NULL );
+    for ( int i = 0; i < N; ++i )
+        start.try_put( i );
+    g.wait_for_all();
+    profiler.stop();
+    ASSERT( !profiler.is_active(), NULL );
+
+    graph_profiler::report r = profiler.make_report();
+    ASSERT( r.duration() > 0, NULL );
+    ASSERT( r.nodes().size() == 4, "the nodes that took part are reported" );
+    ASSERT( r.find( "fast" )->invocations == size_t(N), NULL );
+    ASSERT( r.find( "slow" )->invocations == size_t(N), NULL );
+    ASSERT( r.find( "slow" )->max_body_time >= 0.002, NULL );
+    ASSERT( r.find( "slow" )->mean_body_time() > r.find( "fast" )->mean_body_time(), NULL );
+    ASSERT( r.find( "sink" )->enqueued == size_t(2*N), NULL );
+    ASSERT( std::string( r.find( "sink" )->type ) == "queue_node", NULL );
+    ASSERT( r.find( static_cast< tbb::flow::sender<int>& >( slow ) ) == r.find( "slow" ), NULL );
+    ASSERT( r.find( "missing" ) == NULL, NULL );
+
+    ASSERT( edge_messages( r, "start", "fast" ) == size_t(N), NULL );
+    ASSERT( edge_messages( r, "start", "slow" ) == size_t(N), NULL );
+    ASSERT( edge_messages( r, "fast", "sink" ) == size_t(N), NULL );
+    ASSERT( edge_messages( r, "slow", "sink" ) == size_t(N), NULL );
+    for ( size_t k = 0; k < r.edges().size(); ++k )
+        ASSERT( r.edges()[k].throughput > 0, NULL );
+
+    const std::vector<size_t> &path = r.critical_path();
+    ASSERT( path.size() == 3, NULL );
+    ASSERT( path[0] == index_of( r, "start" ) && path[1] == index_of( r, "slow" ) && path[2] == index_of( r, "sink" ),
+            "the critical path should go through the slow node" );
+    ASSERT( r.critical_path_length() >= r.find( "slow" )->mean_body_time(), NULL );
+
+    // The messages put after stop() are not counted, and start() resets the counters
+    start.try_put( 0 );
+    g.wait_for_all();
+    ASSERT( profiler.make_report().find( "fast" )->invocations == size_t(N), NULL );
+    profiler.start();
+    start.try_put( 0 );
+    g.wait_for_all();
+    profiler.stop();
+    ASSERT( profiler.make_report().find( "fast" )->invocations == 1, NULL );
+}
+
+//! The messages wait in the queue of a serial node
+void test_queueing_delay() {
+    tbb::flow::graph g;
+    graph_profiler profiler( g );
+    tbb::flow::function_node<int, int> serial( g, tbb::flow::serial, sleep_body() );
+    serial.set_name( "serial" );
+    profiler.start();
+    for ( int i = 0; i < N; ++i )
+        serial.try_put( i );
+    g.wait_for_all();
+    profiler.stop();
+    const graph_profiler::node_statistics *n = profiler.make_report().find( "serial" );
+    ASSERT( n && n->invocations == size_t(N), NULL );
+    ASSERT( n->enqueued > 0 && n->enqueued < size_t(N), "the first message is not queued" );
+    ASSERT( n->mean_queueing_delay() > 0, NULL );
+    ASSERT( n->latency() > n->mean_body_time(), "the latency includes the queueing delay" );
+}
+
+//! A reserving join_node rejects the messages put to it and reserves them
+void test_rejections_and_reservations() {
+    typedef tbb::flow::tuple<int, int> tuple_type;
+    tbb::flow::graph g;
+    graph_profiler profiler( g );
+    tbb::flow::queue_node<int> q0( g ), q1( g );
+    tbb::flow::join_node<tuple_type, tbb::flow::reserving> j( g );
+    tbb::flow::queue_node<tuple_type> out( g );
+    q0.set_name( "q0" );
+    q1.set_name( "q1" );
+    j.set_name( "join" );
+    out.set_name( "out" );
+    tbb::flow::make_edge( q0, tbb::flow::input_port<0>( j ) );
+    tbb::flow::make_edge( q1, tbb::flow::input_port<1>( j ) );
+    tbb::flow::make_edge( j, out );
+    profiler.start();
+    for ( int i = 0; i < N; ++i )
+        q0.try_put( i );
+    g.wait_for_all();
+    for ( int i = 0; i < N; ++i )
+        q1.try_put( i );
+    g.wait_for_all();
+    profiler.stop();
+
+    graph_profiler::report r = profiler.make_report();
+    ASSERT( r.find( "join" )->rejections > 0, NULL );
+    ASSERT( r.find( "join" )->reservations >= size_t(2*N), NULL );
+    ASSERT( edge_messages( r, "q0", "join" ) == size_t(N), NULL );
+    ASSERT( edge_messages( r, "q1", "join" ) == size_t(N), NULL );
+    ASSERT( edge_messages( r, "join", "out" ) == size_t(N), NULL );
+    ASSERT( r.find( tbb::flow::input_port<1>( j ) ) == r.find( "join" ), NULL );
+}
+
+//! The messages put to the output ports of a multifunction_node are counted on its edges
+void test_ports() {
+    tbb::flow::graph g;
+    graph_profiler profiler( g );
+    split_body::node_type split( g, tbb::flow::unlimited, split_body() );
+    tbb::flow::queue_node<int> even( g ), odd( g );
+    split.set_name( "split" );
+    even.set_name( "even" );
+    odd.set_name( "odd" );
+    tbb::flow::make_edge( tbb::flow::output_port<0>( split ), even );
+    tbb::flow::make_edge( tbb::flow::output_port<1>( split ), odd );
+    profiler.start();
+    for ( int i = 0; i < N; ++i )
+        split.try_put( i );
+    g.wait_for_all();
+    profiler.stop();
+
+    graph_profiler::report r = profiler.make_report();
+    ASSERT( r.find( tbb::flow::output_port<1>( split ) ) == r.find( "split" ), NULL );
+    ASSERT( edge_messages( r, "split", "even" ) == size_t(N/2), NULL );
+    ASSERT( edge_messages( r, "split", "odd" ) == size_t(N/2), NULL );
+
+    std::ostringstream dot, json;
+    r.write_dot( dot );
+    r.write_json( json );
+    ASSERT( dot.str().find( "digraph" ) == 0, NULL );
+    ASSERT( dot.str().find( "color=red" ) != std::string::npos, "the critical path is highlighted" );
+    ASSERT( json.str().find( "\"name\": \"split\"" ) != std::string::npos, NULL );
+    ASSERT( json.str().find( "\"critical_path\"" ) != std::string::npos, NULL );
+}
+
+//! A graph that was not profiled has an empty report
+void test_not_started() {
+    tbb::flow::graph g;
+    graph_profiler profiler( g );
+    tbb::flow::function_node<int, int> f( g, tbb::flow::unlimited, pass_body() );
+    f.try_put( 0 );
+    g.wait_for_all();
+    graph_profiler::report r = profiler.make_report();
+    ASSERT( r.nodes().empty() && r.edges().empty() && r.critical_path().empty(), NULL );
+    ASSERT( r.duration() == 0, NULL );
+}
+
+int TestMain() {
+    if( MinThread<1 ) {
+        REPORT("number of threads must be positive\n");
+        exit(1);
+    }
+    test_not_started();
+    for( int p=MinThread; p<=MaxThread; ++p ) {
+        tbb::task_scheduler_init init(p);
+        test_critical_path();
+        test_queueing_delay();
+        test_rejections_and_reservations();
+        test_ports();
+    }
+    return Harness::Done;
+}
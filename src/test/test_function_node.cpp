@@ -456,6 +456,73 @@ void test_function_node_with_continue_msg_as_input() {
     g.wait_for_all();
 }
 
+//! Checks that the bodies that run for the batches do not exceed the concurrency limit
+struct batch_body {
+    tbb::atomic<size_t> *my_running;
+    size_t my_limit;
+    batch_body( tbb::atomic<size_t> &running, size_t limit ) : my_running(&running), my_limit(limit) {}
+    int operator()( int v ) const {
+        size_t r = ++*my_running;
+        ASSERT( my_limit == tbb::flow::unlimited || r <= my_limit, "too many bodies run for the batches" );
+        --*my_running;
+        return v;
+    }
+};
+
+const int batch_size = 10;
+
+template< typename Node >
+struct parallel_put_batches : NoAssign {
+    Node &my_node;
+    parallel_put_batches( Node &n ) : my_node(n) {}
+    void operator()( int i ) const {
+        int items[batch_size];
+        for ( int k = 0; k < batch_size; ++k ) items[k] = i*batch_size + k;
+        ASSERT( my_node.try_put_batch( items, batch_size ) == size_t(batch_size), "the batch was not accepted" );
+    }
+};
+
+//! Puts batches in parallel to a node that does not reject and checks that every output arrives once
+template< typename Policy >
+void test_try_put_batch( size_t concurrency, int num_threads ) {
+    tbb::flow::graph g;
+    tbb::atomic<size_t> running;
+    running = 0;
+    tbb::flow::function_node< int, int, Policy > f( g, concurrency, batch_body( running, concurrency ) );
+    tbb::flow::queue_node<int> q( g );
+    tbb::flow::make_edge( f, q );
+    NativeParallelFor( num_threads, parallel_put_batches< tbb::flow::function_node< int, int, Policy > >( f ) );
+    g.wait_for_all();
+    std::vector<bool> seen( num_threads*batch_size );
+    int j, count = 0;
+    while ( q.try_get( j ) ) {
+        ASSERT( 0 <= j && j < num_threads*batch_size && !seen[j], "unexpected or duplicate output" );
+        seen[j] = true;
+        ++count;
+    }
+    ASSERT( count == num_threads*batch_size, "missing outputs" );
+}
+
+//! A rejecting node takes a whole batch when it is idle
+void test_try_put_batch_rejecting() {
+    tbb::flow::graph g;
+    tbb::atomic<size_t> running;
+    running = 0;
+    tbb::flow::function_node< int, int, tbb::flow::rejecting > f( g, tbb::flow::serial, batch_body( running, tbb::flow::serial ) );
+    tbb::flow::queue_node<int> q( g );
+    tbb::flow::make_edge( f, q );
+    int items[batch_size];
+    for ( int i = 0; i < 5; ++i ) {
+        for ( int k = 0; k < batch_size; ++k ) items[k] = i*batch_size + k;
+        ASSERT( f.try_put_batch( items, batch_size ) == size_t(batch_size), "an idle rejecting node should accept the batch" );
+        g.wait_for_all();
+    }
+    int j;
+    for ( int i = 0; i < 5*batch_size; ++i )
+        ASSERT( q.try_get( j ) && j == i, "missing or out of order output" );
+    ASSERT( f.try_put_batch( items, 0 ) == 0, NULL );
+}
+
 //! Tests limited concurrency cases for nodes that accept data messages
 void test_concurrency(int num_threads) {
     tbb::task_scheduler_init init(num_threads);
@@ -469,6 +536,11 @@ void test_concurrency(int num_threads) {
     run_unlimited_concurrency<int,tbb::flow::continue_msg>();
     run_unlimited_concurrency<empty_no_assign,tbb::flow::continue_msg>();
     test_function_node_with_continue_msg_as_input();
+    test_try_put_batch<tbb::flow::queueing>( tbb::flow::unlimited, num_threads );
+    test_try_put_batch<tbb::flow::queueing>( tbb::flow::serial, num_threads );
+    test_try_put_batch<tbb::flow::queueing>( 2, num_threads );
+    test_try_put_batch<tbb::flow::queueing_lightweight>( tbb::flow::serial, num_threads );
+    test_try_put_batch_rejecting();
 }
 
 #if TBB_DEPRECATED_FLOW_NODE_EXTRACTION
@@ -753,6 +753,43 @@ void TestForgottenEnqueuedTasks()
 }
 #endif
 
+#include "tbb/task_arena.h"
+
+struct NumaStealingBody : NoAssign {
+    tbb::atomic<int>& my_sum;
+    NumaStealingBody( tbb::atomic<int>& sum ) : my_sum(sum) {}
+    void operator()() const {
+        tbb::parallel_for(0, 1000, *this, tbb::simple_partitioner());
+    }
+    void operator()( int i ) const {
+        my_sum += i;
+    }
+};
+
+// NUMA-aware stealing is a hint: it must not change the results,
+// also when there is a single NUMA node or the topology is unknown.
+void TestNumaAwareStealing()
+{
+    ASSERT(0 == tbb::global_control::active_value(tbb::global_control::numa_aware_stealing), NULL);
+    {
+        tbb::global_control c(tbb::global_control::numa_aware_stealing, 1);
+        ASSERT(1 == tbb::global_control::active_value(tbb::global_control::numa_aware_stealing), NULL);
+        {
+            tbb::global_control c1(tbb::global_control::numa_aware_stealing, 0);
+            ASSERT(1 == tbb::global_control::active_value(tbb::global_control::numa_aware_stealing),
+                   "Any active control enables NUMA-aware stealing");
+        }
+        for (int p = 1; p <= 4; ++p) {
+            tbb::task_arena a(p);
+            tbb::atomic<int> sum;
+            sum = 0;
+            a.execute(NumaStealingBody(sum));
+            ASSERT(sum == 1000*999/2, NULL);
+        }
+    }
+    ASSERT(0 == tbb::global_control::active_value(tbb::global_control::numa_aware_stealing), NULL);
+}
+
 int TestMain()
 {
     TestTaskEnqueue();
@@ -778,6 +815,7 @@ int TestMain()
     TestConcurrentSetUseConcurrency();
     TestInvalidParallelism();
     TestAutoInit(); // auto-initialization done at this point
+    TestNumaAwareStealing();
 
     size_t default_ss = tbb::global_control::active_value(tbb::global_control::thread_stack_size);
     ASSERT(default_ss, NULL);
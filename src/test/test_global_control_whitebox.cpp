@@ -66,6 +66,127 @@ void TestWorkersSleep() {
     RunAndCheckSleeping();
 }
 
+#include "tbb/task.h"
+#include "tbb/task_arena.h"
+#include "harness_barrier.h"
+
+// Fake TBBbind entry points. They resolve the weak symbols of the injected scheduler,
+// so that the threads are spread round-robin over two NUMA nodes.
+tbb::atomic<int> numaNodeQueries;
+
+namespace tbb {
+namespace internal {
+extern "C" {
+    void initialize_numa_topology( size_t, int& nodes_count, int*& indexes_list, int*& concurrency_list ) {
+        static int indexes[2] = { 0, 1 };
+        static int concurrency[2];
+        concurrency[0] = concurrency[1] = max(1, tbb::task_scheduler_init::default_num_threads()/2);
+        nodes_count = 2;
+        indexes_list = indexes;
+        concurrency_list = concurrency;
+    }
+    binding_handler* allocate_binding_handler( int ) { return NULL; }
+    void deallocate_binding_handler( binding_handler* ) {}
+    void bind_to_node( binding_handler*, int, int ) {}
+    void restore_affinity( binding_handler*, int ) {}
+    int current_numa_node() { return numaNodeQueries++ % 2; }
+}
+} // namespace internal
+} // namespace tbb
+
+struct StealCounters {
+    tbb::atomic<int> local, remote;
+};
+
+int CurrentNumaNode() {
+    return tbb::internal::governor::local_scheduler_if_initialized()->my_numa_node;
+}
+
+// Counts the steals of itself: a task executed outside of the slot it was spawned in
+// has been stolen, and the steal is local if both threads are on the same NUMA node.
+class NumaStealingTask : public tbb::task {
+    int my_owner;
+    int my_owner_node;
+    StealCounters& my_counters;
+    tbb::task* execute() __TBB_override {
+        if( tbb::this_task_arena::current_thread_index() != my_owner )
+            ++(CurrentNumaNode() == my_owner_node ? my_counters.local : my_counters.remote);
+        for( volatile int i = 0; i < 20000; ++i ) {}
+        return NULL;
+    }
+public:
+    NumaStealingTask( int owner, int owner_node, StealCounters& counters )
+        : my_owner(owner), my_owner_node(owner_node), my_counters(counters) {}
+};
+
+// Each thread fills its task pool, and the threads that run out of tasks steal from the others.
+struct NumaStealingBody : NoAssign {
+    bool my_numa_aware;
+    Harness::SpinBarrier& my_barrier;
+    StealCounters& my_counters;
+    NumaStealingBody( bool numa_aware, Harness::SpinBarrier& barrier, StealCounters& counters )
+        : my_numa_aware(numa_aware), my_barrier(barrier), my_counters(counters) {}
+    void operator()( int ) const {
+        tbb::internal::generic_scheduler* s = tbb::internal::governor::local_scheduler_if_initialized();
+        if( my_numa_aware )
+            ASSERT(s->my_numa_node >= 0 && s->my_arena_slot->my_numa_node == s->my_numa_node,
+                   "The node of the thread is not recorded in its slot");
+        else
+            ASSERT(s->my_arena_slot->my_numa_node == -1, "The node is recorded in an arena without NUMA-aware stealing");
+        const int tasks_per_thread = 100;
+        tbb::task& parent = *new( tbb::task::allocate_root() ) tbb::empty_task;
+        parent.set_ref_count(tasks_per_thread+1);
+        for( int i = 0; i < tasks_per_thread; ++i )
+            tbb::task::spawn( *new( parent.allocate_child() )
+                NumaStealingTask(tbb::this_task_arena::current_thread_index(), s->my_numa_node, my_counters) );
+        my_barrier.wait();
+        parent.wait_for_all();
+        tbb::task::destroy(parent);
+    }
+};
+
+struct NumaStealingFunctor : NoAssign {
+    int my_p;
+    NumaStealingBody my_body;
+    NumaStealingFunctor( int p, const NumaStealingBody& body ) : my_p(p), my_body(body) {}
+    void operator()() const {
+        tbb::parallel_for(0, my_p, my_body, tbb::simple_partitioner());
+    }
+};
+
+void RunNumaStealing( int p, bool numa_aware, StealCounters& counters ) {
+    counters.local = counters.remote = 0;
+    for( int i = 0; i < 10; ++i ) {
+        tbb::task_arena a(p);
+        if( numa_aware ) {
+            tbb::global_control c(tbb::global_control::numa_aware_stealing, 1);
+            a.initialize();
+        }
+        Harness::SpinBarrier barrier(p);
+        a.execute(NumaStealingFunctor(p, NumaStealingBody(numa_aware, barrier, counters)));
+        for( int j = 0; j < p; ++j )
+            ASSERT(a.my_arena->my_slots[j].my_numa_node == -1 || a.my_arena->my_slots[j].my_scheduler,
+                   "A free slot must not keep the node of its former owner");
+    }
+    REMARK("%s stealing: %d local and %d remote steals\n", numa_aware ? "NUMA-aware" : "Random",
+           int(counters.local), int(counters.remote));
+}
+
+// Threads are spread over two NUMA nodes, so random victim selection makes about a third of
+// the steals local. Thieves in an arena with NUMA-aware stealing must prefer the local victims.
+void TestNumaAwareStealing() {
+    const int p = 4;
+    tbb::task_scheduler_init init(p);
+    StealCounters aware, random;
+    // The NUMA-aware arena runs first, so that all the threads have their nodes sampled.
+    RunNumaStealing(p, /*numa_aware*/true, aware);
+    RunNumaStealing(p, /*numa_aware*/false, random);
+    ASSERT(numaNodeQueries <= p, "The node must be queried once per thread");
+    ASSERT(aware.local > aware.remote, "Steals from the remote node prevail");
+    ASSERT(double(aware.local)/(aware.local + aware.remote) > double(random.local)/(random.local + random.remote),
+           "NUMA-aware stealing does not prefer victims on the same node");
+}
+
 int TestMain () {
     {
         tbb::task_scheduler_init tsi;
@@ -73,6 +194,7 @@ int TestMain () {
             return Harness::Skipped;
     }
     TestWorkersSleep();
+    TestNumaAwareStealing();
 
     return Harness::Done;
 }
@@ -50,6 +50,90 @@ void test_deduction_guides() {
 }
 #endif
 
+// The items with different keys are matched in parallel; each port gets its items from its own thread.
+namespace sharded_matching {
+
+typedef tbb::flow::tuple<int, int, int, int> tuple_type;
+typedef tbb::flow::join_node<tuple_type, tbb::flow::key_matching<int> > join_type;
+
+const int N = 10000;
+
+// the item of port p for key k is k*(p+1)
+template<int P>
+struct key_body {
+    int operator()( int v ) const { return v / (P + 1); }
+};
+
+class put_body : NoAssign {
+    join_type &my_join;
+public:
+    put_body( join_type &j ) : my_join(j) {}
+    void operator()( int p ) const {
+        for ( int i = 0; i < N; ++i ) {
+            // the threads put the keys in different orders
+            const int k = p % 2 ? N - 1 - i : i;
+            bool accepted = false;
+            switch ( p ) {
+            case 0: accepted = tbb::flow::input_port<0>( my_join ).try_put( k ); break;
+            case 1: accepted = tbb::flow::input_port<1>( my_join ).try_put( 2*k ); break;
+            case 2: accepted = tbb::flow::input_port<2>( my_join ).try_put( 3*k ); break;
+            case 3: accepted = tbb::flow::input_port<3>( my_join ).try_put( 4*k ); break;
+            }
+            ASSERT( accepted, "the put of a new key should be accepted" );
+        }
+    }
+};
+
+struct check_body {
+    tbb::atomic<int> *my_seen;
+    check_body( tbb::atomic<int> *seen ) : my_seen(seen) {}
+    tbb::flow::continue_msg operator()( const tuple_type &t ) const {
+        const int k = tbb::flow::get<0>( t );
+        ASSERT( 0 <= k && k < N, NULL );
+        ASSERT( tbb::flow::get<1>( t ) == 2*k && tbb::flow::get<2>( t ) == 3*k && tbb::flow::get<3>( t ) == 4*k,
+                "items with different keys were matched" );
+        ++my_seen[k];
+        return tbb::flow::continue_msg();
+    }
+};
+
+void test_parallel_puts() {
+    tbb::flow::graph g;
+    join_type j( g, key_body<0>(), key_body<1>(), key_body<2>(), key_body<3>() );
+    std::vector< tbb::atomic<int> > seen( N );
+    for ( int i = 0; i < N; ++i ) seen[i] = 0;
+    tbb::flow::function_node<tuple_type> check( g, tbb::flow::unlimited, check_body( &seen[0] ) );
+    tbb::flow::make_edge( j, check );
+    NativeParallelFor( 4, put_body( j ) );
+    g.wait_for_all();
+    for ( int i = 0; i < N; ++i )
+        ASSERT( seen[i] == 1, "each key should be emitted once" );
+}
+
+//! The tuples that are not accepted by a successor wait in the join_node
+void test_buffered_tuples() {
+    tbb::flow::graph g;
+    join_type j( g, key_body<0>(), key_body<1>(), key_body<2>(), key_body<3>() );
+    ASSERT( tbb::flow::input_port<1>( j ).try_put( 2 ), NULL );
+    ASSERT( !tbb::flow::input_port<1>( j ).try_put( 2 ), "a second item with the key should be rejected" );
+    for ( int k = 1; k <= 3; ++k ) {
+        tbb::flow::input_port<0>( j ).try_put( k );
+        if ( k != 1 ) tbb::flow::input_port<1>( j ).try_put( 2*k );
+        tbb::flow::input_port<2>( j ).try_put( 3*k );
+    }
+    for ( int k = 3; k >= 1; --k )
+        tbb::flow::input_port<3>( j ).try_put( 4*k );
+    g.wait_for_all();
+    tuple_type t;
+    for ( int k = 3; k >= 1; --k ) {
+        ASSERT( j.try_get( t ), NULL );
+        ASSERT( tbb::flow::get<0>( t ) == k && tbb::flow::get<3>( t ) == 4*k, "the tuples should be buffered in order" );
+    }
+    ASSERT( !j.try_get( t ), NULL );
+}
+
+} // namespace sharded_matching
+
 int TestMain() {
 #if __TBB_USE_TBB_TUPLE
     REMARK("  Using TBB tuple\n");
@@ -83,6 +167,12 @@ int TestMain() {
     generate_test<parallel_test, tbb::flow::tuple<MyKeyFirst<int, double>, MyKeySecond<int, float> >, tbb::flow::key_matching<int&> >::do_test();
     generate_test<parallel_test, tbb::flow::tuple<MyKeyFirst<std::string, double>, MyKeySecond<std::string, float> >, tbb::flow::key_matching<std::string&> >::do_test();
 
+    sharded_matching::test_buffered_tuples();
+    for ( int p = MinThread; p <= MaxThread; ++p ) {
+        tbb::task_scheduler_init init( p );
+        sharded_matching::test_parallel_puts();
+    }
+
 #if MAX_TUPLE_TEST_SIZE >= 10
     generate_test<parallel_test, tbb::flow::tuple<
         MyKeyFirst<std::string, double>,
@@ -849,9 +849,9 @@ void TestPoolMSize() {
     // On Power architecture TLS bins are divided differently.
     size_t allocatedSz[SZ] =
 #if __powerpc64__ || __ppc64__ || __bgp__
-        {8, 16, 512, 1024, 2688, 5376, 8064, 1024*1024, 4242+4242, 8484+8484};
+        {8, 16, 512, 1024, 2304, 5376, 8064, 1024*1024, 4242+4242, 8484+8484};
 #else
-        {8, 16, 512, 1024, 2688, 4032, 8128, 1024*1024, 4242+4242, 8484+8484};
+        {8, 16, 512, 1024, 2304, 4032, 8128, 1024*1024, 4242+4242, 8484+8484};
 #endif
     for (int i = 0; i < SZ; i++) {
         void* obj = pool_malloc(pool, requestedSz[i]);
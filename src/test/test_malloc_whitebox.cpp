@@ -863,6 +863,63 @@ void TestCleanThreadBuffers() {
     NativeParallelFor(num_threads, TestCleanThreadBuffersBody());
 }
 
+//! Objects freed by a thread that does not own their block must be kept by the thread
+//! until a batch is collected or the thread cleans its buffers.
+struct TestRemoteFreeBatchingBody : public SimpleBarrier {
+    static const int cachedNum = 16, batchSize = 32, objectsNum = cachedNum + batchSize;
+    static void *objects[objectsNum];
+
+    static Block *blockOf(void *object) { return (Block*)alignDown(object, slabSize); }
+
+    void operator() ( int id ) const {
+        if (id == 0)
+            for (int i = 0; i < objectsNum; i++)
+                objects[i] = scalable_malloc(64);
+        barrier.wait();
+        if (id == 1) {
+            Block *block = blockOf(objects[0]);
+            for (int i = 0; i < objectsNum; i++)
+                ASSERT(blockOf(objects[i]) == block, "Objects are expected to be from a single block.");
+            for (int i = 0; i < cachedNum; i++)
+                scalable_free(objects[i]);
+            ASSERT(!block->publicFreeList, "Objects freed by other thread must be cached.");
+            ASSERT(scalable_allocation_command(TBBMALLOC_CLEAN_THREAD_BUFFERS, 0) == TBBMALLOC_OK,
+                   "Cached objects must be returned by the cleanup.");
+            ASSERT(block->publicFreeList, "Objects were not returned to the block.");
+        }
+        barrier.wait();
+        if (id == 0) {
+            Block *block = blockOf(objects[0]);
+            scalable_allocation_command(TBBMALLOC_CLEAN_THREAD_BUFFERS, 0);
+            ASSERT(block->allocatedCount == batchSize, "Cached objects were not returned exactly once.");
+        }
+        barrier.wait();
+        if (id == 1) {
+            Block *block = blockOf(objects[0]);
+            for (int i = cachedNum; i < objectsNum; i++)
+                scalable_free(objects[i]);
+            ASSERT(block->publicFreeList, "Full batch was not returned to the block.");
+            TLSData *tls = defaultMemPool->getTLS(/*create=*/false);
+            ASSERT(!tls->remoteFreeCache.flush(), "Full batch was not flushed.");
+        }
+        barrier.wait();
+    }
+};
+
+void *TestRemoteFreeBatchingBody::objects[TestRemoteFreeBatchingBody::objectsNum];
+
+void TestRemoteFreeBatching() {
+    ASSERT(scalable_allocation_mode(TBBMALLOC_USE_REMOTE_FREE_BATCHING, 2) == TBBMALLOC_INVALID_PARAM, NULL);
+    ASSERT(scalable_allocation_mode(TBBMALLOC_USE_REMOTE_FREE_BATCHING, 1) == TBBMALLOC_OK, NULL);
+    ASSERT(remoteFreeBatching, NULL);
+
+    TestRemoteFreeBatchingBody::initBarrier(2);
+    NativeParallelFor(2, TestRemoteFreeBatchingBody());
+
+    ASSERT(scalable_allocation_mode(TBBMALLOC_USE_REMOTE_FREE_BATCHING, 0) == TBBMALLOC_OK, NULL);
+    ASSERT(!remoteFreeBatching, NULL);
+}
+
 /*---------------------------------------------------------------------------*/
 /*------------------------- Large Object Cache tests ------------------------*/
 #if _MSC_VER==1600 || _MSC_VER==1500
@@ -1190,6 +1247,210 @@ void TestSlabAlignment() {
     }
 }
 
+// test the size classes of objects from 1KB to 8KB, and that they cannot be changed in use
+void TestSizeClasses() {
+    ASSERT(scalable_allocation_mode(TBBMALLOC_SET_SIZE_CLASSES, 2) == TBBMALLOC_INVALID_PARAM, NULL);
+    const bool classic = fittingBins.isClassic();
+    ASSERT(scalable_allocation_mode(TBBMALLOC_SET_SIZE_CLASSES, classic ? TBBMALLOC_SIZE_CLASSES_CLASSIC
+                                                                        : TBBMALLOC_SIZE_CLASSES_FINE) == TBBMALLOC_OK, NULL);
+    ASSERT(scalable_allocation_mode(TBBMALLOC_SET_SIZE_CLASSES, classic ? TBBMALLOC_SIZE_CLASSES_FINE
+                                                                        : TBBMALLOC_SIZE_CLASSES_CLASSIC) == TBBMALLOC_NO_EFFECT,
+           "The size classes must not change after initialization.");
+    ASSERT(fittingBins.getNum() == (classic ? numClassicFittingBins : numFineFittingBins), NULL);
+
+    const unsigned usable = slabSize - sizeof(Block);
+    unsigned prevSize = maxSegregatedObjectSize;
+    for (unsigned i = 0; i < fittingBins.getNum(); i++) {
+        const unsigned sz = fittingBins.getSizes()[i];
+        ASSERT(sz > prevSize && sz % fittingAlignment == 0, "Fitting sizes must be aligned and increase.");
+        ASSERT(usable / sz > usable / (sz + fittingAlignment), "A larger fitting size would fit as many objects.");
+        ASSERT(getIndex(prevSize + 1) == minFittingIndex + i && getIndex(sz) == minFittingIndex + i, NULL);
+        ASSERT(getObjectSize(prevSize + 1) == sz && getObjectSize(sz) == sz, NULL);
+        prevSize = sz;
+    }
+    ASSERT(prevSize == maxFittingSize && prevSize + 1 == minLargeObjectSize, NULL);
+
+    for (unsigned sz = maxSegregatedObjectSize + 1; sz < minLargeObjectSize; sz += 61) {
+        void *p = scalable_malloc(sz);
+        ASSERT(p, NULL);
+        ASSERT(scalable_msize(p) == getObjectSize(sz), NULL);
+        ASSERT(((Block *)alignDown(p, slabSize))->getSize() == getObjectSize(sz), NULL);
+        scalable_free(p);
+    }
+}
+
+// allocates objects in a thread that exits, to check that their count is kept
+struct StatisticsAllocBody: NoAssign {
+    void **objects;
+    int num;
+    size_t size;
+    StatisticsAllocBody(void **obj, int n, size_t sz) : objects(obj), num(n), size(sz) {}
+    void operator()(int) const {
+        for (int i = 0; i < num; i++)
+            objects[i] = scalable_malloc(size);
+    }
+};
+
+void TestStatistics() {
+    ScalableAllocationStatistics before, after;
+    ASSERT(scalable_allocation_mode(TBBMALLOC_COLLECT_STATISTICS, 2) == TBBMALLOC_INVALID_PARAM, NULL);
+    ASSERT(scalable_allocation_command(TBBMALLOC_GET_STATISTICS, NULL) == TBBMALLOC_INVALID_PARAM, NULL);
+    ASSERT(scalable_allocation_mode(TBBMALLOC_COLLECT_STATISTICS, 1) == TBBMALLOC_OK, NULL);
+
+    const int num = 1000;
+    const size_t sizes[] = {16, 700, 2000, 8000};
+    void *objects[num];
+    for (unsigned k = 0; k < sizeof(sizes)/sizeof(sizes[0]); k++) {
+        const unsigned index = getIndex(sizes[k]);
+        ASSERT(scalable_allocation_command(TBBMALLOC_GET_STATISTICS, &before) == TBBMALLOC_OK, NULL);
+        ASSERT(before.collecting && before.numBins == minFittingIndex + fittingBins.getNum(), NULL);
+        ASSERT(before.bins[index].objectSize == getObjectSize(sizes[k]), NULL);
+
+        NativeParallelFor(1, StatisticsAllocBody(objects, num, sizes[k]));
+        ASSERT(scalable_msize(objects[0]) == before.bins[index].objectSize, NULL);
+        scalable_allocation_command(TBBMALLOC_GET_STATISTICS, &after);
+        const ScalableBinStatistics &bin = after.bins[index];
+        ASSERT(bin.liveObjects == before.bins[index].liveObjects + num, "Objects of an exited thread are not counted.");
+        ASSERT(bin.liveBytes == bin.liveObjects * bin.objectSize, NULL);
+        ASSERT(bin.slabs * (slabSize - sizeof(Block)) >= bin.liveBytes + bin.cachedBytes, NULL);
+        ASSERT(bin.slabs * (slabSize - sizeof(Block)) < bin.liveBytes + bin.cachedBytes + bin.slabs * bin.objectSize, NULL);
+        ASSERT(after.orphanedSlabs > 0, "The slabs of the exited thread must be orphaned.");
+
+        for (int i = 0; i < num; i++)
+            scalable_free(objects[i]);
+        scalable_allocation_command(TBBMALLOC_GET_STATISTICS, &after);
+        ASSERT(after.bins[index].liveObjects == before.bins[index].liveObjects, "Freed objects are counted as live.");
+    }
+
+    const size_t largeSize = 1024*1024;
+    scalable_allocation_command(TBBMALLOC_GET_STATISTICS, &before);
+    void *large = scalable_malloc(largeSize);
+    scalable_allocation_command(TBBMALLOC_GET_STATISTICS, &after);
+    ASSERT(after.largeLiveBytes >= before.largeLiveBytes + largeSize, NULL);
+    ASSERT(after.largeCacheHits + after.largeCacheMisses == before.largeCacheHits + before.largeCacheMisses + 1, NULL);
+    scalable_free(large);
+    large = scalable_malloc(largeSize);
+    scalable_allocation_command(TBBMALLOC_GET_STATISTICS, &after);
+    ASSERT(after.largeCacheHits > before.largeCacheHits, "A freed large object must be reused from a cache.");
+    scalable_free(large);
+    ASSERT(after.threads >= 1 && after.backendRegions > 0 && after.backendBytes >= after.backendRegions * slabSize, NULL);
+
+    ASSERT(scalable_allocation_mode(TBBMALLOC_COLLECT_STATISTICS, 0) == TBBMALLOC_OK, NULL);
+    void *p = scalable_malloc(2000);
+    scalable_allocation_command(TBBMALLOC_GET_STATISTICS, &after);
+    ASSERT(!after.collecting && !after.bins[getIndex(2000)].liveObjects, NULL);
+    scalable_free(p);
+}
+
+// the objects allocated before collection is turned on are not counted when freed;
+// run in a new thread, so that its slabs hold no objects of other tests
+struct StatisticsEarlierObjectsBody: NoAssign {
+    void operator()(int) const {
+        ScalableAllocationStatistics before, after;
+        const int num = 1000, numNew = 100;
+        const size_t size = 48;
+        const unsigned index = getIndex(size);
+        void *objects[num];
+        ASSERT(scalable_allocation_mode(TBBMALLOC_COLLECT_STATISTICS, 0) == TBBMALLOC_OK, NULL);
+        for (int i = 0; i < num; i++)
+            objects[i] = scalable_malloc(size);
+        ASSERT(scalable_allocation_mode(TBBMALLOC_COLLECT_STATISTICS, 1) == TBBMALLOC_OK, NULL);
+        scalable_allocation_command(TBBMALLOC_GET_STATISTICS, &before);
+        for (int i = 0; i < num; i++)
+            scalable_free(objects[i]);
+        // the slabs are empty now, so the new objects are counted
+        for (int i = 0; i < numNew; i++)
+            objects[i] = scalable_malloc(size);
+        scalable_allocation_command(TBBMALLOC_GET_STATISTICS, &after);
+        ASSERT(after.bins[index].liveObjects == before.bins[index].liveObjects + numNew,
+               "Freed objects allocated before collection are counted.");
+        for (int i = 0; i < numNew; i++)
+            scalable_free(objects[i]);
+        scalable_allocation_command(TBBMALLOC_GET_STATISTICS, &after);
+        ASSERT(after.bins[index].liveObjects == before.bins[index].liveObjects, NULL);
+        ASSERT(scalable_allocation_mode(TBBMALLOC_COLLECT_STATISTICS, 0) == TBBMALLOC_OK, NULL);
+    }
+};
+
+void TestStatisticsOfEarlierObjects() {
+    NativeParallelFor(1, StatisticsEarlierObjectsBody());
+}
+
+#if MALLOC_HEAP_PROFILER
+struct HeapProfileTotals {
+    long liveObjects, liveBytes, allocatedObjects, allocatedBytes, interval;
+};
+
+HeapProfileTotals DumpHeapProfile(const char *fileName) {
+    HeapProfileTotals t;
+    ASSERT(scalable_allocation_command(TBBMALLOC_DUMP_HEAP_PROFILE, (void*)fileName) == TBBMALLOC_OK, NULL);
+    FILE *f = fopen(fileName, "r");
+    ASSERT(f, NULL);
+    int n = fscanf(f, "heap profile: %ld: %ld [%ld: %ld] @ heap_v2/%ld", &t.liveObjects, &t.liveBytes,
+                   &t.allocatedObjects, &t.allocatedBytes, &t.interval);
+    ASSERT(n == 5, "Wrong header of the heap profile.");
+    char line[1024];
+    bool mapped = false;
+    while (fgets(line, sizeof(line), f))
+        mapped |= !strcmp(line, "MAPPED_LIBRARIES:\n");
+    ASSERT(mapped, "No mapped libraries in the heap profile.");
+    fclose(f);
+    return t;
+}
+
+void TestHeapProfiler() {
+    const char *fileName = "test_malloc_whitebox.heap";
+    ASSERT(scalable_allocation_mode(TBBMALLOC_SET_HEAP_PROFILE_SAMPLING, -1) == TBBMALLOC_INVALID_PARAM, NULL);
+    ASSERT(scalable_allocation_command(TBBMALLOC_DUMP_HEAP_PROFILE, NULL) == TBBMALLOC_INVALID_PARAM, NULL);
+    // with the mean interval of a byte, every allocation is sampled
+    ASSERT(scalable_allocation_mode(TBBMALLOC_SET_HEAP_PROFILE_SAMPLING, 1) == TBBMALLOC_OK, NULL);
+    // the countdown of the thread might be set to a megabyte while the profiler was off
+    scalable_free(scalable_malloc(2*1024*1024));
+
+    const HeapProfileTotals before = DumpHeapProfile(fileName);
+    ASSERT(before.interval == 1, NULL);
+    const size_t sizes[] = {16, 2000, 100000};
+    const int num = sizeof(sizes)/sizeof(sizes[0]);
+    void *objects[num+2];
+    long bytes = 0;
+    for (int i = 0; i < num; i++) {
+        objects[i] = scalable_malloc(sizes[i]);
+        ASSERT(isLargeObject<ourMem>(objects[i]), "A sampled object must be large.");
+        ASSERT(scalable_msize(objects[i]) == sizes[i], NULL);
+        bytes += sizes[i];
+    }
+    objects[num] = scalable_aligned_malloc(100, 512);
+    objects[num+1] = scalable_calloc(10, 10);
+    ASSERT(isAligned(objects[num], 512) && isLargeObject<ourMem>(objects[num]), NULL);
+    ASSERT(isLargeObject<ourMem>(objects[num+1]) && !((char*)objects[num+1])[99], NULL);
+    bytes += 200;
+    HeapProfileTotals after = DumpHeapProfile(fileName);
+    ASSERT(after.liveObjects == before.liveObjects + num + 2 && after.liveBytes == before.liveBytes + bytes, NULL);
+    ASSERT(after.allocatedObjects == before.allocatedObjects + num + 2, NULL);
+
+    // resized in place, the object stays sampled
+    void *shrunk = scalable_realloc(objects[num-1], 90000);
+    ASSERT(shrunk == objects[num-1], NULL);
+    objects[num-1] = shrunk;
+    after = DumpHeapProfile(fileName);
+    ASSERT(after.liveBytes == before.liveBytes + bytes - 10000, "Resizing of a sampled object is not counted.");
+
+    for (int i = 0; i < num+2; i++)
+        scalable_free(objects[i]);
+    after = DumpHeapProfile(fileName);
+    ASSERT(after.liveObjects == before.liveObjects && after.liveBytes == before.liveBytes,
+           "Freed objects are in the heap profile.");
+
+    ASSERT(scalable_allocation_mode(TBBMALLOC_SET_HEAP_PROFILE_SAMPLING, 0) == TBBMALLOC_OK, NULL);
+    void *p = scalable_malloc(16);
+    ASSERT(!isLargeObject<ourMem>(p), "Objects are sampled after the profiler is off.");
+    scalable_free(p);
+    // not to leave the sampled objects in the caches for the following tests
+    scalable_allocation_command(TBBMALLOC_CLEAN_ALL_BUFFERS, 0);
+    remove(fileName);
+}
+#endif
+
 #include "harness_memory.h"
 
 // TODO: Consider adding Huge Pages support on macOS (special mmap flag).
@@ -1578,6 +1839,60 @@ void TestHugeSizeThreshold() {
     TestHugeSizeThresholdImpl(loc, 56 * MByte, true);
 }
 
+#if __linux__
+// In the huge page slab mode backend regions are huge pages from the reserved arena,
+// they must be returned to OS as soon as no blocks are used in them.
+// Allocations are done in a separate thread, so its local caches are released
+// with the thread and do not keep huge page regions in use.
+struct HugePageSlabsBody: NoAssign {
+    int *inArena;
+    size_t *peakCommittedNum;
+    HugePageSlabsBody(int *in, size_t *peak) : inArena(in), peakCommittedNum(peak) {}
+    void operator()(int) const {
+        const int num = 1000;
+        void *objects[num];
+
+        for (int i = 0; i < num; i++) {
+            const bool large = i % 2;
+            objects[i] = scalable_malloc(large ? 100*1024 : 1024);
+            ASSERT(objects[i], NULL);
+            memset(objects[i], 0, large ? 100*1024 : 1024);
+            void *block = large ? (void*)(((LargeObjectHdr*)objects[i] - 1)->memoryBlock)
+                                : alignDown(objects[i], slabSize);
+            if (hugePageArena.inArena(block)) {
+                MemRegion *region = (MemRegion*)alignDown(block, HUGE_PAGE_SIZE);
+                ASSERT(region->occupancy > 0, "Used block is not accounted in its region.");
+                ASSERT(region->allocSz == HUGE_PAGE_SIZE, "Region must be a single huge page.");
+                (*inArena)++;
+            }
+        }
+        *peakCommittedNum = hugePageArena.getCommittedNum();
+        for (int i = 0; i < num; i++)
+            scalable_free(objects[i]);
+    }
+};
+
+void TestHugePageSlabs() {
+    ASSERT(scalable_allocation_mode(TBBMALLOC_USE_HUGE_PAGE_SLABS, 2) == TBBMALLOC_INVALID_PARAM, NULL);
+    ASSERT(scalable_allocation_mode(TBBMALLOC_USE_HUGE_PAGE_SLABS, 1) == TBBMALLOC_OK, NULL);
+
+    int inArena = 0;
+    size_t peakCommittedNum = 0;
+    NativeParallelFor(1, HugePageSlabsBody(&inArena, &peakCommittedNum));
+    if (hugePageArena.isReserveFailed())
+        REMARK("Address space for huge page regions is not available - skipped the check\n");
+    else {
+        ASSERT(inArena, "Huge page regions are not used.");
+        scalable_allocation_command(TBBMALLOC_CLEAN_ALL_BUFFERS, 0);
+        // a region can stay pinned by long-lived internal data, e.g. thread-local structures
+        ASSERT(hugePageArena.getCommittedNum() < peakCommittedNum/2,
+               "Empty huge page regions were not released.");
+    }
+
+    ASSERT(scalable_allocation_mode(TBBMALLOC_USE_HUGE_PAGE_SLABS, 0) == TBBMALLOC_OK, NULL);
+}
+#endif
+
 int TestMain () {
     scalable_allocation_mode(USE_HUGE_PAGES, 0);
 #if !__TBB_WIN8UI_SUPPORT
@@ -1592,6 +1907,7 @@ int TestMain () {
     TestCleanAllBuffers<4*1024>();
     TestCleanAllBuffers<16*1024>();
     TestCleanThreadBuffers();
+    TestRemoteFreeBatching();
     TestPools();
     TestBackend();
 
@@ -1609,9 +1925,18 @@ int TestMain () {
     TestHeapLimit();
     TestLOC();
     TestSlabAlignment();
+    TestSizeClasses();
+    TestStatistics();
+    TestStatisticsOfEarlierObjects();
     TestReallocDecreasing();
     TestLOCacheBinsConverter();
     TestHugeSizeThreshold();
+#if MALLOC_HEAP_PROFILER
+    TestHeapProfiler();
+#endif
+#if __linux__
+    TestHugePageSlabs();
+#endif
 
 #if __linux__
     if (isTHPEnabledOnMachine()) {
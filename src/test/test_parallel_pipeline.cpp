@@ -23,6 +23,7 @@ int filter_node_count = 0;
 #include "tbb/atomic.h"
 #include "harness.h"
 #include <string.h>
+#include <stdexcept>
 
 #include "tbb/tbb_allocator.h"
 #include "tbb/spin_mutex.h"
@@ -631,6 +632,189 @@ void run_function(const char *l1, const char *l2) {
     }
 }
 
+//! An item that counts its instances, so that leaks in batches are detected
+class batch_item {
+    int my_value;
+public:
+    static tbb::atomic<int> live;
+    batch_item( int v = 0 ) : my_value(v) { ++live; }
+    batch_item( const batch_item& other ) : my_value(other.my_value) { ++live; }
+    ~batch_item() { --live; }
+    int value() const { return my_value; }
+};
+
+tbb::atomic<int> batch_item::live;
+
+static tbb::atomic<int> items_in_flight, peak_items_in_flight;
+static const int batch_stream_size = 5000;
+
+class batch_input_body {
+    int* my_next;
+public:
+    batch_input_body( int* next ) : my_next(next) {}
+    int operator()( tbb::flow_control& control ) const {
+        if( *my_next==batch_stream_size ) {
+            control.stop();
+            return 0;
+        }
+        int n = ++items_in_flight;
+        for( int peak = peak_items_in_flight; n>peak; peak = peak_items_in_flight )
+            peak_items_in_flight.compare_and_swap( n, peak );
+        return (*my_next)++;
+    }
+};
+
+struct batch_convert_body {
+    //! The item that makes the body throw, or -1
+    int my_throw_at;
+    batch_convert_body( int throw_at = -1 ) : my_throw_at(throw_at) {}
+    batch_item operator()( int i ) const {
+#if TBB_USE_EXCEPTIONS
+        if( i==my_throw_at )
+            throw std::runtime_error("batch_convert_body");
+#endif
+        return batch_item(i);
+    }
+};
+
+//! Checks that the items of a serial_in_order filter arrive in order
+class batch_order_body {
+    int* my_expected;
+public:
+    batch_order_body( int* expected ) : my_expected(expected) {}
+    batch_item operator()( const batch_item& item ) const {
+        ASSERT( item.value()==(*my_expected)++, "serial_in_order filter received an item out of order" );
+        return item;
+    }
+};
+
+class batch_output_body {
+    tbb::atomic<int>* my_sum;
+public:
+    batch_output_body( tbb::atomic<int>* sum ) : my_sum(sum) {}
+    void operator()( const batch_item& item ) const {
+        --items_in_flight;
+        *my_sum += item.value();
+    }
+};
+
+void run_batch_pipeline( size_t max_number_of_live_tokens, const tbb::filter_batch& batch, tbb::filter::mode middle_mode, int throw_at = -1 ) {
+    int next = 0, expected = 0;
+    tbb::atomic<int> sum; sum = 0;
+    items_in_flight = 0;
+    peak_items_in_flight = 0;
+    bool caught = false;
+    tbb::filter_t<void,void> chain =
+        tbb::make_filter<void,int>( tbb::filter::serial_in_order, batch_input_body(&next), batch ) &
+        tbb::make_filter<int,batch_item>( middle_mode, batch_convert_body(throw_at) ) &
+        tbb::make_filter<batch_item,batch_item>( tbb::filter::serial_in_order, batch_order_body(&expected) ) &
+        tbb::make_filter<batch_item,void>( tbb::filter::parallel, batch_output_body(&sum) );
+#if TBB_USE_EXCEPTIONS
+    try {
+        tbb::parallel_pipeline( max_number_of_live_tokens, chain );
+    } catch( ... ) {
+        // std::runtime_error or tbb::captured_exception
+        caught = true;
+    }
+#else
+    tbb::parallel_pipeline( max_number_of_live_tokens, chain );
+#endif
+    if( throw_at<0 ) {
+        ASSERT( expected==batch_stream_size && sum==batch_stream_size*(batch_stream_size-1)/2, "items are lost" );
+        ASSERT( size_t(peak_items_in_flight)<=max_number_of_live_tokens, "the number of live items exceeds the limit" );
+    } else {
+        ASSERT( caught, "the exception is lost" );
+    }
+    chain.clear();
+    ASSERT( !batch_item::live, "items are leaked" );
+}
+
+//! Tests parallel_pipeline with the input filter that groups the items into batches
+void run_batch_tests() {
+    REMARK("Testing batches\n");
+    const tbb::filter::mode modes[] = { tbb::filter::parallel, tbb::filter::serial_out_of_order };
+    for( int m = 0; m<2; ++m ) {
+        run_batch_pipeline( 32, tbb::filter_batch(7), modes[m] );
+        run_batch_pipeline( 4, tbb::filter_batch(16), modes[m] );
+        run_batch_pipeline( 1, tbb::filter_batch(1), modes[m] );
+        run_batch_pipeline( 256, tbb::filter_batch(64, tbb::filter_batch::adaptive), modes[m] );
+#if TBB_USE_EXCEPTIONS && !__TBB_THROW_ACROSS_MODULE_BOUNDARY_BROKEN
+        run_batch_pipeline( 32, tbb::filter_batch(8), modes[m], 1234 );
+        run_batch_pipeline( 64, tbb::filter_batch(32, tbb::filter_batch::adaptive), modes[m], 4321 );
+#endif
+    }
+    const tbb::filter_batch::kind kinds[] = { tbb::filter_batch::fixed, tbb::filter_batch::adaptive };
+    for( int k = 0; k<2; ++k ) {
+        // the batches are reduced, so that every thread has a token when the limit is low
+        const size_t p = size_t(tbb::this_task_arena::max_concurrency());
+        int next = 0;
+        tbb::atomic<int> sum; sum = 0;
+        tbb::filter_t<void,void> chain =
+            tbb::make_filter<void,int>( tbb::filter::serial_in_order, batch_input_body(&next), tbb::filter_batch(64, kinds[k]) ) &
+            tbb::make_filter<int,batch_item>( tbb::filter::parallel, batch_convert_body() ) &
+            tbb::make_filter<batch_item,void>( tbb::filter::parallel, batch_output_body(&sum) );
+        tbb::interface6::internal::pipeline_proxy pipe( chain, 4*p );
+        ASSERT( pipe.number_of_tokens()>=p, "there are fewer tokens than threads" );
+        run_batch_pipeline( 4*p, tbb::filter_batch(64, kinds[k]), tbb::filter::parallel );
+    }
+    ASSERT( !filter_node_count, "filter_node objects leaked" );
+}
+
+//! Runs the pipeline of run_batch_pipeline with the adaptive number of tokens
+void run_adaptive_pipeline( tbb::adaptive_token_limit& limit, size_t max_items_in_flight, size_t batch_size = 0 ) {
+    int next = 0, expected = 0;
+    tbb::atomic<int> sum; sum = 0;
+    items_in_flight = 0;
+    peak_items_in_flight = 0;
+    tbb::filter_t<void,int> input = batch_size ?
+        tbb::make_filter<void,int>( tbb::filter::serial_in_order, batch_input_body(&next), tbb::filter_batch(batch_size) ) :
+        tbb::make_filter<void,int>( tbb::filter::serial_in_order, batch_input_body(&next) );
+    tbb::parallel_pipeline( limit,
+        input &
+        tbb::make_filter<int,batch_item>( tbb::filter::parallel, batch_convert_body() ) &
+        tbb::make_filter<batch_item,batch_item>( tbb::filter::serial_in_order, batch_order_body(&expected) ) &
+        tbb::make_filter<batch_item,void>( tbb::filter::parallel, batch_output_body(&sum) ) );
+    ASSERT( expected==batch_stream_size && sum==batch_stream_size*(batch_stream_size-1)/2, "items are lost" );
+    ASSERT( size_t(peak_items_in_flight)<=max_items_in_flight, "the number of live items exceeds the limit" );
+    ASSERT( limit.current_limit()>=limit.min_tokens() && limit.current_limit()<=max_items_in_flight, "the limit is out of range" );
+    ASSERT( limit.number_of_stages()==4, NULL );
+    for( size_t i = 0; i<limit.number_of_stages(); ++i ) {
+        const tbb::adaptive_token_limit::stage_statistics& stats = limit.stage(i);
+        size_t items = batch_size ? (batch_stream_size+batch_size-1)/batch_size : batch_stream_size;
+        ASSERT( stats.items>=items && stats.items<=items+1, "wrong number of items in the statistics" );
+        ASSERT( stats.busy_time>=0 && stats.utilization>=0, NULL );
+    }
+    ASSERT( !batch_item::live, "items are leaked" );
+}
+
+//! Tests parallel_pipeline with the number of tokens adjusted at run time
+void run_adaptive_tests() {
+    REMARK("Testing adaptive number of tokens\n");
+    {
+        tbb::adaptive_token_limit limit( 1, 64 );
+        run_adaptive_pipeline( limit, 64 );
+        // the statistics are replaced by the next run
+        run_adaptive_pipeline( limit, 64 );
+    }
+    {
+        tbb::adaptive_token_limit limit( 5, 5 );
+        run_adaptive_pipeline( limit, 5 );
+        ASSERT( limit.current_limit()==5, NULL );
+    }
+    {
+        tbb::adaptive_token_limit limit( 2, 1000 );
+        limit.set_memory_budget( 10*sizeof(batch_item), sizeof(batch_item) );
+        run_adaptive_pipeline( limit, 10 );
+    }
+    {
+        // the limit counts items, and tokens carry batches of 8 items
+        tbb::adaptive_token_limit limit( 8, 256 );
+        run_adaptive_pipeline( limit, 256, 8 );
+        ASSERT( limit.current_limit()%8==0, NULL );
+    }
+    ASSERT( !filter_node_count, "filter_node objects leaked" );
+}
+
 #include "tbb/task_scheduler_init.h"
 
 int TestMain() {
@@ -667,6 +851,8 @@ int TestMain() {
         RUN_FUNCTION(std::unique_ptr<int>, std::unique_ptr<int>) // move-only type
 #endif
         #undef RUN_FUNCTION
+        run_batch_tests();
+        run_adaptive_tests();
     }
     return Harness::Done;
 }
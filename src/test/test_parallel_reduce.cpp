@@ -300,17 +300,9 @@ struct parallel_deterministic_reduce_lambda_invoker<ResultType, harness_default_
 //! Define overloads of parallel_deterministic_reduce that accept "undesired" types of partitioners
 namespace unsupported {
 
-    template<typename Range, typename Body>
-    void parallel_deterministic_reduce(const Range&, Body&, const tbb::auto_partitioner&) { }
-
     template<typename Range, typename Body>
     void parallel_deterministic_reduce(const Range&, Body&, tbb::affinity_partitioner&) { }
 
-    template<typename Range, typename Value, typename RealBody, typename Reduction>
-    Value parallel_deterministic_reduce(const Range& , const Value& identity, const RealBody& , const Reduction& , const tbb::auto_partitioner&) {
-        return identity;
-    }
-
     template<typename Range, typename Value, typename RealBody, typename Reduction>
     Value parallel_deterministic_reduce(const Range& , const Value& identity, const RealBody& , const Reduction& , tbb::affinity_partitioner&) {
         return identity;
@@ -326,30 +318,17 @@ struct Body {
     void join(Body&) {}
 };
 
-//! Check that other types of partitioners are not supported (auto, affinity)
+//! Check that other types of partitioners are not supported (affinity)
 //! In the case of "unsupported" API unexpectedly sneaking into namespace tbb,
 //! this test should result in a compilation error due to overload resolution ambiguity
 static void TestUnsupportedPartitioners() {
     using namespace tbb;
     using namespace unsupported;
     Body body;
-    parallel_deterministic_reduce(blocked_range<int>(0, 10), body, tbb::auto_partitioner());
-
     tbb::affinity_partitioner ap;
     parallel_deterministic_reduce(blocked_range<int>(0, 10), body, ap);
 
 #if __TBB_CPP11_LAMBDAS_PRESENT
-    parallel_deterministic_reduce(
-        blocked_range<int>(0, 10),
-        0,
-        [](const blocked_range<int>&, int init)->int {
-            return init;
-        },
-        [](int x, int y)->int {
-            return x + y;
-        },
-        tbb::auto_partitioner()
-    );
     parallel_deterministic_reduce(
         blocked_range<int>(0, 10),
         0,
@@ -400,11 +379,87 @@ void TestDeterministicReductionFor() {
 void TestDeterministicReduction () {
     TestDeterministicReductionFor<tbb::simple_partitioner>();
     TestDeterministicReductionFor<tbb::static_partitioner>();
+    TestDeterministicReductionFor<tbb::auto_partitioner>();
     TestDeterministicReductionFor<harness_default_partitioner>();
     ASSERT_WARNING((Harness::ConcurrencyTracker::PeakParallelism() > 1), "no parallel execution\n");
 }
 
 #include "tbb/task_scheduler_init.h"
+#include <vector>
+#include <cstring>
+#include <functional>
+
+//! Sums floating-point numbers of different magnitudes, so that the result depends on the order of additions
+struct FloatSumBody {
+    typedef double result_type;
+    const double* my_array;
+    double my_value;
+    FloatSumBody( const double* array ) : my_array(array), my_value(0) {}
+    FloatSumBody( FloatSumBody& other, tbb::split ) : my_array(other.my_array), my_value(0) {}
+    void operator()( const tbb::blocked_range<int>& r ) {
+        double value = my_value;
+        for( int i = r.begin(); i != r.end(); ++i )
+            value += my_array[i];
+        my_value = value;
+    }
+    void join( const FloatSumBody& y ) { my_value += y.my_value; }
+};
+
+struct FloatSumFunc {
+    const double* my_array;
+    double operator()( const tbb::blocked_range<int>& r, double value ) const {
+        for( int i = r.begin(); i != r.end(); ++i )
+            value += my_array[i];
+        return value;
+    }
+};
+
+//! Imbalanced work, to make the auto partitioner split the range on demand
+struct ImbalancedSumBody: FloatSumBody {
+    ImbalancedSumBody( const double* array ) : FloatSumBody(array) {}
+    ImbalancedSumBody( ImbalancedSumBody& other, tbb::split ) : FloatSumBody(other, tbb::split()) {}
+    void operator()( const tbb::blocked_range<int>& r ) {
+        if( r.begin() < 50000 )
+            Harness::Sleep( 1 );
+        FloatSumBody::operator()( r );
+    }
+};
+
+//! The auto partitioner gives the same bits as the simple partitioner, with any number of threads
+void TestAdaptiveDeterministicReduction() {
+    REMARK("testing parallel_deterministic_reduce with auto_partitioner\n");
+    const int N = 100000;
+    std::vector<double> array( N );
+    Harness::FastRandom rnd( 42 );
+    for( int i = 0; i < N; ++i )
+        array[i] = double( rnd.get() ) * ( i % 7 == 0 ? 1e10 : 1e-3 ) * ( i % 3 ? 1 : -1 );
+    const int grainsizes[] = { 1, 7, 100, 1000, N };
+    for( int g = 0; g < 5; ++g ) {
+        const tbb::blocked_range<int> range( 0, N, grainsizes[g] );
+        FloatSumBody simple_body( &array[0] );
+        tbb::parallel_deterministic_reduce( range, simple_body, tbb::simple_partitioner() );
+        for( int p = MinThread; p <= MaxThread; ++p ) {
+            tbb::task_scheduler_init init( p );
+            for( int k = 0; k < 10; ++k ) {
+                FloatSumBody body( &array[0] );
+                tbb::parallel_deterministic_reduce( range, body, tbb::auto_partitioner() );
+                ASSERT( std::memcmp( &body.my_value, &simple_body.my_value, sizeof(double) ) == 0,
+                        "auto_partitioner does not reproduce the result of simple_partitioner" );
+                FloatSumFunc f = { &array[0] };
+                double value = tbb::parallel_deterministic_reduce( range, 0.0, f, std::plus<double>(), tbb::auto_partitioner() );
+                ASSERT( std::memcmp( &value, &simple_body.my_value, sizeof(double) ) == 0,
+                        "functional parallel_deterministic_reduce with auto_partitioner is not reproducible" );
+            }
+            if( grainsizes[g] == 1000 ) {
+                ImbalancedSumBody body( &array[0] );
+                tbb::parallel_deterministic_reduce( range, body, tbb::auto_partitioner() );
+                ASSERT( std::memcmp( &body.my_value, &simple_body.my_value, sizeof(double) ) == 0,
+                        "the result depends on the load balancing" );
+            }
+        }
+    }
+}
+
 #include "harness_cpu.h"
 #include "test_partitioner.h"
 
@@ -464,6 +519,14 @@ void test() {
     parallel_deterministic_reduce(Range4(false, true), body, tbb::simple_partitioner());
     parallel_deterministic_reduce(Range5(false, true), body, tbb::simple_partitioner());
     parallel_deterministic_reduce(Range6(false, true), body, tbb::simple_partitioner());
+
+    parallel_deterministic_reduce(Range1(/*assert_in_split*/false, /*assert_in_proportional_split*/ true),
+                                         body, tbb::auto_partitioner());
+    parallel_deterministic_reduce(Range2(false, true), body, tbb::auto_partitioner());
+    parallel_deterministic_reduce(Range3(false, true), body, tbb::auto_partitioner());
+    parallel_deterministic_reduce(Range4(false, true), body, tbb::auto_partitioner());
+    parallel_deterministic_reduce(Range5(false, true), body, tbb::auto_partitioner());
+    parallel_deterministic_reduce(Range6(false, true), body, tbb::auto_partitioner());
 }
 
 } // interaction_with_range_and_partitioner
@@ -483,6 +546,7 @@ int TestMain () {
         // Test that all workers sleep when no work
         TestCPUUserTime(p);
     }
+    TestAdaptiveDeterministicReduction();
     interaction_with_range_and_partitioner::test();
     return Harness::Done;
 }
@@ -439,6 +439,101 @@ static void TestScanTags() {
 #include "tbb/task_scheduler_init.h"
 #include "harness_cpu.h"
 
+//! Affine map x -> a*x+b; the composition of the maps is associative, but not commutative
+struct Affine {
+    unsigned a, b;
+    Affine( unsigned a_ = 1, unsigned b_ = 0 ) : a(a_), b(b_) {}
+    bool operator==( const Affine& other ) const { return a == other.a && b == other.b; }
+};
+
+//! Applies x and then y
+struct Compose {
+    Affine operator()( const Affine& x, const Affine& y ) const { return Affine( y.a*x.a, y.a*x.b + y.b ); }
+};
+
+template<typename T, typename Op>
+void CheckScans( const std::vector<T>& input, const Op& op, T init ) {
+    const size_t n = input.size();
+    std::vector<T> inclusive( n ), inclusive_init( n ), exclusive( n );
+    for( size_t i = 0; i < n; ++i ) {
+        inclusive[i] = i ? op( inclusive[i-1], input[i] ) : input[i];
+        inclusive_init[i] = op( i ? inclusive_init[i-1] : init, input[i] );
+        exclusive[i] = i ? op( exclusive[i-1], input[i-1] ) : init;
+    }
+    std::vector<T> out( n );
+    ASSERT( tbb::parallel_inclusive_scan( input.begin(), input.end(), out.begin(), op ) == out.end(), NULL );
+    ASSERT( out == inclusive, "wrong result of parallel_inclusive_scan" );
+    tbb::parallel_inclusive_scan( input.begin(), input.end(), out.begin(), op, init );
+    ASSERT( out == inclusive_init, "wrong result of parallel_inclusive_scan with the initial value" );
+    tbb::parallel_exclusive_scan( input.begin(), input.end(), out.begin(), init, op );
+    ASSERT( out == exclusive, "wrong result of parallel_exclusive_scan" );
+    // in place
+    out = input;
+    tbb::parallel_exclusive_scan( out.begin(), out.end(), out.begin(), init, op );
+    ASSERT( out == exclusive, "wrong result of parallel_exclusive_scan in place" );
+    out = input;
+    tbb::parallel_inclusive_scan( out.begin(), out.end(), out.begin(), op );
+    ASSERT( out == inclusive, "wrong result of parallel_inclusive_scan in place" );
+}
+
+void TestInclusiveExclusiveScan() {
+    const size_t block = tbb::internal::scan_block_size;
+    const size_t sizes[] = { 0, 1, 2, 100, block-1, block, block+1, 2*block, 5*block+7, 100000 };
+    for( size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s ) {
+        REMARK( "testing parallel_inclusive_scan and parallel_exclusive_scan of %d elements\n", int(sizes[s]) );
+        std::vector<int> ints( sizes[s] );
+        std::vector<unsigned char> bytes( sizes[s] );
+        std::vector<double> doubles( sizes[s] );
+        std::vector<Affine> maps( sizes[s] );
+        for( size_t i = 0; i < sizes[s]; ++i ) {
+            ints[i] = int(i % 1000) - 300;
+            bytes[i] = (unsigned char)(i*7);
+            // the sums of small integers are exact regardless of their order
+            doubles[i] = double(i % 16);
+            maps[i] = Affine( unsigned(i % 5 + 1), unsigned(i) );
+        }
+        CheckScans( ints, std::plus<int>(), 5 );
+        CheckScans( bytes, std::plus<unsigned char>(), (unsigned char)200 );
+        CheckScans( doubles, std::plus<double>(), 0.5 );
+        CheckScans( maps, Compose(), Affine( 3, 4 ) );
+        std::vector<int> out( sizes[s] );
+        std::vector<int> expected( sizes[s] );
+        for( size_t i = 0, sum = 0; i < sizes[s]; ++i )
+            expected[i] = int( sum += ints[i] );
+        tbb::parallel_inclusive_scan( ints.begin(), ints.end(), out.begin() );
+        ASSERT( out == expected, "parallel_inclusive_scan with the default operation" );
+        for( size_t i = 0, sum = 0; i < sizes[s]; sum += ints[i], ++i )
+            expected[i] = int( sum + 1 );
+        tbb::parallel_exclusive_scan( ints.begin(), ints.end(), out.begin(), 1 );
+        ASSERT( out == expected, "parallel_exclusive_scan with the default operation" );
+    }
+}
+
+//! An amount with operator+ only and no default constructor
+class Cents {
+    long my_value;
+public:
+    explicit Cents( long v ) : my_value(v) {}
+    friend Cents operator+( const Cents& x, const Cents& y ) { return Cents( x.my_value + y.my_value ); }
+    bool operator==( const Cents& other ) const { return my_value == other.my_value; }
+};
+
+// std::plus of the types other than arithmetic ones is applied through operator+ alone
+void TestPlusOfClassType() {
+    const size_t n = 3*tbb::internal::scan_block_size + 5;
+    std::vector<Cents> input, inclusive, exclusive;
+    for( size_t i = 0; i < n; ++i ) {
+        input.push_back( Cents( long(i % 100) ) );
+        inclusive.push_back( i ? inclusive[i-1] + input[i] : input[i] );
+        exclusive.push_back( i ? exclusive[i-1] + input[i-1] : Cents( 7 ) );
+    }
+    std::vector<Cents> out( n, Cents( 0 ) );
+    tbb::parallel_inclusive_scan( input.begin(), input.end(), out.begin() );
+    ASSERT( out == inclusive, "wrong result of parallel_inclusive_scan with operator+" );
+    tbb::parallel_exclusive_scan( input.begin(), input.end(), out.begin(), Cents( 7 ), std::plus<Cents>() );
+    ASSERT( out == exclusive, "wrong result of parallel_exclusive_scan with operator+" );
+}
+
 int TestMain () {
     TestScanTags();
     for( int p=MinThread; p<=MaxThread; ++p ) {
@@ -446,6 +541,10 @@ int TestMain () {
             tbb::task_scheduler_init init(p);
             NumberOfLiveStorage = 0;
             TestAccumulator(mode, p);
+            if( mode == 0 ) {
+                TestInclusiveExclusiveScan();
+                TestPlusOfClassType();
+            }
             // Test that all workers sleep when no work
             TestCPUUserTime(p);
 
@@ -17,6 +17,7 @@
 #include "tbb/parallel_sort.h"
 #include "tbb/task_scheduler_init.h"
 #include "tbb/concurrent_vector.h"
+#include "tbb/atomic.h"
 #include "harness.h"
 #include <math.h>
 #include <vector>
@@ -532,6 +533,129 @@ void range_sort_test() {
     for(int i=0; i<elements-1; ++i) ASSERT(arr[i] <= arr[i+1], "arr not sorted");
 }
 
+//! Element with a key and its initial position, that counts the live instances
+struct KeyedItem {
+    int key;
+    int index;
+    static tbb::atomic<long> live;
+    KeyedItem( int k = 0, int i = 0 ) : key(k), index(i) { ++live; }
+    KeyedItem( const KeyedItem& other ) : key(other.key), index(other.index) { ++live; }
+    ~KeyedItem() { --live; }
+};
+
+tbb::atomic<long> KeyedItem::live;
+
+struct KeyedItemLess {
+    bool operator()( const KeyedItem& a, const KeyedItem& b ) const { return a.key < b.key; }
+};
+
+//! Checks that the sequence is sorted by the keys, and the items with equal keys keep their order
+template<typename Iterator>
+void ValidateStable( Iterator first, Iterator last, const char* message ) {
+    for( Iterator i = first; i != last && i+1 != last; ++i )
+        ASSERT( i[0].key < i[1].key || (i[0].key == i[1].key && i[0].index < i[1].index), message );
+}
+
+void TestStableSort() {
+    const size_t sizes[] = { 0, 1, 2, 500, 501, 2001, 10000, 100000 };
+    const int key_ranges[] = { 1, 10, 1000, 1<<30 };
+    for( size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s ) {
+        for( size_t r = 0; r < sizeof(key_ranges)/sizeof(key_ranges[0]); ++r ) {
+            std::vector<KeyedItem> v;
+            for( size_t i = 0; i < sizes[s]; ++i )
+                v.push_back( KeyedItem( rand() % key_ranges[r], int(i) ) );
+            const long live = KeyedItem::live;
+            tbb::parallel_stable_sort( v.begin(), v.end(), KeyedItemLess() );
+            ASSERT( KeyedItem::live == live, "parallel_stable_sort leaks or destroys elements" );
+            ValidateStable( v.begin(), v.end(), "parallel_stable_sort is not stable" );
+        }
+    }
+    // the elements with resources are moved through the buffer
+    std::vector<std::string> strings;
+    for( int i = 0; i < 20000; ++i ) {
+        char buf[32];
+        sprintf( buf, "%d", rand() % 5000 );
+        strings.push_back( buf );
+    }
+    std::vector<std::string> expected( strings );
+    std::stable_sort( expected.begin(), expected.end() );
+    tbb::parallel_stable_sort( strings );
+    ASSERT( strings == expected, "parallel_stable_sort of strings" );
+    std::vector<int> v;
+    rand_vec( v );
+    tbb::parallel_stable_sort( v, std::greater<int>() );
+    for( size_t i = 1; i < v.size(); ++i )
+        ASSERT( v[i-1] >= v[i], "v not sorted" );
+}
+
+//! Random value of any arithmetic type; the floating point values are not integral
+template<typename T>
+T RandomValue( int range ) {
+    unsigned long long x = (unsigned long long)rand() << 40 ^ (unsigned long long)rand() << 20 ^ rand();
+    T t = range ? T( x % range ) : T( x );
+    if( T(-1) < T(0) && rand() % 2 )
+        t = T( -t );
+    return T( t / (T(3)/T(2) > T(1) ? T(7) : T(1)) );
+}
+
+template<typename T>
+void TestRadixSortOf( const char* name ) {
+    REMARK( "testing parallel_radix_sort of %s\n", name );
+    const size_t sizes[] = { 0, 1, 2, 64, 65, 1000, 100000, 300000 };
+    // the range of 0 is the whole type, others leave the high digits equal
+    const int ranges[] = { 0, 100, 1, 1<<20 };
+    for( size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s ) {
+        for( size_t r = 0; r < sizeof(ranges)/sizeof(ranges[0]); ++r ) {
+            std::vector<T> v;
+            for( size_t i = 0; i < sizes[s]; ++i )
+                v.push_back( RandomValue<T>( ranges[r] ) );
+            std::vector<T> expected( v );
+            std::sort( expected.begin(), expected.end() );
+            tbb::parallel_radix_sort( v.begin(), v.end() );
+            ASSERT( v == expected, "parallel_radix_sort of random values" );
+            // presorted and reversed sequences
+            tbb::parallel_radix_sort( v.begin(), v.end() );
+            ASSERT( v == expected, "parallel_radix_sort of a sorted sequence" );
+            std::reverse( v.begin(), v.end() );
+            tbb::parallel_radix_sort( v.begin(), v.end() );
+            ASSERT( v == expected, "parallel_radix_sort of a reversed sequence" );
+        }
+    }
+}
+
+#if __TBB_CPP11_DECLTYPE_PRESENT
+struct PlainItem {
+    short key;
+    int index;
+};
+
+struct PlainItemKey {
+    short operator()( const PlainItem& x ) const { return x.key; }
+};
+#endif
+
+void TestRadixSort() {
+    TestRadixSortOf<unsigned char>( "unsigned char" );
+    TestRadixSortOf<char>( "char" );
+    TestRadixSortOf<short>( "short" );
+    TestRadixSortOf<int>( "int" );
+    TestRadixSortOf<unsigned>( "unsigned" );
+    TestRadixSortOf<long long>( "long long" );
+    TestRadixSortOf<unsigned long>( "unsigned long" );
+    TestRadixSortOf<float>( "float" );
+    TestRadixSortOf<double>( "double" );
+#if __TBB_CPP11_DECLTYPE_PRESENT
+    REMARK( "testing parallel_radix_sort with a key function\n" );
+    std::vector<PlainItem> v;
+    for( int i = 0; i < 200000; ++i ) {
+        PlainItem x = { short( rand() % 2000 - 1000 ), i };
+        v.push_back( x );
+    }
+    tbb::parallel_radix_sort( v.begin(), v.end(), PlainItemKey() );
+    ValidateStable( v.begin(), v.end(), "parallel_radix_sort is not stable" );
+#endif
+}
+
 #include <cstdio>
 #include "harness_cpu.h"
 
@@ -546,6 +670,8 @@ int TestMain () {
             current_p = p;
             Flog();
             range_sort_test();
+            TestStableSort();
+            TestRadixSort();
 
             // Test that all workers sleep when no work
             TestCPUUserTime(p);
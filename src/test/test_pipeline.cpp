@@ -266,6 +266,122 @@ void TestTrivialPipeline( unsigned nthread, unsigned number_of_filters ) {
     }
 }
 
+//! Produces the sequence numbers of the items
+class SequenceInputFilter: public tbb::filter {
+    unsigned long my_count, my_limit;
+public:
+    SequenceInputFilter() : filter(tbb::filter::serial_in_order), my_count(0), my_limit(0) {}
+    void reset( unsigned long limit ) { my_count = 0; my_limit = limit; }
+    void* operator()( void* ) __TBB_override {
+        return my_count<my_limit ? (void*)(++my_count) : NULL;
+    }
+};
+
+//! Checks that a serial filter sees the items in order if it is ordered, and one at a time
+class SequenceCheckFilter: public tbb::filter {
+    tbb::atomic<unsigned long> my_expected;
+    tbb::atomic<int> my_running;
+public:
+    SequenceCheckFilter( tbb::filter::mode type ) : filter(type) { my_expected = 0; my_running = 0; }
+    void reset() { my_expected = 0; }
+    unsigned long count() const { return my_expected; }
+    void* operator()( void* item ) __TBB_override {
+        if( is_serial() )
+            ASSERT( ++my_running==1, "serial filter runs concurrently" );
+        unsigned long k = ++my_expected;
+        if( is_ordered() )
+            ASSERT( (unsigned long)item==k, "ordered filter received an item out of order" );
+        if( is_serial() )
+            --my_running;
+        return item;
+    }
+};
+
+//! Passes the items through serial filters that are separated by parallel ones, with various numbers of tokens
+/** The runs reuse the buffers of the filters, and some numbers of tokens are too large for the lock-free ring. */
+void TestSerialBuffers( unsigned nthread ) {
+    REMARK( "testing serial filters separated by parallel ones with %u threads\n", nthread );
+    const tbb::filter::mode modes[] = { tbb::filter::parallel, tbb::filter::serial_in_order,
+        tbb::filter::parallel, tbb::filter::serial_out_of_order, tbb::filter::parallel, tbb::filter::serial_in_order };
+    const unsigned n = sizeof(modes)/sizeof(modes[0]);
+    SequenceInputFilter input;
+    SequenceCheckFilter* filters[n];
+    tbb::pipeline pipeline;
+    pipeline.add_filter( input );
+    for( unsigned i=0; i<n; ++i ) {
+        filters[i] = new SequenceCheckFilter( modes[i] );
+        pipeline.add_filter( *filters[i] );
+    }
+    const size_t tokens[] = { 1, 2, 3, 4*nthread, 100, 1<<15, 7 };
+    for( unsigned k=0; k<sizeof(tokens)/sizeof(tokens[0]); ++k ) {
+        const unsigned long items = 2000;
+        input.reset( items );
+        for( unsigned i=0; i<n; ++i )
+            filters[i]->reset();
+        pipeline.run( tokens[k] );
+        for( unsigned i=0; i<n; ++i )
+            ASSERT( filters[i]->count()==items, "items are lost or duplicated" );
+    }
+    pipeline.clear();
+    for( unsigned i=0; i<n; ++i )
+        delete filters[i];
+}
+
+#if __TBB_TASK_GROUP_CONTEXT
+//! Cancels the run of the pipeline when it sees the given number of items
+class CancelFilter: public tbb::filter {
+    tbb::atomic<unsigned long> my_count;
+    unsigned long my_limit;
+public:
+    CancelFilter() : filter(tbb::filter::parallel), my_limit(0) { my_count = 0; }
+    void reset( unsigned long limit ) { my_count = 0; my_limit = limit; }
+    void* operator()( void* item ) __TBB_override {
+        if( ++my_count==my_limit )
+            tbb::task::self().cancel_group_execution();
+        return item;
+    }
+};
+
+//! Reruns the pipeline after a cancelled run, which leaves tokens that never came to the serial filters
+void TestRerunAfterCancellation( unsigned nthread ) {
+    REMARK( "testing rerun of a cancelled pipeline with %u threads\n", nthread );
+    const tbb::filter::mode modes[] = { tbb::filter::serial_in_order, tbb::filter::parallel,
+        tbb::filter::serial_out_of_order, tbb::filter::serial_in_order };
+    const unsigned n = sizeof(modes)/sizeof(modes[0]);
+    SequenceInputFilter input;
+    CancelFilter canceller;
+    SequenceCheckFilter* filters[n];
+    tbb::pipeline pipeline;
+    pipeline.add_filter( input );
+    pipeline.add_filter( canceller );
+    for( unsigned i=0; i<n; ++i ) {
+        filters[i] = new SequenceCheckFilter( modes[i] );
+        pipeline.add_filter( *filters[i] );
+    }
+    const size_t tokens[] = { 2, 4*nthread, 100, 1<<15 };
+    for( unsigned k=0; k<sizeof(tokens)/sizeof(tokens[0]); ++k ) {
+        const unsigned long items = 2000;
+        // the first run is cancelled half way, the second one must pass all the items
+        for( int pass=0; pass<2; ++pass ) {
+            const unsigned long cancel_at = pass ? 0 : items/2;
+            input.reset( items );
+            canceller.reset( cancel_at );
+            for( unsigned i=0; i<n; ++i )
+                filters[i]->reset();
+            tbb::task_group_context context;
+            pipeline.run( tokens[k], context );
+            if( cancel_at )
+                ASSERT( context.is_group_execution_cancelled(), NULL );
+            else for( unsigned i=0; i<n; ++i )
+                ASSERT( filters[i]->count()==items, "items are lost or duplicated after cancellation" );
+        }
+    }
+    pipeline.clear();
+    for( unsigned i=0; i<n; ++i )
+        delete filters[i];
+}
+#endif /* __TBB_TASK_GROUP_CONTEXT */
+
 #include "harness_cpu.h"
 
 static int nthread; // knowing number of threads is necessary to call TestCPUUserTime
@@ -300,6 +416,11 @@ int TestMain () {
         for( unsigned n=0; n<=MaxFilters; ++n )
             TestTrivialPipeline(nthread,n);
 
+        TestSerialBuffers(nthread);
+#if __TBB_TASK_GROUP_CONTEXT
+        TestRerunAfterCancellation(nthread);
+#endif
+
         // Test that all workers sleep when no work
         TestCPUUserTime(nthread);
     }
@@ -447,6 +447,24 @@ int test_serial() {
     return 0;
 }
 
+//! A batch is buffered in a single operation and forwarded in FIFO order
+void test_try_put_batch() {
+    tbb::flow::graph g;
+    tbb::flow::queue_node<int> q(g);
+    tbb::flow::queue_node<int> q2(g);
+    int items[N];
+    for ( int i = 0; i < N; ++i ) items[i] = i;
+    ASSERT( q.try_put_batch( items, N ) == N, "queue_node should accept the whole batch" );
+    ASSERT( q.try_put_batch( items, 0 ) == 0, NULL );
+    tbb::flow::make_edge( q, q2 );
+    g.wait_for_all();
+    int j;
+    for ( int i = 0; i < N; ++i ) {
+        ASSERT( q2.try_get( j ) && j == i, "the batch is not in FIFO order" );
+    }
+    ASSERT( !q.try_get( j ) && !q2.try_get( j ), "extra messages in the queues" );
+}
+
 #if __TBB_PREVIEW_FLOW_GRAPH_NODE_SET
 #include <array>
 #include <vector>
@@ -502,6 +520,7 @@ int TestMain() {
     REMARK("Testing resets\n");
     test_resets<int, tbb::flow::queue_node<int> >();
     test_resets<float, tbb::flow::queue_node<float> >();
+    test_try_put_batch();
 #if __TBB_PREVIEW_FLOW_GRAPH_NODE_SET
     test_follows_and_precedes_api();
 #endif
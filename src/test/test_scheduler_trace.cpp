@@ -0,0 +1,144 @@
+/*
+    Copyright (c) 2005-2020 Intel Corporation
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#define TBB_PREVIEW_WAITING_FOR_WORKERS 1
+#include "tbb/global_control.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/task_arena.h"
+#include "tbb/parallel_for.h"
+#include "tbb/atomic.h"
+
+#define HARNESS_CUSTOM_MAIN 1
+#include "harness.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#if !(_WIN32||_WIN64||__bg__)
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+struct SumBody : NoAssign {
+    tbb::atomic<int>& my_sum;
+    SumBody( tbb::atomic<int>& sum ) : my_sum(sum) {}
+    void operator()() const {
+        tbb::parallel_for(0, 1000, *this, tbb::simple_partitioner());
+    }
+    void operator()( int i ) const {
+        my_sum += i;
+    }
+};
+
+std::string ReadTrace( const char* file_name ) {
+    std::string trace;
+    if( std::FILE* f = std::fopen(file_name, "r") ) {
+        char buf[4096];
+        while( size_t n = std::fread(buf, 1, sizeof(buf), f) )
+            trace.append(buf, n);
+        std::fclose(f);
+    }
+    std::remove(file_name);
+    return trace;
+}
+
+void CheckTrace( const std::string& trace ) {
+    ASSERT(trace.find("{\"traceEvents\":[") == 0, "the trace is not written");
+    ASSERT(trace.find("\"thread_name\"") != std::string::npos, NULL);
+    ASSERT(trace.find("\"ph\":\"X\"") != std::string::npos, "task executions are not traced");
+    ASSERT(trace.find("\"arena enter\"") != std::string::npos, NULL);
+    ASSERT(trace.find("\"spawn\"") != std::string::npos, NULL);
+    ASSERT(trace.find("\"displayTimeUnit\"") != std::string::npos, "the trace is incomplete");
+}
+
+#if !(_WIN32||_WIN64||__bg__)
+const char* const exit_trace_name = "test_scheduler_trace_exit.json";
+
+//! The program run by the child process: the scheduler is released by the main thread just before the exit
+int RunChild() {
+    tbb::atomic<int> sum;
+    sum = 0;
+    {
+        tbb::task_scheduler_init init(2);
+        SumBody body(sum);
+        body();
+    }
+    return sum == 1000*999/2 ? 0 : 1;
+}
+
+// TBB_TRACE_FILE turns the trace on for the whole run, and the trace is written at the exit
+// even if the workers still hold the library resources at that time.
+void TestTraceWrittenAtExit( const char* self ) {
+    std::remove(exit_trace_name);
+    pid_t p = fork();
+    ASSERT(p >= 0, "fork failed");
+    if( !p ) {
+        Harness::SetEnv("TBB_TRACE_FILE", exit_trace_name);
+        execl(self, self, "child", NULL);
+        REPORT("exec fails %s: %d: %s\n", self, errno, strerror(errno));
+        exit(2);
+    }
+    int status = 1;
+    ASSERT(waitpid(p, &status, 0) == p, "wait failed");
+    ASSERT(WIFEXITED(status) && !WEXITSTATUS(status), "the child process failed");
+    CheckTrace(ReadTrace(exit_trace_name));
+}
+#endif /* !(_WIN32||_WIN64||__bg__) */
+
+// global_control::scheduler_tracing turns the trace on for a region, and the trace is written
+// when the last control is destroyed.
+void TestTraceOfRegion() {
+    const char* file_name = "test_scheduler_trace_region.json";
+    // TBB_TRACE_FILE is read by the one-time initialization, so it is set afterwards
+    // to name the file only.
+    tbb::task_arena a(2);
+    a.initialize();
+    Harness::SetEnv("TBB_TRACE_FILE", file_name);
+    std::remove(file_name);
+    ASSERT(0 == tbb::global_control::active_value(tbb::global_control::scheduler_tracing), NULL);
+    {
+        tbb::global_control c(tbb::global_control::scheduler_tracing, 1);
+        ASSERT(1 == tbb::global_control::active_value(tbb::global_control::scheduler_tracing), NULL);
+        tbb::atomic<int> sum;
+        sum = 0;
+        a.execute(SumBody(sum));
+        ASSERT(sum == 1000*999/2, NULL);
+    }
+    ASSERT(0 == tbb::global_control::active_value(tbb::global_control::scheduler_tracing), NULL);
+    Harness::SetEnv("TBB_TRACE_FILE", "");
+    CheckTrace(ReadTrace(file_name));
+}
+
+HARNESS_EXPORT
+int main( int argc, char* argv[] ) {
+#if __TBB_WIN8UI_SUPPORT
+    REPORT("skip\n");
+#else
+#if !(_WIN32||_WIN64||__bg__)
+    if( argc > 1 && !std::strcmp(argv[1], "child") )
+        return RunChild();
+    TestTraceWrittenAtExit(argv[0]);
+#else
+    (void)argc; (void)argv;
+#endif
+    TestTraceOfRegion();
+    REPORT("done\n");
+#endif /* !__TBB_WIN8UI_SUPPORT */
+    return 0;
+}
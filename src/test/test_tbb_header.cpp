@@ -24,6 +24,9 @@
 // Add testing of preview features
 #define TBB_PREVIEW_AGGREGATOR 1
 #define TBB_PREVIEW_CONCURRENT_LRU_CACHE 1
+#define TBB_PREVIEW_CONCURRENT_FLAT_MAP 1
+#define TBB_PREVIEW_CONCURRENT_RING_QUEUE 1
+#define TBB_PREVIEW_FILE_READER 1
 #define TBB_PREVIEW_VARIADIC_PARALLEL_INVOKE 1
 #define TBB_PREVIEW_FLOW_GRAPH_NODES 1
 #define TBB_PREVIEW_BLOCKED_RANGE_ND 1
@@ -192,6 +195,10 @@ static void TestPreviewNames() {
     TestTypeDefinitionPresence2(blocked_rangeNd<int,4> );
 #endif
     TestTypeDefinitionPresence2(concurrent_lru_cache<int, int> );
+    TestTypeDefinitionPresence2(concurrent_flat_map<int, int> );
+    TestTypeDefinitionPresence( concurrent_ring_queue<int> );
+    TestTypeDefinitionPresence( file_reader );
+    TestTypeDefinitionPresence( file_chunk );
     TestTypeDefinitionPresence( isolated_task_group );
 #if !__TBB_TEST_SECONDARY
     TestExceptionClassExports( std::runtime_error("test"), tbb::internal::eid_blocking_thread_join_impossible );
@@ -233,6 +240,7 @@ int TestMain ()
     TestTypeDefinitionPresence( strict_ppl::concurrent_queue<int> );
     TestTypeDefinitionPresence( concurrent_priority_queue<int> );
     TestTypeDefinitionPresence( concurrent_vector<int> );
+    TestTypeDefinitionPresence( contiguous_reserve );
     TestTypeDefinitionPresence( combinable<int> );
     TestTypeDefinitionPresence( enumerable_thread_specific<int> );
     /* Flow graph names */
@@ -301,12 +309,19 @@ int TestMain ()
     TestFuncDefinitionPresence( parallel_reduce, (const tbb::blocked_range<int>&, Body2&, tbb::affinity_partitioner&), void );
     TestFuncDefinitionPresence( parallel_deterministic_reduce, (const tbb::blocked_range<int>&, const int&, const Body2a&, const Body1b&), int );
     TestFuncDefinitionPresence( parallel_deterministic_reduce, (const tbb::blocked_range<int>&, Body2&, const tbb::static_partitioner&), void );
+    TestFuncDefinitionPresence( parallel_deterministic_reduce, (const tbb::blocked_range<int>&, Body2&, const tbb::auto_partitioner&), void );
     TestFuncDefinitionPresence( parallel_scan, (const tbb::blocked_range2d<int>&, Body3&, const tbb::auto_partitioner&), void );
     TestFuncDefinitionPresence( parallel_scan, (const tbb::blocked_range<int>&, const int&, const Body3a&, const Body1b&), int );
+    TestFuncDefinitionPresence( parallel_inclusive_scan, (int*, int*, int*), int* );
+    TestFuncDefinitionPresence( parallel_exclusive_scan, (int*, int*, int*, int), int* );
     typedef int intarray[10];
     TestFuncDefinitionPresence( parallel_sort, (int*, int*), void );
     TestFuncDefinitionPresence( parallel_sort, (intarray&, const Body1b&), void );
+    TestFuncDefinitionPresence( parallel_stable_sort, (int*, int*), void );
+    TestFuncDefinitionPresence( parallel_radix_sort, (int*, int*), void );
     TestTypeDefinitionPresence( pipeline );
+    TestTypeDefinitionPresence( filter_batch );
+    TestTypeDefinitionPresence( adaptive_token_limit );
     TestFuncDefinitionPresence( parallel_pipeline, (size_t, const tbb::filter_t<void,void>&), void );
 #if __TBB_TASK_GROUP_CONTEXT
     TestFuncDefinitionPresence( parallel_invoke, (const Body&, const Body&, tbb::task_group_context&), void );